@@ -0,0 +1,229 @@
+/*adaptive.c
+ *Entropy estimation that picks between the naive, slow and fast
+ *versions of the algorithm as the stream goes, rather than making the
+ *caller guess.
+ *
+ *The slow version does O(c) work per token but no heap or hash table
+ *work, so it is the cheapest for few samplers and starts there. Else
+ *the naive version starts: it skips between sampled tokens like the
+ *fast one but keeps no backup samples, so it is only right while no
+ *token fills more than half the stream. Every ADAPT_WINDOW tokens the
+ *running version is timed, and the naive one asks its Misra-Gries
+ *counters for a dominant token; if there is one it hands over to the
+ *fast version. The slow and fast versions trade places when the other
+ *was last measured faster by ADAPT_MARGIN, or when the running one has
+ *slowed to ADAPT_SLOWDOWN times its best and the other never ran.
+ *
+ *Switches hand the samplers, the Misra-Gries counters and the
+ *generator over (see handoff.h), so nothing already read is lost and
+ *no token is read twice. The naive version is never gone back to.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdlib.h>
+#include <math.h>
+#include <sys/time.h>
+#include "adaptivepriv.h"
+#include "util.h"
+
+static const char* adaptive_names[ADAPT_VERSIONS] = {"naive", "slow", "fast"};
+
+Adaptive_Estimator_type* Adaptive_Estimator_Init(int c, int k)
+{
+  Adaptive_Estimator_type* est = (Adaptive_Estimator_type*) safe_malloc(sizeof(Adaptive_Estimator_type));
+  est->c = c;
+  est->k = k;
+  est->count = 0;
+  est->naive = NULL;
+  est->slow = NULL;
+  est->fast = NULL;
+  if(c <= ADAPT_SLOW_C)
+  {
+    est->version = ADAPT_SLOW;
+    est->slow = Slow_Estimator_Init(c, k);
+  }
+  else
+  {
+    est->version = ADAPT_NAIVE;
+    est->naive = Naive_Estimator_Init(c, k);
+  }
+  for(int i = 0; i < ADAPT_VERSIONS; i++)
+  {
+    est->rate[i] = est->best[i] = 0;
+  }
+  est->switches = 0;
+  est->since = 0;
+  est->start = adaptive_usec();
+  return est;
+}
+
+void Adaptive_Estimator_Destroy(Adaptive_Estimator_type* est)
+{
+  if(est->naive) Naive_Estimator_Destroy(est->naive);
+  if(est->slow) Slow_Estimator_Destroy(est->slow);
+  if(est->fast) Estimator_Destroy(est->fast);
+  free(est);
+}
+
+//size of the running version plus this front-end
+int Adaptive_Estimator_Size(Adaptive_Estimator_type* est)
+{
+  int admin = sizeof(Adaptive_Estimator_type);
+  if(est->naive) return admin + Naive_Estimator_Size(est->naive);
+  if(est->slow) return admin + Slow_Estimator_Size(est->slow);
+  return admin + Estimator_Size(est->fast);
+}
+
+void Adaptive_Estimator_Update(Adaptive_Estimator_type* est, int token)
+{
+  est->count++;
+  switch(est->version)
+  {
+    case ADAPT_NAIVE: Naive_Estimator_Update(est->naive, token); break;
+    case ADAPT_SLOW: Slow_Estimator_Update(est->slow, token); break;
+    default: Estimator_Update(est->fast, token);
+  }
+  if(++est->since == ADAPT_WINDOW)
+    adaptive_check(est);
+}
+
+double Adaptive_Estimator_end_stream(Adaptive_Estimator_type* est)
+{
+  if(est->naive) return Naive_Estimator_end_stream(est->naive);
+  if(est->slow) return Slow_Estimator_end_stream(est->slow);
+  return Estimator_end_stream(est->fast);
+}
+
+//name of the running version
+const char* Adaptive_Estimator_Version(Adaptive_Estimator_type* est)
+{
+  return adaptive_names[est->version];
+}
+
+//how many times the running version has changed
+int Adaptive_Estimator_Switches(Adaptive_Estimator_type* est)
+{
+  return est->switches;
+}
+
+static long adaptive_usec()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000000L + tv.tv_usec;
+}
+
+//end of a window: time it and decide whether to change versions
+static void adaptive_check(Adaptive_Estimator_type* est)
+{
+  long now = adaptive_usec();
+  double ns = (now - est->start) * 1000.0 / est->since;
+  int v = est->version, next = v, token, count;
+
+  est->rate[v] = ns;
+  if(est->best[v] == 0 || ns < est->best[v])
+    est->best[v] = ns;
+
+  //the fastest of the others as last measured, if it beats this window
+  //by the margin
+  for(int i = ADAPT_SLOW; i <= ADAPT_FAST; i++)
+  {
+    if(i != v && est->rate[i] > 0 && est->rate[i] * ADAPT_MARGIN < ns &&
+       (next == v || est->rate[i] < est->rate[next]))
+      next = i;
+  }
+  //else one never tried, once this one has slowed down
+  if(next == v && ns > ADAPT_SLOWDOWN * est->best[v])
+  {
+    if(v != ADAPT_FAST && est->rate[ADAPT_FAST] == 0) next = ADAPT_FAST;
+    else if(v != ADAPT_SLOW && est->rate[ADAPT_SLOW] == 0) next = ADAPT_SLOW;
+  }
+  if(v == ADAPT_NAIVE && next == v &&
+     Naive_Estimator_Dominant(est->naive, &token, &count))
+    next = ADAPT_FAST;
+
+  if(next != v)
+    adaptive_switch(est, next);
+  est->since = 0;
+  est->start = adaptive_usec();
+}
+
+//hand the running version's samplers over to version
+static void adaptive_switch(Adaptive_Estimator_type* est, int version)
+{
+  Sampler_handoff h;
+
+  switch(est->version)
+  {
+    case ADAPT_NAIVE:
+      Naive_Estimator_Handoff(est->naive, &h);
+      est->naive = NULL;
+      adaptive_fill_backups(&h);
+      break;
+    case ADAPT_SLOW:
+      Slow_Estimator_Handoff(est->slow, &h);
+      est->slow = NULL;
+      break;
+    default:
+      Estimator_Handoff(est->fast, &h);
+      est->fast = NULL;
+  }
+  if(version == ADAPT_SLOW)
+    est->slow = Slow_Estimator_Init_From_Handoff(&h);
+  else
+    est->fast = Estimator_Init_From_Handoff(&h);
+  est->version = version;
+  est->switches++;
+}
+
+static int adaptive_ref_cmp(const void* p, const void* q)
+{
+  int a = ((const adaptive_ref*) p)->s0;
+  int b = ((const adaptive_ref*) q)->s0;
+  return (a==b) ? 0 : (a<b) ? -1 : 1;
+}
+
+//the naive version keeps no backups, so they are drawn here. The
+//primary sample of a sampler that turned out not to hold token s is a
+//uniform position among those not holding s, which is what a backup
+//for a sampler on s is, so each sampler borrows the token and count of
+//another one, picked uniformly from those on other tokens. Its rank is
+//the least of those positions' above t0; there are about m(1 - g/c)
+//for the g samplers on s. If every sampler holds the same token none
+//gets a backup
+static void adaptive_fill_backups(Sampler_handoff* h)
+{
+  adaptive_ref* refs;
+  Sample_state* st;
+  int lo, hi, others, x;
+  double rest;
+
+  if(h->count == 0) return;
+  refs = (adaptive_ref*) safe_malloc(h->c * sizeof(adaptive_ref));
+  for(int i = 0; i < h->c; i++)
+  {
+    refs[i].s0 = h->samplers[i].s0;
+    refs[i].index = i;
+  }
+  qsort(refs, h->c, sizeof(adaptive_ref), adaptive_ref_cmp);
+
+  for(lo = 0; lo < h->c; lo = hi)
+  {
+    for(hi = lo+1; hi < h->c && refs[hi].s0 == refs[lo].s0; hi++);
+    others = h->c - (hi - lo);
+    if(others == 0) break;
+    rest = maximum((double) h->count * others / h->c, 1);
+    for(int i = lo; i < hi; i++)
+    {
+      st = &h->samplers[refs[i].index];
+      x = (int) (prng_float(h->prng) * others) % others;
+      if(x >= lo) x += hi - lo;
+      st->s1 = h->samplers[refs[x].index].s0;
+      st->r1 = h->samplers[refs[x].index].r0;
+      st->t1 = st->t0 + (1 - st->t0) * (1 - pow(prng_float(h->prng), 1.0/rest));
+    }
+  }
+  free(refs);
+}
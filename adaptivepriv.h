@@ -0,0 +1,39 @@
+#ifndef ADAPTIVEPRIV_H
+#define ADAPTIVEPRIV_H
+#include "adaptivepub.h"
+#include "entropypub.h"
+#include "naivepub.h"
+#include "slowentropypub.h"
+
+#define maximum(x,y)	((x) > (y) ? (x) : (y))
+
+#define ADAPT_WINDOW 65536  //tokens between looks at the throughput
+#define ADAPT_SLOW_C 128    //most samplers the slow version starts with
+#define ADAPT_SLOWDOWN 1.5  //drop from the best rate that tries another version
+#define ADAPT_MARGIN 1.25   //how much faster another version must have run
+
+enum { ADAPT_NAIVE, ADAPT_SLOW, ADAPT_FAST, ADAPT_VERSIONS };
+
+struct Adaptive_Estimator_type{
+  int c, k, count;
+  int version;             //the one running; only its estimator is set
+  Naive_Estimator_type* naive;
+  Slow_Estimator_type* slow;
+  Estimator_type* fast;
+  int since;               //tokens read in this window
+  long start;              //when the window began, in microseconds
+  double rate[ADAPT_VERSIONS]; //ns per token in each version's last window
+  double best[ADAPT_VERSIONS]; //and in its best, 0 if it never ran
+  int switches;
+};
+
+typedef struct adaptive_ref{
+  int s0, index;
+} adaptive_ref;
+
+static long adaptive_usec();
+static void adaptive_check(Adaptive_Estimator_type* est);
+static void adaptive_switch(Adaptive_Estimator_type* est, int version);
+static void adaptive_fill_backups(Sampler_handoff* h);
+
+#endif
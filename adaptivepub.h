@@ -0,0 +1,14 @@
+#ifndef ADAPTIVEPUB_H
+#define ADAPTIVEPUB_H
+
+typedef struct Adaptive_Estimator_type Adaptive_Estimator_type;
+
+extern Adaptive_Estimator_type* Adaptive_Estimator_Init(int c, int k);
+extern void Adaptive_Estimator_Destroy(Adaptive_Estimator_type* est);
+extern int Adaptive_Estimator_Size(Adaptive_Estimator_type* est);
+extern void Adaptive_Estimator_Update(Adaptive_Estimator_type* est, int token);
+extern double Adaptive_Estimator_end_stream(Adaptive_Estimator_type* est);
+extern const char* Adaptive_Estimator_Version(Adaptive_Estimator_type* est);
+extern int Adaptive_Estimator_Switches(Adaptive_Estimator_type* est);
+
+#endif
@@ -5,7 +5,15 @@
  *in the length array and zipf array, outputting results in two files:
  *timevlength and timevzipf. These two files contain the same information,
  *but the results are ordered differently so it's easier to isolate the
- *desired independent variable in any graphs a user creates*/
+ *desired independent variable in any graphs a user creates.
+ *
+ *The cells of the grid, and -T repeated trials of each cell, run on a
+ *work-stealing pool of -p threads pinned to cores. Each cell generates
+ *its stream and then submits its trials to the pool, so idle threads
+ *steal trials of the long streams. With -i timed regions run one at a
+ *time so concurrent trials don't disturb each other's timings; stream
+ *generation still overlaps. A cell reports the median time and mean
+ *estimate of its trials.*/
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -14,10 +22,12 @@
 #include <unistd.h>
 #include <errno.h>
 #include <ctype.h>
+#include <pthread.h>
 #include "massdal.h"
 #include "entropypub.h"
 #include "slowentropypub.h"
 #include "naivepub.h"
+#include "pool.h"
 #include "util.h"
 
 #define INVALID_TOKEN INT_MIN
@@ -37,13 +47,46 @@ typedef struct entry{
   double estimated_ent;
   int time;
   int space;
+  long seed;   //srand48 seed of the trial's estimator
 } entry;
 
+typedef void (*handler_fn)(int* stream, int c, int k, int length, entry* the_entry);
+
+//one cell of the length x zipf grid
+typedef struct cell_type{
+  int l_index, z_index;
+  int c, k, range;
+  handler_fn handler;
+  int* stream;
+  int trials;
+  entry* trial;   //result of each trial
+  int remaining;  //trials still running; the last one reports the cell
+  entry* result;
+} cell_type;
+
+typedef struct trial_type{
+  cell_type* cell;
+  int index;
+} trial_type;
+
 int length[L_MAX]= {100000, 500000, MB, 3*MB, 5*MB, 10*MB}; 
 double zipf[Z_MAX]={1.001, 1.5, 2.0, 2.5, 3.0, 3.5, 4.0};
 
+static Pool_type* pool;
+static int isolate;
+//serializes timed regions when isolate is set
+static pthread_mutex_t timing_lock = PTHREAD_MUTEX_INITIALIZER;
+//the estimators seed themselves from lrand48(), which is not thread safe
+static pthread_mutex_t init_lock = PTHREAD_MUTEX_INITIALIZER;
+
 static int * CreateStream(int the_length, entry* the_entry, double zipfpar, int range);
-static void CheckArguments(int argc, char **argv, int*, int*, int*, double*, double*, int*); 
+static void CheckArguments(int argc, char **argv, int*, int*, int*, double*, double*, int*,
+                           int*, int*, int*);
+static void Run_Cell(void* arg);
+static void Run_Trial(void* arg);
+static void Finish_Cell(cell_type* cell);
+static void Begin_Timing(void);
+static long End_Timing(void);
 static void Fast_Handle_stream(int* stream, int c, int k, int range, entry* the_entry);
 static void Slow_Handle_stream(int* stream, int c, int k, int range, entry* the_entry);
 static void Naive_Handle_stream(int* stream, int c, int k, int range, entry* the_entry);
@@ -54,8 +97,11 @@ int main(int argc, char **argv)
   double delta = DELTA_DEFAULT;
   int range = RANGE_DEFAULT;
   int fflag, sflag, nflag;
+  int threads, trials;
+  handler_fn handler;
   
-  CheckArguments(argc, argv, &fflag, &nflag, &sflag, &eps, &delta, &range);
+  CheckArguments(argc, argv, &fflag, &nflag, &sflag, &eps, &delta, &range,
+                 &threads, &trials, &isolate);
 
   FILE* time_v_length = fopen("timevlength", "w");
   if(time_v_length == NULL)
@@ -80,71 +126,49 @@ int main(int argc, char **argv)
     values[i] = (entry*) malloc(Z_MAX * sizeof(struct entry));
   }
   
-  int c, k;
-  int* stream;
   entry* cur_entry;
+  cell_type* cells = (cell_type*) safe_malloc(L_MAX * Z_MAX * sizeof(cell_type));
 
   if(fflag)
+    handler = Fast_Handle_stream;
+  else if(nflag)
+    handler = Naive_Handle_stream;
+  else
+    handler = Slow_Handle_stream;
+
+  //only pin when there is more than one worker to spread out
+  pool = Pool_Init(threads, threads > 1);
+  //submit the longest streams first so they don't finish last
+  for(int l_index = L_MAX-1; l_index >= 0; l_index--)
   {
     for(int z_index = 0; z_index<Z_MAX; z_index++)
     {
-      for(int l_index = 0; l_index<L_MAX; l_index++)
-	  {
-	    fprintf(stderr, "starting new stream\n");
-	    c = ceil(16 * 1/(eps*eps) * log(2/delta) * log(length[l_index] * M_E));
-        k = ceil(7/eps);
-	    cur_entry = &(values[l_index][z_index]);
-	    stream = CreateStream(length[l_index], cur_entry, zipf[z_index], range);
-	    Fast_Handle_stream(stream, c, k, length[l_index], cur_entry);
-	    free(stream);
-	  
-	    //time_v_length results should be in groups of fixed zipfpars
-	    fprintf(time_v_length, "%5f\t%d\t%d\t%d\t%5f\t%5f\n", zipf[z_index], length[l_index],
-	                          cur_entry->time, cur_entry->space, cur_entry->exact_ent,
-							  cur_entry->estimated_ent);
-	  }
-    }
-  }
-  if(nflag)
-  {
-    for(int z_index = 0; z_index<Z_MAX; z_index++)
-    {
-      for(int l_index = 0; l_index<L_MAX; l_index++)
-	  {
-	    fprintf(stderr, "starting new stream\n");
-	    c = ceil(16 * 1/(eps*eps) * log(2/delta) * log(length[l_index] * M_E));
-        k = ceil(7/eps);
-	    cur_entry = &(values[l_index][z_index]);
-	    stream = CreateStream(length[l_index], cur_entry, zipf[z_index], range);
-	    Naive_Handle_stream(stream, c, k, length[l_index], cur_entry);
-	    free(stream);
-	  
-	    //time_v_length results should be in groups of fixed zipfpars
-	    fprintf(time_v_length, "%5f\t%d\t%d\t%d\t%5f\t%5f\n", zipf[z_index], length[l_index],
-	                          cur_entry->time, cur_entry->space, cur_entry->exact_ent,
-							  cur_entry->estimated_ent);
-	  }
+      cell_type* cell = &cells[l_index * Z_MAX + z_index];
+      cell->l_index = l_index;
+      cell->z_index = z_index;
+      cell->c = ceil(16 * 1/(eps*eps) * log(2/delta) * log(length[l_index] * M_E));
+      cell->k = ceil(7/eps);
+      cell->range = range;
+      cell->handler = handler;
+      cell->trials = trials;
+      cell->trial = (entry*) safe_malloc(trials * sizeof(entry));
+      cell->remaining = trials;
+      cell->result = &(values[l_index][z_index]);
+      Pool_Submit(pool, Run_Cell, cell);
     }
   }
-  if(sflag)
+  Pool_Wait(pool);
+  Pool_Destroy(pool);
+
+  //time_v_length results should be in groups of fixed zipfpars
+  for(int z_index = 0; z_index<Z_MAX; z_index++)
   {
-    for(int z_index = 0; z_index<Z_MAX; z_index++)
+    for(int l_index = 0; l_index<L_MAX; l_index++)
     {
-      for(int l_index = 0; l_index<L_MAX; l_index++)
-	  {
-	    fprintf(stderr, "starting new stream\n");
-	    c = ceil(16 * 1/(eps*eps) * log(2/delta) * log(length[l_index] * M_E));
-        k = ceil(7/eps);
-	    cur_entry = &(values[l_index][z_index]);
-	    stream = CreateStream(length[l_index], cur_entry, zipf[z_index], range);
-	    Slow_Handle_stream(stream, c, k, length[l_index], cur_entry);
-	    free(stream);
-	  
-	    //time_v_length results should be in groups of fixed zipfpars
-	    fprintf(time_v_length, "%5f\t%d\t%d\t%d\t%5f\t%5f\n", zipf[z_index], length[l_index],
+      cur_entry = &(values[l_index][z_index]);
+      fprintf(time_v_length, "%5f\t%d\t%d\t%d\t%5f\t%5f\n", zipf[z_index], length[l_index],
 	                          cur_entry->time, cur_entry->space, cur_entry->exact_ent,
 							  cur_entry->estimated_ent);
-	  }
     }
   }
   //finally output time_v_zipf
@@ -163,22 +187,102 @@ int main(int argc, char **argv)
   fclose(time_v_length);
   fclose(time_v_zipf);
 
+  for(int i = 0; i < L_MAX * Z_MAX; i++)
+    free(cells[i].trial);
+  free(cells);
+  for(int i = 0; i < L_MAX; i++)
+    free(values[i]);
+  free(values);
   return 0;
 }
 
+//pool task: create the stream of a cell and submit its trials
+static void Run_Cell(void* arg)
+{
+  cell_type* cell = (cell_type*) arg;
+
+  fprintf(stderr, "starting new stream\n");
+  cell->stream = CreateStream(length[cell->l_index], cell->result,
+                              zipf[cell->z_index], cell->range);
+  for(int i = 0; i < cell->trials; i++)
+  {
+    trial_type* trial = (trial_type*) safe_malloc(sizeof(trial_type));
+    trial->cell = cell;
+    trial->index = i;
+    Pool_Submit(pool, Run_Trial, trial);
+  }
+}
+
+//pool task: one run of the estimator over the stream of a cell
+static void Run_Trial(void* arg)
+{
+  trial_type* trial = (trial_type*) arg;
+  cell_type* cell = trial->cell;
+
+  //each trial of a cell samples its own positions, whichever thread
+  //runs it
+  cell->trial[trial->index].seed = trial->index + 1;
+
+  cell->handler(cell->stream, cell->c, cell->k, length[cell->l_index],
+                &cell->trial[trial->index]);
+  free(trial);
+  if(__atomic_sub_fetch(&cell->remaining, 1, __ATOMIC_ACQ_REL) == 0)
+    Finish_Cell(cell);
+}
+
+//called by the last trial of a cell: median time, mean estimate
+static void Finish_Cell(cell_type* cell)
+{
+  int* times = (int*) safe_malloc((cell->trials + 1) * sizeof(int));
+  double estimated = 0;
+
+  for(int i = 0; i < cell->trials; i++)
+  {
+    //MedSelect indexes from 1
+    times[i+1] = cell->trial[i].time;
+    estimated += cell->trial[i].estimated_ent;
+  }
+  cell->result->time = MedSelect((cell->trials + 1)/2, cell->trials, times);
+  cell->result->space = cell->trial[0].space;
+  cell->result->estimated_ent = estimated / cell->trials;
+  free(times);
+  free(cell->stream);
+  cell->stream = NULL;
+}
+
+//the clock is thread-local; with isolate set only one thread is
+//inside a timed region at a time
+static void Begin_Timing(void)
+{
+  if(isolate) pthread_mutex_lock(&timing_lock);
+  StartTheClock();
+}
+
+static long End_Timing(void)
+{
+  long ms = StopTheClock();
+  if(isolate) pthread_mutex_unlock(&timing_lock);
+  return ms;
+}
+
 //compute entropy ofstream w/ c samplers and
 // k counters for use by Misra-Gries alg
 //uses fast implementation of algorithm
 static void Fast_Handle_stream(int* stream, int c, int k, int length, entry* the_entry)
 {
-  Estimator_type* est = Estimator_Init(c, k);  
+  Estimator_type* est;
+
+  pthread_mutex_lock(&init_lock);
+  srand48(the_entry->seed);
+  est = Estimator_Init(c, k);
+  pthread_mutex_unlock(&init_lock);
   
-  StartTheClock();
+  Begin_Timing();
   for(int i = 0; i < length; i++)
   {
 	Estimator_Update(est, stream[i]);
   }
-  the_entry->time = StopTheClock();
+  the_entry->time = End_Timing();
   the_entry->space = Estimator_Size(est);
   //reached end of stream
   the_entry->estimated_ent= Estimator_end_stream(est);
@@ -190,14 +294,19 @@ static void Fast_Handle_stream(int* stream, int c, int k, int length, entry* the
 //uses naive implementation of algorithm
 static void Naive_Handle_stream(int* stream, int c, int k, int length, entry* the_entry)
 {
-  Naive_Estimator_type* est = Naive_Estimator_Init(c, k);  
+  Naive_Estimator_type* est;
+
+  pthread_mutex_lock(&init_lock);
+  srand48(the_entry->seed);
+  est = Naive_Estimator_Init(c, k);
+  pthread_mutex_unlock(&init_lock);
   
-  StartTheClock();
+  Begin_Timing();
   for(int i = 0; i < length; i++)
   {
 	Naive_Estimator_Update(est, stream[i]);
   }
-  the_entry->time = StopTheClock();
+  the_entry->time = End_Timing();
   the_entry->space = Naive_Estimator_Size(est);
   //reached end of stream
   the_entry->estimated_ent= Naive_Estimator_end_stream(est);
@@ -208,14 +317,19 @@ static void Naive_Handle_stream(int* stream, int c, int k, int length, entry* th
 //w/ c samplers and k counters for use by Misra-Gries alg
 static void Slow_Handle_stream(int* stream, int c, int k, int length, entry* the_entry)
 {
-  Slow_Estimator_type* est = Slow_Estimator_Init(c, k);  
+  Slow_Estimator_type* est;
+
+  pthread_mutex_lock(&init_lock);
+  srand48(the_entry->seed);
+  est = Slow_Estimator_Init(c, k);
+  pthread_mutex_unlock(&init_lock);
   
-  StartTheClock();
+  Begin_Timing();
   for(int i = 0; i < length; i++)
   {
 	Slow_Estimator_Update(est, stream[i]);
   }
-  the_entry->time = StopTheClock();
+  the_entry->time = End_Timing();
   the_entry->space = Slow_Estimator_Size(est);
   //reached end of stream
   the_entry->estimated_ent= Slow_Estimator_end_stream(est);
@@ -272,14 +386,17 @@ int* CreateStream(int the_length, entry* the_entry, double zipfpar, int range)
 //as specified and the other two as 0 (default: fflag set to 1). Also 
 //sets eps and delta if specified. Does error checking on command line args
 static void CheckArguments(int argc, char **argv, int* fflag, int* nflag,
-					int* sflag, double* eps, double* delta, int* range) {
+					int* sflag, double* eps, double* delta, int* range,
+					int* threads, int* trials, int* isolate) {
   
   int next;
   //set defaults
   *fflag = *nflag = *sflag = 0;
   *eps = *delta = .1;
+  *threads = *trials = 1;
+  *isolate = 0;
 	  
-  while ((next = getopt (argc, argv, "fnse:d:")) != -1)
+  while ((next = getopt (argc, argv, "fnse:d:p:T:i")) != -1)
   {     
 	switch (next)
 	{
@@ -327,6 +444,23 @@ static void CheckArguments(int argc, char **argv, int* fflag, int* nflag,
 		 exit(1);
 	   }
 	   break; 
+	  case 'p':
+	   *threads = (int)strtol(optarg, (char **)NULL, 10);
+	   if(*threads <= 0){
+		 fprintf(stderr, "number of threads must be positive\n");
+		 exit(1);
+	   }
+	   break;
+	  case 'T':
+	   *trials = (int)strtol(optarg, (char **)NULL, 10);
+	   if(*trials <= 0){
+		 fprintf(stderr, "number of trials must be positive\n");
+		 exit(1);
+	   }
+	   break;
+	  case 'i':
+	   *isolate = 1;
+	   break;
    	  case '?':
 	   if (isprint (optopt))
 		fprintf (stderr, "Unknown option `-%c'.\n", optopt);
@@ -69,6 +69,25 @@ int cur_size_bheap(backup_heap* h)
   return h->cursize;
 }
 
+/* -------------------------------------------------------------------
+ * replace the contents of the heap with the n values, which must
+ * already be in heap order, keeping capacity for maxsize nodes. Each
+ * value's backup_pos is set to its position
+ */
+void load_bheap( backup_heap* h, c_a** values, int n, int maxsize )
+{
+  if (maxsize <= n) maxsize = n+1;
+  if (maxsize != h->maxsize) {
+    h->maxsize = maxsize;
+    h->node = safe_realloc( h->node, h->maxsize * sizeof(c_a*) );
+  }
+  h->cursize = n;
+  for (int i = 0; i < n; i++) {
+    h->node[ root+i ] = values[ i ];
+    values[ i ]->backup_pos = root+i;
+  }
+}
+
 /* -------------------------------------------------------------------
  * insert element at end of heap and fixup heap by walk towards root
  */
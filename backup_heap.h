@@ -37,6 +37,7 @@ void restore_bheap_property( backup_heap* h, int index);
 void delete_pos_bheap(backup_heap* h, int index);
 int sizeof_bheap(backup_heap* h);
 int cur_size_bheap(backup_heap* h);
+void load_bheap( backup_heap*, c_a** values, int n, int maxsize );
 void print_bheap(backup_heap* h);
 void test_bheap(backup_heap* h);
 #endif
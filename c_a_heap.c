@@ -66,6 +66,25 @@ int cur_size_c_a_heap(c_a_heap* h)
   return h->cursize;
 }
 
+/* -------------------------------------------------------------------
+ * replace the contents of the heap with the n values, which must
+ * already be in heap order, keeping capacity for maxsize nodes. Each
+ * value's c_s0_pos is set to its position
+ */
+void load_c_a_heap( c_a_heap* h, Sample_type** values, int n, int maxsize )
+{
+  if (maxsize <= n) maxsize = n+1;
+  if (maxsize != h->maxsize) {
+    h->maxsize = maxsize;
+    h->node = safe_realloc( h->node, h->maxsize * sizeof(Sample_type*) );
+  }
+  h->cursize = n;
+  for (int i = 0; i < n; i++) {
+    h->node[ root+i ] = values[ i ];
+    values[ i ]->c_s0_pos = root+i;
+  }
+}
+
 /* -------------------------------------------------------------------
  * insert element at end of heap and fixup heap by walk towards root
  * any Sample_type whose position in the heap changes will have the change
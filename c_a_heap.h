@@ -33,6 +33,7 @@ void delete_pos_c_a_heap(c_a_heap* h, int index);
 void restore_c_a_heap_property( c_a_heap* h, int index);
 int sizeof_c_a_heap(c_a_heap* h);
 int cur_size_c_a_heap(c_a_heap* h);
+void load_c_a_heap( c_a_heap*, Sample_type** values, int n, int maxsize );
 void print_c_a_heap(c_a_heap* h);
 void test_heap(c_a_heap* h);
 void print_c_a_heapspec(c_a_heap* h, int index);
@@ -0,0 +1,72 @@
+/*cross.c
+ *Cross-entropy and KL divergence of a stream P against a reference
+ *distribution Q (reference.c):
+ *  H(P, Q) = -sum p_i log2 q_i    D(P || Q) = H(P, Q) - H(P)
+ *The cross-entropy is the mean of -log2 q(token) over the stream, so
+ *it is kept exactly with one table lookup per token. H(P) comes from
+ *the fast estimator of entropy.c run on the same tokens. D(P || Q) is
+ *not the exact H(P, Q) less that estimate, which would carry all of
+ *its error: it is estimated from the same samplers, each adding the
+ *cost of its token less its term of H(P), so the error from which
+ *tokens were sampled shows up in both parts and cancels.
+ */
+
+#include <stdlib.h>
+#include <math.h>
+#include "crosspriv.h"
+#include "util.h"
+
+static double cross_cost(void* ref, int token);
+
+//ref must outlive the estimator; several estimators may share it
+Cross_Estimator_type* Cross_Estimator_Init(int c, int k, Reference_type* ref)
+{
+  Cross_Estimator_type* est = (Cross_Estimator_type*) safe_malloc(sizeof(Cross_Estimator_type));
+  est->ref = ref;
+  est->est = Estimator_Init(c, k);
+  est->count = 0;
+  est->sum = est->carry = 0;
+  return est;
+}
+
+void Cross_Estimator_Destroy(Cross_Estimator_type* est)
+{
+  Estimator_Destroy(est->est);
+  free(est);
+}
+
+//the reference is counted where it is owned
+int Cross_Estimator_Size(Cross_Estimator_type* est)
+{
+  return sizeof(Cross_Estimator_type) + Estimator_Size(est->est);
+}
+
+void Cross_Estimator_Update(Cross_Estimator_type* est, int token)
+{
+  //Kahan summation: billions of costs of similar size add up in
+  //double without losing the last ones
+  double y = Reference_Cost(est->ref, token) - est->carry;
+  double t = est->sum + y;
+  est->carry = (t - est->sum) - y;
+  est->sum = t;
+  est->count++;
+  Estimator_Update(est->est, token);
+}
+
+//end of stream reached. Returns the cross-entropy H(P, Q) and sets
+//the estimated entropy H(P) and divergence D(P || Q), all in bits.
+//D is at least 0, so the estimate is clamped there
+double Cross_Estimator_end_stream(Cross_Estimator_type* est, double* entropy,
+                                  double* kl)
+{
+  double cross = est->count > 0 ? est->sum / est->count : 0;
+
+  if(entropy != NULL) *entropy = Estimator_end_stream(est->est);
+  if(kl != NULL) *kl = fmax(0, Estimator_Divergence(est->est, cross_cost, est->ref));
+  return cross;
+}
+
+static double cross_cost(void* ref, int token)
+{
+  return Reference_Cost((Reference_type*) ref, token);
+}
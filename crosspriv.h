@@ -0,0 +1,13 @@
+#ifndef CROSSPRIV_H
+#define CROSSPRIV_H
+#include "crosspub.h"
+#include "entropypub.h"
+
+struct Cross_Estimator_type{
+  Reference_type* ref;     //not owned
+  Estimator_type* est;     //entropy of the stream itself
+  long count;
+  double sum, carry;       //sum of -log2 q(token), compensated
+};
+
+#endif
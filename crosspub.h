@@ -0,0 +1,14 @@
+#ifndef CROSSPUB_H
+#define CROSSPUB_H
+#include "reference.h"
+
+typedef struct Cross_Estimator_type Cross_Estimator_type;
+
+extern Cross_Estimator_type* Cross_Estimator_Init(int c, int k, Reference_type* ref);
+extern void Cross_Estimator_Destroy(Cross_Estimator_type* est);
+extern int Cross_Estimator_Size(Cross_Estimator_type* est);
+extern void Cross_Estimator_Update(Cross_Estimator_type* est, int token);
+extern double Cross_Estimator_end_stream(Cross_Estimator_type* est, double* entropy,
+                                         double* kl);
+
+#endif
@@ -0,0 +1,311 @@
+/*decay.c
+ *Exponentially time-decayed entropy: a token seen at time t counts
+ *with weight 2^-((now - t)/half_life), so the estimate follows the
+ *recent stream and forgets the old one smoothly.
+ *
+ *Weights use forward decay (Cormode et al. 2009): a token gets weight
+ *exp(lambda (t - landmark)) once, when it arrives, and nothing stored
+ *is ever touched to age it. The decayed entropy only depends on ratios
+ *of weights, so the common factor exp(-lambda (now - landmark)) never
+ *needs applying. When weights get too large to hold the landmark moves
+ *forward and everything stored is scaled down once (decay_rebase),
+ *every few hundred half-lives.
+ *
+ *The estimator is the one of entropy.c with weights. Each of c samplers
+ *holds a position sampled with probability proportional to its weight
+ *(Efraimidis and Spirakis' weighted reservoir with exponential jumps),
+ *and R, the weight of its token from that position on; with G the
+ *total weight and w the position's weight,
+ *  X = (R log(G/R) - (R-w) log(G/(R-w))) / w
+ *averages to the entropy. As in the fast estimator each sampler knows
+ *in advance when it will next be replaced, here as a total weight, and
+ *a heap on that keeps an update to O(1) unless a sampler is replaced.
+ *A token holding more than half the weight, found with weighted
+ *Misra-Gries counters, is left out of the samples and accounted for
+ *exactly.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <float.h>
+#include <limits.h>
+#include "decaypriv.h"
+#include "prng.h"
+#include "util.h"
+
+Decay_Estimator_type* Decay_Estimator_Init(int c, int k, double half_life)
+{
+  Decay_Estimator_type* est = (Decay_Estimator_type*) safe_malloc(sizeof(Decay_Estimator_type));
+  prng_type* prng;
+
+  est->c = c;
+  est->k = k;
+  est->lambda = log(2) / half_life;
+  est->landmark = 0;
+  est->total = 0;
+  est->count = 0;
+
+  prng = prng_Init(lrand48(), 2);
+  est->rng = ((unsigned long long) prng_int(prng) << 32 ^ prng_int(prng)) | 1;
+  est->a = (long long) (prng_int(prng) & MOD);
+  est->b = (long long) (prng_int(prng) & MOD);
+  prng_Destroy(prng);
+
+  //empty samplers have key 0 and take the first position
+  est->samplers = (Decay_Sample*) safe_malloc(c * sizeof(Decay_Sample));
+  est->next_heap = new_heap(decay_next_comp, c+2);
+  for(int i = 0; i < c; i++)
+  {
+    est->samplers[i].entry = NULL;
+    est->samplers[i].base = est->samplers[i].w = 0;
+    est->samplers[i].log_key = -INFINITY;
+    est->samplers[i].next_at = 0;
+    insert_heap(est->next_heap, &est->samplers[i]);
+  }
+
+  est->table_size = 2*c > 0 ? 2*c : 1;
+  est->table = (decay_entry**) safe_malloc(est->table_size * sizeof(decay_entry*));
+  for(int i = 0; i < est->table_size; i++)
+    est->table[i] = NULL;
+  est->entries = 0;
+
+  est->nfreq = 0;
+  est->freq_items = (int*) safe_malloc(k * sizeof(int));
+  est->freq_weights = (double*) safe_malloc(k * sizeof(double));
+  return est;
+}
+
+void Decay_Estimator_Destroy(Decay_Estimator_type* est)
+{
+  decay_entry *e, *next;
+  for(int i = 0; i < est->table_size; i++)
+  {
+    for(e = est->table[i]; e != NULL; e = next)
+    {
+      next = e->next;
+      free(e);
+    }
+  }
+  free(est->table);
+  free_heap(est->next_heap);
+  free(est->samplers);
+  free(est->freq_items);
+  free(est->freq_weights);
+  free(est);
+}
+
+int Decay_Estimator_Size(Decay_Estimator_type* est)
+{
+  return sizeof(Decay_Estimator_type) + est->c * sizeof(Decay_Sample) +
+         sizeof_heap(est->next_heap) + est->table_size * sizeof(decay_entry*) +
+         est->entries * sizeof(decay_entry) + est->k * (sizeof(int) + sizeof(double));
+}
+
+//token seen at time. Times may arrive out of order: a token's weight
+//depends only on its own time
+void Decay_Estimator_Update(Decay_Estimator_type* est, double time, int token)
+{
+  Decay_Sample* s;
+  decay_entry* e;
+  double x, w, before, tw;
+
+  if(est->count == 0)
+    est->landmark = time;
+  x = est->lambda * (time - est->landmark);
+  if(x > DECAY_REBASE)
+  {
+    decay_rebase(est, time);
+    x = 0;
+  }
+  w = exp(x);
+  est->count++;
+  est->total += w;
+  decay_freq_update(est, token, w);
+
+  e = decay_find(est, token);
+  before = 0;
+  if(e != NULL)
+  {
+    before = e->weight;
+    e->weight += w;
+  }
+
+  //replace every sampler whose jump ends at this position
+  while((s = (Decay_Sample*) peek_min(est->next_heap))->next_at <= est->total)
+  {
+    delete_min(est->next_heap);
+    if(e == NULL)
+    {
+      e = decay_hold(est, token);
+      e->weight = w;
+    }
+    e->refs++;
+    if(s->entry != NULL)
+      decay_release(est, s->entry);
+    s->entry = e;
+    s->base = before;
+    s->w = w;
+    //new key, conditioned on beating the old one, then the weight to
+    //skip before the next replacement
+    tw = exp(s->log_key * w);
+    s->log_key = log(tw + (1-tw) * decay_uniform(est)) / w;
+    if(!(s->log_key < 0))
+      s->log_key = -DBL_MIN;
+    s->next_at = est->total + log(decay_uniform(est)) / s->log_key;
+    insert_heap(est->next_heap, s);
+  }
+}
+
+//end of stream reached. Compute estimate for the decayed entropy
+double Decay_Estimator_end_stream(Decay_Estimator_type* est)
+{
+  double G = est->total, p_max = 0, sum_Xis = 0, R, w;
+  int max_token = INT_MIN, n = 0;
+
+  if(est->count == 0 || G <= 0)
+    return 0;
+  for(int i = 0; i < est->nfreq; i++)
+  {
+    if(est->freq_weights[i] > G/2)
+    {
+      max_token = est->freq_items[i];
+      p_max = est->freq_weights[i] / G;
+    }
+  }
+  for(int i = 0; i < est->c; i++)
+  {
+    Decay_Sample* s = &est->samplers[i];
+    if(s->entry == NULL || !(s->w > 0))
+      continue;
+    if(p_max > 0 && s->entry->key == max_token)
+      continue;
+    w = s->w;
+    R = s->entry->weight - s->base;
+    if(R < w) R = w; //rounding
+    sum_Xis += R * log2(G/R) / w;
+    if(R - w > 0)
+      sum_Xis -= (R-w) * log2(G/(R-w)) / w;
+    n++;
+  }
+  if(p_max == 0)
+    return n > 0 ? sum_Xis / n : 0;
+  return (n > 0 ? (1-p_max) * sum_Xis / n : 0) + p_max * log2(1/p_max);
+}
+
+//uniform in (0, 1), from xorshift64*
+static double decay_uniform(Decay_Estimator_type* est)
+{
+  est->rng ^= est->rng >> 12;
+  est->rng ^= est->rng << 25;
+  est->rng ^= est->rng >> 27;
+  return ((est->rng * 2685821657736338717ULL >> 11) + 0.5) / 9007199254740992.0;
+}
+
+static decay_entry* decay_find(Decay_Estimator_type* est, int key)
+{
+  decay_entry* e = est->table[hash31(est->a, est->b, key) % est->table_size];
+  while(e != NULL && e->key != key)
+    e = e->next;
+  return e;
+}
+
+//a fresh entry for key, which must not be held yet
+static decay_entry* decay_hold(Decay_Estimator_type* est, int key)
+{
+  int bn = hash31(est->a, est->b, key) % est->table_size;
+  decay_entry* e = (decay_entry*) safe_malloc(sizeof(decay_entry));
+  e->key = key;
+  e->refs = 0;
+  e->weight = 0;
+  e->next = est->table[bn];
+  est->table[bn] = e;
+  est->entries++;
+  return e;
+}
+
+//a sampler lets go of e; forget the token once no sampler holds it
+static void decay_release(Decay_Estimator_type* est, decay_entry* e)
+{
+  decay_entry** p;
+
+  if(--e->refs > 0)
+    return;
+  p = &est->table[hash31(est->a, est->b, e->key) % est->table_size];
+  while(*p != e)
+    p = &(*p)->next;
+  *p = e->next;
+  free(e);
+  est->entries--;
+}
+
+//weighted Misra-Gries: a token that is not counted and finds no free
+//counter takes the smallest weight among it and the counters off all of
+//them. k is small, so the counters are scanned
+static void decay_freq_update(Decay_Estimator_type* est, int token, double w)
+{
+  double least;
+  int i, n;
+
+  for(i = 0; i < est->nfreq; i++)
+  {
+    if(est->freq_items[i] == token)
+    {
+      est->freq_weights[i] += w;
+      return;
+    }
+  }
+  if(est->nfreq == est->k)
+  {
+    least = w;
+    for(i = 0; i < est->nfreq; i++)
+      if(est->freq_weights[i] < least) least = est->freq_weights[i];
+    w -= least;
+    for(i = n = 0; i < est->nfreq; i++)
+    {
+      est->freq_weights[i] -= least;
+      if(est->freq_weights[i] > 0)
+      {
+        est->freq_items[n] = est->freq_items[i];
+        est->freq_weights[n++] = est->freq_weights[i];
+      }
+    }
+    est->nfreq = n;
+  }
+  if(w > 0 && est->nfreq < est->k)
+  {
+    est->freq_items[est->nfreq] = token;
+    est->freq_weights[est->nfreq++] = w;
+  }
+}
+
+//move the landmark to time, scaling every stored weight by the same
+//factor. Keys u^(1/w) are unchanged, so their logs scale inversely.
+//The heap order is unchanged too
+static void decay_rebase(Decay_Estimator_type* est, double time)
+{
+  double f = exp(-est->lambda * (time - est->landmark));
+  decay_entry* e;
+
+  est->landmark = time;
+  est->total *= f;
+  for(int i = 0; i < est->table_size; i++)
+    for(e = est->table[i]; e != NULL; e = e->next)
+      e->weight *= f;
+  for(int i = 0; i < est->c; i++)
+  {
+    Decay_Sample* s = &est->samplers[i];
+    s->base *= f;
+    s->w *= f;
+    s->next_at *= f;
+    s->log_key = f > 0 ? s->log_key / f : -INFINITY;
+  }
+  for(int i = 0; i < est->nfreq; i++)
+    est->freq_weights[i] *= f;
+}
+
+static int decay_next_comp(void* a, void* b)
+{
+  double x = ((Decay_Sample*) a)->next_at, y = ((Decay_Sample*) b)->next_at;
+  return x < y ? -1 : x > y;
+}
@@ -0,0 +1,56 @@
+#ifndef DECAYPRIV_H
+#define DECAYPRIV_H
+#include "heap.h"
+#include "decaypub.h"
+
+//weights are rebased once exp(lambda (t - landmark)) passes e^DECAY_REBASE
+#define DECAY_REBASE 256.0
+
+//a token some sampler holds, with its weight since it was first held
+typedef struct decay_entry{
+  int key, refs;
+  double weight;
+  struct decay_entry* next;
+} decay_entry;
+
+//one weighted sample: a position picked with probability proportional
+//to its weight. R, the token's weight from the position on, is
+//entry->weight - base
+typedef struct Decay_Sample{
+  decay_entry* entry;
+  double base;        //entry->weight before the sampled position
+  double w;           //weight of the sampled position
+  double log_key;     //log of the position's key u^(1/w)
+  double next_at;     //total weight at which the sample is next replaced
+} Decay_Sample;
+
+struct Decay_Estimator_type{
+  int c, k;
+  double lambda, landmark;
+  double total;       //weight of the whole stream
+  long count;
+  unsigned long long rng;
+
+  Decay_Sample* samplers;
+  heap* next_heap;    //samplers by next_at, smallest first
+
+  //tokens held by samplers, chained in buckets
+  decay_entry** table;
+  int table_size, entries;
+  long long a, b;
+
+  //weighted Misra-Gries: k counters of weight
+  int nfreq;
+  int* freq_items;
+  double* freq_weights;
+};
+
+static double decay_uniform(Decay_Estimator_type* est);
+static decay_entry* decay_find(Decay_Estimator_type* est, int key);
+static decay_entry* decay_hold(Decay_Estimator_type* est, int key);
+static void decay_release(Decay_Estimator_type* est, decay_entry* e);
+static void decay_freq_update(Decay_Estimator_type* est, int token, double w);
+static void decay_rebase(Decay_Estimator_type* est, double time);
+static int decay_next_comp(void* a, void* b);
+
+#endif
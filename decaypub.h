@@ -0,0 +1,12 @@
+#ifndef DECAYPUB_H
+#define DECAYPUB_H
+
+typedef struct Decay_Estimator_type Decay_Estimator_type;
+
+extern Decay_Estimator_type* Decay_Estimator_Init(int c, int k, double half_life);
+extern void Decay_Estimator_Destroy(Decay_Estimator_type* est);
+extern int Decay_Estimator_Size(Decay_Estimator_type* est);
+extern void Decay_Estimator_Update(Decay_Estimator_type* est, double time, int token);
+extern double Decay_Estimator_end_stream(Decay_Estimator_type* est);
+
+#endif
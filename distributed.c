@@ -0,0 +1,606 @@
+/* distributed.c
+ *Continuous distributed entropy monitoring. Each site keeps a bottom-c
+ *sample of the distinct tokens it has seen: the tokens whose hash,
+ *under a hash all sites share, is below the site's threshold, with
+ *their exact counts at the site. When the sample fills, the token of
+ *largest hash is dropped and its hash becomes the new threshold. Sites
+ *also run Misra-Gries counters for the most frequent token.
+ *
+ *Sites ship this state as deltas: the count each sampled token has
+ *gained since the last message, the counters that changed, and the
+ *site's length and threshold. Both kinds of state merge, so sites may
+ *see the same tokens. A token whose hash is below the least threshold
+ *t of all sites is in every sample it could be in, so summing the
+ *sites' counts gives its exact count f over the union of the streams.
+ *Each token is in that merged sample with probability p = t/MOD, and
+ *
+ *   H = log m - (1/m) sum_a f_a log f_a
+ *
+ *is estimated by scaling the merged sample's sum of f log f by 1/p.
+ *Tokens the merged Misra-Gries counters show to be frequent are
+ *summed apart, unscaled; merged counts undercount by at most
+ *sum_i m_i/(k+1). While no site has dropped a token the estimate is
+ *exact. Once the sample is much smaller than the number of distinct
+ *tokens, the moderately frequent ones make the scaled sum noisy: on
+ *entropydist's default stream a sample of 10000 of the ~67000 distinct
+ *tokens errs by up to a bit.
+ *
+ *A site tracks the same estimate of its own stream in O(1) a token,
+ *and sends once it is more than tol/2 from what it last sent, or once
+ *its length has grown by more than a factor 1 + tol/(4(1 + H_i)). When
+ *sites own disjoint tokens the global entropy is a function of the
+ *sites' lengths and entropies, so this keeps the coordinator within
+ *about tol of the sites' merged state. When they overlap it is only a
+ *heuristic: the merged counts can move the global estimate more than
+ *the sites' own estimates move.
+ *
+ *Messages are a SITE_MSG_BYTES header followed by SITE_ENTRY_BYTES
+ *token/count pairs, every field little-endian, so sites and
+ *coordinator need not share a byte order.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <errno.h>
+#include "distributed.h"
+#include "prng.h"
+#include "serial.h"
+#include "util.h"
+
+#define SAMPLE_SEED 31337 //seed of the sample hash every site shares
+
+static void sample_hash_init(long long* a, long long* b, long long* c, long long* d);
+static int site_hash_comp(void* a, void* b);
+static int site_find(Site_type* site, int token, long hash);
+static void site_drop(Site_type* site, int e);
+static void site_send(Site_type* site, int flags);
+static void coord_add(Coordinator_type* coord, int token, long hash, long delta);
+static void coord_prune(Coordinator_type* coord);
+static void coord_grow(Coordinator_type* coord);
+static void coord_freq(Coordinator_type* coord, int id, int token, int count);
+static int coord_merge(Coordinator_type* coord);
+static int coord_find(Coordinator_type* coord, int token);
+
+static double xlogx(long f)
+{
+  return f > 1 ? f * log(f) : 0;
+}
+
+//a site with a sample of c tokens and k counters reporting over socket fd
+Site_type* Site_Init(int id, int c, int k, double tol, int fd)
+{
+  Site_type* site = (Site_type*) safe_malloc(sizeof(Site_type));
+  site->id = id;
+  site->fd = fd;
+  site->c = c;
+  site->k = k;
+  sample_hash_init(&site->ha, &site->hb, &site->hc, &site->hd);
+  site->threshold = MOD;
+  site->entries = (Site_Entry*) safe_malloc(c * sizeof(Site_Entry));
+  site->used = 0;
+  site->nbuckets = 2*c;
+  site->buckets = (int*) safe_malloc(site->nbuckets * sizeof(int));
+  for(int i = 0; i < site->nbuckets; i++)
+    site->buckets[i] = -1;
+  site->by_hash = new_heap(site_hash_comp, c+1);
+  site->dirty = (int*) safe_malloc(c * sizeof(int));
+  site->ndirty = 0;
+  site->sum_flogf = site->sum_frequent = 0;
+  site->freq = Freq_Init((float)1.0/k);
+  site->freq_items = (int*) safe_malloc(k * sizeof(int));
+  site->freq_counts = (int*) safe_malloc(k * sizeof(int));
+  site->nfreq = 0;
+  site->top_items = (int*) safe_malloc(k * sizeof(int));
+  site->top_counts = (int*) safe_malloc(k * sizeof(int));
+  site->msg = (unsigned char*) safe_malloc(SITE_MSG_MAX(c, k));
+  site->tol = tol;
+  site->count = site->sent_count = 0;
+  site->sent_entropy = 0;
+  site->messages = site->bytes = 0;
+  return site;
+}
+
+void Site_Destroy(Site_type* site)
+{
+  free(site->entries);
+  free(site->buckets);
+  free_heap(site->by_hash);
+  free(site->dirty);
+  Freq_Destroy(site->freq);
+  free(site->freq_items);
+  free(site->freq_counts);
+  free(site->top_items);
+  free(site->top_counts);
+  free(site->msg);
+  free(site);
+}
+
+//add a token to the site's state without reporting it
+void Site_Count(Site_type* site, int token)
+{
+  long hash = fourwise(site->ha, site->hb, site->hc, site->hd, token);
+  Site_Entry *top, *entry;
+  int e;
+
+  Freq_Update(site->freq, token);
+  site->count++;
+  if(hash >= site->threshold) return;
+
+  e = site_find(site, token, hash);
+  if(e < 0)
+  {
+    if(site->used < site->c)
+    {
+      e = site->used++;
+      site->entries[e].dirty = 0;
+    }
+    else
+    {
+      //drop the largest hash, which may be this token's
+      top = (Site_Entry*) peek_min(site->by_hash);
+      if(top->hash <= hash)
+      {
+        site->threshold = hash;
+        return;
+      }
+      delete_min(site->by_hash);
+      e = top - site->entries;
+      site->threshold = top->hash;
+      site_drop(site, e);
+    }
+    site->entries[e].token = token;
+    site->entries[e].hash = hash;
+    site->entries[e].count = site->entries[e].sent = 0;
+    site->entries[e].frequent = 0;
+    site->entries[e].next = site->buckets[hash % site->nbuckets];
+    site->buckets[hash % site->nbuckets] = e;
+    insert_heap(site->by_hash, &site->entries[e]);
+  }
+  entry = &site->entries[e];
+  site->sum_flogf += xlogx(entry->count+1) - xlogx(entry->count);
+  if(entry->frequent)
+    site->sum_frequent += xlogx(entry->count+1) - xlogx(entry->count);
+  entry->count++;
+  if(!entry->frequent && entry->count > site->count / (site->k + 1))
+  {
+    entry->frequent = 1;
+    site->sum_frequent += xlogx(entry->count);
+  }
+  if(!entry->dirty)
+  {
+    entry->dirty = 1;
+    site->dirty[site->ndirty++] = e;
+  }
+}
+
+//process a token and report to the coordinator if the site's estimate
+//has moved past the tolerance
+void Site_Update(Site_type* site, int token)
+{
+  double entropy, growth;
+
+  Site_Count(site, token);
+  entropy = Site_Estimate(site);
+  growth = 1 + site->tol / (4 * (1 + entropy));
+  if(fabs(entropy - site->sent_entropy) > site->tol/2 ||
+     site->count > site->sent_count * growth)
+    site_send(site, 0);
+}
+
+//entropy of the site's own stream, estimated from its sample. Sampled
+//tokens that have been frequent are counted apart, as the coordinator
+//does; frequent tokens outside the sample are missed, which biases the
+//estimate but keeps it steady enough to tell when to report
+double Site_Estimate(Site_type* site)
+{
+  double p = (double) site->threshold / MOD;
+  if(site->count == 0) return 0;
+  return (log(site->count) - (site->sum_frequent +
+          (site->sum_flogf - site->sum_frequent) / p) / site->count) / log(2);
+}
+
+//write the changes since the last message into site->msg and return
+//its length.
+//header: site id (4), flags (4), m (8), threshold (4), sampled tokens
+//(4), counters (4), unused (4). Then the sampled tokens with the
+//count each gained, and the counters that changed with their new
+//counts, 0 for counters that were recycled
+int Site_Pack(Site_type* site, int flags)
+{
+  unsigned char* at = site->msg + SITE_MSG_BYTES;
+  Site_Entry* entry;
+  int nsample = 0, nchanged = 0, ntop, j;
+
+  for(int i = 0; i < site->ndirty; i++)
+  {
+    entry = &site->entries[site->dirty[i]];
+    entry->dirty = 0;
+    if(entry->count == entry->sent) continue;
+    Serial_Store(at, (unsigned int) entry->token, 4);
+    Serial_Store(at+4, entry->count - entry->sent, 4);
+    at += SITE_ENTRY_BYTES;
+    entry->sent = entry->count;
+    nsample++;
+  }
+  site->ndirty = 0;
+
+  ntop = Freq_Counts(site->freq, site->top_items, site->top_counts, site->k);
+  for(int i = 0; i < ntop; i++)
+  {
+    for(j = 0; j < site->nfreq; j++)
+      if(site->freq_items[j] == site->top_items[i]) break;
+    if(j < site->nfreq && site->freq_counts[j] == site->top_counts[i]) continue;
+    Serial_Store(at, (unsigned int) site->top_items[i], 4);
+    Serial_Store(at+4, site->top_counts[i], 4);
+    at += SITE_ENTRY_BYTES;
+    nchanged++;
+  }
+  for(j = 0; j < site->nfreq; j++)
+  {
+    int i;
+    for(i = 0; i < ntop; i++)
+      if(site->top_items[i] == site->freq_items[j]) break;
+    if(i < ntop) continue;
+    Serial_Store(at, (unsigned int) site->freq_items[j], 4);
+    Serial_Store(at+4, 0, 4);
+    at += SITE_ENTRY_BYTES;
+    nchanged++;
+  }
+  memcpy(site->freq_items, site->top_items, ntop * sizeof(int));
+  memcpy(site->freq_counts, site->top_counts, ntop * sizeof(int));
+  site->nfreq = ntop;
+
+  Serial_Store(site->msg, site->id, 4);
+  Serial_Store(site->msg+4, flags, 4);
+  Serial_Store(site->msg+8, site->count, 8);
+  Serial_Store(site->msg+16, site->threshold, 4);
+  Serial_Store(site->msg+20, nsample, 4);
+  Serial_Store(site->msg+24, nchanged, 4);
+  Serial_Store(site->msg+28, 0, 4);
+  site->sent_count = site->count;
+  site->sent_entropy = Site_Estimate(site);
+  return at - site->msg;
+}
+
+static void site_send(Site_type* site, int flags)
+{
+  int len = Site_Pack(site, flags), done = 0, n;
+
+  while(done < len)
+  {
+    n = write(site->fd, site->msg+done, len-done);
+    if(n < 0 && errno == EINTR) continue;
+    if(n <= 0) fatal("site %d: can't write to coordinator", site->id);
+    done += n;
+  }
+  site->messages++;
+  site->bytes += len;
+}
+
+//send the final state of the site's stream
+void Site_Finish(Site_type* site)
+{
+  site_send(site, SITE_MSG_FINAL);
+}
+
+//length of the message that starts with header
+int Site_Message_Bytes(const unsigned char* header)
+{
+  return SITE_MSG_BYTES + (int) (Serial_Load(header+20, 4) +
+                                 Serial_Load(header+24, 4)) * SITE_ENTRY_BYTES;
+}
+
+//entry of token in the site's sample, or -1
+static int site_find(Site_type* site, int token, long hash)
+{
+  int e = site->buckets[hash % site->nbuckets];
+  while(e >= 0 && site->entries[e].token != token)
+    e = site->entries[e].next;
+  return e;
+}
+
+//unlink entry e from its bucket and from the sample's sum
+static void site_drop(Site_type* site, int e)
+{
+  int* link = &site->buckets[site->entries[e].hash % site->nbuckets];
+  while(*link != e)
+    link = &site->entries[*link].next;
+  *link = site->entries[e].next;
+  site->sum_flogf -= xlogx(site->entries[e].count);
+  if(site->entries[e].frequent)
+    site->sum_frequent -= xlogx(site->entries[e].count);
+}
+
+static int site_hash_comp(void* a, void* b)
+{
+  long x = ((Site_Entry*) a)->hash, y = ((Site_Entry*) b)->hash;
+  return x > y ? -1 : x < y;
+}
+
+static void sample_hash_init(long long* a, long long* b, long long* c, long long* d)
+{
+  prng_type* prng = prng_Init(SAMPLE_SEED, 2);
+  *a = (long long) (prng_int(prng) % MOD);
+  *b = (long long) (prng_int(prng) % MOD);
+  *c = (long long) (prng_int(prng) % MOD);
+  *d = (long long) (prng_int(prng) % MOD);
+  prng_Destroy(prng);
+}
+
+/******************************************************************/
+
+//coordinator of sites each running k Misra-Gries counters
+Coordinator_type* Coordinator_Init(int sites, int k)
+{
+  Coordinator_type* coord = (Coordinator_type*) safe_malloc(sizeof(Coordinator_type));
+  coord->sites = sites;
+  coord->finished = 0;
+  coord->k = k;
+  sample_hash_init(&coord->ha, &coord->hb, &coord->hc, &coord->hd);
+  coord->counts = (long*) safe_malloc(sites * sizeof(long));
+  coord->thresholds = (long*) safe_malloc(sites * sizeof(long));
+  coord->freq_items = (int**) safe_malloc(sites * sizeof(int*));
+  coord->freq_counts = (int**) safe_malloc(sites * sizeof(int*));
+  coord->nfreq = (int*) safe_malloc(sites * sizeof(int));
+  for(int i = 0; i < sites; i++)
+  {
+    coord->counts[i] = 0;
+    coord->thresholds[i] = MOD;
+    coord->freq_items[i] = (int*) safe_malloc(k * sizeof(int));
+    coord->freq_counts[i] = (int*) safe_malloc(k * sizeof(int));
+    coord->nfreq[i] = 0;
+  }
+  coord->merged_tokens = (int*) safe_malloc(sites * k * sizeof(int));
+  coord->merged_counts = (long*) safe_malloc(sites * k * sizeof(long));
+  coord->threshold = MOD;
+  coord->cap = 0;
+  coord->tokens = NULL;
+  coord->hashes = NULL;
+  coord->token_counts = NULL;
+  coord->next = NULL;
+  coord->buckets = NULL;
+  coord->free_entry = -1;
+  coord_grow(coord);
+  coord->sum_flogf = 0;
+  coord->messages = coord->bytes = 0;
+  return coord;
+}
+
+void Coordinator_Destroy(Coordinator_type* coord)
+{
+  for(int i = 0; i < coord->sites; i++)
+  {
+    free(coord->freq_items[i]);
+    free(coord->freq_counts[i]);
+  }
+  free(coord->freq_items);
+  free(coord->freq_counts);
+  free(coord->nfreq);
+  free(coord->merged_tokens);
+  free(coord->merged_counts);
+  free(coord->counts);
+  free(coord->thresholds);
+  free(coord->tokens);
+  free(coord->hashes);
+  free(coord->token_counts);
+  free(coord->next);
+  free(coord->buckets);
+  free(coord);
+}
+
+//apply one message of Site_Message_Bytes(msg). Returns the sending
+//site's id, or -1 if the message is malformed
+int Coordinator_Receive(Coordinator_type* coord, const unsigned char* msg)
+{
+  int id = (int) Serial_Load(msg, 4);
+  int flags = (int) Serial_Load(msg+4, 4);
+  long threshold = (long) Serial_Load(msg+16, 4);
+  int nsample = (int) Serial_Load(msg+20, 4);
+  int nchanged = (int) Serial_Load(msg+24, 4);
+  const unsigned char* at = msg + SITE_MSG_BYTES;
+  int token;
+
+  if(id < 0 || id >= coord->sites || threshold > coord->thresholds[id] ||
+     nsample < 0 || nchanged < 0 || nchanged > 2*coord->k) return -1;
+  coord->counts[id] = (long) Serial_Load(msg+8, 8);
+  coord->thresholds[id] = threshold;
+  if(threshold < coord->threshold)
+  {
+    coord->threshold = threshold;
+    coord_prune(coord);
+  }
+  for(int i = 0; i < nsample; i++, at += SITE_ENTRY_BYTES)
+  {
+    token = (int) Serial_Load(at, 4);
+    coord_add(coord, token, fourwise(coord->ha, coord->hb, coord->hc, coord->hd, token),
+              (long) Serial_Load(at+4, 4));
+  }
+  for(int i = 0; i < nchanged; i++, at += SITE_ENTRY_BYTES)
+    coord_freq(coord, id, (int) Serial_Load(at, 4), (int) Serial_Load(at+4, 4));
+  if(flags & SITE_MSG_FINAL) coord->finished++;
+  coord->messages++;
+  coord->bytes += at - msg;
+  return id;
+}
+
+//current estimate of the entropy of the union of the sites' streams.
+//Tokens whose merged Misra-Gries count is above the counters' error are
+//counted apart, with their exact count if they are in the merged
+//sample: a frequent token that falls in or out of the sample would
+//otherwise swing the scaled sum
+double Coordinator_Estimate(Coordinator_type* coord)
+{
+  double p = (double) coord->threshold / MOD, frequent = 0, sampled = 0;
+  long m = 0, f;
+  int n, e;
+
+  for(int i = 0; i < coord->sites; i++)
+    m += coord->counts[i];
+  if(m == 0) return 0;
+  n = coord_merge(coord);
+  for(int i = 0; i < n; i++)
+  {
+    if(coord->merged_counts[i] <= m / (coord->k + 1)) continue;
+    e = coord_find(coord, coord->merged_tokens[i]);
+    f = e >= 0 ? coord->token_counts[e] : coord->merged_counts[i];
+    frequent += xlogx(f);
+    if(e >= 0) sampled += xlogx(f);
+  }
+  return (log(m) - (frequent + (coord->sum_flogf - sampled) / p) / m) / log(2);
+}
+
+//most frequent token in the sites' merged Misra-Gries counters
+void Coordinator_Max(Coordinator_type* coord, int* max_token, int* max_count)
+{
+  int n = coord_merge(coord);
+
+  *max_token = *max_count = 0;
+  for(int i = 0; i < n; i++)
+  {
+    if(coord->merged_counts[i] > *max_count)
+    {
+      *max_count = (int) coord->merged_counts[i];
+      *max_token = coord->merged_tokens[i];
+    }
+  }
+}
+
+//sum the sites' Misra-Gries counters by token into merged_tokens and
+//merged_counts, and return how many tokens there are
+static int coord_merge(Coordinator_type* coord)
+{
+  int n = 0, j;
+
+  for(int i = 0; i < coord->sites; i++)
+  {
+    for(int l = 0; l < coord->nfreq[i]; l++)
+    {
+      for(j = 0; j < n; j++)
+        if(coord->merged_tokens[j] == coord->freq_items[i][l]) break;
+      if(j == n)
+      {
+        coord->merged_tokens[n] = coord->freq_items[i][l];
+        coord->merged_counts[n++] = 0;
+      }
+      coord->merged_counts[j] += coord->freq_counts[i][l];
+    }
+  }
+  return n;
+}
+
+//entry of token in the merged sample, or -1
+static int coord_find(Coordinator_type* coord, int token)
+{
+  long hash = fourwise(coord->ha, coord->hb, coord->hc, coord->hd, token);
+  int e;
+
+  if(hash >= coord->threshold) return -1;
+  for(e = coord->buckets[hash % coord->nbuckets]; e >= 0; e = coord->next[e])
+    if(coord->tokens[e] == token) break;
+  return e;
+}
+
+//add delta to the merged count of token, if it is in the merged sample
+static void coord_add(Coordinator_type* coord, int token, long hash, long delta)
+{
+  int e;
+
+  if(hash >= coord->threshold) return;
+  for(e = coord->buckets[hash % coord->nbuckets]; e >= 0; e = coord->next[e])
+    if(coord->tokens[e] == token) break;
+  if(e < 0)
+  {
+    if(coord->free_entry < 0) coord_grow(coord);
+    e = coord->free_entry;
+    coord->free_entry = coord->next[e];
+    coord->tokens[e] = token;
+    coord->hashes[e] = hash;
+    coord->token_counts[e] = 0;
+    coord->next[e] = coord->buckets[hash % coord->nbuckets];
+    coord->buckets[hash % coord->nbuckets] = e;
+  }
+  coord->sum_flogf += xlogx(coord->token_counts[e] + delta) - xlogx(coord->token_counts[e]);
+  coord->token_counts[e] += delta;
+}
+
+//drop the tokens at or above the threshold
+static void coord_prune(Coordinator_type* coord)
+{
+  int* link;
+  int e;
+
+  for(int b = 0; b < coord->nbuckets; b++)
+  {
+    link = &coord->buckets[b];
+    while((e = *link) >= 0)
+    {
+      if(coord->hashes[e] < coord->threshold)
+      {
+        link = &coord->next[e];
+        continue;
+      }
+      coord->sum_flogf -= xlogx(coord->token_counts[e]);
+      *link = coord->next[e];
+      coord->next[e] = coord->free_entry;
+      coord->free_entry = e;
+    }
+  }
+}
+
+//double the room for merged tokens and rehash
+static void coord_grow(Coordinator_type* coord)
+{
+  int old = coord->cap, b;
+
+  coord->cap = old > 0 ? 2*old : 1024;
+  coord->tokens = (int*) safe_realloc(coord->tokens, coord->cap * sizeof(int));
+  coord->hashes = (long*) safe_realloc(coord->hashes, coord->cap * sizeof(long));
+  coord->token_counts = (long*) safe_realloc(coord->token_counts, coord->cap * sizeof(long));
+  coord->next = (int*) safe_realloc(coord->next, coord->cap * sizeof(int));
+  free(coord->buckets);
+  coord->nbuckets = 2*coord->cap;
+  coord->buckets = (int*) safe_malloc(coord->nbuckets * sizeof(int));
+  for(b = 0; b < coord->nbuckets; b++)
+    coord->buckets[b] = -1;
+  //every entry below old is in use, as the free list was empty
+  for(int e = 0; e < old; e++)
+  {
+    b = coord->hashes[e] % coord->nbuckets;
+    coord->next[e] = coord->buckets[b];
+    coord->buckets[b] = e;
+  }
+  for(int e = old; e < coord->cap; e++)
+    coord->next[e] = e+1 < coord->cap ? e+1 : -1;
+  coord->free_entry = old;
+}
+
+//set site id's counter for token; a count of 0 removes it
+static void coord_freq(Coordinator_type* coord, int id, int token, int count)
+{
+  int* items = coord->freq_items[id];
+  int* counts = coord->freq_counts[id];
+  int j;
+
+  for(j = 0; j < coord->nfreq[id]; j++)
+    if(items[j] == token) break;
+  if(count == 0)
+  {
+    if(j < coord->nfreq[id])
+    {
+      coord->nfreq[id]--;
+      items[j] = items[coord->nfreq[id]];
+      counts[j] = counts[coord->nfreq[id]];
+    }
+    return;
+  }
+  if(j == coord->nfreq[id])
+  {
+    if(j == coord->k) return;
+    coord->nfreq[id]++;
+  }
+  items[j] = token;
+  counts[j] = count;
+}
@@ -0,0 +1,94 @@
+/*************************************************************************/
+/* distributed.h                                                         */
+/*************************************************************************/
+
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+#include "heap.h"
+#include "frequent.h"
+
+#define SITE_MSG_BYTES 32   //size of a message header
+#define SITE_ENTRY_BYTES 8  //size of one token/count pair after it
+#define SITE_MSG_FINAL 1    //flag: site has reached the end of its stream
+
+//longest message from a site with c samples and k counters
+#define SITE_MSG_MAX(c, k) (SITE_MSG_BYTES + ((c) + 2*(k)) * SITE_ENTRY_BYTES)
+
+//a token in a site's sample
+typedef struct Site_Entry{
+  int token;
+  long hash;      //sample hash, below the site's threshold
+  long count;     //occurrences at this site
+  long sent;      //count in the last message sent
+  int next;       //next entry in the same bucket, or -1
+  int dirty;      //on the list of entries changed since the last message
+  int frequent;   //count has been above the Misra-Gries counters' error
+} Site_Entry;
+
+//one collector. It keeps the tokens whose shared sample hash is below
+//its threshold, at most c of them, with their exact counts
+typedef struct Site_type{
+  int id, fd, c, k;
+  long long ha, hb, hc, hd;   //sample hash, the same at every site
+  long threshold;             //hash of the first token dropped, or MOD
+  Site_Entry* entries;
+  int used;
+  int* buckets;
+  int nbuckets;
+  heap* by_hash;              //entries, largest hash first
+  int* dirty;                 //entries changed since the last message
+  int ndirty;
+  double sum_flogf;           //sum of f ln f over the sample
+  double sum_frequent;        //the part of it from frequent entries
+  freq_type* freq;            //Misra-Gries counters
+  int* freq_items;            //their tokens and counts as last sent
+  int* freq_counts;
+  int nfreq;
+  int* top_items;             //scratch for the current counters
+  int* top_counts;
+  unsigned char* msg;
+  double tol;
+  long count;                 //tokens seen
+  long sent_count;            //count in the last message sent
+  double sent_entropy;        //local estimate when it was sent
+  long messages, bytes;
+} Site_type;
+
+//the global view, merged from site messages
+typedef struct Coordinator_type{
+  int sites, finished, k;
+  long long ha, hb, hc, hd;
+  long* counts;               //each site's length
+  long* thresholds;           //each site's threshold
+  long threshold;             //the least of them
+  int* tokens;                //sampled tokens below threshold
+  long* hashes;
+  long* token_counts;         //their counts summed over the sites
+  int* next;                  //bucket chains; free entries chain from free_entry
+  int* buckets;
+  int nbuckets, cap, free_entry;
+  double sum_flogf;           //sum of f ln f over the merged sample
+  int** freq_items;           //each site's Misra-Gries counters
+  int** freq_counts;
+  int* nfreq;
+  int* merged_tokens;         //scratch for the counters summed by token
+  long* merged_counts;
+  long messages, bytes;
+} Coordinator_type;
+
+extern Site_type* Site_Init(int id, int c, int k, double tol, int fd);
+extern void Site_Destroy(Site_type* site);
+extern void Site_Count(Site_type* site, int token);
+extern void Site_Update(Site_type* site, int token);
+extern double Site_Estimate(Site_type* site);
+extern int Site_Pack(Site_type* site, int flags);
+extern void Site_Finish(Site_type* site);
+extern int Site_Message_Bytes(const unsigned char* header);
+
+extern Coordinator_type* Coordinator_Init(int sites, int k);
+extern void Coordinator_Destroy(Coordinator_type* coord);
+extern int Coordinator_Receive(Coordinator_type* coord, const unsigned char* msg);
+extern double Coordinator_Estimate(Coordinator_type* coord);
+extern void Coordinator_Max(Coordinator_type* coord, int* max_token, int* max_count);
+
+#endif
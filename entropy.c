@@ -21,17 +21,36 @@
 #include <stdio.h>
 #include <math.h>
 #include <limits.h>
+#include <stdint.h>
 #include "massdal.h"
 #include "entropypriv.h"
+#include "moments.h"
 #include "util.h"
 
 #define INVALID_TOKEN INT_MIN
 //this constant should be defined in math.h
 //#define M_E 2.71828183
 #define MAX_WAIT 90000000
+//a budgeted estimator over its budget sheds samplers until it is this
+//fraction of the budget under, so it doesn't shed on every token
+#define BUDGET_SLACK 16
 
 static int b_cmp(c_a* p, c_a* q);
 static int prim_cmp(void* p, void* q);
+static Estimator_type* estimator_new(int c, int k, prng_type* prng, freq_type* freq);
+static int count_position(const long* starts, int n, long x);
+static c_a* handoff_counter(Estimator_type* est, int key, int r);
+static void estimator_free(Estimator_type* est);
+static long budget_bytes(int c, int k);
+static int budget_counters(int c);
+static void estimator_shed(Estimator_type* est);
+static int sampler_prim_cmp(const void* p, const void* q);
+
+//maps a sampler's address back to its index in est->samplers
+typedef struct sampler_ref{
+  Sample_type* sm;
+  int index;
+} sampler_ref;
 
 static int b_cmp(c_a* p, c_a* q)
 {
@@ -64,15 +83,383 @@ Sample_type * Sample_Init()
 
 //initialize estimator with c samplers and k counters (used by Misra-Gries alg)
 Estimator_type * Estimator_Init(int c, int k)
+{
+  // initialize the random number generator
+  prng_type* prng = prng_Init(lrand48(), 2); 
+  return estimator_new(c, k, prng, Freq_Init((float)1.0/k));
+}
+
+//an estimator in the state Estimator_Update would have reached on a
+//stream holding the n distinct tokens items[i] counts[i] times each,
+//in random order, without reading it. A uniform position of such a
+//stream holds token i with probability counts[i]/m and is its j-th
+//occurrence with j uniform in [1, counts[i]], whatever the order, so
+//each sampler is drawn from the histogram: t0 as the least of m
+//uniforms, its backup as the least of the positions of other tokens,
+//all of which lie above t0. Needs n >= 2 and counts[i] > 0
+Estimator_type* Estimator_Init_From_Counts(int c, int k, const int* items,
+                                           const int* counts, int n)
+{
+  Estimator_type* est;
+  c_a** counters;
+  long* starts;
+  long m = 0, x;
+  int i0, i1;
+  Sample_type* cur;
+
+  if(n < 2) fatal("Estimator_Init_From_Counts: need two distinct tokens");
+  est = Estimator_Init(c, k);
+  Freq_Destroy(est->freq);
+  est->freq = Freq_From_Counts((float)1.0/k, items, counts, n);
+
+  //starts[i] is the position of token i's first occurrence
+  starts = (long*) safe_malloc((n+1) * sizeof(long));
+  counters = (c_a**) safe_malloc(n * sizeof(c_a*));
+  for(int i = 0; i < n; i++)
+  {
+    starts[i] = m;
+    m += counts[i];
+    counters[i] = NULL;
+    HLL_Add(&est->distinct, (unsigned int) items[i]);
+  }
+  starts[n] = m;
+  if(m > MAX_WAIT) fatal("Estimator_Init_From_Counts: stream too long");
+  est->count = m;
+  est->two_distinct_tokens = 1;
+
+  for(int i = 0; i < c; i++)
+  {
+    cur = est->samplers[i];
+    cur->t0 = 1 - pow(prng_float(est->prng), 1.0/m);
+    x = (long) (prng_float(est->prng) * m) % m;
+    i0 = count_position(starts, n, x);
+    cur->val_c_s0 = x - starts[i0] + 1;
+
+    //positions of the other tokens, skipping token i0's
+    cur->t1 = cur->t0 + (1 - cur->t0) *
+              (1 - pow(prng_float(est->prng), 1.0/(m - counts[i0])));
+    x = (long) (prng_float(est->prng) * (m - counts[i0])) % (m - counts[i0]);
+    if(x >= starts[i0]) x += counts[i0];
+    i1 = count_position(starts, n, x);
+    cur->val_c_s1 = x - starts[i1] + 1;
+
+    for(int j = 0; j < 2; j++)
+    {
+      int t = j ? i1 : i0;
+      if(counters[t] == NULL)
+      {
+        counters[t] = insert_c_a(est->hashtable, items[t]);
+        counters[t]->count = counts[t];
+        counters[t]->processing = 0;
+      }
+    }
+    cur->c_s0 = counters[i0];
+    cur->c_s1 = counters[i1];
+  }
+  //as in handle_second_distinct, once every counter has its count
+  for(int i = 0; i < c; i++)
+  {
+    cur = est->samplers[i];
+    reset_wait_times(cur, est);
+    insert_heap(est->prim_heap, cur);
+    increment_prim_samplers(est->hashtable, cur->c_s0, est->bheap, cur);
+    increment_backup_samplers(cur->c_s1);
+  }
+  free(starts);
+  free(counters);
+  return est;
+}
+
+//the token whose occurrences cover position x, given the position
+//each token starts at
+static int count_position(const long* starts, int n, long x)
+{
+  int lo = 0, hi = n-1, mid;
+  while(lo < hi)
+  {
+    mid = (lo + hi + 1) / 2;
+    if(starts[mid] <= x) lo = mid;
+    else hi = mid - 1;
+  }
+  return lo;
+}
+
+//add samplers until there are c, each a copy of one of the samplers
+//already there, picked uniformly. A copy holds a valid sample of the
+//stream so far and, as wait times are memoryless, draws its own from
+//here on, so it only shares its original's sample while both keep the
+//position they had: with probability m0/m when copied at length m0.
+//Lets the samplers grow with a stream of unknown length
+void Estimator_Grow(Estimator_type* est, int c)
+{
+  Sample_type *cur, *from;
+
+  if(c <= est->c) return;
+  est->samplers = (Sample_type**) safe_realloc(est->samplers, c * sizeof(Sample_type*));
+  for(int i = est->c; i < c; i++)
+  {
+    cur = est->samplers[i] = Sample_Init();
+    //before the first token handle_first sets every sampler
+    if(est->count == 0) continue;
+    from = est->samplers[(int) (prng_float(est->prng) * est->c) % est->c];
+    cur->c_s0 = from->c_s0;
+    cur->val_c_s0 = from->val_c_s0;
+    cur->t0 = from->t0;
+    //while the stream has one token samplers are in no heap
+    if(!est->two_distinct_tokens) continue;
+    cur->c_s1 = from->c_s1;
+    cur->val_c_s1 = from->val_c_s1;
+    cur->t1 = from->t1;
+    reset_wait_times(cur, est);
+    insert_heap(est->prim_heap, cur);
+    increment_prim_samplers(est->hashtable, cur->c_s0, est->bheap, cur);
+    increment_backup_samplers(cur->c_s1);
+  }
+  est->c = c;
+}
+
+//the estimator with the most samplers that fits in bytes bytes.
+//Sized for the worst case, when each sampler's primary and backup
+//samples are tokens no other sampler holds; Estimator_Update keeps it
+//within bytes if that ever falls short. k is 7/eps for the eps the c
+//samplers give with the log terms of Estimator_Error taken as 1
+Estimator_type* Estimator_Init_Budget(long bytes)
+{
+  Estimator_type* est;
+  int lo = 1, hi = 2, mid;
+
+  if(budget_bytes(1, budget_counters(1)) > bytes)
+    fatal("Estimator_Init_Budget: budget too small for one sampler");
+  while(hi < INT_MAX/2 && budget_bytes(hi, budget_counters(hi)) <= bytes)
+    hi *= 2;
+  while(lo < hi - 1)
+  {
+    mid = lo + (hi - lo) / 2;
+    if(budget_bytes(mid, budget_counters(mid)) <= bytes) lo = mid;
+    else hi = mid;
+  }
+  est = Estimator_Init(lo, budget_counters(lo));
+  est->budget = bytes;
+  return est;
+}
+
+//keep est within bytes bytes from here on, shedding samplers now if it
+//is over; 0 lifts the budget. Shedding picks the samplers uniformly at
+//random, whatever they hold, so those left are still independent
+//samples of the stream and the estimate stays unbiased, only with the
+//wider error Estimator_Error reports
+void Estimator_Set_Budget(Estimator_type* est, long bytes)
+{
+  est->budget = bytes;
+  if(bytes > 0 && Estimator_Size(est) > bytes)
+    estimator_shed(est);
+}
+
+//relative error the samplers left guarantee with probability 1-delta
+//on the stream read so far: eps from c = 16/eps^2 log(2/delta) log(m e)
+double Estimator_Error(Estimator_type* est, double delta)
+{
+  double m = maximum(est->count, 1);
+  return 4 * sqrt(log(2/delta) * (log(m) + 1) / est->c);
+}
+
+//samplers left
+int Estimator_Samplers(Estimator_type* est)
+{
+  return est->c;
+}
+
+//most Estimator_Size can reach with c samplers and k counters: a
+//sampler's own slots plus two counters with their heaps and a slot each
+//in the backup heap, over the fixed parts
+static long budget_bytes(int c, int k)
+{
+  long counter = sizeof(c_a) + sizeof(c_a_heap) +
+                 C_A_HEAP_SIZE * sizeof(Sample_type*) + sizeof(c_a*);
+  long sampler = sizeof(Sample_type) + 2 * sizeof(Sample_type*) + 2 * counter;
+  return sizeof(Estimator_type) + sizeof(heap) + sizeof(backup_heap) +
+         2 * sizeof(void*) + Freq_Size_Phi((float)1.0/k) +
+         sizeof_new_symtab(2*c) + (long) c * sampler;
+}
+
+static int budget_counters(int c)
+{
+  return ceil(7 * sqrt(c) / 4);
+}
+
+//drop samplers picked uniformly at random until est is BUDGET_SLACK
+//under its budget, or one is left. Samplers leave the hash table's
+//counts as they go; the primary heap shrinks after, so until then
+//Estimator_Size still counts a slot there for each sampler dropped
+static void estimator_shed(Estimator_type* est)
+{
+  long target = est->budget - est->budget / BUDGET_SLACK;
+  long slot = sizeof(void*);
+  Sample_type* cur;
+  Sample_type** sorted;
+  int i, c = est->c;
+
+  while(est->c > 1 && Estimator_Size(est) - (c - est->c) * slot > target)
+  {
+    i = (int) (prng_float(est->prng) * est->c) % est->c;
+    cur = est->samplers[i];
+    //while the stream has one token samplers are in no heap
+    if(est->two_distinct_tokens)
+    { //backup first, as in Estimator_Update, so c_s0 can't be freed
+      //from under decrement_prim_samplers
+      decrement_backup_samplers(est->hashtable, cur->c_s1);
+      decrement_prim_samplers(est->hashtable, cur->c_s0, est->bheap, cur);
+    }
+    Sample_Destroy(cur);
+    est->samplers[i] = est->samplers[--est->c];
+  }
+  est->samplers = (Sample_type**) safe_realloc(est->samplers, est->c * sizeof(Sample_type*));
+
+  //a sorted array is in heap order
+  sorted = (Sample_type**) safe_malloc(est->c * sizeof(Sample_type*));
+  for(i = 0; i < est->c; i++)
+    sorted[i] = est->samplers[i];
+  if(est->two_distinct_tokens)
+    qsort(sorted, est->c, sizeof(Sample_type*), sampler_prim_cmp);
+  load_heap(est->prim_heap, (void**) sorted,
+            est->two_distinct_tokens ? est->c : 0, est->c+1);
+  free(sorted);
+}
+
+static int sampler_prim_cmp(const void* p, const void* q)
+{
+  return prim_cmp(*(Sample_type* const*) p, *(Sample_type* const*) q);
+}
+
+//an estimator taking over the samplers of another version part way
+//through a stream. Counters here only count a token from its earliest
+//sample on, so each starts at the largest r any sampler holds for it.
+//Once the stream has two distinct tokens every sampler needs a backup;
+//before that all must hold the one token seen. The distinct count
+//only covers tokens read after the handoff. Takes over h->prng and
+//h->freq and frees h->samplers
+Estimator_type* Estimator_Init_From_Handoff(Sampler_handoff* h)
+{
+  Estimator_type* est = estimator_new(h->c, h->k, h->prng, h->freq);
+  Sample_state* st;
+  Sample_type* cur;
+  int backups = 0;
+
+  est->count = h->count;
+  for(int i = 0; i < h->c; i++)
+  {
+    if(h->samplers[i].r1 > 0) backups++;
+  }
+  if(est->count > 0 && backups == 0)
+  { //as handle_nondistinct leaves it; first stays processing until
+    //handle_second_distinct
+    est->first = insert_c_a(est->hashtable, h->samplers[0].s0);
+    est->first->count = est->count;
+    for(int i = 0; i < h->c; i++)
+    {
+      st = &h->samplers[i];
+      cur = est->samplers[i];
+      if(st->s0 != est->first->key)
+        fatal("Estimator_Init_From_Handoff: sampler without a backup");
+      cur->c_s0 = est->first;
+      cur->val_c_s0 = est->count - st->r0 + 1;
+      cur->t0 = st->t0;
+    }
+  }
+  else if(est->count > 0)
+  {
+    if(backups < h->c)
+      fatal("Estimator_Init_From_Handoff: sampler without a backup");
+    est->two_distinct_tokens = 1;
+    for(int i = 0; i < h->c; i++)
+    {
+      handoff_counter(est, h->samplers[i].s0, h->samplers[i].r0);
+      handoff_counter(est, h->samplers[i].s1, h->samplers[i].r1);
+    }
+    //as in Estimator_Init_From_Counts, once every counter has its count
+    for(int i = 0; i < h->c; i++)
+    {
+      st = &h->samplers[i];
+      cur = est->samplers[i];
+      cur->c_s0 = find_c_a(est->hashtable, st->s0);
+      cur->val_c_s0 = cur->c_s0->count - st->r0 + 1;
+      cur->t0 = st->t0;
+      cur->c_s1 = find_c_a(est->hashtable, st->s1);
+      cur->val_c_s1 = cur->c_s1->count - st->r1 + 1;
+      cur->t1 = st->t1;
+      reset_wait_times(cur, est);
+      insert_heap(est->prim_heap, cur);
+      increment_prim_samplers(est->hashtable, cur->c_s0, est->bheap, cur);
+      increment_backup_samplers(cur->c_s1);
+    }
+  }
+  free(h->samplers);
+  h->samplers = NULL;
+  return est;
+}
+
+//the counter of key, created if need be, counting at least r
+static c_a* handoff_counter(Estimator_type* est, int key, int r)
+{
+  c_a* a = find_c_a(est->hashtable, key);
+  if(a == NULL)
+  {
+    a = insert_c_a(est->hashtable, key);
+    a->count = 0;
+    a->processing = 0;
+  }
+  a->count = maximum(a->count, r);
+  return a;
+}
+
+//hand est's samplers, Misra-Gries counters and generator over to h and
+//free the rest of est
+void Estimator_Handoff(Estimator_type* est, Sampler_handoff* h)
+{
+  Sample_state* st;
+  Sample_type* cur;
+
+  h->c = est->c;
+  h->k = est->k;
+  h->count = est->count;
+  h->prng = est->prng;
+  h->freq = est->freq;
+  h->samplers = (Sample_state*) safe_malloc(est->c * sizeof(Sample_state));
+  for(int i = 0; i < est->c; i++)
+  {
+    st = &h->samplers[i];
+    cur = est->samplers[i];
+    st->s0 = st->s1 = 0;
+    st->r0 = st->r1 = 0;
+    st->t0 = cur->t0;
+    st->t1 = 1;
+    if(est->count > 0)
+    {
+      st->s0 = cur->c_s0->key;
+      st->r0 = cur->c_s0->count - cur->val_c_s0 + 1;
+    }
+    if(est->two_distinct_tokens)
+    {
+      st->s1 = cur->c_s1->key;
+      st->r1 = cur->c_s1->count - cur->val_c_s1 + 1;
+      st->t1 = cur->t1;
+    }
+  }
+  estimator_free(est);
+}
+
+//an empty estimator using the given generator and Misra-Gries counters
+static Estimator_type* estimator_new(int c, int k, prng_type* prng, freq_type* freq)
 {
   Estimator_type* est = (Estimator_type*) safe_malloc(sizeof(Estimator_type));
   est->c=c;
   est->k=k;
   est->count = 0;
   est->two_distinct_tokens=0;
-  est->prng=prng_Init(drand48(), 2); 
-  // initialize the random number generator
-  est->freq=Freq_Init((float)1.0/k);
+  est->first = NULL;
+  est->budget = 0;
+  est->prng=prng;
+  est->freq=freq;
 	
   est->samplers = (Sample_type**) safe_malloc(sizeof(Sample_type*) * c);	
   for(int i = 0; i < c; i++)
@@ -81,8 +468,10 @@ Estimator_type * Estimator_Init(int c, int k)
   }
   
   est->hashtable=new_symtab(2*c);
-  est->prim_heap = new_heap(prim_cmp, c);
-  est->bheap = new_bheap(b_cmp, c);  
+  HLL_Reset(&est->distinct);
+  //heaps start at slot 1, so c entries need c+1 slots
+  est->prim_heap = new_heap(prim_cmp, c+1);
+  est->bheap = new_bheap(b_cmp, c+1);  
   return est;
 }
 
@@ -95,12 +484,18 @@ void Sample_Destroy(Sample_type * sm)
 void Estimator_Destroy(Estimator_type * est)
 {
   prng_Destroy(est->prng);
+  Freq_Destroy(est->freq);
+  estimator_free(est);
+}
+
+//everything but the generator and the Misra-Gries counters
+static void estimator_free(Estimator_type* est)
+{
   for(int i=0; i < est->c; i++)
   {
     Sample_Destroy(est->samplers[i]);
   }
   free(est->samplers);
-  Freq_Destroy(est->freq);
   free_bheap(est->bheap);
   free_heap(est->prim_heap);
   free_symtab(est->hashtable);
@@ -116,7 +511,7 @@ int Estimator_Size(Estimator_type * est)
   admin=sizeof(Estimator_type);
   freq=Freq_Size(est->freq);
   //note Freq_Size just a placeholder function at the moment
-  samplers = est->c*sizeof(Sample_type);
+  samplers = est->c*(sizeof(Sample_type) + sizeof(Sample_type*));
   hash = sizeof_symtab(est->hashtable);
   prim = sizeof_heap(est->prim_heap);
   backup = sizeof_bheap(est->bheap);
@@ -185,7 +580,7 @@ void handle_second_distinct(Estimator_type* est, c_a* token)
 	//insertion/restoring heap property in c_s0's heap and est's bheapneeds 
 	//and hence needs the wait times to be set properly as precondition
 	insert_heap(est->prim_heap, cur);
-	increment_prim_samplers(cur->c_s0, est->bheap, cur);
+	increment_prim_samplers(est->hashtable, cur->c_s0, est->bheap, cur);
 	increment_backup_samplers(cur->c_s1);
   }
 }
@@ -239,6 +634,8 @@ void reset_wait_times(Sample_type* cur, Estimator_type* est)
 void Estimator_Update(Estimator_type * est, int token)
 {
   int old_cs0pos, old_backupminuswait, wait;
+  if(est->budget && est->c > 1 && Estimator_Size(est) > est->budget)
+    estimator_shed(est);
   est->count++;
   
   Freq_Update(est->freq, token);
@@ -250,6 +647,7 @@ void Estimator_Update(Estimator_type * est, int token)
   //ties by having the sampler take a new *primary* sample
 
   //increment count of token, sets processing to 1
+  HLL_Add(&est->distinct, (unsigned int) token);
   c_a* counter = increment_count(est->hashtable, token);
   
   //check for special cases
@@ -325,7 +723,7 @@ void Estimator_Update(Estimator_type * est, int token)
 	  increment_backup_samplers(min->c_s1);
 	  decrement_backup_samplers(est->hashtable, old_c_s1);
 	  decrement_prim_samplers(est->hashtable, min->c_s1, est->bheap, min);	  
-	  increment_prim_samplers(counter, est->bheap, min);
+	  increment_prim_samplers(est->hashtable, counter, est->bheap, min);
 	}
 	//reinsert min into primary heap
 	insert_heap(est->prim_heap, min);
@@ -439,4 +837,383 @@ double Estimator_end_stream(Estimator_type* est)
 	}
 	return sum_Xis /est->c;  
   }	  
-}
\ No newline at end of file
+}
+
+//frequency moment F_p = sum f_i^p from the same samplers as the
+//entropy; see moments.c
+double Estimator_Fp(Estimator_type* est, double p)
+{
+  int max_count, max_token, m = est->count;
+  int* r;
+  double fp;
+
+  if(est->count == 0)
+    return 0;
+  if(est->two_distinct_tokens == 0) //only one token in stream
+    return pow(m, p);
+  max_count = 0;
+  SaveMax(est->freq, &max_token, &max_count);
+  if(max_count <= (int) (m/2))
+    max_count = 0;
+  r = (int*) safe_malloc(est->c * sizeof(int));
+  for(int i = 0; i < est->c; i++)
+  {
+    if(max_count > 0 && est->samplers[i]->c_s0->key == max_token)
+      r[i] = est->samplers[i]->c_s1->count - est->samplers[i]->val_c_s1 + 1;
+    else
+      r[i] = est->samplers[i]->c_s0->count - est->samplers[i]->val_c_s0 + 1;
+  }
+  fp = Moments_Fp(r, est->c, p, m, max_count);
+  free(r);
+  return fp;
+}
+
+//divergence D(P || Q) in bits of the stream from the Q in which token
+//has probability 2^-cost(arg, token), from the same samplers as the
+//entropy. Each sampler's term is its token's cost less the one it adds
+//to the entropy, so the error from which tokens were sampled shows up
+//in both parts and cancels
+double Estimator_Divergence(Estimator_type* est, double (*cost)(void* arg, int token),
+                            void* arg)
+{
+  int max_count = 0, max_token, m = est->count, r, token;
+  double p_max = 0, sum_Xis = 0, X;
+
+  if(est->count == 0)
+    return 0;
+  if(est->two_distinct_tokens == 0) //only one token in stream
+    return cost(arg, est->samplers[0]->c_s0->key);
+  SaveMax(est->freq, &max_token, &max_count);
+  if(max_count > (int) (m/2))
+    p_max = (double) max_count/m;
+  for(int i = 0; i < est->c; i++)
+  {
+    if(p_max > 0 && est->samplers[i]->c_s0->key == max_token)
+    {
+      token = est->samplers[i]->c_s1->key;
+      r = est->samplers[i]->c_s1->count - est->samplers[i]->val_c_s1 + 1;
+    }
+    else
+    {
+      token = est->samplers[i]->c_s0->key;
+      r = est->samplers[i]->c_s0->count - est->samplers[i]->val_c_s0 + 1;
+    }
+    X = r * log10((double) m/r)/log10(2);
+    if(r > 1)
+      X -= (r-1) * log10((double) m/(r-1))/log10(2);
+    sum_Xis += cost(arg, token) - X;
+  }
+  if(p_max == 0)
+    return sum_Xis / est->c;
+  return (1-p_max) * sum_Xis / est->c +
+         p_max * (log10(p_max)/log10(2) + cost(arg, max_token));
+}
+
+//Renyi entropy of order alpha, in bits
+double Estimator_Renyi(Estimator_type* est, double alpha)
+{
+  if(alpha == 1)
+    return Estimator_end_stream(est);
+  return Moments_Renyi(Estimator_Fp(est, alpha), alpha, est->count);
+}
+
+//Tsallis entropy of order alpha
+double Estimator_Tsallis(Estimator_type* est, double alpha)
+{
+  if(alpha == 1) //the limit is the Shannon entropy in nats
+    return Estimator_end_stream(est) * log(2);
+  return Moments_Tsallis(Estimator_Fp(est, alpha), alpha, est->count);
+}
+
+//number of distinct tokens F_0, from the HyperLogLog registers
+double Estimator_Distinct(Estimator_type* est)
+{
+  return HLL_Estimate(&est->distinct);
+}
+
+//entropy as a fraction of its largest value log2(F_0) for the number
+//of distinct tokens; 0 if there are fewer than two
+double Estimator_Normalized(Estimator_type* est)
+{
+  double f0 = Estimator_Distinct(est);
+  if(f0 < 2)
+    return 0;
+  return fmin(1, Estimator_end_stream(est) / log2(f0));
+}
+
+static int sampler_ref_cmp(const void* p, const void* q)
+{
+  uintptr_t a = (uintptr_t) ((const sampler_ref*) p)->sm;
+  uintptr_t b = (uintptr_t) ((const sampler_ref*) q)->sm;
+  return (a==b) ? 0 : (a<b) ? -1 : 1;
+}
+
+static int sampler_index(sampler_ref* refs, int c, Sample_type* sm)
+{
+  sampler_ref key, *found;
+  key.sm = sm;
+  found = (sampler_ref*) bsearch(&key, refs, c, sizeof(sampler_ref), sampler_ref_cmp);
+  if(found == NULL) fatal("Estimator_Serialize: sampler not in estimator");
+  return found->index;
+}
+
+//writes the whole state of est: samplers, the counters c_a they
+//sample with the exact order of every heap, the generator and the
+//Misra-Gries counters. Returns a malloc'd image of *len bytes that
+//Estimator_Deserialize turns back into an estimator which continues
+//exactly as est would
+unsigned char* Estimator_Serialize(Estimator_type* est, long* len)
+{
+  serial_buf b;
+  sampler_ref* refs;
+  c_a** counters;
+  Sample_type* cur;
+  int n;
+
+  Serial_Init(&b);
+  Serial_Put_Header(&b, SERIAL_FAST);
+  Serial_Put_Int(&b, est->c);
+  Serial_Put_Int(&b, est->k);
+  Serial_Put_Int(&b, est->count);
+  Serial_Put_Int(&b, est->two_distinct_tokens);
+  //est->first is only used until the second distinct token
+  if(est->count > 0 && !est->two_distinct_tokens)
+  {
+    Serial_Put_Int(&b, 1);
+    Serial_Put_Int(&b, est->first->key);
+  }
+  else
+  {
+    Serial_Put_Int(&b, 0);
+    Serial_Put_Int(&b, 0);
+  }
+  prng_Serialize(est->prng, &b);
+  Freq_Serialize(est->freq, &b);
+  for(int i = 0; i < HLL_REGISTERS; i += 4)
+    Serial_Put_U32(&b, (unsigned int) Serial_Load(est->distinct.reg + i, 4));
+
+  refs = (sampler_ref*) safe_malloc(est->c * sizeof(sampler_ref));
+  for(int i = 0; i < est->c; i++)
+  {
+    refs[i].sm = est->samplers[i];
+    refs[i].index = i;
+  }
+  qsort(refs, est->c, sizeof(sampler_ref), sampler_ref_cmp);
+
+  n = list_c_a(est->hashtable, NULL);
+  counters = (c_a**) safe_malloc((n+1) * sizeof(c_a*));
+  list_c_a(est->hashtable, counters);
+  Serial_Put_Int(&b, n);
+  for(int i = 0; i < n; i++)
+  {
+    c_a* a = counters[i];
+    Serial_Put_Int(&b, a->key);
+    Serial_Put_Int(&b, a->count);
+    Serial_Put_Int(&b, a->num_prim_samplers);
+    Serial_Put_Int(&b, a->num_backup_samplers);
+    Serial_Put_Int(&b, a->processing);
+    Serial_Put_Int(&b, a->backup_pos);
+    Serial_Put_Int(&b, a->sample_heap->maxsize);
+    Serial_Put_Int(&b, a->sample_heap->cursize);
+    for(int j = 1; j <= a->sample_heap->cursize; j++)
+      Serial_Put_Int(&b, sampler_index(refs, est->c, a->sample_heap->node[j]));
+  }
+
+  for(int i = 0; i < est->c; i++)
+  {
+    cur = est->samplers[i];
+    Serial_Put_Int(&b, cur->val_c_s0);
+    Serial_Put_Int(&b, cur->val_c_s1);
+    Serial_Put_Double(&b, cur->t0);
+    Serial_Put_Double(&b, cur->t1);
+    Serial_Put_Int(&b, cur->c_s0 != NULL);
+    Serial_Put_Int(&b, cur->c_s0 ? cur->c_s0->key : 0);
+    Serial_Put_Int(&b, cur->c_s1 != NULL);
+    Serial_Put_Int(&b, cur->c_s1 ? cur->c_s1->key : 0);
+    Serial_Put_Int(&b, cur->c_s0_pos);
+    Serial_Put_Int(&b, cur->prim);
+    Serial_Put_Int(&b, cur->backup_minus_delay);
+  }
+
+  Serial_Put_Int(&b, est->prim_heap->maxsize);
+  Serial_Put_Int(&b, est->prim_heap->cursize);
+  for(int j = 1; j <= est->prim_heap->cursize; j++)
+    Serial_Put_Int(&b, sampler_index(refs, est->c, est->prim_heap->node[j]));
+  Serial_Put_Int(&b, est->bheap->maxsize);
+  Serial_Put_Int(&b, est->bheap->cursize);
+  for(int j = 1; j <= est->bheap->cursize; j++)
+    Serial_Put_Int(&b, est->bheap->node[j]->key);
+
+  free(counters);
+  free(refs);
+  *len = b.len;
+  return b.data;
+}
+
+//read one heap of sampler indices into sms, checking each index
+static int read_sampler_heap(serial_reader* r, Estimator_type* est,
+                             Sample_type** sms, int* maxsize, int* n)
+{
+  int index;
+  *maxsize = Serial_Get_Int(r);
+  *n = Serial_Get_Int(r);
+  if(*n < 0 || *n > est->c || *maxsize < 0) r->error = 1;
+  for(int j = 0; j < *n && !r->error; j++)
+  {
+    index = Serial_Get_Int(r);
+    if(index < 0 || index >= est->c) r->error = 1;
+    else sms[j] = est->samplers[index];
+  }
+  return !r->error;
+}
+
+//rebuild an estimator from an image written by Estimator_Serialize.
+//Returns NULL if the image is truncated, corrupt, or from another
+//version of the format
+Estimator_type* Estimator_Deserialize(const unsigned char* image, long len)
+{
+  serial_reader r;
+  Estimator_type* est;
+  prng_type* prng;
+  freq_type* freq;
+  int c, k, count, two_distinct, has_first, first_key, n, maxsize, hn;
+  int *keys, *starts, *fields, *indices, nindices = 0;
+  Sample_type** sms;
+  c_a* a;
+
+  Serial_Reader_Init(&r, image, len);
+  if(!Serial_Get_Header(&r, SERIAL_FAST)) return NULL;
+  c = Serial_Get_Int(&r);
+  k = Serial_Get_Int(&r);
+  count = Serial_Get_Int(&r);
+  two_distinct = Serial_Get_Int(&r);
+  has_first = Serial_Get_Int(&r);
+  first_key = Serial_Get_Int(&r);
+  if(r.error || c < 1 || k < 1 || count < 0 || !Serial_Check_Count(&r, c, 4))
+    return NULL;
+  prng = prng_Deserialize(&r);
+  if(prng == NULL) return NULL;
+  freq = Freq_Deserialize(&r);
+  if(freq == NULL)
+  {
+    prng_Destroy(prng);
+    return NULL;
+  }
+  est = estimator_new(c, k, prng, freq);
+  est->count = count;
+  est->two_distinct_tokens = two_distinct;
+  for(int i = 0; i < HLL_REGISTERS; i += 4)
+    Serial_Store(est->distinct.reg + i, Serial_Get_U32(&r), 4);
+  for(int i = 0; i < HLL_REGISTERS; i++)
+    if(est->distinct.reg[i] > 32 - HLL_BITS + 1) r.error = 1;
+
+  //counters are read in full first, since they must be inserted in
+  //reverse to recreate the buckets
+  n = Serial_Get_Int(&r);
+  if(!Serial_Check_Count(&r, n, 32))
+  {
+    Estimator_Destroy(est);
+    return NULL;
+  }
+  keys = (int*) safe_malloc((n+1) * sizeof(int));
+  fields = (int*) safe_malloc((n+1) * 7 * sizeof(int));
+  starts = (int*) safe_malloc((n+1) * sizeof(int));
+  //every index takes 4 bytes of what is left of the image
+  indices = (int*) safe_malloc(((r.len - r.pos)/4 + 1) * sizeof(int));
+  for(int i = 0; i < n && !r.error; i++)
+  {
+    keys[i] = Serial_Get_Int(&r);
+    for(int f = 0; f < 7; f++)
+      fields[7*i + f] = Serial_Get_Int(&r);
+    hn = fields[7*i + 6];
+    starts[i] = nindices;
+    if(hn > c || !Serial_Check_Count(&r, hn, 4))
+    {
+      r.error = 1;
+      break;
+    }
+    for(int j = 0; j < hn; j++)
+    {
+      indices[nindices] = Serial_Get_Int(&r);
+      if(indices[nindices] < 0 || indices[nindices] >= c) r.error = 1;
+      nindices++;
+    }
+  }
+  starts[n] = nindices;
+  sms = (Sample_type**) safe_malloc((c+1) * sizeof(Sample_type*));
+  for(int i = n-1; i >= 0 && !r.error; i--)
+  {
+    a = insert_c_a(est->hashtable, keys[i]);
+    if(a == NULL)
+    {
+      r.error = 1;
+      break;
+    }
+    a->count = fields[7*i];
+    a->num_prim_samplers = fields[7*i + 1];
+    a->num_backup_samplers = fields[7*i + 2];
+    a->processing = fields[7*i + 3];
+    a->backup_pos = fields[7*i + 4];
+    for(int j = starts[i]; j < starts[i+1]; j++)
+      sms[j - starts[i]] = est->samplers[indices[j]];
+    load_c_a_heap(a->sample_heap, sms, starts[i+1] - starts[i], fields[7*i + 5]);
+  }
+  recount_symtab(est->hashtable);
+  free(keys);
+  free(fields);
+  free(starts);
+  free(indices);
+
+  for(int i = 0; i < c && !r.error; i++)
+  {
+    Sample_type* cur = est->samplers[i];
+    int has0, key0, has1, key1;
+    cur->val_c_s0 = Serial_Get_Int(&r);
+    cur->val_c_s1 = Serial_Get_Int(&r);
+    cur->t0 = Serial_Get_Double(&r);
+    cur->t1 = Serial_Get_Double(&r);
+    has0 = Serial_Get_Int(&r);
+    key0 = Serial_Get_Int(&r);
+    has1 = Serial_Get_Int(&r);
+    key1 = Serial_Get_Int(&r);
+    //c_s0_pos was set by load_c_a_heap if cur is in a heap
+    if(Serial_Get_Int(&r) != cur->c_s0_pos) r.error = 1;
+    cur->prim = Serial_Get_Int(&r);
+    cur->backup_minus_delay = Serial_Get_Int(&r);
+    cur->c_s0 = has0 ? find_c_a(est->hashtable, key0) : NULL;
+    cur->c_s1 = has1 ? find_c_a(est->hashtable, key1) : NULL;
+    if((has0 && cur->c_s0 == NULL) || (has1 && cur->c_s1 == NULL))
+      r.error = 1;
+  }
+
+  if(!r.error && read_sampler_heap(&r, est, sms, &maxsize, &hn))
+    load_heap(est->prim_heap, (void**) sms, hn, maxsize);
+  free(sms);
+
+  maxsize = Serial_Get_Int(&r);
+  hn = Serial_Get_Int(&r);
+  if(!r.error && hn >= 0 && Serial_Check_Count(&r, hn, 4))
+  {
+    c_a** nodes = (c_a**) safe_malloc((hn+1) * sizeof(c_a*));
+    for(int j = 0; j < hn && !r.error; j++)
+    {
+      nodes[j] = find_c_a(est->hashtable, Serial_Get_Int(&r));
+      if(nodes[j] == NULL) r.error = 1;
+    }
+    if(!r.error) load_bheap(est->bheap, nodes, hn, maxsize);
+    free(nodes);
+  }
+  else r.error = 1;
+
+  if(has_first)
+  {
+    est->first = find_c_a(est->hashtable, first_key);
+    if(est->first == NULL) r.error = 1;
+  }
+  if(r.error || r.pos != r.len)
+  {
+    Estimator_Destroy(est);
+    return NULL;
+  }
+  return est;
+}
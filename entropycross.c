@@ -0,0 +1,188 @@
+/*Harness for cross-entropy and KL divergence (cross.c).
+ *
+ *Builds a reference from the exact counts of a zipfian stream with
+ *parameter z, then measures a live zipfian stream with parameter Z,
+ *its tokens shifted by s to model drift, against it: once against the
+ *full reference and once against a sketch keeping only the K most
+ *frequent tokens. With -o the reference pairs go through a file, as
+ *from a prior run. Compares with the exact entropy and divergence
+ *against each reference, failing if a divergence is off by more than
+ *the estimator's guarantee of a relative error eps on the entropy, and
+ *times the pass against Estimator_Update.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <unistd.h>
+#include <ctype.h>
+#include "massdal.h"
+#include "crosspub.h"
+#include "entropypub.h"
+#include "prng.h"
+#include "util.h"
+
+#define LENGTH_DEFAULT 2000000
+#define RANGE_DEFAULT 99999
+#define KEEP_DEFAULT 1000
+#define ALPHA_DEFAULT 0.5
+
+static int* CreateStream(int length, double zipfpar, int range, int shift, long seed);
+
+int main(int argc, char **argv) 
+{
+  int length = LENGTH_DEFAULT, range = RANGE_DEFAULT, keep = KEEP_DEFAULT;
+  int c = 0, k = 0, shift = 0, next;
+  double zipfparam = 1.1, zipfparam2 = 1.1, eps = .5, delta = .1, alpha = ALPHA_DEFAULT;
+  char* path = NULL;
+  
+  while ((next = getopt (argc, argv, "z:Z:s:l:r:e:d:c:k:K:a:o:")) != -1)
+  {     
+	switch (next)
+	{
+	  case 'z': zipfparam = strtod(optarg, (char **) NULL); break;
+	  case 'Z': zipfparam2 = strtod(optarg, (char **) NULL); break;
+	  case 's': shift = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'l': length = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'r': range = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'e': eps = strtod(optarg, (char **) NULL); break;
+	  case 'd': delta = strtod(optarg, (char **) NULL); break;
+	  case 'c': c = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'k': k = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'K': keep = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'a': alpha = strtod(optarg, (char **) NULL); break;
+	  case 'o': path = optarg; break;
+   	  case '?':
+	   if (isprint (optopt))
+		fprintf (stderr, "Unknown option or required argument not provided `-%c'.\n", optopt);
+		else
+		 fprintf (stderr, "Unknown option character `\\x%x'.\n",
+                        optopt);
+		exit(1);
+		break;
+	 default:
+	   abort();
+    }
+  }
+  if(length <= 0 || range <= 0 || keep <= 0 || shift < 0 || alpha <= 0 ||
+     zipfparam < 0 || zipfparam2 < 0 || eps <= 0 || eps > 1 ||
+     delta <= 0 || delta > 1)
+  {
+    fprintf(stderr, "invalid arguments\n");
+	exit(1);
+  }
+  if(c <= 0)
+	c = ceil(16 * 1/(eps*eps) * log(2/delta) * log(length * M_E));
+  if(k <= 0)
+	k = ceil(7/eps);
+
+  //the reference: exact counts of a prior stream
+  int* base = CreateStream(length, zipfparam, range, 0, 44545);
+  long* counts = (long*) calloc(range+2, sizeof(long));
+  int* tokens = (int*) safe_malloc((range+2) * sizeof(int));
+  int n = 0;
+  for(int i = 0; i < length; i++) counts[base[i]]++;
+  for(int t = 0; t <= range+1; t++)
+  {
+    if(counts[t] > 0)
+    {
+      tokens[n] = t;
+      counts[n++] = counts[t];
+    }
+  }
+  free(base);
+
+  Reference_type *full, *sketch;
+  if(path != NULL)
+  {
+    if(Reference_Save(path, tokens, counts, n) != 0)
+      fatal("can't write reference %s", path);
+    full = Reference_Load(path, 0, alpha);
+    sketch = Reference_Load(path, keep, alpha);
+    if(full == NULL || sketch == NULL)
+      fatal("can't read reference %s", path);
+  }
+  else
+  {
+    full = Reference_Init(tokens, counts, n, 0, alpha);
+    sketch = Reference_Init(tokens, counts, n, keep, alpha);
+  }
+
+  //the live stream and its exact entropy
+  int* stream = CreateStream(length, zipfparam2, range, shift, 54454);
+  long* live = (long*) calloc(range+2, sizeof(long));
+  double h = 0, cross, h_est, kl, cross2, kl2, exact = 0, exact2 = 0, p, bound;
+  long ms;
+  for(int i = 0; i < length; i++) live[stream[i]]++;
+  for(int t = 0; t <= range+1; t++)
+  {
+    if(live[t] == 0) continue;
+    p = (double) live[t]/length;
+    h -= p * log2(p);
+    exact += p * Reference_Cost(full, t);
+    exact2 += p * Reference_Cost(sketch, t);
+  }
+  exact -= h;
+  exact2 -= h;
+  bound = eps * h;
+
+  Cross_Estimator_type* est = Cross_Estimator_Init(c, k, full);
+  Cross_Estimator_type* est2 = Cross_Estimator_Init(c, k, sketch);
+  StartTheClock();
+  for(int i = 0; i < length; i++)
+    Cross_Estimator_Update(est, stream[i]);
+  cross = Cross_Estimator_end_stream(est, &h_est, &kl);
+  ms = StopTheClock();
+  for(int i = 0; i < length; i++)
+    Cross_Estimator_Update(est2, stream[i]);
+  cross2 = Cross_Estimator_end_stream(est2, NULL, &kl2);
+
+  printf("c %d, k %d, %d reference tokens, shift %d\n", c, k, n, shift);
+  printf("exact entropy %f, estimated %f\n", h, h_est);
+  printf("full reference (%d bytes): cross-entropy %f, KL exact %f, estimated %f%s\n",
+         Reference_Size(full), cross, exact, kl,
+         fabs(kl - exact) > bound ? ", OFF BY MORE THAN EXPECTED" : "");
+  printf("%d-token sketch (%d bytes): cross-entropy %f, KL exact %f, estimated %f%s\n",
+         keep, Reference_Size(sketch), cross2, exact2, kl2,
+         fabs(kl2 - exact2) > bound ? ", OFF BY MORE THAN EXPECTED" : "");
+  printf("cross-entropy pass took %ld ms\n", ms);
+
+  Estimator_type* est_full = Estimator_Init(c, k);
+  StartTheClock();
+  for(int i = 0; i < length; i++)
+    Estimator_Update(est_full, stream[i]);
+  ms = StopTheClock();
+  printf("Estimator_Update took %ld ms\n", ms);
+  Estimator_Destroy(est_full);
+
+  Cross_Estimator_Destroy(est);
+  Cross_Estimator_Destroy(est2);
+  Reference_Destroy(full);
+  Reference_Destroy(sketch);
+  free(live);
+  free(stream);
+  free(tokens);
+  free(counts);
+  return fabs(kl - exact) > bound || fabs(kl2 - exact2) > bound;
+}
+
+/******************************************************************/
+//Creates and returns stream of ints in range [1, range+1], zipfian
+//with zipfpar, each token moved shift places along the range
+static int* CreateStream(int length, double zipfpar, int range, int shift, long seed)
+{
+  float zet;
+  int* stream;
+  prng_type * prng;
+  
+  stream=(int *) safe_malloc(length * sizeof(int));
+  prng=prng_Init(seed,2);
+  zet=zeta(length,zipfpar);
+  for (int i=0;i<length;i++) 
+  {
+	stream[i]=(int) floor(fastzipf(zipfpar,range,zet,prng));
+	stream[i]=(stream[i] - 1 + shift) % (range+1) + 1;
+  }
+  prng_Destroy(prng);
+  return(stream);
+}
@@ -0,0 +1,186 @@
+/*Harness for exponentially time-decayed entropy (decay.c).
+ *
+ *Feeds a synthetic stream, alternating between segments with two zipf
+ *parameters, at rate tokens per time unit into an estimator with the
+ *given half-life. With -j times are jittered by up to that many units,
+ *so tokens arrive out of order.
+ *
+ *At evenly spaced points it compares the estimate with the exact
+ *decayed entropy, kept with an exact decayed count per token, and it
+ *times updates against Estimator_Update on the same stream.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <unistd.h>
+#include <ctype.h>
+#include "massdal.h"
+#include "decaypub.h"
+#include "entropypub.h"
+#include "prng.h"
+#include "util.h"
+
+#define LENGTH_DEFAULT 4000000
+#define RANGE_DEFAULT 99999
+#define HALF_LIFE_DEFAULT 100
+#define RATE_DEFAULT 1000
+#define SEGMENTS_DEFAULT 20
+#define CHECKS_DEFAULT 40
+
+static int* CreateStream(int length, double zipfpar, double zipfpar2, int range,
+                         int segments);
+
+int main(int argc, char **argv) 
+{
+  int length = LENGTH_DEFAULT, range = RANGE_DEFAULT, c = 0, k = 0;
+  int rate = RATE_DEFAULT, segments = SEGMENTS_DEFAULT, checks = CHECKS_DEFAULT;
+  int next;
+  double zipfparam = 1.1, zipfparam2 = 0.6, eps = .5, delta = .1;
+  double half_life = HALF_LIFE_DEFAULT, jitter = 0;
+  
+  while ((next = getopt (argc, argv, "z:Z:l:r:e:d:c:k:H:T:j:S:q:")) != -1)
+  {     
+	switch (next)
+	{
+	  case 'z': zipfparam = strtod(optarg, (char **) NULL); break;
+	  case 'Z': zipfparam2 = strtod(optarg, (char **) NULL); break;
+	  case 'l': length = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'r': range = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'e': eps = strtod(optarg, (char **) NULL); break;
+	  case 'd': delta = strtod(optarg, (char **) NULL); break;
+	  case 'c': c = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'k': k = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'H': half_life = strtod(optarg, (char **) NULL); break;
+	  case 'T': rate = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'j': jitter = strtod(optarg, (char **) NULL); break;
+	  case 'S': segments = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'q': checks = (int)strtol(optarg, (char **)NULL, 10); break;
+   	  case '?':
+	   if (isprint (optopt))
+		fprintf (stderr, "Unknown option or required argument not provided `-%c'.\n", optopt);
+		else
+		 fprintf (stderr, "Unknown option character `\\x%x'.\n",
+                        optopt);
+		exit(1);
+		break;
+	 default:
+	   abort();
+    }
+  }
+  if(length <= 0 || range <= 0 || rate <= 0 || half_life <= 0 || jitter < 0 ||
+     segments <= 0 || checks <= 0 || zipfparam < 0 || zipfparam2 < 0 ||
+     eps <= 0 || eps > 1 || delta <= 0 || delta > 1)
+  {
+    fprintf(stderr, "invalid arguments\n");
+	exit(1);
+  }
+  if(c <= 0)
+	c = ceil(16 * 1/(eps*eps) * log(2/delta) * log(length * M_E));
+  if(k <= 0)
+	k = ceil(7/eps);
+
+  int* stream = CreateStream(length, zipfparam, zipfparam2, range, segments);
+  double* times = (double*) safe_malloc(length * sizeof(double));
+  prng_type* prng = prng_Init(4242, 2);
+  for(int i = 0; i < length; i++)
+  {
+    times[i] = (double) i / rate;
+    if(jitter > 0)
+      times[i] -= jitter * ((prng_int(prng) & MOD) / (double) MOD);
+  }
+  prng_Destroy(prng);
+
+  //exact decayed counts, forward-decayed from their own landmark
+  double lambda = log(2) / half_life, landmark = times[0], total = 0;
+  double* weights = (double*) calloc(range+2, sizeof(double));
+  Decay_Estimator_type* d = Decay_Estimator_Init(c, k, half_life);
+  long check = length / checks, step = check, fed = 0, ms = 0, size, max_size = 0;
+  double est, exact, err, sum_err = 0, max_err = 0;
+  int done = 0;
+
+  if(step < 1) step = check = 1;
+  StartTheClock();
+  for(int i = 0; i < length; i++)
+  {
+    Decay_Estimator_Update(d, times[i], stream[i]);
+    if(i+1 < check) continue;
+    ms += StopTheClock();
+    check += step;
+
+    //bring the exact counts up to i, then the exact decayed entropy
+    for(; fed <= i; fed++)
+    {
+      double x = lambda * (times[fed] - landmark);
+      if(x > 256)
+      {
+        double f = exp(-x);
+        for(int t = 0; t <= range+1; t++)
+          weights[t] *= f;
+        total *= f;
+        landmark = times[fed];
+        x = 0;
+      }
+      weights[stream[fed]] += exp(x);
+      total += exp(x);
+    }
+    double sum_wlogw = 0;
+    for(int t = 0; t <= range+1; t++)
+      if(weights[t] > 0) sum_wlogw += weights[t] * log(weights[t]);
+    exact = (log(total) - sum_wlogw/total) / log(2);
+    est = Decay_Estimator_end_stream(d);
+    err = fabs(est - exact);
+    sum_err += err;
+    if(err > max_err) max_err = err;
+    size = Decay_Estimator_Size(d);
+    if(size > max_size) max_size = size;
+    done++;
+    StartTheClock();
+  }
+  ms += StopTheClock();
+  printf("half-life %g time units at %d tokens per unit, c %d, k %d\n",
+         half_life, rate, c, k);
+  printf("%d checks: mean error %f, max error %f, at most %ld bytes\n", done,
+         sum_err/done, max_err, max_size);
+  printf("decayed updates took %ld ms\n", ms);
+
+  //the whole-stream estimator on the same stream, for comparison
+  Estimator_type* est_full = Estimator_Init(c, k);
+  StartTheClock();
+  for(int i = 0; i < length; i++)
+    Estimator_Update(est_full, stream[i]);
+  ms = StopTheClock();
+  printf("Estimator_Update took %ld ms\n", ms);
+  Estimator_Destroy(est_full);
+
+  Decay_Estimator_Destroy(d);
+  free(weights);
+  free(times);
+  free(stream);
+  return 0;
+}
+
+/******************************************************************/
+//Creates and returns stream of ints in range [1, range+1], in segments
+//that alternate between zipfian distributions with zipfpar and zipfpar2
+static int* CreateStream(int length, double zipfpar, double zipfpar2, int range,
+                         int segments)
+{
+  float zet, zet2;
+  int* stream;
+  prng_type * prng;
+  
+  stream=(int *) safe_malloc(length * sizeof(int));
+  prng=prng_Init(44545,2);
+  zet=zeta(length,zipfpar);
+  zet2=zeta(length,zipfpar2);
+  for (int i=0;i<length;i++) 
+  {
+    if (((long) i * segments / length) % 2 == 0)
+	  stream[i]=(int) floor(fastzipf(zipfpar,range,zet,prng));
+    else
+	  stream[i]=(int) floor(fastzipf(zipfpar2,range,zet2,prng));
+  }
+  prng_Destroy(prng);
+  return(stream);
+}
@@ -0,0 +1,313 @@
+/*Harness for the distributed monitoring protocol in distributed.c.
+ *
+ *Forks one process per site, each connected to the coordinator (this
+ *process) by a Unix socket pair. Every site sees the same synthetic
+ *zipfian stream but only processes its share of the positions, so the
+ *same token turns up at several sites; with -H each token goes to the
+ *site it hashes to instead, so the sites own disjoint tokens. The
+ *stream is cut into rounds; after its share of each round a site
+ *writes a tick, and once the coordinator has read every site's tick
+ *for a round it compares its estimate with the exact entropy of the
+ *stream so far. This process also runs a copy of every site and
+ *merges their whole state each round, so the error splits into the
+ *merged samples' and the coordinator's lag behind them.
+ *Ticks are harness traffic and are not counted as protocol bytes.
+ *
+ *Reports the bytes sent by the sites against the error of the
+ *continuously maintained estimate, and against shipping every token.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <unistd.h>
+#include <errno.h>
+#include <ctype.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include "massdal.h"
+#include "distributed.h"
+#include "serial.h"
+#include "prng.h"
+#include "util.h"
+
+#define SITES_DEFAULT 4
+#define LENGTH_DEFAULT 1000000
+#define RANGE_DEFAULT 99999
+#define ROUNDS_DEFAULT 100
+#define TOL_DEFAULT 0.1
+#define HARNESS_TICK 0x100 //flag of a harness tick message
+
+static int* CreateStream(int length, double zipfpar, int range,
+                         int rounds, double* prefix_entropy);
+static int site_of(int i, int token, int sites, int by_token);
+static void Run_Site(int id, int sites, int by_token, int fd, int* stream,
+                     int length, int rounds, int c, int k, double tol);
+static void read_full(int fd, unsigned char* buf, int n);
+static void usage(void);
+
+int main(int argc, char **argv) 
+{
+  int sites = SITES_DEFAULT, length = LENGTH_DEFAULT, range = RANGE_DEFAULT;
+  int rounds = ROUNDS_DEFAULT, c = 0, k = 0, by_token = 0, next;
+  double zipfparam = 1.1, eps = .1, delta = .1, tol = TOL_DEFAULT;
+  double* prefix_entropy;
+  int* stream;
+  int** fds;
+  pid_t* pids;
+  
+  while ((next = getopt (argc, argv, "P:z:l:r:e:d:c:k:t:R:Hh")) != -1)
+  {     
+	switch (next)
+	{
+	  case 'P': sites = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'z': zipfparam = strtod(optarg, (char **) NULL); break;
+	  case 'l': length = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'r': range = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'e': eps = strtod(optarg, (char **) NULL); break;
+	  case 'd': delta = strtod(optarg, (char **) NULL); break;
+	  case 'c': c = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'k': k = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 't': tol = strtod(optarg, (char **) NULL); break;
+	  case 'R': rounds = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'H': by_token = 1; break;
+	  case 'h': usage(); exit(0);
+   	  case '?':
+	   if (isprint (optopt))
+		fprintf (stderr, "Unknown option or required argument not provided `-%c'.\n", optopt);
+		else
+		 fprintf (stderr, "Unknown option character `\\x%x'.\n",
+                        optopt);
+		exit(1);
+		break;
+	 default:
+	   abort();
+    }
+  }
+  if(sites <= 0 || length <= 0 || range <= 0 || rounds <= 0 || rounds > length ||
+     zipfparam < 0 || eps <= 0 || eps > 1 || delta <= 0 || delta > 1 || tol <= 0)
+  {
+    fprintf(stderr, "invalid arguments\n");
+    usage();
+	exit(1);
+  }
+  if(c <= 0)
+	c = ceil(16 * 1/(eps*eps) * log(2/delta) * log(length * M_E));
+  if(k <= 0)
+	k = ceil(7/eps);
+
+  prefix_entropy = (double*) safe_malloc((rounds+1) * sizeof(double));
+  stream = CreateStream(length, zipfparam, range, rounds, prefix_entropy);
+
+  fds = (int**) safe_malloc(sites * sizeof(int*));
+  pids = (pid_t*) safe_malloc(sites * sizeof(pid_t));
+  for(int i = 0; i < sites; i++)
+  {
+    fds[i] = (int*) safe_malloc(2 * sizeof(int));
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds[i]) != 0)
+      fatal("can't create socket pair");
+    fflush(stdout);
+    pids[i] = fork();
+    if(pids[i] < 0) fatal("can't fork site %d", i);
+    if(pids[i] == 0)
+    {
+      close(fds[i][0]);
+      Run_Site(i, sites, by_token, fds[i][1], stream, length, rounds, c, k, tol);
+      _exit(0);
+    }
+    close(fds[i][1]);
+  }
+
+  Coordinator_type* coord = Coordinator_Init(sites, k);
+  unsigned char* msg = (unsigned char*) safe_malloc(SITE_MSG_MAX(c, k));
+  double est, err, max_err = 0, sum_err = 0;
+  double own, lag, max_lag = 0, sum_lag = 0, max_own = 0, sum_own = 0;
+  //copies of the sites, whose whole state is merged every round
+  Coordinator_type* fresh = Coordinator_Init(sites, k);
+  Site_type** copies = (Site_type**) safe_malloc(sites * sizeof(Site_type*));
+  int from = 0, to, flags;
+
+  for(int i = 0; i < sites; i++)
+    copies[i] = Site_Init(i, c, k, tol, -1);
+  StartTheClock();
+  for(int r = 1; r <= rounds; r++)
+  {
+    //apply each site's messages up to its tick for round r
+    for(int i = 0; i < sites; i++)
+    {
+      for(;;)
+      {
+        read_full(fds[i][0], msg, SITE_MSG_BYTES);
+        flags = msg[4] | msg[5] << 8;
+        if(flags & HARNESS_TICK) break;
+        if(Site_Message_Bytes(msg) > SITE_MSG_MAX(c, k))
+          fatal("malformed message from site %d", i);
+        read_full(fds[i][0], msg + SITE_MSG_BYTES, Site_Message_Bytes(msg) - SITE_MSG_BYTES);
+        if(Coordinator_Receive(coord, msg) < 0)
+          fatal("malformed message from site %d", i);
+      }
+    }
+    to = (long) length * r / rounds;
+    for(int i = from; i < to; i++)
+      Site_Count(copies[site_of(i, stream[i], sites, by_token)], stream[i]);
+    from = to;
+    for(int i = 0; i < sites; i++)
+    {
+      Site_Pack(copies[i], 0);
+      Coordinator_Receive(fresh, copies[i]->msg);
+    }
+
+    est = Coordinator_Estimate(coord);
+    err = fabs(est - prefix_entropy[r]);
+    sum_err += err;
+    if(err > max_err) max_err = err;
+    own = Coordinator_Estimate(fresh);
+    lag = fabs(est - own);
+    sum_lag += lag;
+    if(lag > max_lag) max_lag = lag;
+    sum_own += fabs(own - prefix_entropy[r]);
+    if(fabs(own - prefix_entropy[r]) > max_own) max_own = fabs(own - prefix_entropy[r]);
+  }
+  //final reports
+  for(int i = 0; i < sites; i++)
+  {
+    read_full(fds[i][0], msg, SITE_MSG_BYTES);
+    if(Site_Message_Bytes(msg) > SITE_MSG_MAX(c, k))
+      fatal("malformed message from site %d", i);
+    read_full(fds[i][0], msg + SITE_MSG_BYTES, Site_Message_Bytes(msg) - SITE_MSG_BYTES);
+    Coordinator_Receive(coord, msg);
+    waitpid(pids[i], NULL, 0);
+    close(fds[i][0]);
+    free(fds[i]);
+    Site_Destroy(copies[i]);
+  }
+  long ms = StopTheClock();
+  int max_token, max_count;
+  Coordinator_Max(coord, &max_token, &max_count);
+  est = Coordinator_Estimate(coord);
+
+  printf("exact entropy is %f\n", prefix_entropy[rounds]);
+  printf("Estimated entropy is: %f (error %f)\n", est, fabs(est - prefix_entropy[rounds]));
+  printf("most frequent token %d with count %d\n", max_token, max_count);
+  printf("sites %d (%s), c %d, k %d, tolerance %f, took %ld ms\n", sites,
+         by_token ? "disjoint tokens" : "overlapping tokens", c, k, tol, ms);
+  printf("tracking error over %d rounds: max %f, mean %f\n", rounds, max_err,
+         sum_err/rounds);
+  printf("  merged samples of the sites: max %f, mean %f\n", max_own,
+         sum_own/rounds);
+  printf("  coordinator's lag behind them: max %f, mean %f (tolerance %f)\n", max_lag, sum_lag/rounds, tol);
+  printf("sent %ld messages, %ld bytes (%f%% of the %ld bytes in the raw stream)\n",
+         coord->messages, coord->bytes, 100.0 * coord->bytes / (4.0 * length),
+         4L * length);
+
+  Coordinator_Destroy(coord);
+  Coordinator_Destroy(fresh);
+  free(copies);
+  free(msg);
+  free(fds);
+  free(pids);
+  free(stream);
+  free(prefix_entropy);
+  return 0;
+}
+
+//site process: handle the tokens of each round that go to this site
+static void Run_Site(int id, int sites, int by_token, int fd, int* stream,
+                     int length, int rounds, int c, int k, double tol)
+{
+  Site_type* site = Site_Init(id, c, k, tol, fd);
+  unsigned char tick[SITE_MSG_BYTES];
+  int from = 0, to;
+
+  memset(tick, 0, SITE_MSG_BYTES);
+  tick[0] = id & 0xff;
+  tick[1] = (id >> 8) & 0xff;
+  tick[4] = HARNESS_TICK & 0xff;
+  tick[5] = (HARNESS_TICK >> 8) & 0xff;
+  for(int r = 1; r <= rounds; r++)
+  {
+    to = (long) length * r / rounds;
+    for(int i = from; i < to; i++)
+    {
+      if(site_of(i, stream[i], sites, by_token) == id)
+        Site_Update(site, stream[i]);
+    }
+    from = to;
+    //harness only: the coordinator never sees this
+    if(write(fd, tick, SITE_MSG_BYTES) != SITE_MSG_BYTES)
+      fatal("site %d: can't write tick", id);
+  }
+  Site_Finish(site);
+  Site_Destroy(site);
+  close(fd);
+}
+
+//site that handles position i of the stream, which holds token
+static int site_of(int i, int token, int sites, int by_token)
+{
+  //same hash family as symtab and frequent.c, fixed so all sites agree
+  long long a = 1103515245, b = 12345;
+  return hash31(a, b, by_token ? token : i) % sites;
+}
+
+static void usage(void)
+{
+  fprintf(stderr,
+    "usage: entropydist [-P sites] [-z zipf] [-l length] [-r range] [-e eps]\n"
+    "                   [-d delta] [-c samplers] [-k counters] [-t tolerance]\n"
+    "                   [-R rounds] [-H]\n"
+    "Each site handles its share of the positions, so sites see the same\n"
+    "tokens; with -H each token goes to the site it hashes to instead.\n"
+    "-c is the number of distinct tokens each site samples; the estimate\n"
+    "is exact while that covers every token, and noisy well below it.\n");
+}
+
+static void read_full(int fd, unsigned char* buf, int n)
+{
+  int done = 0, got;
+  while(done < n)
+  {
+    got = read(fd, buf+done, n-done);
+    if(got < 0 && errno == EINTR) continue;
+    if(got <= 0) fatal("lost connection to a site");
+    done += got;
+  }
+}
+
+/******************************************************************/
+//Creates and returns stream of ints in range [1, range+1] according
+//to zipfian distribution based on zipfpar. Also saves the exact entropy
+//of the stream after each of rounds equal rounds in prefix_entropy[1..]
+static int* CreateStream(int length, double zipfpar, int range,
+                         int rounds, double* prefix_entropy)
+{
+  float zet;
+  int* stream;
+  prng_type * prng;
+  double sum_flogf = 0;
+  int* exact = (int*)calloc(range+2, sizeof(int));
+  int r = 1, f;
+  
+  stream=(int *) safe_malloc(length * sizeof(int));
+  prng=prng_Init(44545,2);
+  zet=zeta(length,zipfpar);
+
+  prefix_entropy[0] = 0;
+  for (int i=0;i<length;i++) 
+  {
+	stream[i]=(int) floor(fastzipf(zipfpar,range,zet,prng));
+	f = ++exact[ stream[i] ];
+	//entropy of prefix of length n is log n - (sum f log f)/n
+	sum_flogf += f * log(f) - (f > 1 ? (f-1) * log(f-1) : 0);
+	if(i+1 == (long) length * r / rounds)
+	{
+	  prefix_entropy[r++] = (log(i+1) - sum_flogf/(i+1)) / log(2);
+	}
+  }
+  free(exact);
+  prng_Destroy(prng);
+  return(stream);
+}
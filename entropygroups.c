@@ -0,0 +1,209 @@
+/*Harness for per-group entropy (group.c).
+ *
+ *Feeds a synthetic stream of (group, token) pairs, like (source
+ *address, destination port): groups are zipfian with parameter z over
+ *G groups, and each group's tokens are zipfian over range with its own
+ *parameter, from 0.5 to 1.5, so groups differ in entropy. With a
+ *budget of B MB the least recently updated groups are evicted; a group
+ *seen again after eviction starts afresh, so a tight budget shows up as
+ *error on the groups it churned.
+ *
+ *Compares the estimates with the exact entropy of every group with at
+ *least min tokens, and the top n groups with the exact top n, and times
+ *updates against Estimator_Update on the tokens.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <unistd.h>
+#include <ctype.h>
+#include "massdal.h"
+#include "grouppub.h"
+#include "entropypub.h"
+#include "prng.h"
+#include "util.h"
+
+#define LENGTH_DEFAULT 4000000
+#define GROUPS_DEFAULT 200000
+#define RANGE_DEFAULT 65535
+#define C_DEFAULT 256
+#define K_DEFAULT 14
+#define BUDGET_DEFAULT 64
+#define TOP_DEFAULT 20
+#define MIN_DEFAULT 1000
+#define PARAMS 11            //token zipf parameters 0.5, 0.6, ... 1.5
+
+static void CreateStream(int length, double zipfpar, int ngroups, int range,
+                         int* groups, int* tokens);
+static int ll_cmp(const void* p, const void* q);
+static int rank_cmp(const void* p, const void* q);
+
+typedef struct exact_group{
+  int group, count;
+  double entropy;
+} exact_group;
+
+int main(int argc, char **argv) 
+{
+  int length = LENGTH_DEFAULT, ngroups = GROUPS_DEFAULT, range = RANGE_DEFAULT;
+  int c = C_DEFAULT, k = K_DEFAULT, n = TOP_DEFAULT, min = MIN_DEFAULT, next;
+  long budget = BUDGET_DEFAULT;
+  double zipfparam = 1.1;
+  
+  while ((next = getopt (argc, argv, "z:l:G:r:c:k:B:n:m:")) != -1)
+  {     
+	switch (next)
+	{
+	  case 'z': zipfparam = strtod(optarg, (char **) NULL); break;
+	  case 'l': length = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'G': ngroups = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'r': range = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'c': c = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'k': k = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'B': budget = strtol(optarg, (char **)NULL, 10); break;
+	  case 'n': n = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'm': min = (int)strtol(optarg, (char **)NULL, 10); break;
+   	  case '?':
+	   if (isprint (optopt))
+		fprintf (stderr, "Unknown option or required argument not provided `-%c'.\n", optopt);
+		else
+		 fprintf (stderr, "Unknown option character `\\x%x'.\n",
+                        optopt);
+		exit(1);
+		break;
+	 default:
+	   abort();
+    }
+  }
+  if(length <= 0 || ngroups <= 0 || range <= 0 || c <= 0 || k <= 0 ||
+     budget <= 0 || n <= 0 || min < 0 || zipfparam < 0)
+  {
+    fprintf(stderr, "invalid arguments\n");
+	exit(1);
+  }
+
+  int* groups = (int*) safe_malloc(length * sizeof(int));
+  int* tokens = (int*) safe_malloc(length * sizeof(int));
+  CreateStream(length, zipfparam, ngroups, range, groups, tokens);
+
+  Group_Estimator_type* est = Group_Estimator_Init(c, k, budget << 20);
+  long ms;
+  StartTheClock();
+  for(int i = 0; i < length; i++)
+    Group_Estimator_Update(est, groups[i], tokens[i]);
+  ms = StopTheClock();
+  printf("c %d, k %d: %d groups held in %ld bytes\n", c, k,
+         Group_Estimator_Groups(est), Group_Estimator_Size(est));
+  printf("group updates took %ld ms\n", ms);
+
+  //exact entropy of every group, from the sorted pairs
+  long long* pairs = (long long*) safe_malloc(length * sizeof(long long));
+  exact_group* exact = (exact_group*) safe_malloc(ngroups * sizeof(exact_group));
+  int nexact = 0, run = 0, total = 0;
+  double sum_flogf = 0;
+  for(int i = 0; i < length; i++)
+    pairs[i] = (long long) groups[i] << 32 | tokens[i];
+  qsort(pairs, length, sizeof(long long), ll_cmp);
+  for(int i = 0; i < length; i++)
+  {
+    run++;
+    if(i+1 < length && pairs[i+1] == pairs[i]) continue;
+    sum_flogf += run * log2(run);
+    total += run;
+    run = 0;
+    if(i+1 < length && pairs[i+1] >> 32 == pairs[i] >> 32) continue;
+    exact[nexact].group = (int) (pairs[i] >> 32);
+    exact[nexact].count = total;
+    exact[nexact++].entropy = log2(total) - sum_flogf / total;
+    sum_flogf = 0;
+    total = 0;
+  }
+
+  //accuracy over the groups still held with at least min tokens
+  double err, sum_err = 0, max_err = 0, h;
+  int checked = 0, held = 0;
+  for(int i = 0; i < nexact; i++)
+  {
+    if(exact[i].count < min) continue;
+    h = Group_Estimator_Entropy(est, exact[i].group);
+    if(h < 0) continue;
+    held++;
+    err = fabs(h - exact[i].entropy);
+    sum_err += err;
+    if(err > max_err) max_err = err;
+    checked++;
+  }
+  if(checked > 0)
+    printf("%d groups with at least %d tokens: mean error %f, max error %f\n",
+           checked, min, sum_err/checked, max_err);
+
+  //top n against the exact top n
+  int* top = (int*) safe_malloc(n * sizeof(int));
+  double* top_h = (double*) safe_malloc(n * sizeof(double));
+  int found, common = 0;
+  qsort(exact, nexact, sizeof(exact_group), rank_cmp);
+  found = Group_Estimator_Top(est, n, min, top, top_h);
+  for(int i = 0; i < found; i++)
+    for(int j = 0, seen = 0; j < nexact && seen < n; j++)
+    {
+      if(exact[j].count < min) continue;
+      seen++;
+      if(exact[j].group == top[i]) { common++; break; }
+    }
+  printf("top %d groups: %d of them in the exact top %d; first %d at %f bits\n",
+         found, common, n, found > 0 ? top[0] : -1, found > 0 ? top_h[0] : 0);
+
+  Estimator_type* est_full = Estimator_Init(c, k);
+  StartTheClock();
+  for(int i = 0; i < length; i++)
+    Estimator_Update(est_full, tokens[i]);
+  ms = StopTheClock();
+  printf("Estimator_Update took %ld ms\n", ms);
+  Estimator_Destroy(est_full);
+
+  Group_Estimator_Destroy(est);
+  free(top);
+  free(top_h);
+  free(exact);
+  free(pairs);
+  free(groups);
+  free(tokens);
+  return 0;
+}
+
+/******************************************************************/
+//Fills groups, zipfian in [1, ngroups+1], and tokens, zipfian in
+//[1, range+1] with a parameter that depends on the group
+static void CreateStream(int length, double zipfpar, int ngroups, int range,
+                         int* groups, int* tokens)
+{
+  float zet, zets[PARAMS];
+  prng_type * prng;
+  int p;
+  
+  prng=prng_Init(44545,2);
+  zet=zeta(length,zipfpar);
+  for (p=0;p<PARAMS;p++)
+    zets[p]=zeta(length,0.5+0.1*p);
+  for (int i=0;i<length;i++) 
+  {
+	groups[i]=(int) floor(fastzipf(zipfpar,ngroups,zet,prng));
+	p=groups[i] % PARAMS;
+	tokens[i]=(int) floor(fastzipf(0.5+0.1*p,range,zets[p],prng));
+  }
+  prng_Destroy(prng);
+}
+
+static int ll_cmp(const void* p, const void* q)
+{
+  long long a = *(const long long*) p, b = *(const long long*) q;
+  return (a==b) ? 0 : (a<b) ? -1 : 1;
+}
+
+//largest entropy first
+static int rank_cmp(const void* p, const void* q)
+{
+  double a = ((const exact_group*) p)->entropy, b = ((const exact_group*) q)->entropy;
+  return (a==b) ? 0 : (a>b) ? -1 : 1;
+}
@@ -0,0 +1,194 @@
+/*Harness for point-in-time entropy queries (history.c).
+ *
+ *Feeds a synthetic stream of rate tokens per time unit into a history
+ *with periods of the given length. The stream alternates between
+ *segments with two zipf parameters, so its entropy changes over time.
+ *Then asks for the entropy of random past ranges and compares each
+ *answer with the exact entropy of the range requested.
+ *
+ *Reports the errors of the answers, how much of the requested ranges
+ *they covered, and the history's memory as it grows. The estimator
+ *promises an error of at most eps with probability 1-delta, so the run
+ *fails if more than a delta share of the answers miss by more than eps.
+ *Old ranges get fewer samples than recent ones, so how often they miss
+ *depends on per_level.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <unistd.h>
+#include <ctype.h>
+#include "massdal.h"
+#include "history.h"
+#include "prng.h"
+#include "util.h"
+
+#define LENGTH_DEFAULT 2000000
+#define RANGE_DEFAULT 99999
+#define RATE_DEFAULT 1000
+#define PERIOD_DEFAULT 60
+#define SEGMENTS_DEFAULT 20
+#define QUERIES_DEFAULT 200
+
+static int* CreateStream(int length, double zipfpar, double zipfpar2, int range,
+                         int segments);
+static double Exact_Entropy(int* stream, long from, long to, int* counts);
+
+int main(int argc, char **argv) 
+{
+  int length = LENGTH_DEFAULT, range = RANGE_DEFAULT, c = 0, k = 0;
+  int rate = RATE_DEFAULT, segments = SEGMENTS_DEFAULT, queries = QUERIES_DEFAULT;
+  int per_level = 4, next;
+  long period = PERIOD_DEFAULT;
+  double zipfparam = 1.1, zipfparam2 = 0.6, eps = .5, delta = .1;
+  
+  while ((next = getopt (argc, argv, "z:Z:l:r:e:d:c:k:T:P:L:S:q:")) != -1)
+  {     
+	switch (next)
+	{
+	  case 'z': zipfparam = strtod(optarg, (char **) NULL); break;
+	  case 'Z': zipfparam2 = strtod(optarg, (char **) NULL); break;
+	  case 'l': length = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'r': range = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'e': eps = strtod(optarg, (char **) NULL); break;
+	  case 'd': delta = strtod(optarg, (char **) NULL); break;
+	  case 'c': c = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'k': k = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'T': rate = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'P': period = strtol(optarg, (char **)NULL, 10); break;
+	  case 'L': per_level = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'S': segments = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'q': queries = (int)strtol(optarg, (char **)NULL, 10); break;
+   	  case '?':
+	   if (isprint (optopt))
+		fprintf (stderr, "Unknown option or required argument not provided `-%c'.\n", optopt);
+		else
+		 fprintf (stderr, "Unknown option character `\\x%x'.\n",
+                        optopt);
+		exit(1);
+		break;
+	 default:
+	   abort();
+    }
+  }
+  if(length <= 0 || range <= 0 || rate <= 0 || period <= 0 || per_level <= 0 ||
+     segments <= 0 || queries < 0 || zipfparam < 0 || zipfparam2 < 0 ||
+     eps <= 0 || eps > 1 || delta <= 0 || delta > 1)
+  {
+    fprintf(stderr, "invalid arguments\n");
+	exit(1);
+  }
+  if(c <= 0)
+	c = ceil(16 * 1/(eps*eps) * log(2/delta) * log(length * M_E));
+  if(k <= 0)
+	k = ceil(7/eps);
+
+  int* stream = CreateStream(length, zipfparam, zipfparam2, range, segments);
+  History_type* h = History_Init(c, k, period, per_level);
+
+  StartTheClock();
+  for(long i = 0, report = (long) rate * period; i < length; i++)
+  {
+    History_Update(h, i / rate, stream[i]);
+    if(i+1 == report || i+1 == length)
+    {
+      printf("after %9ld tokens (%7ld periods): %4d buckets, %10d bytes\n", i+1,
+             (i / rate) / period + 1, h->nbuckets, History_Size(h));
+      report *= 4;
+    }
+  }
+  long ms = StopTheClock();
+  printf("c %d, k %d, %d per level, ingest took %ld ms\n", c, k, per_level, ms);
+
+  //random past ranges
+  prng_type* prng = prng_Init(4242, 2);
+  int* counts = (int*) calloc(range+2, sizeof(int));
+  long end_time = (length-1) / rate + 1, from, to, cf, ct;
+  double est, exact, err, sum_err = 0, max_err = 0, covered = 0;
+  int answered = 0, missed = 0;
+
+  StartTheClock();
+  for(int q = 0; q < queries; q++)
+  {
+    from = (prng_int(prng) & MOD) % end_time;
+    to = from + 1 + (prng_int(prng) & MOD) % (end_time/8 + 1);
+    if(to > end_time) to = end_time;
+    est = History_Query(h, from, to, &cf, &ct);
+    if(est < 0) continue;
+    exact = Exact_Entropy(stream, from * rate < length ? from * rate : length,
+                          to * rate < length ? to * rate : length, counts);
+    err = fabs(est - exact);
+    sum_err += err;
+    if(err > max_err) max_err = err;
+    if(err > eps) missed++;
+    covered += (double) (ct - cf) / (to - from);
+    answered++;
+  }
+  ms = StopTheClock();
+  if(answered > 0)
+  {
+    printf("%d queries: mean error %f, max error %f, covered range %.2fx requested\n",
+           answered, sum_err/answered, max_err, covered/answered);
+    printf("  %d answers (%.3f) off by more than eps = %g\n",
+           missed, (double) missed/answered, eps);
+  }
+  printf("queries took %ld ms\n", ms);
+
+  free(counts);
+  prng_Destroy(prng);
+  History_Destroy(h);
+  free(stream);
+  if(missed > delta * answered)
+  {
+    fprintf(stderr, "more than delta = %g of the answers off by more than eps\n", delta);
+    return 1;
+  }
+  return 0;
+}
+
+//exact entropy of stream[from, to), using counts (all zero on entry
+//and on return) as scratch
+static double Exact_Entropy(int* stream, long from, long to, int* counts)
+{
+  double sum_flogf = 0;
+  long m = to - from;
+
+  if(m <= 0) return 0;
+  for(long i = from; i < to; i++)
+    counts[stream[i]]++;
+  for(long i = from; i < to; i++)
+  {
+    if(counts[stream[i]] > 0)
+    {
+      sum_flogf += counts[stream[i]] * log(counts[stream[i]]);
+      counts[stream[i]] = 0;
+    }
+  }
+  return (log(m) - sum_flogf/m) / log(2);
+}
+
+/******************************************************************/
+//Creates and returns stream of ints in range [1, range+1], in segments
+//that alternate between zipfian distributions with zipfpar and zipfpar2
+static int* CreateStream(int length, double zipfpar, double zipfpar2, int range,
+                         int segments)
+{
+  float zet, zet2;
+  int* stream;
+  prng_type * prng;
+  
+  stream=(int *) safe_malloc(length * sizeof(int));
+  prng=prng_Init(44545,2);
+  zet=zeta(length,zipfpar);
+  zet2=zeta(length,zipfpar2);
+  for (int i=0;i<length;i++) 
+  {
+    if (((long) i * segments / length) % 2 == 0)
+	  stream[i]=(int) floor(fastzipf(zipfpar,range,zet,prng));
+    else
+	  stream[i]=(int) floor(fastzipf(zipfpar2,range,zet2,prng));
+  }
+  prng_Destroy(prng);
+  return(stream);
+}
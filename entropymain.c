@@ -2,16 +2,30 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 #include <limits.h>
 #include <unistd.h>
 #include <errno.h>
 #include <ctype.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "massdal.h"
 #include "entropypub.h"
 #include "naivepub.h"
 #include "slowentropypub.h"
+#include "parallelpub.h"
+#include "ingestpub.h"
+#include "snapshot.h"
+#include "prefixpub.h"
+#include "hybridpub.h"
+#include "adaptivepub.h"
+#include "obliviouspub.h"
 #include "prng.h"
+#include "serial.h"
+#include "moments.h"
 #include "util.h"
 
 #define INVALID_TOKEN INT_MIN
@@ -25,16 +39,79 @@
 #define RANGE_DEFAULT 99999
 #define EPS_DEFAULT 1.0
 #define DELTA_DEFAULT 1.0
+#define BUDGET_DELTA_DEFAULT 0.1 //the bound -M prints means nothing at 1
 #define BYTES_DEFAULT 1
+#define CHECKPOINT_DEFAULT 1000000 //tokens between checkpoints
+
+//hands a token read from a file to an estimator
+typedef void (*Token_Update)(void* est, int token);
+
+//where and how often Read_Tokens saves the estimator it feeds
+typedef struct Checkpoint_Saver{
+  char* path;
+  long every;              //tokens between checkpoints
+  unsigned char* (*serialize)(void* est, long* len);
+} Checkpoint_Saver;
 
 static int* CreateStream(int length, double zipfpar, int range);
 void CheckArguments(int argc, char **argv); 
 static double Fast_Handle_stream(int* stream, int c, int k, int length);
-static double Fast_Handle_file(char* filename, int c, int k, int bytes);
+static double Fast_Handle_file(char* filename, int c, int k, int bytes,
+                               char* checkpoint, long every, int resume);
 static double Naive_Handle_stream(int* stream, int c, int k, int length);
-static double Naive_Handle_file(char* filename, int c, int k, int bytes);
-static double Slow_Handle_stream(int* stream, int c, int k, int length);
-static double Slow_Handle_file(char* filename, int c, int k, int bytes);
+static double Naive_Handle_file(char* filename, int c, int k, int bytes,
+                                char* checkpoint, long every, int resume);
+static double Slow_Handle_stream(int* stream, int c, int k, int length,
+                                 int threads);
+static double Slow_Handle_file(char* filename, int c, int k, int bytes,
+                               int threads, char* checkpoint, long every,
+                               int resume);
+static double Parallel_Handle_stream(int* stream, int c, int k, int length,
+                                     int shards);
+static double Parallel_Handle_file(char* filename, int c, int k, int bytes,
+                                   int shards);
+static double Ingest_Handle_stream(int* stream, int c, int k, int length,
+                                   int producers);
+static double Snapshot_Handle_stream(int* stream, int c, int k, int length,
+                                     int readers, long budget);
+static void Gram_Handle_file(char* filename, int c, int k, int grams);
+static double Hybrid_Handle_stream(int* stream, int c, int k, int length,
+                                   long threshold);
+static double Hybrid_Handle_file(char* filename, int c, int k, int bytes,
+                                 long threshold);
+static double Adaptive_Handle_stream(int* stream, int c, int k, int length);
+static double Adaptive_Handle_file(char* filename, int c, int k, int bytes);
+static double Oblivious_Handle_stream(int* stream, double eps, double delta,
+                                      int k, int length);
+static double Oblivious_Handle_file(char* filename, double eps, double delta,
+                                    int k, int bytes);
+static double Budget_Handle_stream(int* stream, long budget, double delta,
+                                   int length);
+static double Budget_Handle_file(char* filename, long budget, double delta,
+                                 int bytes);
+static void Read_Tokens(FILE* file, int bytes, Token_Update update, void* est,
+                        Checkpoint_Saver* save);
+static void fast_update(void* est, int token);
+static void naive_update(void* est, int token);
+static void slow_update(void* est, int token);
+static void parallel_update(void* est, int token);
+static void hybrid_update(void* est, int token);
+static void adaptive_update(void* est, int token);
+static void oblivious_update(void* est, int token);
+static unsigned char* fast_serialize(void* est, long* len);
+static unsigned char* naive_serialize(void* est, long* len);
+static unsigned char* slow_serialize(void* est, long* len);
+static void Save_Checkpoint(char* path, long offset, int bytes,
+                            unsigned char* image, long len);
+static unsigned char* Load_Checkpoint(char* path, long* offset, int bytes,
+                                      long* len);
+static void Fast_Print_Moments(Estimator_type* est);
+static void Fast_Print_Distinct(Estimator_type* est);
+static void Slow_Print_Moments(Slow_Estimator_type* est);
+
+//order of the Renyi and Tsallis entropies and moment also reported
+//from the samplers (-a), negative if none was asked for
+static double moment_alpha = -1;
 
 
 int main(int argc, char **argv) 
@@ -60,6 +137,8 @@ static double Fast_Handle_stream(int* stream, int c, int k, int length)
   entropy = Estimator_end_stream(est);
   printf("took %ld ms and used %d bytes\n", 
          StopTheClock(), Estimator_Size(est));
+  Fast_Print_Distinct(est);
+  Fast_Print_Moments(est);
   Estimator_Destroy(est);
   return entropy;
 }
@@ -67,12 +146,17 @@ static double Fast_Handle_stream(int* stream, int c, int k, int length)
 //compute the entropy of the stream contained in file file_name
 //with c samplers and k counters used by Misra-Gries alg
 //uses fast implementation of algorithm
-static double Fast_Handle_file(char* file_name, int c, int k, int bytes)
+//If checkpoint is set the estimator is saved there every every tokens
+//and at the end of the file, along with the offset reached; with
+//resume set it is restored from there and reading resumes at that offset
+static double Fast_Handle_file(char* file_name, int c, int k, int bytes,
+                               char* checkpoint, long every, int resume)
 {
-  char buf[5];
   double entropy;
-  int token;
-  Estimator_type* est = Estimator_Init(c, k);  
+  long offset = 0, len;
+  Checkpoint_Saver saver = {checkpoint, every, fast_serialize};
+  unsigned char* image;
+  Estimator_type* est;
   
   FILE* file = fopen(file_name, "r");
   if(!file)
@@ -80,34 +164,24 @@ static double Fast_Handle_file(char* file_name, int c, int k, int bytes)
     fprintf(stderr, "Can't open file %s\n", file_name);
 	exit(1);
   }
-  
-  StartTheClock();
-  while(fgets(buf, bytes+1, file)!=NULL)
+  if(resume)
   {
-    token = 0;
-	if(!feof(file)) //if not at end of stream, add all the bytes
-	{
-	  for(int i = 0; i <= bytes-1 ; i++)
-	  {
-	    token += buf[i] << (8*i);
-	  }
-	}
-	else
-	{ //handle case where number of bytes in 
-	  //file not divisible by parameter bytes
-	  //assumes no bytes in stream are "0"
-	  for(int i = 0; i <= bytes-1 ; i++)
-	  {
-	    if(buf[i] == 0) break;
-	    token += buf[i] << (8*i);
-	  }
-	}
-	Estimator_Update(est, token);
+    image = Load_Checkpoint(checkpoint, &offset, bytes, &len);
+    est = Estimator_Deserialize(image, len);
+    if(est == NULL) fatal("checkpoint %s is not a fast estimator", checkpoint);
+    free(image);
+    fseek(file, offset, SEEK_SET);
   }
+  else est = Estimator_Init(c, k);  
+  
+  StartTheClock();
+  Read_Tokens(file, bytes, fast_update, est, checkpoint ? &saver : NULL);
   //reached end of stream
   entropy = Estimator_end_stream(est);
   printf("took %ld ms and used %d bytes\n", 
          StopTheClock(), Estimator_Size(est));
+  Fast_Print_Distinct(est);
+  Fast_Print_Moments(est);
 
   Estimator_Destroy(est);
   fclose(file);
@@ -138,13 +212,15 @@ static double Naive_Handle_stream(int* stream, int c, int k, int length)
 //compute the entropy of the stream contained in file file_name
 //with c samplers and k counters used by Misra-Gries alg
 //uses naive implementation of algorithm
-static double Naive_Handle_file(char* file_name, int c, int k, int bytes)
+//checkpoint, every and resume as for Fast_Handle_file
+static double Naive_Handle_file(char* file_name, int c, int k, int bytes,
+                                char* checkpoint, long every, int resume)
 {
-  char buf[2];
   double entropy;
-  int token;
-  
-  Naive_Estimator_type* est = Naive_Estimator_Init(c, k);  
+  long offset = 0, len;
+  Checkpoint_Saver saver = {checkpoint, every, naive_serialize};
+  unsigned char* image;
+  Naive_Estimator_type* est;
   
   FILE* file = fopen(file_name, "r");
   if(!file)
@@ -152,30 +228,18 @@ static double Naive_Handle_file(char* file_name, int c, int k, int bytes)
     fprintf(stderr, "Can't open file %s\n", file_name);
 	exit(1);
   }
-  
-  StartTheClock();
-  while(fgets(buf, bytes+1, file)!=NULL)
+  if(resume)
   {
-    token = 0;
-	if(!feof(file)) //if not at end of stream, add all the bytes
-	{
-	  for(int i = 0; i <= bytes-1 ; i++)
-	  {
-	    token += buf[i] << (8*i);
-	  }
-	}
-	else
-	{ //handle case where number of bytes in 
-	  //file not divisible by parameter bytes
-	  //assumes no bytes in stream are "0"
-	  for(int i = 0; i <= bytes-1 ; i++)
-	  {
-	    if(buf[i] == 0) break;
-	    token += buf[i] << (8*i);
-	  }
-	}
-	Naive_Estimator_Update(est, token);
+    image = Load_Checkpoint(checkpoint, &offset, bytes, &len);
+    est = Naive_Estimator_Deserialize(image, len);
+    if(est == NULL) fatal("checkpoint %s is not a naive estimator", checkpoint);
+    free(image);
+    fseek(file, offset, SEEK_SET);
   }
+  else est = Naive_Estimator_Init(c, k);  
+  
+  StartTheClock();
+  Read_Tokens(file, bytes, naive_update, est, checkpoint ? &saver : NULL);
   //reached end of stream
   entropy = Naive_Estimator_end_stream(est);
   printf("took %ld ms and used %d bytes\n", 
@@ -187,10 +251,13 @@ static double Naive_Handle_file(char* file_name, int c, int k, int bytes)
 
 //compute entropy ofstream w/ c samplers and
 // k counters for use by Misra-Gries alg
-static double Slow_Handle_stream(int* stream, int c, int k, int length)
+//samplers are split across threads threads if threads > 0
+static double Slow_Handle_stream(int* stream, int c, int k, int length,
+                                 int threads)
 {
   double entropy;
-  Slow_Estimator_type* est = Slow_Estimator_Init(c, k);  
+  Slow_Estimator_type* est = threads ? Slow_Estimator_Init_Threaded(c, k, threads)
+                                     : Slow_Estimator_Init(c, k);  
   
   StartTheClock();
   for(int i = 0; i < length; i++)
@@ -201,6 +268,7 @@ static double Slow_Handle_stream(int* stream, int c, int k, int length)
   entropy = Slow_Estimator_end_stream(est);
   printf("took %ld ms and used %d bytes\n", 
          StopTheClock(), Slow_Estimator_Size(est));
+  Slow_Print_Moments(est);
   Slow_Estimator_Destroy(est);
   return entropy;
 }
@@ -208,13 +276,76 @@ static double Slow_Handle_stream(int* stream, int c, int k, int length)
 
 //compute the entropy of the stream contained in file file_name
 //with c samplers and k counters used by Misra-Gries alg
-static double Slow_Handle_file(char* file_name, int c, int k, int bytes)
+//samplers are split across threads threads if threads > 0 (a resumed
+//estimator is not threaded). checkpoint, every and resume as for
+//Fast_Handle_file
+static double Slow_Handle_file(char* file_name, int c, int k, int bytes,
+                               int threads, char* checkpoint, long every,
+                               int resume)
 {
-  char buf[2];
   double entropy;
-  int token;
+  long offset = 0, len;
+  Checkpoint_Saver saver = {checkpoint, every, slow_serialize};
+  unsigned char* image;
+  Slow_Estimator_type* est;
+  
+  FILE* file = fopen(file_name, "r");
+  if(!file)
+  {
+    fprintf(stderr, "Can't open file %s\n", file_name);
+	exit(1);
+  }
+  if(resume)
+  {
+    image = Load_Checkpoint(checkpoint, &offset, bytes, &len);
+    est = Slow_Estimator_Deserialize(image, len);
+    if(est == NULL) fatal("checkpoint %s is not a slow estimator", checkpoint);
+    free(image);
+    fseek(file, offset, SEEK_SET);
+  }
+  else est = threads ? Slow_Estimator_Init_Threaded(c, k, threads)
+                     : Slow_Estimator_Init(c, k);  
+  
+  StartTheClock();
+  Read_Tokens(file, bytes, slow_update, est, checkpoint ? &saver : NULL);
+  //reached end of stream
+  entropy = Slow_Estimator_end_stream(est);
+  printf("took %ld ms and used %d bytes\n", 
+         StopTheClock(), Slow_Estimator_Size(est));
+  Slow_Print_Moments(est);
+  Slow_Estimator_Destroy(est);
+  fclose(file);
+  return entropy;
+}
+
+//compute entropy ofstream w/ c samplers and k counters per shard
+//using the fast implementation partitioned across shards threads
+static double Parallel_Handle_stream(int* stream, int c, int k, int length,
+                                     int shards)
+{
+  double entropy;
+  Parallel_Estimator_type* est = Parallel_Estimator_Init(c, k, shards);  
+  
+  StartTheClock();
+  for(int i = 0; i < length; i++)
+  {
+	Parallel_Estimator_Update(est, stream[i]);
+  }
+  //reached end of stream
+  entropy = Parallel_Estimator_end_stream(est);
+  printf("took %ld ms and used %d bytes\n", 
+         StopTheClock(), Parallel_Estimator_Size(est));
+  Parallel_Estimator_Destroy(est);
+  return entropy;
+}
 
-  Slow_Estimator_type* est = Slow_Estimator_Init(c, k);  
+//compute the entropy of the stream contained in file file_name
+//with c samplers and k counters per shard using shards threads
+static double Parallel_Handle_file(char* file_name, int c, int k, int bytes,
+                                   int shards)
+{
+  double entropy;
+  Parallel_Estimator_type* est = Parallel_Estimator_Init(c, k, shards);  
   
   FILE* file = fopen(file_name, "r");
   if(!file)
@@ -224,13 +355,452 @@ static double Slow_Handle_file(char* file_name, int c, int k, int bytes)
   }
   
   StartTheClock();
+  Read_Tokens(file, bytes, parallel_update, est, NULL);
+  //reached end of stream
+  entropy = Parallel_Estimator_end_stream(est);
+  printf("took %ld ms and used %d bytes\n", 
+         StopTheClock(), Parallel_Estimator_Size(est));
+
+  Parallel_Estimator_Destroy(est);
+  fclose(file);
+  return entropy;
+}
+
+//slice of a synthetic stream fed by one producer thread
+typedef struct producer_arg{
+  Ingest_type* ing;
+  int* stream;
+  int from, to;
+} producer_arg;
+
+static void* producer_main(void* arg)
+{
+  producer_arg* p = (producer_arg*) arg;
+  Ingest_Producer* prod = Ingest_Register(p->ing);
+  for(int i = p->from; i < p->to; i++)
+  {
+    Ingest_Update(prod, p->stream[i]);
+  }
+  Ingest_Flush(prod);
+  return NULL;
+}
+
+//compute entropy ofstream w/ c samplers and k counters using the
+//fast implementation, with the stream split across producers threads
+//that all feed one estimator through the concurrent ingest front-end
+static double Ingest_Handle_stream(int* stream, int c, int k, int length,
+                                   int producers)
+{
+  double entropy;
+  Estimator_type* est = Estimator_Init(c, k);
+  Ingest_type* ing = Ingest_Init(est, producers);
+  pthread_t* threads = (pthread_t*) safe_malloc(producers * sizeof(pthread_t));
+  producer_arg* args = (producer_arg*) safe_malloc(producers * sizeof(producer_arg));
+  
+  StartTheClock();
+  for(int i = 0; i < producers; i++)
+  {
+    args[i].ing = ing;
+    args[i].stream = stream;
+    args[i].from = (long) length * i / producers;
+    args[i].to = (long) length * (i+1) / producers;
+    if(pthread_create(&threads[i], NULL, producer_main, &args[i]) != 0)
+      fatal("can't create producer thread");
+  }
+  for(int i = 0; i < producers; i++)
+  {
+    pthread_join(threads[i], NULL);
+  }
+  //reached end of stream
+  entropy = Ingest_end_stream(ing);
+  printf("took %ld ms and used %d bytes\n", 
+         StopTheClock(), Estimator_Size(est));
+  Ingest_Destroy(ing);
+  Estimator_Destroy(est);
+  free(threads);
+  free(args);
+  return entropy;
+}
+
+//reader thread querying the snapshots published by the ingest thread
+typedef struct reader_arg{
+  Snapshot_Publisher* pub;
+  int done;          //set by the ingest thread at the end of the stream
+  long queries;      //snapshots read
+  long bad;          //snapshots that were torn or went back in time
+} reader_arg;
+
+static void* reader_main(void* arg)
+{
+  reader_arg* r = (reader_arg*) arg;
+  Estimator_Snapshot* snap;
+  int top_tokens[16], top_counts[16], n, last_m = 0;
+  long sum;
+  double entropy;
+
+  while(!__atomic_load_n(&r->done, __ATOMIC_SEQ_CST))
+  {
+    snap = Publisher_Acquire(r->pub);
+    if(snap == NULL) continue;
+    entropy = Snapshot_Estimate(snap);
+    n = Snapshot_Top(snap, 16, top_tokens, top_counts);
+    //counts of a consistent snapshot are sorted and sum to at most m
+    sum = 0;
+    for(int i = 0; i < n; i++)
+    {
+      sum += top_counts[i];
+      if(i > 0 && top_counts[i] > top_counts[i-1]) sum = LONG_MAX;
+    }
+    if(!isfinite(entropy) || sum > snap->m || snap->m < last_m) r->bad++;
+    last_m = snap->m;
+    Publisher_Release(snap);
+    r->queries++;
+  }
+  return NULL;
+}
+
+//compute entropy of stream w/ c samplers and k counters using the fast
+//implementation (or as many samplers as fit in budget bytes if budget
+//is set), publishing a snapshot every c tokens while readers threads
+//query the latest one and check that it is consistent. Halfway the
+//estimator is resized, doubling c or halving the budget, so the
+//snapshots have to follow it
+static double Snapshot_Handle_stream(int* stream, int c, int k, int length,
+                                     int readers, long budget)
+{
+  double entropy;
+  long since = 0, published = 0, skipped = 0, queries = 0, bad = 0;
+  Estimator_type* est = budget ? Estimator_Init_Budget(budget) : Estimator_Init(c, k);
+  Snapshot_Publisher* pub = Publisher_Init(Estimator_Samplers(est), k, readers);
+  Estimator_Snapshot* snap;
+  pthread_t* threads = (pthread_t*) safe_malloc(readers * sizeof(pthread_t));
+  reader_arg* args = (reader_arg*) safe_malloc(readers * sizeof(reader_arg));
+
+  StartTheClock();
+  for(int i = 0; i < readers; i++)
+  {
+    args[i].pub = pub;
+    args[i].done = 0;
+    args[i].queries = args[i].bad = 0;
+    if(pthread_create(&threads[i], NULL, reader_main, &args[i]) != 0)
+      fatal("can't create reader thread");
+  }
+  for(int i = 0; i < length; i++)
+  {
+	if(i == length/2)
+	{
+	  c = Estimator_Samplers(est);
+	  if(budget) Estimator_Set_Budget(est, budget/2);
+	  else Estimator_Grow(est, 2*c);
+	  printf("resized from %d to %d samplers halfway\n", c, Estimator_Samplers(est));
+	}
+	Estimator_Update(est, stream[i]);
+	if(++since >= Estimator_Samplers(est))
+	{
+	  since = 0;
+	  if(Publisher_Publish(pub, est)) published++;
+	  else skipped++;
+	}
+  }
+  for(int i = 0; i < readers; i++)
+  {
+    __atomic_store_n(&args[i].done, 1, __ATOMIC_SEQ_CST);
+    pthread_join(threads[i], NULL);
+    queries += args[i].queries;
+    bad += args[i].bad;
+  }
+  //reached end of stream
+  entropy = Estimator_end_stream(est);
+  printf("took %ld ms and used %d bytes, ended with %d samplers\n",
+         StopTheClock(), Estimator_Size(est), Estimator_Samplers(est));
+  printf("published %ld snapshots (%ld skipped), %d readers made %ld queries, "
+         "%ld inconsistent\n", published, skipped, readers, queries, bad);
+  Publisher_Publish(pub, est);
+  snap = Publisher_Acquire(pub);
+  printf("final snapshot estimate %f %s the estimator's\n", Snapshot_Estimate(snap),
+         Snapshot_Estimate(snap) == entropy ? "matches" : "DIFFERS FROM");
+  Publisher_Release(snap);
+  Publisher_Destroy(pub);
+  Estimator_Destroy(est);
+  free(threads);
+  free(args);
+  return entropy;
+}
+
+//compute entropy of stream exactly while its counts fit in threshold
+//bytes, and with the fast implementation (c samplers and k counters)
+//seeded from the counts after that
+static double Hybrid_Handle_stream(int* stream, int c, int k, int length,
+                                   long threshold)
+{
+  double entropy;
+  Hybrid_Estimator_type* est = Hybrid_Estimator_Init(c, k, threshold);
+
+  StartTheClock();
+  for(int i = 0; i < length; i++)
+  {
+	Hybrid_Estimator_Update(est, stream[i]);
+  }
+  entropy = Hybrid_Estimator_end_stream(est);
+  printf("took %ld ms and used %d bytes, %s\n", StopTheClock(),
+         Hybrid_Estimator_Size(est),
+         Hybrid_Estimator_Exact(est) ? "counting exactly" : "sketching");
+  printf("Estimated distinct tokens: %.0f\n", Hybrid_Estimator_Distinct(est));
+  Hybrid_Estimator_Destroy(est);
+  return entropy;
+}
+
+//as Hybrid_Handle_stream for the stream of bytes-byte tokens in file
+//file_name, read as in Fast_Handle_file
+static double Hybrid_Handle_file(char* file_name, int c, int k, int bytes,
+                                 long threshold)
+{
+  double entropy;
+  Hybrid_Estimator_type* est;
+
+  FILE* file = fopen(file_name, "r");
+  if(!file)
+  {
+    fprintf(stderr, "Can't open file %s\n", file_name);
+	exit(1);
+  }
+  est = Hybrid_Estimator_Init(c, k, threshold);
+  StartTheClock();
+  Read_Tokens(file, bytes, hybrid_update, est, NULL);
+  entropy = Hybrid_Estimator_end_stream(est);
+  printf("took %ld ms and used %d bytes, %s\n", StopTheClock(),
+         Hybrid_Estimator_Size(est),
+         Hybrid_Estimator_Exact(est) ? "counting exactly" : "sketching");
+  printf("Estimated distinct tokens: %.0f\n", Hybrid_Estimator_Distinct(est));
+  Hybrid_Estimator_Destroy(est);
+  fclose(file);
+  return entropy;
+}
+
+//compute entropy of stream with c samplers and k counters, letting
+//the estimator pick the naive, slow or fast version as it goes
+static double Adaptive_Handle_stream(int* stream, int c, int k, int length)
+{
+  double entropy;
+  Adaptive_Estimator_type* est = Adaptive_Estimator_Init(c, k);
+
+  StartTheClock();
+  for(int i = 0; i < length; i++)
+  {
+	Adaptive_Estimator_Update(est, stream[i]);
+  }
+  entropy = Adaptive_Estimator_end_stream(est);
+  printf("took %ld ms and used %d bytes, ended on %s version after %d switches\n",
+         StopTheClock(), Adaptive_Estimator_Size(est),
+         Adaptive_Estimator_Version(est), Adaptive_Estimator_Switches(est));
+  Adaptive_Estimator_Destroy(est);
+  return entropy;
+}
+
+//as Adaptive_Handle_stream for the stream of bytes-byte tokens in file
+//file_name, read as in Fast_Handle_file
+static double Adaptive_Handle_file(char* file_name, int c, int k, int bytes)
+{
+  double entropy;
+  Adaptive_Estimator_type* est;
+
+  FILE* file = fopen(file_name, "r");
+  if(!file)
+  {
+    fprintf(stderr, "Can't open file %s\n", file_name);
+	exit(1);
+  }
+  est = Adaptive_Estimator_Init(c, k);
+  StartTheClock();
+  Read_Tokens(file, bytes, adaptive_update, est, NULL);
+  entropy = Adaptive_Estimator_end_stream(est);
+  printf("took %ld ms and used %d bytes, ended on %s version after %d switches\n",
+         StopTheClock(), Adaptive_Estimator_Size(est),
+         Adaptive_Estimator_Version(est), Adaptive_Estimator_Switches(est));
+  Adaptive_Estimator_Destroy(est);
+  fclose(file);
+  return entropy;
+}
+
+//compute entropy of stream without using its length: the samplers
+//grow with the stream to keep the (eps, delta) guarantee, with k
+//counters for the Misra-Gries part
+static double Oblivious_Handle_stream(int* stream, double eps, double delta,
+                                      int k, int length)
+{
+  double entropy;
+  Oblivious_Estimator_type* est = Oblivious_Estimator_Init(eps, delta, k);
+
+  StartTheClock();
+  for(int i = 0; i < length; i++)
+  {
+	Oblivious_Estimator_Update(est, stream[i]);
+  }
+  entropy = Oblivious_Estimator_end_stream(est);
+  printf("took %ld ms and used %d bytes, ended with %d samplers\n",
+         StopTheClock(), Oblivious_Estimator_Size(est),
+         Oblivious_Estimator_Samplers(est));
+  Oblivious_Estimator_Destroy(est);
+  return entropy;
+}
+
+//as Oblivious_Handle_stream for the stream of bytes-byte tokens in file
+//file_name, read as in Fast_Handle_file. A file_name of "-" reads
+//standard input, so the stream can come from a pipe
+static double Oblivious_Handle_file(char* file_name, double eps, double delta,
+                                    int k, int bytes)
+{
+  double entropy;
+  Oblivious_Estimator_type* est;
+
+  FILE* file = strcmp(file_name, "-") ? fopen(file_name, "r") : stdin;
+  if(!file)
+  {
+    fprintf(stderr, "Can't open file %s\n", file_name);
+	exit(1);
+  }
+  est = Oblivious_Estimator_Init(eps, delta, k);
+  StartTheClock();
+  Read_Tokens(file, bytes, oblivious_update, est, NULL);
+  entropy = Oblivious_Estimator_end_stream(est);
+  printf("took %ld ms and used %d bytes, ended with %d samplers\n",
+         StopTheClock(), Oblivious_Estimator_Size(est),
+         Oblivious_Estimator_Samplers(est));
+  Oblivious_Estimator_Destroy(est);
+  if(file != stdin) fclose(file);
+  return entropy;
+}
+
+//compute entropy of stream with as many samplers as fit in budget
+//bytes, shedding some if the stream needs more room than planned. The
+//error bound printed holds with probability 1-delta
+static double Budget_Handle_stream(int* stream, long budget, double delta,
+                                   int length)
+{
+  double entropy;
+  Estimator_type* est = Estimator_Init_Budget(budget);
+  int c = Estimator_Samplers(est);
+
+  StartTheClock();
+  for(int i = 0; i < length; i++)
+  {
+	Estimator_Update(est, stream[i]);
+  }
+  entropy = Estimator_end_stream(est);
+  printf("took %ld ms and used %d bytes, kept %d of %d samplers\n",
+         StopTheClock(), Estimator_Size(est), Estimator_Samplers(est), c);
+  printf("relative error at most %f with probability %f\n",
+         Estimator_Error(est, delta), 1-delta);
+  Estimator_Destroy(est);
+  return entropy;
+}
+
+//as Budget_Handle_stream for the stream of bytes-byte tokens in file
+//file_name, read as in Fast_Handle_file
+static double Budget_Handle_file(char* file_name, long budget, double delta,
+                                 int bytes)
+{
+  double entropy;
+  int c;
+  Estimator_type* est;
+
+  FILE* file = fopen(file_name, "r");
+  if(!file)
+  {
+    fprintf(stderr, "Can't open file %s\n", file_name);
+	exit(1);
+  }
+  est = Estimator_Init_Budget(budget);
+  c = Estimator_Samplers(est);
+  StartTheClock();
+  Read_Tokens(file, bytes, fast_update, est, NULL);
+  entropy = Estimator_end_stream(est);
+  printf("took %ld ms and used %d bytes, kept %d of %d samplers\n",
+         StopTheClock(), Estimator_Size(est), Estimator_Samplers(est), c);
+  printf("relative error at most %f with probability %f\n",
+         Estimator_Error(est, delta), 1-delta);
+  Estimator_Destroy(est);
+  fclose(file);
+  return entropy;
+}
+
+//entropy of the 1- to grams-byte n-grams of file filename, overlapping
+//(one starting at every byte), in one read of the file. The n-gram at
+//a byte is the top 8n bits of the grams-byte window starting there
+//read big-endian, so every order is a prefix level of one stream of
+//windows and one Prefix_Estimator covers all of them. Only whole
+//windows are fed, so the last grams-1 bytes enter only as part of
+//grams that start earlier. The differences between orders are the
+//conditional entropies H(X_n | X_1..X_n-1)
+static void Gram_Handle_file(char* file_name, int c, int k, int grams)
+{
+  int bits[4];
+  double entropies[4];
+  unsigned char* data;
+  unsigned int window = 0;
+  struct stat st;
+  int fd;
+  Prefix_Estimator_type* est;
+
+  fd = open(file_name, O_RDONLY);
+  if(fd < 0 || fstat(fd, &st) != 0)
+  {
+    fprintf(stderr, "Can't open file %s\n", file_name);
+	exit(1);
+  }
+  if(st.st_size < grams)
+  {
+    fprintf(stderr, "File %s is shorter than one %d-gram\n", file_name, grams);
+	exit(1);
+  }
+  data = (unsigned char*) mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if(data == MAP_FAILED) fatal("can't map file %s", file_name);
+  madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+  for(int n = 0; n < grams; n++)
+    bits[n] = 8 * (n+1);
+  est = Prefix_Estimator_Init(c, k, grams, bits);
+  StartTheClock();
+  for(long i = 0; i < st.st_size; i++)
+  {
+    window = window << 8 | data[i];
+    if(i >= grams-1)
+      Prefix_Estimator_Update(est, (int) (window << (32 - 8*grams)));
+  }
+  Prefix_Estimator_end_stream(est, entropies);
+  printf("took %ld ms and used %d bytes\n",
+         StopTheClock(), Prefix_Estimator_Size(est));
+  for(int n = 0; n < grams; n++)
+  {
+    printf("Estimated %d-gram entropy is: %f", n+1, entropies[n]);
+    if(n > 0)
+      printf(", of byte %d given the ones before it: %f", n+1,
+             fmax(0, entropies[n] - entropies[n-1]));
+    printf("\n");
+  }
+  Prefix_Estimator_Destroy(est);
+  munmap(data, st.st_size);
+  close(fd);
+}
+
+//feed the bytes-byte tokens of file, from where it is, to est through
+//update, the bytes of a token read little-endian. If save is set est is
+//checkpointed every save->every tokens and at the end of the file
+static void Read_Tokens(FILE* file, int bytes, Token_Update update, void* est,
+                        Checkpoint_Saver* save)
+{
+  char buf[5];
+  int token;
+  long since = 0, len;
+  unsigned char* image;
+
   while(fgets(buf, bytes+1, file)!=NULL)
   {
     token = 0;
 	if(!feof(file)) //if not at end of stream, add all the bytes
 	{
 	  for(int i = 0; i <= bytes-1 ; i++)
-	  { 
+	  {
 	    token += buf[i] << (8*i);
 	  }
 	}
@@ -244,28 +814,173 @@ static double Slow_Handle_file(char* file_name, int c, int k, int bytes)
 	    token += buf[i] << (8*i);
 	  }
 	}
-	Slow_Estimator_Update(est, token);
+	update(est, token);
+	if(save && ++since == save->every)
+	{
+	  since = 0;
+	  image = save->serialize(est, &len);
+	  Save_Checkpoint(save->path, ftell(file), bytes, image, len);
+	  free(image);
+	}
   }
-  //reached end of stream
-  entropy = Slow_Estimator_end_stream(est);
-  printf("took %ld ms and used %d bytes\n", 
-         StopTheClock(), Slow_Estimator_Size(est));
-  Slow_Estimator_Destroy(est);
+  if(save)
+  {
+    image = save->serialize(est, &len);
+    Save_Checkpoint(save->path, ftell(file), bytes, image, len);
+    free(image);
+  }
+}
+
+//the estimators' updates and serializers in the form Read_Tokens takes
+static void fast_update(void* est, int token)
+{
+  Estimator_Update((Estimator_type*) est, token);
+}
+
+static void naive_update(void* est, int token)
+{
+  Naive_Estimator_Update((Naive_Estimator_type*) est, token);
+}
+
+static void slow_update(void* est, int token)
+{
+  Slow_Estimator_Update((Slow_Estimator_type*) est, token);
+}
+
+static void parallel_update(void* est, int token)
+{
+  Parallel_Estimator_Update((Parallel_Estimator_type*) est, token);
+}
+
+static void hybrid_update(void* est, int token)
+{
+  Hybrid_Estimator_Update((Hybrid_Estimator_type*) est, token);
+}
+
+static void adaptive_update(void* est, int token)
+{
+  Adaptive_Estimator_Update((Adaptive_Estimator_type*) est, token);
+}
+
+static void oblivious_update(void* est, int token)
+{
+  Oblivious_Estimator_Update((Oblivious_Estimator_type*) est, token);
+}
+
+static unsigned char* fast_serialize(void* est, long* len)
+{
+  return Estimator_Serialize((Estimator_type*) est, len);
+}
+
+static unsigned char* naive_serialize(void* est, long* len)
+{
+  return Naive_Estimator_Serialize((Naive_Estimator_type*) est, len);
+}
+
+static unsigned char* slow_serialize(void* est, long* len)
+{
+  return Slow_Estimator_Serialize((Slow_Estimator_type*) est, len);
+}
+
+//write a checkpoint: the estimator image and the offset in the input
+//file it covers. The file is written beside path and renamed over it,
+//so a crash while saving leaves the previous checkpoint intact
+static void Save_Checkpoint(char* path, long offset, int bytes,
+                            unsigned char* image, long len)
+{
+  serial_buf b;
+  char* tmp = (char*) safe_malloc(strlen(path) + 5);
+  FILE* file;
+
+  Serial_Init(&b);
+  Serial_Put_Header(&b, SERIAL_CHECKPOINT);
+  Serial_Put_Long(&b, offset);
+  Serial_Put_Int(&b, bytes);
+  Serial_Put_Long(&b, len);
+
+  sprintf(tmp, "%s.tmp", path);
+  file = fopen(tmp, "wb");
+  if(file == NULL) fatal("can't write checkpoint %s", tmp);
+  if(fwrite(b.data, 1, b.len, file) != (size_t) b.len ||
+     fwrite(image, 1, len, file) != (size_t) len ||
+     fflush(file) != 0 || fsync(fileno(file)) != 0)
+    fatal("can't write checkpoint %s", tmp);
   fclose(file);
-  return entropy;
+  if(rename(tmp, path) != 0) fatal("can't replace checkpoint %s", path);
+  Serial_Free(&b);
+  free(tmp);
+}
+
+//read a checkpoint written by Save_Checkpoint for a stream of bytes-byte
+//tokens; returns the estimator image and sets offset
+static unsigned char* Load_Checkpoint(char* path, long* offset, int bytes,
+                                      long* len)
+{
+  unsigned char header[32];
+  unsigned char* image;
+  serial_reader r;
+  FILE* file = fopen(path, "rb");
+
+  if(file == NULL) fatal("can't open checkpoint %s", path);
+  if(fread(header, 1, 32, file) != 32) fatal("checkpoint %s is truncated", path);
+  Serial_Reader_Init(&r, header, 32);
+  Serial_Get_Header(&r, SERIAL_CHECKPOINT);
+  *offset = (long) Serial_Get_Long(&r);
+  if(Serial_Get_Int(&r) != bytes) r.error = 1;
+  *len = (long) Serial_Get_Long(&r);
+  if(r.error || *offset < 0 || *len <= 0)
+    fatal("%s is not a checkpoint of a stream of %d-byte tokens", path, bytes);
+  image = (unsigned char*) safe_malloc(*len);
+  if(fread(image, 1, *len, file) != (size_t) *len)
+    fatal("checkpoint %s is truncated", path);
+  fclose(file);
+  return image;
 }
 
 /******************************************************************/
 
+//the number of distinct tokens, from the HyperLogLog registers kept
+//alongside the samplers, and the entropy relative to log2 of it
+static void Fast_Print_Distinct(Estimator_type* est)
+{
+  printf("Estimated distinct tokens: %.0f, normalized entropy: %f\n",
+         Estimator_Distinct(est), Estimator_Normalized(est));
+}
+
+//with -a, the Renyi and Tsallis entropies of order moment_alpha and
+//the moment F_alpha, from the samplers that gave the entropy
+static void Fast_Print_Moments(Estimator_type* est)
+{
+  if(moment_alpha < 0) return;
+  printf("Estimated Renyi entropy of order %g is: %f\n", moment_alpha,
+         Estimator_Renyi(est, moment_alpha));
+  printf("Estimated Tsallis entropy of order %g is: %f\n", moment_alpha,
+         Estimator_Tsallis(est, moment_alpha));
+  printf("Estimated F_%g is: %g\n", moment_alpha, Estimator_Fp(est, moment_alpha));
+}
+
+static void Slow_Print_Moments(Slow_Estimator_type* est)
+{
+  if(moment_alpha < 0) return;
+  printf("Estimated Renyi entropy of order %g is: %f\n", moment_alpha,
+         Slow_Estimator_Renyi(est, moment_alpha));
+  printf("Estimated Tsallis entropy of order %g is: %f\n", moment_alpha,
+         Slow_Estimator_Tsallis(est, moment_alpha));
+  printf("Estimated F_%g is: %g\n", moment_alpha, Slow_Estimator_Fp(est, moment_alpha));
+}
+
 void CheckArguments(int argc, char **argv) {
-  int fflag, nflag, sflag, zflag;
+  int fflag, nflag, sflag, Aflag, Uflag, zflag;
   int mflag, eflag, dflag, cflag, kflag, lflag;
-  int length, c, k, range, next, bytes;
+  int length, c, k, range, next, bytes, shards, producers, resume, grams;
+  int readers;
+  long every, threshold, budget;
   char* filename;
+  char* checkpoint;
   double delta, eps, zipfparam;
   
   //set defaults
-  fflag = nflag = sflag = zflag = 0;
+  fflag = nflag = sflag = Aflag = Uflag = zflag = 0;
   mflag = eflag = dflag = cflag = kflag = lflag = 0;
   
   length = LENGTH_DEFAULT;
@@ -275,11 +990,20 @@ void CheckArguments(int argc, char **argv) {
   k = K_DEFAULT;
   range = RANGE_DEFAULT;
   bytes = BYTES_DEFAULT;
+  shards = 0;
+  producers = 0;
+  readers = 0;
+  grams = 0;
+  threshold = 0;
+  budget = 0;
   filename = "";
+  checkpoint = NULL;
+  every = CHECKPOINT_DEFAULT;
+  resume = 0;
   zipfparam = 1.1;
 	  
   opterr = 0;	  
-  while ((next = getopt (argc, argv, "fnsz:m:e:d:c:k:l:b:")) != -1)
+  while ((next = getopt (argc, argv, "fnsAUz:m:e:d:c:k:l:b:p:t:q:o:i:Ra:g:x:M:")) != -1)
   {     
 	switch (next)
 	{
@@ -295,6 +1019,12 @@ void CheckArguments(int argc, char **argv) {
 	   //fprintf(stderr, "s\n");
 		sflag = 1;
 	  break;
+	  case 'A':
+	    Aflag = 1;
+	    break;
+	  case 'U':
+	    Uflag = 1;
+	    break;
 	  case 'z':
 	    //fprintf(stderr, "z\n");
 	    zflag = 1;
@@ -385,6 +1115,75 @@ void CheckArguments(int argc, char **argv) {
 		 exit(1);
 	   }
 	   break; 
+	 case 'p':
+	   shards = (int)strtol(optarg, (char **)NULL, 10);
+	   if(shards <= 0){
+		 fprintf(stderr, "error occurred in reading number of shards ");
+		 fprintf(stderr, "or nonpositive number given\n");
+		 exit(1);
+	   }
+	   break;
+	 case 't':
+	   producers = (int)strtol(optarg, (char **)NULL, 10);
+	   if(producers <= 0){
+		 fprintf(stderr, "error occurred in reading number of producers ");
+		 fprintf(stderr, "or nonpositive number given\n");
+		 exit(1);
+	   }
+	   break;
+	 case 'q':
+	   readers = (int)strtol(optarg, (char **)NULL, 10);
+	   if(readers <= 0){
+		 fprintf(stderr, "error occurred in reading number of readers ");
+		 fprintf(stderr, "or nonpositive number given\n");
+		 exit(1);
+	   }
+	   break;
+	 case 'o':
+	   checkpoint = optarg;
+	   break;
+	 case 'i':
+	   every = strtol(optarg, (char **)NULL, 10);
+	   if(every <= 0){
+		 fprintf(stderr, "error occurred in reading checkpoint interval ");
+		 fprintf(stderr, "or nonpositive interval given\n");
+		 exit(1);
+	   }
+	   break;
+	 case 'R':
+	   resume = 1;
+	   break;
+	 case 'a':
+	   moment_alpha = strtod(optarg, (char **) NULL);
+	   if(moment_alpha < 0){
+		 fprintf(stderr, "order of Renyi and Tsallis entropies (-a) must be at least 0\n");
+		 exit(1);
+	   }
+	   break;
+	 case 'g':
+	   grams = (int)strtol(optarg, (char **)NULL, 10);
+	   if(grams <= 0 || grams > 4){
+		 fprintf(stderr, "Can't take %d-grams.", grams);
+		 fprintf(stderr, " Must be integer between 1 and 4 inclusive\n");
+		 exit(1);
+	   }
+	   break;
+	 case 'x':
+	   threshold = strtol(optarg, (char **)NULL, 10);
+	   if(threshold <= 0){
+		 fprintf(stderr, "error occurred in reading exact counting threshold ");
+		 fprintf(stderr, "or nonpositive threshold given\n");
+		 exit(1);
+	   }
+	   break;
+	 case 'M':
+	   budget = strtol(optarg, (char **)NULL, 10);
+	   if(budget <= 0){
+		 fprintf(stderr, "error occurred in reading memory budget ");
+		 fprintf(stderr, "or nonpositive budget given\n");
+		 exit(1);
+	   }
+	   break;
 	 case '?':
 	   if (isprint (optopt))
 		fprintf (stderr, "Unknown option or required argument not provided `-%c'.\n", optopt);
@@ -399,7 +1198,7 @@ void CheckArguments(int argc, char **argv) {
   }
   
   //default to fast version if no version specified
-  if(!fflag && !nflag && !sflag)
+  if(!fflag && !nflag && !sflag && !Aflag)
     fflag = 1;
  //default to synthetic stream if -z and -m not specified
  if(!zflag && !mflag)
@@ -411,12 +1210,77 @@ void CheckArguments(int argc, char **argv) {
 	fprintf(stderr, "and create synthetic stream (-z) at same time\n");
 	exit(1);
   }
-  if(fflag + nflag + sflag > 1){
-    fprintf(stderr, "two or more of versions (-f, -n, -s) specified\n");
+  if(fflag + nflag + sflag + Aflag > 1){
+    fprintf(stderr, "two or more of versions (-f, -n, -s, -A) specified\n");
+	exit(1);
+  }
+  if(Aflag && (shards || producers || checkpoint || grams || threshold ||
+                moment_alpha >= 0)){
+    fprintf(stderr, "adaptive version (-A) doesn't support -p, -t, -o, -g, -x or -a\n");
+	exit(1);
+  }
+  if(Uflag && (!fflag || cflag || shards || producers || checkpoint || grams ||
+                threshold || moment_alpha >= 0)){
+    fprintf(stderr, "unknown length mode (-U) only supported by fast version ");
+	fprintf(stderr, "without -c, -p, -t, -o, -g, -x or -a\n");
+	exit(1);
+  }
+  if(budget && (!fflag || cflag || kflag || Uflag || shards || producers ||
+                 checkpoint || grams || threshold || moment_alpha >= 0)){
+    fprintf(stderr, "memory budget (-M) only supported by fast version ");
+	fprintf(stderr, "without -c, -k, -U, -p, -t, -o, -g, -x or -a\n");
+	exit(1);
+  }
+  if(budget && dflag && delta >= 1){
+    fprintf(stderr, "memory budget (-M) needs delta (-d) below 1 for its ");
+	fprintf(stderr, "error bound\n");
+	exit(1);
+  }
+  if(budget && !dflag)
+    delta = BUDGET_DELTA_DEFAULT;
+  if(shards && nflag){
+    fprintf(stderr, "parallel mode (-p) not supported by naive version\n");
+	exit(1);
+  }
+  if(checkpoint && (!mflag || (fflag && shards))){
+    fprintf(stderr, "checkpoints (-o) are only supported when reading a file (-m) ");
+	fprintf(stderr, "without parallel shards\n");
+	exit(1);
+  }
+  if(moment_alpha >= 0 && (nflag || (fflag && (shards || producers)))){
+    fprintf(stderr, "Renyi and Tsallis entropies (-a) only supported by fast ");
+	fprintf(stderr, "version without -p or -t and by slow version\n");
+	exit(1);
+  }
+  if(resume && !checkpoint){
+    fprintf(stderr, "resuming (-R) needs a checkpoint file (-o)\n");
+	exit(1);
+  }
+  if(grams && (!mflag || !fflag || shards || producers || checkpoint ||
+              moment_alpha >= 0)){
+    fprintf(stderr, "n-gram mode (-g) only supported by fast version reading ");
+	fprintf(stderr, "a file (-m) without -p, -t, -o or -a\n");
+	exit(1);
+  }
+  if(threshold && (!fflag || shards || producers || checkpoint || grams ||
+                   moment_alpha >= 0)){
+    fprintf(stderr, "exact counting until a threshold (-x) only supported by fast ");
+	fprintf(stderr, "version without -p, -t, -o, -g or -a\n");
+	exit(1);
+  }
+  if(readers && (!fflag || mflag || Uflag || shards || producers || checkpoint ||
+                  threshold || moment_alpha >= 0)){
+    fprintf(stderr, "snapshot readers (-q) only supported by fast version on a ");
+	fprintf(stderr, "synthetic stream without -U, -p, -t, -o, -x or -a\n");
+	exit(1);
+  }
+  if(producers && (!fflag || shards || mflag)){
+    fprintf(stderr, "concurrent producers (-t) only supported by fast version ");
+	fprintf(stderr, "on a synthetic stream without -p\n");
 	exit(1);
   }
   
-  if(mflag) //figure out length if we're reading from file
+  if(mflag && !Uflag) //figure out length if we're reading from file
   {
 	//determine filesize:
 	FILE* the_file = fopen(filename, "r");
@@ -437,11 +1301,103 @@ void CheckArguments(int argc, char **argv) {
   
   double answer;
   //phew, all errors should have been detected and all variables have correct values
+  if(grams) //1- to grams-byte n-grams of the file
+  {
+    Gram_Handle_file(filename, c, k, grams);
+	return;
+  }
+  if(threshold) //exact counts until they take threshold bytes
+  {
+    if(mflag)
+      answer = Hybrid_Handle_file(filename, c, k, bytes, threshold);
+    else
+    {
+	  int* stream=CreateStream(length, zipfparam, range);
+      answer = Hybrid_Handle_stream(stream, c, k, length, threshold);
+      free(stream);
+    }
+    printf("Estimated entropy is: %f\n", answer);
+	return;
+  }
+  if(Uflag) //grow the samplers with the stream instead
+  {
+    if(mflag)
+      answer = Oblivious_Handle_file(filename, eps, delta, k, bytes);
+    else
+    {
+	  int* stream=CreateStream(length, zipfparam, range);
+      answer = Oblivious_Handle_stream(stream, eps, delta, k, length);
+      free(stream);
+    }
+    printf("Estimated entropy is: %f\n", answer);
+	return;
+  }
+  if(readers) //query published snapshots while the stream is ingested
+  {
+	int* stream=CreateStream(length, zipfparam, range);
+    answer = Snapshot_Handle_stream(stream, c, k, length, readers, budget);
+    printf("Estimated entropy is: %f\n", answer);
+    free(stream);
+	return;
+  }
+  if(budget) //as many samplers as fit in budget bytes
+  {
+    if(mflag)
+      answer = Budget_Handle_file(filename, budget, delta, bytes);
+    else
+    {
+	  int* stream=CreateStream(length, zipfparam, range);
+      answer = Budget_Handle_stream(stream, budget, delta, length);
+      free(stream);
+    }
+    printf("Estimated entropy is: %f\n", answer);
+	return;
+  }
+  if(Aflag) //let the estimator pick the version
+  {
+    if(mflag)
+      answer = Adaptive_Handle_file(filename, c, k, bytes);
+    else
+    {
+	  int* stream=CreateStream(length, zipfparam, range);
+      answer = Adaptive_Handle_stream(stream, c, k, length);
+      free(stream);
+    }
+    printf("Estimated entropy is: %f\n", answer);
+	return;
+  }
+  if(fflag && producers) //use fast version fed by concurrent producers
+  {
+	int* stream=CreateStream(length, zipfparam, range);
+    answer = Ingest_Handle_stream(stream, c, k, length, producers);
+  
+    printf("Estimated entropy is: %f\n", answer);
+    free(stream);
+	return;
+  }
+  if(fflag && shards) //use fast version partitioned across threads
+  {
+    if(mflag) //read from file
+	{
+      answer = Parallel_Handle_file(filename, c, k, bytes, shards);
+      printf("Estimated entropy is: %lf\n", answer);
+	  return;
+	}
+	else //create synthetic stream
+	{
+	  int* stream=CreateStream(length, zipfparam, range);
+      answer = Parallel_Handle_stream(stream, c, k, length, shards);
+  
+      printf("Estimated entropy is: %f\n", answer);
+      free(stream);
+	  return;
+    }
+  }
   if(fflag) //use fast version
   { 
     if(mflag) //read from file
 	{
-      answer = Fast_Handle_file(filename, c, k, bytes);
+      answer = Fast_Handle_file(filename, c, k, bytes, checkpoint, every, resume);
       printf("Estimated entropy is: %lf\n", answer);
 	  return;
 	}
@@ -458,7 +1414,7 @@ void CheckArguments(int argc, char **argv) {
   {
 	if(mflag) //read from file
 	{
-      answer = Naive_Handle_file(filename, c, k, bytes);
+      answer = Naive_Handle_file(filename, c, k, bytes, checkpoint, every, resume);
       printf("Estimated entropy is: %lf\n", answer);
 	  return;
 	}
@@ -475,14 +1431,15 @@ void CheckArguments(int argc, char **argv) {
   {
 	if(mflag) //read from file
 	{
-      answer = Slow_Handle_file(filename, c, k, bytes);
+      answer = Slow_Handle_file(filename, c, k, bytes, shards, checkpoint,
+                                every, resume);
       printf("Estimated entropy is: %lf\n", answer);
 	  return;
 	}
 	else //create synthetic stream
 	{
 	  int* stream=CreateStream(length, zipfparam, range);
-      answer = Slow_Handle_stream(stream, c, k, length);
+      answer = Slow_Handle_stream(stream, c, k, length, shards);
   
       printf("Estimated entropy is: %f\n", answer);
       free(stream);
@@ -495,7 +1452,7 @@ void CheckArguments(int argc, char **argv) {
 int * CreateStream(int length, double zipfpar, int range)
 {
   float zet;
-  int i; 
+  int i, distinct; 
   int * stream, * exact;
   prng_type * prng;
   double entropy, p;
@@ -525,6 +1482,20 @@ int * CreateStream(int length, double zipfpar, int range)
   }
 
   printf("exact entropy is %f\n", entropy);
+  distinct = 0;
+  for(i=0; i<=range+1; i++)
+    if(exact[i] > 0) distinct++;
+  printf("exact distinct tokens %d, normalized entropy %f\n", distinct,
+         distinct > 1 ? entropy / log2(distinct) : 0);
+  if(moment_alpha >= 0)
+  {
+    double f_alpha = 0;
+    for(i=0; i<=range+1; i++)
+      if(exact[i] > 0) f_alpha += pow(exact[i], moment_alpha);
+    printf("exact F_%g is %g, Renyi entropy %f, Tsallis entropy %f\n", moment_alpha,
+           f_alpha, moment_alpha == 1 ? entropy : Moments_Renyi(f_alpha, moment_alpha, length),
+           moment_alpha == 1 ? entropy * log(2) : Moments_Tsallis(f_alpha, moment_alpha, length));
+  }
 
   prng_Destroy(prng);
 
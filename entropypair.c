@@ -0,0 +1,175 @@
+/*Harness for joint entropy and mutual information (pair.c).
+ *
+ *Feeds a synthetic stream of pairs: x is zipfian with parameter z over
+ *range, and y is x mod ymod with probability q, otherwise independent
+ *and zipfian with parameter Z. Compares H(X), H(Y), H(X,Y) and I(X;Y)
+ *with their exact values, and times the pass against one and three
+ *runs of Estimator_Update, the latter being what the three entropies
+ *cost separately.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <unistd.h>
+#include <ctype.h>
+#include "massdal.h"
+#include "pairpub.h"
+#include "entropypub.h"
+#include "prng.h"
+#include "util.h"
+
+#define LENGTH_DEFAULT 2000000
+#define RANGE_DEFAULT 99999
+#define YMOD_DEFAULT 1000
+
+static void CreateStream(int length, double zipfpar, double zipfpar2, int range,
+                         int ymod, double q, int* xs, int* ys);
+static double Exact_Entropy(long long* keys, int length);
+static int ll_cmp(const void* p, const void* q);
+
+int main(int argc, char **argv) 
+{
+  int length = LENGTH_DEFAULT, range = RANGE_DEFAULT, ymod = YMOD_DEFAULT;
+  int c = 0, k = 0, next;
+  double zipfparam = 1.1, zipfparam2 = 0.8, q = 0.5, eps = .5, delta = .1;
+  
+  while ((next = getopt (argc, argv, "z:Z:l:r:e:d:c:k:Y:q:")) != -1)
+  {     
+	switch (next)
+	{
+	  case 'z': zipfparam = strtod(optarg, (char **) NULL); break;
+	  case 'Z': zipfparam2 = strtod(optarg, (char **) NULL); break;
+	  case 'l': length = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'r': range = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'e': eps = strtod(optarg, (char **) NULL); break;
+	  case 'd': delta = strtod(optarg, (char **) NULL); break;
+	  case 'c': c = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'k': k = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'Y': ymod = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'q': q = strtod(optarg, (char **) NULL); break;
+   	  case '?':
+	   if (isprint (optopt))
+		fprintf (stderr, "Unknown option or required argument not provided `-%c'.\n", optopt);
+		else
+		 fprintf (stderr, "Unknown option character `\\x%x'.\n",
+                        optopt);
+		exit(1);
+		break;
+	 default:
+	   abort();
+    }
+  }
+  if(length <= 0 || range <= 0 || ymod <= 0 || q < 0 || q > 1 ||
+     zipfparam < 0 || zipfparam2 < 0 || eps <= 0 || eps > 1 ||
+     delta <= 0 || delta > 1)
+  {
+    fprintf(stderr, "invalid arguments\n");
+	exit(1);
+  }
+  if(c <= 0)
+	c = ceil(16 * 1/(eps*eps) * log(2/delta) * log(length * M_E));
+  if(k <= 0)
+	k = ceil(7/eps);
+
+  int* xs = (int*) safe_malloc(length * sizeof(int));
+  int* ys = (int*) safe_malloc(length * sizeof(int));
+  long long* keys = (long long*) safe_malloc(length * sizeof(long long));
+  double hx, hy, hxy;
+  Pair_Entropies h;
+  long ms;
+
+  CreateStream(length, zipfparam, zipfparam2, range, ymod, q, xs, ys);
+  for(int i = 0; i < length; i++) keys[i] = xs[i];
+  hx = Exact_Entropy(keys, length);
+  for(int i = 0; i < length; i++) keys[i] = ys[i];
+  hy = Exact_Entropy(keys, length);
+  for(int i = 0; i < length; i++) keys[i] = (long long) xs[i] << 32 | ys[i];
+  hxy = Exact_Entropy(keys, length);
+
+  Pair_Estimator_type* est = Pair_Estimator_Init(c, k);
+  StartTheClock();
+  for(int i = 0; i < length; i++)
+    Pair_Estimator_Update(est, xs[i], ys[i]);
+  Pair_Estimator_end_stream(est, &h);
+  ms = StopTheClock();
+  printf("c %d, k %d: pairs took %ld ms and used %d bytes\n", c, k, ms,
+         Pair_Estimator_Size(est));
+  printf("           exact   estimated\n");
+  printf("H(X)    %9f %9f\n", hx, h.hx);
+  printf("H(Y)    %9f %9f\n", hy, h.hy);
+  printf("H(X,Y)  %9f %9f\n", hxy, h.hxy);
+  printf("I(X;Y)  %9f %9f\n", hx + hy - hxy, h.mi);
+  printf("H(X|Y)  %9f %9f\n", hxy - hy, h.hx_y);
+  printf("H(Y|X)  %9f %9f\n", hxy - hx, h.hy_x);
+  Pair_Estimator_Destroy(est);
+
+  //one fast estimator on x, then one per stream as the three
+  //entropies would be computed separately (the pair as a hashed int)
+  Estimator_type* ests[3];
+  for(int s = 0; s < 3; s++) ests[s] = Estimator_Init(c, k);
+  StartTheClock();
+  for(int i = 0; i < length; i++)
+    Estimator_Update(ests[0], xs[i]);
+  ms = StopTheClock();
+  printf("one Estimator_Update took %ld ms\n", ms);
+  StartTheClock();
+  for(int i = 0; i < length; i++)
+  {
+    Estimator_Update(ests[1], ys[i]);
+    Estimator_Update(ests[2], hash31(xs[i], ys[i], 0x5bd1e995) & MOD);
+  }
+  ms += StopTheClock();
+  printf("three Estimator_Updates took %ld ms\n", ms);
+  for(int s = 0; s < 3; s++) Estimator_Destroy(ests[s]);
+
+  free(keys);
+  free(xs);
+  free(ys);
+  return 0;
+}
+
+/******************************************************************/
+//Fills xs and ys with pairs: xs zipfian in [1, range+1], ys equal to
+//xs mod ymod with probability q and otherwise zipfian with zipfpar2
+static void CreateStream(int length, double zipfpar, double zipfpar2, int range,
+                         int ymod, double q, int* xs, int* ys)
+{
+  float zet, zet2;
+  prng_type * prng;
+  
+  prng=prng_Init(44545,2);
+  zet=zeta(length,zipfpar);
+  zet2=zeta(length,zipfpar2);
+  for (int i=0;i<length;i++) 
+  {
+	xs[i]=(int) floor(fastzipf(zipfpar,range,zet,prng));
+	if ((prng_int(prng) & MOD) < q * MOD)
+	  ys[i]=xs[i] % ymod;
+	else
+	  ys[i]=(int) floor(fastzipf(zipfpar2,range,zet2,prng));
+  }
+  prng_Destroy(prng);
+}
+
+//entropy of keys, which it sorts
+static double Exact_Entropy(long long* keys, int length)
+{
+  double sum_flogf = 0;
+  int run = 1;
+
+  qsort(keys, length, sizeof(long long), ll_cmp);
+  for(int i = 1; i <= length; i++)
+  {
+    if(i < length && keys[i] == keys[i-1]) { run++; continue; }
+    sum_flogf += run * log2(run);
+    run = 1;
+  }
+  return log2(length) - sum_flogf/length;
+}
+
+static int ll_cmp(const void* p, const void* q)
+{
+  long long a = *(const long long*) p, b = *(const long long*) q;
+  return (a==b) ? 0 : (a<b) ? -1 : 1;
+}
@@ -0,0 +1,184 @@
+/*Harness for prefix-level entropy (prefix.c).
+ *
+ *Feeds a synthetic stream of IPv4-like addresses: the first octet is
+ *zipfian with parameter z over [1, 127], and each later octet is
+ *zipfian with parameter Z, offset by a hash of the octets before it so
+ *each /8, /16 and /24 has its own spread. Compares the entropy of each
+ *prefix level given with -L (default 8,16,24,32) with its exact value,
+ *and times the pass against one Estimator_Update per level on the
+ *masked addresses, which is what re-running entropymain per mask costs.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <ctype.h>
+#include "massdal.h"
+#include "prefixpub.h"
+#include "entropypub.h"
+#include "prng.h"
+#include "util.h"
+
+#define LENGTH_DEFAULT 2000000
+#define MAX_LEVELS 32
+
+static void CreateStream(int length, double zipfpar, double zipfpar2, int* tokens);
+static int Parse_Levels(char* list, int* bits);
+static double Exact_Entropy(long long* keys, int length);
+static int ll_cmp(const void* p, const void* q);
+
+int main(int argc, char **argv) 
+{
+  int length = LENGTH_DEFAULT, c = 0, k = 0, levels, next;
+  int bits[MAX_LEVELS];
+  double zipfparam = 1.1, zipfparam2 = 0.8, eps = .5, delta = .1;
+  char level_list[256] = "8,16,24,32";
+  
+  while ((next = getopt (argc, argv, "z:Z:l:e:d:c:k:L:")) != -1)
+  {     
+	switch (next)
+	{
+	  case 'z': zipfparam = strtod(optarg, (char **) NULL); break;
+	  case 'Z': zipfparam2 = strtod(optarg, (char **) NULL); break;
+	  case 'l': length = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'e': eps = strtod(optarg, (char **) NULL); break;
+	  case 'd': delta = strtod(optarg, (char **) NULL); break;
+	  case 'c': c = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'k': k = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'L':
+	    strncpy(level_list, optarg, sizeof(level_list)-1);
+	    level_list[sizeof(level_list)-1] = '\0';
+	    break;
+   	  case '?':
+	   if (isprint (optopt))
+		fprintf (stderr, "Unknown option or required argument not provided `-%c'.\n", optopt);
+		else
+		 fprintf (stderr, "Unknown option character `\\x%x'.\n",
+                        optopt);
+		exit(1);
+		break;
+	 default:
+	   abort();
+    }
+  }
+  levels = Parse_Levels(level_list, bits);
+  if(length <= 0 || levels <= 0 || zipfparam < 0 || zipfparam2 < 0 ||
+     eps <= 0 || eps > 1 || delta <= 0 || delta > 1)
+  {
+    fprintf(stderr, "invalid arguments\n");
+	exit(1);
+  }
+  if(c <= 0)
+	c = ceil(16 * 1/(eps*eps) * log(2/delta) * log(length * M_E));
+  if(k <= 0)
+	k = ceil(7/eps);
+
+  int* tokens = (int*) safe_malloc(length * sizeof(int));
+  long long* keys = (long long*) safe_malloc(length * sizeof(long long));
+  unsigned int masks[MAX_LEVELS];
+  double exact[MAX_LEVELS], h[MAX_LEVELS];
+  long ms;
+
+  CreateStream(length, zipfparam, zipfparam2, tokens);
+  for(int l = 0; l < levels; l++)
+  {
+    masks[l] = bits[l] == 32 ? ~0u : ~(~0u >> bits[l]);
+    for(int i = 0; i < length; i++) keys[i] = tokens[i] & masks[l];
+    exact[l] = Exact_Entropy(keys, length);
+  }
+
+  Prefix_Estimator_type* est = Prefix_Estimator_Init(c, k, levels, bits);
+  StartTheClock();
+  for(int i = 0; i < length; i++)
+    Prefix_Estimator_Update(est, tokens[i]);
+  Prefix_Estimator_end_stream(est, h);
+  ms = StopTheClock();
+  printf("c %d, k %d: %d levels took %ld ms and used %d bytes\n", c, k, levels,
+         ms, Prefix_Estimator_Size(est));
+  printf("         exact   estimated\n");
+  for(int l = 0; l < levels; l++)
+    printf("/%-2d  %9f %9f\n", bits[l], exact[l], h[l]);
+  Prefix_Estimator_Destroy(est);
+
+  //the first octet is at most 127, so masked addresses stay positive
+  Estimator_type* ests[MAX_LEVELS];
+  for(int l = 0; l < levels; l++) ests[l] = Estimator_Init(c, k);
+  StartTheClock();
+  for(int i = 0; i < length; i++)
+    for(int l = 0; l < levels; l++)
+      Estimator_Update(ests[l], tokens[i] & masks[l]);
+  ms = StopTheClock();
+  printf("%d Estimator_Updates took %ld ms\n", levels, ms);
+  for(int l = 0; l < levels; l++) Estimator_Destroy(ests[l]);
+
+  free(keys);
+  free(tokens);
+  return 0;
+}
+
+/******************************************************************/
+//Fills tokens with addresses whose octets are zipfian, each offset by
+//a hash of the ones before it
+static void CreateStream(int length, double zipfpar, double zipfpar2, int* tokens)
+{
+  float zet, zet2;
+  prng_type * prng;
+  unsigned int addr, octet;
+  
+  prng=prng_Init(44545,2);
+  zet=zeta(length,zipfpar);
+  zet2=zeta(length,zipfpar2);
+  for (int i=0;i<length;i++) 
+  {
+	addr=(unsigned int) floor(fastzipf(zipfpar,126,zet,prng));
+	for (int j=1;j<4;j++)
+	{
+	  octet=(unsigned int) floor(fastzipf(zipfpar2,255,zet2,prng));
+	  addr=addr << 8 | ((octet + (addr*2654435761u >> 24)) & 255);
+	}
+	tokens[i]=(int) addr;
+  }
+  prng_Destroy(prng);
+}
+
+//prefix lengths from a comma separated list; 0 if it is malformed or
+//they do not increase from 1 to 32
+static int Parse_Levels(char* list, int* bits)
+{
+  int n = 0;
+  char* end;
+
+  for(char* p = strtok(list, ","); p != NULL; p = strtok(NULL, ","))
+  {
+    if(n == MAX_LEVELS) return 0;
+    bits[n] = (int) strtol(p, &end, 10);
+    if(*end != '\0' || bits[n] < 1 || bits[n] > 32 || (n > 0 && bits[n] <= bits[n-1]))
+      return 0;
+    n++;
+  }
+  return n;
+}
+
+//entropy of keys, which it sorts
+static double Exact_Entropy(long long* keys, int length)
+{
+  double sum_flogf = 0;
+  int run = 1;
+
+  qsort(keys, length, sizeof(long long), ll_cmp);
+  for(int i = 1; i <= length; i++)
+  {
+    if(i < length && keys[i] == keys[i-1]) { run++; continue; }
+    sum_flogf += run * log2(run);
+    run = 1;
+  }
+  return log2(length) - sum_flogf/length;
+}
+
+static int ll_cmp(const void* p, const void* q)
+{
+  long long a = *(const long long*) p, b = *(const long long*) q;
+  return (a==b) ? 0 : (a<b) ? -1 : 1;
+}
@@ -8,6 +8,7 @@
 #include "backup_heap.h"
 #include "c_a_heap.h"
 #include "prng.h"
+#include "hll.h"
 
 #define minimum(x,y)	((x) < (y) ? (x) : (y))
 #define maximum(x,y)	((x) > (y) ? (x) : (y))
@@ -15,6 +16,7 @@
 struct Estimator_type{
   int c, k, two_distinct_tokens;
   int count;
+  long budget; //bytes Estimator_Update keeps it within, 0 for none
   symtab* hashtable;
   prng_type* prng;
   Sample_type** samplers;
@@ -22,6 +24,7 @@ struct Estimator_type{
   heap* prim_heap;
   backup_heap* bheap;
   c_a* first;
+  hll_type distinct; //HyperLogLog of the tokens
 };
 
 extern Sample_type* Sample_Init();
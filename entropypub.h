@@ -1,12 +1,32 @@
 #ifndef ENTROPYPUB_H
 #define ENTROPYPUB_H
 
+#include "handoff.h"
+
 typedef struct Estimator_type Estimator_type;
 
 extern Estimator_type* Estimator_Init(int c, int k);
+extern Estimator_type* Estimator_Init_From_Counts(int c, int k, const int* items,
+                                                  const int* counts, int n);
+extern Estimator_type* Estimator_Init_From_Handoff(Sampler_handoff* h);
+extern void Estimator_Handoff(Estimator_type* est, Sampler_handoff* h);
+extern void Estimator_Grow(Estimator_type* est, int c);
+extern Estimator_type* Estimator_Init_Budget(long bytes);
+extern void Estimator_Set_Budget(Estimator_type* est, long bytes);
+extern double Estimator_Error(Estimator_type* est, double delta);
+extern int Estimator_Samplers(Estimator_type* est);
 extern void Estimator_Destroy(Estimator_type * est);
 extern int Estimator_Size(Estimator_type * est);
 extern void Estimator_Update(Estimator_type * est, int token);
 extern double Estimator_end_stream(Estimator_type* est);
+extern double Estimator_Fp(Estimator_type* est, double p);
+extern double Estimator_Divergence(Estimator_type* est, double (*cost)(void* arg, int token),
+                                   void* arg);
+extern double Estimator_Renyi(Estimator_type* est, double alpha);
+extern double Estimator_Tsallis(Estimator_type* est, double alpha);
+extern double Estimator_Distinct(Estimator_type* est);
+extern double Estimator_Normalized(Estimator_type* est);
+extern unsigned char* Estimator_Serialize(Estimator_type* est, long* len);
+extern Estimator_type* Estimator_Deserialize(const unsigned char* image, long len);
 
 #endif
\ No newline at end of file
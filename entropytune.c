@@ -0,0 +1,422 @@
+/*Picks c and k by experiment instead of by the bound.
+ *
+ *The c entropymain derives from eps and delta, 16/eps^2 log(2/delta)
+ *log(m e), holds for any stream but is far more than most streams
+ *need. This runs the estimators on a representative stream, the
+ *tokens of a sample file (-m, read as entropymain reads it), a Zipf
+ *surrogate fitted to that sample (-m with -F), or a synthetic Zipf
+ *stream (-z), and for each engine (-E, any of "fns") and each k in
+ *TUNE_KS fractions of 7/eps grows c from TUNE_C_MIN by steps of sqrt 2
+ *up to the bound. Each configuration runs -T trials from the same
+ *seeds; it meets the target when at most delta of them miss the exact
+ *entropy by more than eps relatively. The first c that meets it ends
+ *the search for that engine and k, as would any c already slower per
+ *token than the cheapest configuration found, since more samplers
+ *only cost more. Of configurations within timing noise of each other
+ *the smallest wins. The estimators draw their seeds from lrand48(),
+ *so srand48 gives each trial its own. Prints every configuration
+ *tried and the cheapest in ns/token that meets the target.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <unistd.h>
+#include <ctype.h>
+#include <sys/time.h>
+#include "prng.h"
+#include "entropypub.h"
+#include "naivepub.h"
+#include "slowentropypub.h"
+#include "util.h"
+
+#define LENGTH_DEFAULT 1000000
+#define RANGE_DEFAULT 99999
+#define TRIALS_DEFAULT 20
+#define TUNE_C_MIN 16
+#define TUNE_THETA_MAX 8 //largest Zipf exponent a fit tries
+//a trial this much slower than the cheapest configuration found ends
+//its configuration early
+#define TUNE_MARGIN 1.5
+//configurations closer than this in ns/token are told apart by bytes
+#define TUNE_NOISE 1.1
+//fastzipf divides by 1 - theta
+#define TUNE_THETA_GAP 0.001
+
+#define minimum(x,y)	((x) < (y) ? (x) : (y))
+#define maximum(x,y)	((x) > (y) ? (x) : (y))
+
+//one run of an engine over a stream: its estimate, and its time and
+//space through space
+typedef double (*tune_fn)(int* stream, int length, int c, int k,
+                          long* usec, int* space);
+
+typedef struct engine_type{
+  char flag;
+  const char* name;
+  tune_fn run;
+} engine_type;
+
+//k as fractions of 7/eps, smallest first
+static const double tune_ks[] = {0.25, 0.5, 1};
+#define TUNE_KS (sizeof(tune_ks)/sizeof(tune_ks[0]))
+
+static double Fast_Run(int* stream, int length, int c, int k, long* usec, int* space);
+static double Naive_Run(int* stream, int length, int c, int k, long* usec, int* space);
+static double Slow_Run(int* stream, int length, int c, int k, long* usec, int* space);
+
+static const engine_type engines[] = {
+  {'f', "fast", Fast_Run},
+  {'n', "naive", Naive_Run},
+  {'s', "slow", Slow_Run},
+};
+#define ENGINES (sizeof(engines)/sizeof(engines[0]))
+
+static int* Read_File(const char* filename, int bytes, int max, int* length);
+static int* Fit_Zipf(const int* sample, int n, int length, double* theta, int* range);
+static double Zipf_Entropy(double theta, int range);
+static int* CreateStream(int length, double zipfpar, int range);
+static double Exact_Entropy(const int* stream, int length, int* distinct);
+static long Now_Usec();
+static int int_cmp(const void* p, const void* q);
+static int long_cmp(const void* p, const void* q);
+static int double_cmp(const void* p, const void* q);
+
+int main(int argc, char **argv)
+{
+  int length = LENGTH_DEFAULT, range = RANGE_DEFAULT, trials = TRIALS_DEFAULT;
+  int bytes = 1, fit = 0, lflag = 0, next, distinct;
+  double zipfparam = 1.1, eps = .1, delta = .1;
+  const char* filename = NULL;
+  const char* which = "fns";
+  int* stream;
+
+  while ((next = getopt (argc, argv, "m:Fz:l:r:b:e:d:T:E:")) != -1)
+  {
+	switch (next)
+	{
+	  case 'm': filename = optarg; break;
+	  case 'F': fit = 1; break;
+	  case 'z': zipfparam = strtod(optarg, (char **) NULL); break;
+	  case 'l': length = (int)strtol(optarg, (char **)NULL, 10); lflag = 1; break;
+	  case 'r': range = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'b': bytes = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'e': eps = strtod(optarg, (char **) NULL); break;
+	  case 'd': delta = strtod(optarg, (char **) NULL); break;
+	  case 'T': trials = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'E': which = optarg; break;
+   	  case '?':
+	   if (isprint (optopt))
+		fprintf (stderr, "Unknown option or required argument not provided `-%c'.\n", optopt);
+		else
+		 fprintf (stderr, "Unknown option character `\\x%x'.\n",
+                        optopt);
+		exit(1);
+		break;
+	 default:
+	   abort();
+    }
+  }
+  if(length <= 1 || range <= 0 || zipfparam < 0 || bytes <= 0 || bytes > 4 ||
+     eps <= 0 || eps > 1 || delta <= 0 || delta > 1 || trials <= 0 ||
+     (fit && !filename))
+  {
+    fprintf(stderr, "invalid arguments\n");
+	exit(1);
+  }
+  for(const char* w = which; *w; w++)
+  {
+    if(!strchr("fns", *w))
+    {
+      fprintf(stderr, "unknown engine `%c' in -E, must be one of f, n, s\n", *w);
+      exit(1);
+    }
+  }
+
+  if(filename && fit)
+  { //without -l the surrogate is as long as the sample
+    int n;
+    int* sample = Read_File(filename, bytes, INT_MAX, &n);
+    stream = Fit_Zipf(sample, n, lflag ? length : n, &zipfparam, &range);
+    if(!lflag) length = n;
+    printf("sample of %d tokens, Zipf fit %f over %d tokens, exact entropy %f\n",
+           n, zipfparam, range, Exact_Entropy(sample, n, &distinct));
+    free(sample);
+  }
+  else if(filename)
+    stream = Read_File(filename, bytes, lflag ? length : INT_MAX, &length);
+  else
+    stream = CreateStream(length, zipfparam, range);
+  if(length < 2)
+    fatal("need a stream of at least 2 tokens");
+
+  double exact = Exact_Entropy(stream, length, &distinct);
+  int c_bound = ceil(16 * 1/(eps*eps) * log(2/delta) * log(length * M_E));
+  int k_bound = ceil(7/eps);
+  //misses a configuration may have and still meet the target
+  int allowed = floor(delta * trials);
+  printf("%d tokens, %d distinct, exact entropy %f\n", length, distinct, exact);
+  printf("target: relative error %g in all but %d of %d trials; the bound "
+         "needs c %d, k %d\n", eps, allowed, trials, c_bound, k_bound);
+  printf("engine       c      k  misses  err@%-5g  ns/token       bytes\n", 1-delta);
+
+  double* errors = (double*) safe_malloc(trials * sizeof(double));
+  long* usecs = (long*) safe_malloc(trials * sizeof(long));
+  const engine_type* best = NULL;
+  int best_c = 0, best_k = 0, best_space = 0;
+  double best_ns = 0;
+
+  for(int e = 0; e < ENGINES; e++)
+  {
+    if(!strchr(which, engines[e].flag)) continue;
+    for(int ki = 0; ki < TUNE_KS; ki++)
+    {
+      int k = maximum(1, (int) ceil(tune_ks[ki] * k_bound));
+      int step = 0, c = 0, misses = 0, space = 0;
+      double ns = 0;
+      while(c < c_bound)
+      {
+        c = ceil(TUNE_C_MIN * pow(2, step++ / 2.0));
+        c = minimum(c, c_bound);
+        misses = 0;
+        int tried = 0;
+        for(int t = 0; t < trials; t++)
+        {
+          srand48(t+1); //every configuration sees the same seeds
+          double estimate = engines[e].run(stream, length, c, k, &usecs[t], &space);
+          errors[t] = fabs(estimate - exact) / (exact > 0 ? exact : 1);
+          if(errors[t] > eps) misses++;
+          tried++;
+          //too slow already, or can't meet the target any more
+          if(best && usecs[t] * 1000.0 / length > TUNE_MARGIN * best_ns) break;
+          if(misses > allowed) break;
+        }
+        qsort(usecs, tried, sizeof(long), long_cmp);
+        ns = usecs[tried/2] * 1000.0 / length;
+        qsort(errors, tried, sizeof(double), double_cmp);
+        printf("%-6s %7d %6d  %2d/%-3d  %8.4f  %8.1f  %10d%s\n", engines[e].name,
+               c, k, misses, tried, errors[minimum(tried-1, (int) ceil((1-delta) * tried) - 1)],
+               ns, space, tried < trials ? "  (stopped early)" : "");
+        fflush(stdout);
+        if(best && ns > best_ns) break;
+        if(misses <= allowed && tried == trials)
+        {
+          if(!best || ns * TUNE_NOISE < best_ns ||
+             (ns < best_ns * TUNE_NOISE && space < best_space))
+          {
+            best = &engines[e];
+            best_c = c;
+            best_k = k;
+            best_ns = ns;
+            best_space = space;
+          }
+          break;
+        }
+      }
+    }
+  }
+
+  if(best)
+    printf("cheapest meeting the target: %s version, c %d, k %d, %.1f ns/token, "
+           "%d bytes (%.1f%% of the samplers the bound needs)\n",
+           best->name, best_c, best_k, best_ns, best_space, 100.0 * best_c / c_bound);
+  else
+    printf("no configuration up to the bound met the target\n");
+  free(errors);
+  free(usecs);
+  free(stream);
+  return best ? 0 : 1;
+}
+
+//compute entropy of stream w/ c samplers and k counters
+//for use by Misra-Gries alg, using the fast version
+static double Fast_Run(int* stream, int length, int c, int k, long* usec, int* space)
+{
+  double entropy;
+  Estimator_type* est = Estimator_Init(c, k);
+  long start = Now_Usec();
+
+  for(int i = 0; i < length; i++)
+    Estimator_Update(est, stream[i]);
+  *usec = Now_Usec() - start;
+  *space = Estimator_Size(est);
+  entropy = Estimator_end_stream(est);
+  Estimator_Destroy(est);
+  return entropy;
+}
+
+//as Fast_Run, using the naive version
+static double Naive_Run(int* stream, int length, int c, int k, long* usec, int* space)
+{
+  double entropy;
+  Naive_Estimator_type* est = Naive_Estimator_Init(c, k);
+  long start = Now_Usec();
+
+  for(int i = 0; i < length; i++)
+    Naive_Estimator_Update(est, stream[i]);
+  *usec = Now_Usec() - start;
+  *space = Naive_Estimator_Size(est);
+  entropy = Naive_Estimator_end_stream(est);
+  Naive_Estimator_Destroy(est);
+  return entropy;
+}
+
+//as Fast_Run, using the slow version
+static double Slow_Run(int* stream, int length, int c, int k, long* usec, int* space)
+{
+  double entropy;
+  Slow_Estimator_type* est = Slow_Estimator_Init(c, k);
+  long start = Now_Usec();
+
+  for(int i = 0; i < length; i++)
+    Slow_Estimator_Update(est, stream[i]);
+  *usec = Now_Usec() - start;
+  *space = Slow_Estimator_Size(est);
+  entropy = Slow_Estimator_end_stream(est);
+  Slow_Estimator_Destroy(est);
+  return entropy;
+}
+
+//the first max bytes-byte tokens of file filename, split up as
+//entropymain's Fast_Handle_file does so the tuned c and k carry over
+static int* Read_File(const char* filename, int bytes, int max, int* length)
+{
+  char buf[5];
+  int token, n = 0, size = 1024;
+  int* stream = (int*) safe_malloc(size * sizeof(int));
+  FILE* file = fopen(filename, "r");
+
+  if(!file)
+    fatal("Can't open file %s", filename);
+  while(n < max && fgets(buf, bytes+1, file)!=NULL)
+  {
+    token = 0;
+	if(!feof(file)) //if not at end of stream, add all the bytes
+	{
+	  for(int i = 0; i <= bytes-1 ; i++)
+	  {
+	    token += buf[i] << (8*i);
+	  }
+	}
+	else
+	{ //bytes in file not divisible by bytes; assumes no "0" bytes
+	  for(int i = 0; i <= bytes-1 ; i++)
+	  {
+	    if(buf[i] == 0) break;
+	    token += buf[i] << (8*i);
+	  }
+	}
+	if(n == size)
+	{
+	  size *= 2;
+	  stream = (int*) safe_realloc(stream, size * sizeof(int));
+	}
+	stream[n++] = token;
+  }
+  fclose(file);
+  *length = n;
+  return stream;
+}
+
+//a Zipf stream of length tokens standing in for sample: over as many
+//tokens as it has distinct ones, with the exponent whose distribution
+//has the sample's entropy, found by bisection as the entropy falls
+//with the exponent
+static int* Fit_Zipf(const int* sample, int n, int length, double* theta, int* range)
+{
+  int v;
+  double target = Exact_Entropy(sample, n, &v), lo = 0, hi = TUNE_THETA_MAX;
+
+  for(int i = 0; i < 50; i++)
+  {
+    *theta = (lo + hi) / 2;
+    if(Zipf_Entropy(*theta, v) > target) lo = *theta;
+    else hi = *theta;
+  }
+  if(fabs(*theta - 1) < TUNE_THETA_GAP) *theta = 1 + TUNE_THETA_GAP;
+  *range = v;
+  return CreateStream(length, *theta, v);
+}
+
+//entropy in bits of the Zipf distribution with exponent theta over
+//range tokens
+static double Zipf_Entropy(double theta, int range)
+{
+  double z = 0, sum_plogi = 0, p;
+
+  for(int i = 1; i <= range; i++)
+    z += pow(i, -theta);
+  for(int i = 1; i <= range; i++)
+  {
+    p = pow(i, -theta) / z;
+    sum_plogi += p * log(i);
+  }
+  return (log(z) + theta * sum_plogi) / log(2);
+}
+
+/******************************************************************/
+//Creates and returns stream of ints in range [1, range+1] according
+//to zipfian distribution based on zipfpar
+static int* CreateStream(int length, double zipfpar, int range)
+{
+  int* stream = (int *) safe_malloc(length * sizeof(int));
+  prng_type* prng = prng_Init(44545,2);
+  double zet = zeta(range, zipfpar);
+
+  for (int i=0;i<length;i++)
+	stream[i]=(int) floor(fastzipf(zipfpar,range,zet,prng));
+  prng_Destroy(prng);
+  return(stream);
+}
+
+//entropy of stream in bits and its number of distinct tokens
+static double Exact_Entropy(const int* stream, int length, int* distinct)
+{
+  int* sorted = (int*) safe_malloc(length * sizeof(int));
+  double sum_flogf = 0;
+
+  memcpy(sorted, stream, length * sizeof(int));
+  qsort(sorted, length, sizeof(int), int_cmp);
+  *distinct = 0;
+  for(int i = 0, j; i < length; i = j)
+  {
+    for(j = i+1; j < length && sorted[j] == sorted[i]; j++);
+    sum_flogf += (j - i) * log(j - i);
+    (*distinct)++;
+  }
+  free(sorted);
+  return (log(length) - sum_flogf/length) / log(2);
+}
+
+static long Now_Usec()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000000L + tv.tv_usec;
+}
+
+static int int_cmp(const void* p, const void* q)
+{
+  int a = *(const int*) p;
+  int b = *(const int*) q;
+  return (a==b) ? 0 : (a<b) ? -1 : 1;
+}
+
+static int long_cmp(const void* p, const void* q)
+{
+  long a = *(const long*) p;
+  long b = *(const long*) q;
+  return (a==b) ? 0 : (a<b) ? -1 : 1;
+}
+
+static int double_cmp(const void* p, const void* q)
+{
+  double a = *(const double*) p;
+  double b = *(const double*) q;
+  return (a==b) ? 0 : (a<b) ? -1 : 1;
+}
@@ -0,0 +1,161 @@
+/*Harness for turnstile entropy (stable.c).
+ *
+ *Inserts a zipfian stream, then retracts each of its tokens again with
+ *probability q, in order: the net counts are those of the insertions
+ *that remain. The stream is dealt round-robin to s sketches, which are
+ *merged at the end. Compares the merged estimate with the exact entropy
+ *of the net counts, before and after the retractions, failing if it is
+ *off by more than 3 times the expected error 1.2/sqrt(k), and times
+ *updates against Estimator_Update on the insertions.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <unistd.h>
+#include <ctype.h>
+#include "massdal.h"
+#include "stablepub.h"
+#include "entropypub.h"
+#include "prng.h"
+#include "util.h"
+
+#define LENGTH_DEFAULT 1000000
+#define RANGE_DEFAULT 99999
+#define K_DEFAULT 512
+#define SEED_DEFAULT 1234
+#define SHARDS_DEFAULT 4
+
+static int* CreateStream(int length, double zipfpar, int range);
+static double Exact_Entropy(long* counts, int range);
+
+int main(int argc, char **argv) 
+{
+  int length = LENGTH_DEFAULT, range = RANGE_DEFAULT, k = K_DEFAULT;
+  int shards = SHARDS_DEFAULT, next, failed = 0;
+  long seed = SEED_DEFAULT;
+  double zipfparam = 1.1, q = 0.5;
+  
+  while ((next = getopt (argc, argv, "z:l:r:k:q:s:S:")) != -1)
+  {     
+	switch (next)
+	{
+	  case 'z': zipfparam = strtod(optarg, (char **) NULL); break;
+	  case 'l': length = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'r': range = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'k': k = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'q': q = strtod(optarg, (char **) NULL); break;
+	  case 's': shards = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'S': seed = strtol(optarg, (char **)NULL, 10); break;
+   	  case '?':
+	   if (isprint (optopt))
+		fprintf (stderr, "Unknown option or required argument not provided `-%c'.\n", optopt);
+		else
+		 fprintf (stderr, "Unknown option character `\\x%x'.\n",
+                        optopt);
+		exit(1);
+		break;
+	 default:
+	   abort();
+    }
+  }
+  if(length <= 0 || range <= 0 || k <= 0 || shards <= 0 || q < 0 || q >= 1 ||
+     zipfparam < 0)
+  {
+    fprintf(stderr, "invalid arguments\n");
+	exit(1);
+  }
+
+  int* stream = CreateStream(length, zipfparam, range);
+  long* counts = (long*) calloc(range+2, sizeof(long));
+  Stable_Estimator_type** sk = (Stable_Estimator_type**) safe_malloc(shards * sizeof(Stable_Estimator_type*));
+  double exact, est, bound = 3 * 1.2 / sqrt(k);
+  long ms;
+
+  for(int s = 0; s < shards; s++)
+    sk[s] = Stable_Estimator_Init(k, seed);
+  StartTheClock();
+  for(int i = 0; i < length; i++)
+    Stable_Estimator_Update(sk[i % shards], stream[i], 1);
+  ms = StopTheClock();
+  for(int i = 0; i < length; i++) counts[stream[i]]++;
+  exact = Exact_Entropy(counts, range);
+
+  //a merged copy for the insertions alone, leaving the shards to go on
+  Stable_Estimator_type* merged = Stable_Estimator_Init(k, seed);
+  for(int s = 0; s < shards; s++)
+    if(Stable_Estimator_Merge(merged, sk[s]) != 0) fatal("can't merge shard %d", s);
+  est = Stable_Estimator_end_stream(merged);
+  Stable_Estimator_Destroy(merged);
+  printf("k %d, %d shards, %d bytes each, %s kernel\n", k, shards, Stable_Estimator_Size(sk[0]),
+         Stable_Estimator_Kernel(sk[0]));
+  printf("inserted %d: exact entropy %f, merged estimate %f%s\n", length, exact, est,
+         fabs(est - exact) > bound ? ", OFF BY MORE THAN EXPECTED" : "");
+  failed |= fabs(est - exact) > bound;
+  printf("insertions took %ld ms\n", ms);
+
+  //retract tokens, each shard taking whichever it is dealt
+  prng_type* prng = prng_Init(4242, 2);
+  long retracted = 0;
+  for(int i = 0; i < length; i++)
+  {
+    if((prng_int(prng) & MOD) < q * MOD)
+    {
+      Stable_Estimator_Update(sk[retracted % shards], stream[i], -1);
+      counts[stream[i]]--;
+      retracted++;
+    }
+  }
+  prng_Destroy(prng);
+  exact = Exact_Entropy(counts, range);
+  for(int s = 1; s < shards; s++)
+    if(Stable_Estimator_Merge(sk[0], sk[s]) != 0) fatal("can't merge shard %d", s);
+  est = Stable_Estimator_end_stream(sk[0]);
+  printf("retracted %ld: exact entropy %f, merged estimate %f%s\n", retracted, exact, est,
+         fabs(est - exact) > bound ? ", OFF BY MORE THAN EXPECTED" : "");
+  failed |= fabs(est - exact) > bound;
+
+  Estimator_type* est_full = Estimator_Init(ceil(16 * 4 * log(20) * log(length * M_E)), 14);
+  StartTheClock();
+  for(int i = 0; i < length; i++)
+    Estimator_Update(est_full, stream[i]);
+  ms = StopTheClock();
+  printf("Estimator_Update took %ld ms\n", ms);
+  Estimator_Destroy(est_full);
+
+  for(int s = 0; s < shards; s++)
+    Stable_Estimator_Destroy(sk[s]);
+  free(sk);
+  free(counts);
+  free(stream);
+  return failed;
+}
+
+/******************************************************************/
+//Creates and returns stream of ints in range [1, range+1], zipfian
+//with zipfpar
+static int* CreateStream(int length, double zipfpar, int range)
+{
+  float zet;
+  int* stream;
+  prng_type * prng;
+  
+  stream=(int *) safe_malloc(length * sizeof(int));
+  prng=prng_Init(44545,2);
+  zet=zeta(length,zipfpar);
+  for (int i=0;i<length;i++) 
+	stream[i]=(int) floor(fastzipf(zipfpar,range,zet,prng));
+  prng_Destroy(prng);
+  return(stream);
+}
+
+static double Exact_Entropy(long* counts, int range)
+{
+  double m = 0, sum_flogf = 0;
+  for(int t = 0; t <= range+1; t++)
+  {
+    m += counts[t];
+    if(counts[t] > 0) sum_flogf += counts[t] * log2(counts[t]);
+  }
+  return m > 0 ? log2(m) - sum_flogf/m : 0;
+}
@@ -0,0 +1,190 @@
+/*Harness for sliding-window entropy (window.c).
+ *
+ *Feeds a synthetic stream, alternating between segments with two zipf
+ *parameters, into a window of the last width tokens or, with -t, of
+ *the last width time units at rate tokens per unit. With -j times are
+ *jittered by up to that many units, so tokens arrive out of order; the
+ *window tolerates lateness up to the jitter.
+ *
+ *At evenly spaced points after the first window has filled it compares
+ *the windowed estimate with the exact entropy of the window, and it
+ *times updates against Estimator_Update on the same stream.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <unistd.h>
+#include <ctype.h>
+#include "massdal.h"
+#include "window.h"
+#include "entropypub.h"
+#include "prng.h"
+#include "util.h"
+
+#define LENGTH_DEFAULT 4000000
+#define RANGE_DEFAULT 99999
+#define WIDTH_DEFAULT 500000
+#define RATE_DEFAULT 1000
+#define SEGMENTS_DEFAULT 20
+#define CHECKS_DEFAULT 40
+
+static int* CreateStream(int length, double zipfpar, double zipfpar2, int range,
+                         int segments);
+
+int main(int argc, char **argv) 
+{
+  int length = LENGTH_DEFAULT, range = RANGE_DEFAULT, c = 0, k = 0;
+  int rate = RATE_DEFAULT, segments = SEGMENTS_DEFAULT, checks = CHECKS_DEFAULT;
+  int by_time = 0, next;
+  long width = WIDTH_DEFAULT, jitter = 0;
+  double zipfparam = 1.1, zipfparam2 = 0.6, eps = .5, delta = .1;
+  
+  while ((next = getopt (argc, argv, "z:Z:l:r:e:d:c:k:W:tT:j:S:q:")) != -1)
+  {     
+	switch (next)
+	{
+	  case 'z': zipfparam = strtod(optarg, (char **) NULL); break;
+	  case 'Z': zipfparam2 = strtod(optarg, (char **) NULL); break;
+	  case 'l': length = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'r': range = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'e': eps = strtod(optarg, (char **) NULL); break;
+	  case 'd': delta = strtod(optarg, (char **) NULL); break;
+	  case 'c': c = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'k': k = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'W': width = strtol(optarg, (char **)NULL, 10); break;
+	  case 't': by_time = 1; break;
+	  case 'T': rate = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'j': jitter = strtol(optarg, (char **)NULL, 10); break;
+	  case 'S': segments = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'q': checks = (int)strtol(optarg, (char **)NULL, 10); break;
+   	  case '?':
+	   if (isprint (optopt))
+		fprintf (stderr, "Unknown option or required argument not provided `-%c'.\n", optopt);
+		else
+		 fprintf (stderr, "Unknown option character `\\x%x'.\n",
+                        optopt);
+		exit(1);
+		break;
+	 default:
+	   abort();
+    }
+  }
+  if(by_time && width == WIDTH_DEFAULT)
+    width = 500;
+  if(length <= 0 || range <= 0 || rate <= 0 || width <= 0 || jitter < 0 ||
+     segments <= 0 || checks <= 0 || zipfparam < 0 || zipfparam2 < 0 ||
+     eps <= 0 || eps > 1 || delta <= 0 || delta > 1)
+  {
+    fprintf(stderr, "invalid arguments\n");
+	exit(1);
+  }
+  if(c <= 0)
+	c = ceil(16 * 1/(eps*eps) * log(2/delta) * log(length * M_E));
+  if(k <= 0)
+	k = ceil(7/eps);
+
+  int* stream = CreateStream(length, zipfparam, zipfparam2, range, segments);
+  long* times = (long*) safe_malloc(length * sizeof(long));
+  long now = 0;
+  prng_type* prng = prng_Init(4242, 2);
+  //times as the window will see them: late tokens are at most jitter old
+  for(int i = 0; i < length; i++)
+  {
+    times[i] = i / rate;
+    if(jitter > 0)
+      times[i] -= (prng_int(prng) & MOD) % (jitter+1);
+    if(i == 0 || times[i] > now) now = times[i];
+    else if(times[i] < now - jitter) times[i] = now - jitter;
+  }
+  prng_Destroy(prng);
+
+  Window_type* w = Window_Init(c, k, width, by_time, jitter);
+  int* counts = (int*) calloc(range+2, sizeof(int));
+  long first = by_time ? (width + jitter) * rate : width, size, max_size = 0;
+  long check = first, step = (length - first) / checks, ms = 0;
+  double est, exact, err, sum_err = 0, max_err = 0;
+  int done = 0;
+
+  if(step < 1) step = 1;
+  StartTheClock();
+  for(int i = 0; i < length; i++)
+  {
+    Window_Update(w, times[i], stream[i]);
+    if(i+1 < check && i+1 < length) continue;
+    ms += StopTheClock();
+    if(i+1 < check)
+      break;
+    check += step;
+
+    //exact entropy of the tokens in the window
+    long from = by_time ? w->now - width + 1 : i+1 - width;
+    long lo = by_time ? (long) i - (width + 2*jitter + 1) * rate : i+1 - width;
+    double m = 0, sum_flogf = 0;
+    if(lo < 0) lo = 0;
+    for(long j = lo; j <= i; j++)
+      if(!by_time || times[j] >= from) { counts[stream[j]]++; m++; }
+    for(long j = lo; j <= i; j++)
+    {
+      if(counts[stream[j]] > 0)
+      {
+        sum_flogf += counts[stream[j]] * log(counts[stream[j]]);
+        counts[stream[j]] = 0;
+      }
+    }
+    exact = (log(m) - sum_flogf/m) / log(2);
+    est = Window_Estimate(w);
+    err = fabs(est - exact);
+    sum_err += err;
+    if(err > max_err) max_err = err;
+    size = Window_Size(w);
+    if(size > max_size) max_size = size;
+    done++;
+    StartTheClock();
+  }
+  printf("window of %ld %s, c %d, k %d\n", width, by_time ? "time units" : "tokens", c, k);
+  if(done > 0)
+    printf("%d checks: mean error %f, max error %f, at most %ld bytes\n", done,
+           sum_err/done, max_err, max_size);
+  printf("window updates took %ld ms\n", ms);
+
+  //the whole-stream estimator on the same stream, for comparison
+  Estimator_type* est_full = Estimator_Init(c, k);
+  StartTheClock();
+  for(int i = 0; i < length; i++)
+    Estimator_Update(est_full, stream[i]);
+  ms = StopTheClock();
+  printf("Estimator_Update took %ld ms\n", ms);
+  Estimator_Destroy(est_full);
+
+  Window_Destroy(w);
+  free(counts);
+  free(times);
+  free(stream);
+  return 0;
+}
+
+/******************************************************************/
+//Creates and returns stream of ints in range [1, range+1], in segments
+//that alternate between zipfian distributions with zipfpar and zipfpar2
+static int* CreateStream(int length, double zipfpar, double zipfpar2, int range,
+                         int segments)
+{
+  float zet, zet2;
+  int* stream;
+  prng_type * prng;
+  
+  stream=(int *) safe_malloc(length * sizeof(int));
+  prng=prng_Init(44545,2);
+  zet=zeta(length,zipfpar);
+  zet2=zeta(length,zipfpar2);
+  for (int i=0;i<length;i++) 
+  {
+    if (((long) i * segments / length) % 2 == 0)
+	  stream[i]=(int) floor(fastzipf(zipfpar,range,zet,prng));
+    else
+	  stream[i]=(int) floor(fastzipf(zipfpar2,range,zet2,prng));
+  }
+  prng_Destroy(prng);
+  return(stream);
+}
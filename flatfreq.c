@@ -0,0 +1,107 @@
+/*************************************************************************/
+/* flatfreq.c -- Misra-Gries counters in a flat, relocatable block       */
+/*************************************************************************/
+
+#include <string.h>
+#include "flatfreq.h"
+#include "prng.h"
+
+//ints in the block for k counters: used, k items, k counts and a
+//2k slot index
+long FlatFreq_Ints(int k)
+{
+  return 1 + 2L*k + 2L*k;
+}
+
+//point f at the block mem. The block holds only the counters, so the
+//same block can be attached at any address
+void FlatFreq_Attach(flatfreq_type* f, int k, long long a, long long b, int* mem)
+{
+  f->k = k;
+  f->tblsz = 2*k;
+  f->a = a;
+  f->b = b;
+  f->used = mem;
+  f->items = mem + 1;
+  f->counts = mem + 1 + k;
+  f->index = mem + 1 + 2*k;
+}
+
+void FlatFreq_Reset(flatfreq_type* f)
+{
+  memset(f->used, 0, FlatFreq_Ints(f->k) * sizeof(int));
+}
+
+//index slot holding item, or the empty slot where it would go
+static int flatfreq_slot(flatfreq_type* f, int item)
+{
+  int i = hash31(f->a, f->b, item) % f->tblsz;
+  while(f->index[i] != 0 && f->items[f->index[i]-1] != item)
+    i = (i + 1) % f->tblsz;
+  return i;
+}
+
+//drop the counters that reached zero, keeping the live ones at the
+//front, and rebuild the index. Only runs after a decrement, which
+//touches every counter anyway
+static void flatfreq_compact(flatfreq_type* f)
+{
+  int n = 0;
+  for(int j = 0; j < *f->used; j++)
+  {
+    if(f->counts[j] > 0)
+    {
+      f->items[n] = f->items[j];
+      f->counts[n] = f->counts[j];
+      n++;
+    }
+  }
+  *f->used = n;
+  memset(f->index, 0, f->tblsz * sizeof(int));
+  for(int j = 0; j < n; j++)
+    f->index[flatfreq_slot(f, f->items[j])] = j+1;
+}
+
+void FlatFreq_Update(flatfreq_type* f, int item)
+{
+  int i, j;
+
+  if(item > 0)
+  {
+    i = flatfreq_slot(f, item);
+    if(f->index[i] != 0)
+      f->counts[f->index[i]-1]++;
+    else if(*f->used < f->k)
+    {
+      j = (*f->used)++;
+      f->items[j] = item;
+      f->counts[j] = 1;
+      f->index[i] = j+1;
+    }
+    else
+    {
+      for(j = 0; j < f->k; j++)
+        f->counts[j]--;
+      flatfreq_compact(f);
+    }
+  }
+  else if(item < 0)
+  {
+    //delete an item that isnt there, ignore it
+    i = flatfreq_slot(f, -item);
+    if(f->index[i] != 0 && --f->counts[f->index[i]-1] == 0)
+      flatfreq_compact(f);
+  }
+}
+
+void FlatFreq_Max(flatfreq_type* f, int* max_token, int* max_count)
+{
+  for(int j = 0; j < *f->used; j++)
+  {
+    if(f->counts[j] > *max_count)
+    {
+      *max_count = f->counts[j];
+      *max_token = f->items[j];
+    }
+  }
+}
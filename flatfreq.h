@@ -0,0 +1,28 @@
+/*************************************************************************/
+/* flatfreq.h                                                            */
+/*************************************************************************/
+
+#ifndef FLATFREQ_H
+#define FLATFREQ_H
+
+//Misra-Gries with k counters kept in one flat block of ints supplied
+//by the caller, with no pointers inside it, so the block can live in a
+//file mapping and be used again from another process. Counts match
+//frequent.c: an unmonitored token takes a free counter, or decrements
+//every counter when all k are in use; negative tokens are deletions
+typedef struct flatfreq_type{
+  int k, tblsz;
+  long long a, b;
+  int* used;     //counters in use; live counters are [0, *used)
+  int* items;
+  int* counts;
+  int* index;    //open addressing: counter+1 for a token, 0 if empty
+} flatfreq_type;
+
+extern long FlatFreq_Ints(int k);
+extern void FlatFreq_Attach(flatfreq_type* f, int k, long long a, long long b, int* mem);
+extern void FlatFreq_Reset(flatfreq_type* f);
+extern void FlatFreq_Update(flatfreq_type* f, int item);
+extern void FlatFreq_Max(flatfreq_type* f, int* max_token, int* max_count);
+
+#endif
@@ -17,7 +17,8 @@ to Creative Commons, 559 Nathan Abbott Way, Stanford, California
 
 Code modified by Justin Thaler during July 2007. The modification
 consists of the addition of the function SaveMax for use in streaming
-entropy calculation.
+entropy calculation. Freq_Counts, Freq_Serialize and Freq_Deserialize
+were added later.
 *********************************************************************/
 #include <stdlib.h>
 #include <stdio.h>
@@ -113,6 +114,52 @@ void SaveMax(freq_type* freq, int* max_token, int* max_count)
   *max_token=g->items->item;
 }
 
+//saves up to max of the items retained by Misra-Gries alg in items,
+//with their counts in counts, most frequent first. Returns number saved
+int Freq_Counts(freq_type* freq, int* items, int* counts, int max)
+{
+  GROUP *g;
+  ITEMLIST *i,*first;
+  int count=0, n=0, total=0, skip, tmp;
+
+  // groups are kept in increasing order of count, so skip all but
+  // the last max items and then reverse
+  for (g=freq->groups->nextg; g!=NULL; g=g->nextg)
+    {
+      i=g->items;
+      if (i!=NULL)
+	do { total++; i=i->nexting; } while (i!=g->items);
+    }
+  skip=(total > max) ? total-max : 0;
+
+  g=freq->groups->nextg;
+  while (g!=NULL) 
+    {
+      count=count+g->diff;
+      first=g->items;
+      i=first;
+      if (i!=NULL)
+	do 
+	  {
+	    if (skip > 0) skip--;
+	    else
+	      {
+		items[n]=i->item;
+		counts[n]=count;
+		n++;
+	      }
+	    i=i->nexting;
+	  }
+	while (i!=first);
+      g=g->nextg;
+    }
+  for (int j=0; j<n/2; j++)
+    {
+      tmp=items[j]; items[j]=items[n-1-j]; items[n-1-j]=tmp;
+      tmp=counts[j]; counts[j]=counts[n-1-j]; counts[n-1-j]=tmp;
+    }
+  return n;
+}
 
 ITEMLIST * GetNewCounter(freq_type * freq)
 {
@@ -495,9 +542,224 @@ int Freq_Size(freq_type * freq)
   return size;
 
 }
+// what Freq_Size reports for the counters Freq_Init(phi) makes,
+// without making them
+int Freq_Size_Phi(float phi)
+{
+  int k=(int) ceil(1.0/phi);
+  if (k<1) k=1;
+  return 2*(2*k)*sizeof(ITEMLIST) + (k + 1)*sizeof(ITEMLIST) +
+    k*sizeof(GROUP);
+}
+
 void Freq_Destroy(freq_type * freq)
 {
   // placeholder implementation: need to go through and free 
   // all memory associated with the data structure explicitly
   free (freq);
 }  
+
+// write the counters: the pool of zero counters, then each group with
+// its difference from the previous group. Items are written in the
+// order of their circular lists, since that order decides which
+// counter is recycled next and which item SaveMax reports
+void Freq_Serialize(freq_type* freq, serial_buf* b)
+{
+  GROUP *g;
+  ITEMLIST *i;
+  int n;
+
+  Serial_Put_Header(b, SERIAL_FREQ);
+  Serial_Put_Int(b, freq->k);
+  Serial_Put_Int(b, freq->tblsz);
+  Serial_Put_Long(b, freq->a);
+  Serial_Put_Long(b, freq->b);
+
+  for (g=freq->groups, n=0; g!=NULL; g=g->nextg) n++;
+  Serial_Put_Int(b, n);
+  for (g=freq->groups; g!=NULL; g=g->nextg)
+    {
+      Serial_Put_Int(b, g->diff);
+      n=0;
+      i=g->items;
+      if (i!=NULL)
+	do { n++; i=i->nexting; } while (i!=g->items);
+      Serial_Put_Int(b, n);
+      i=g->items;
+      if (i!=NULL)
+	do
+	  {
+	    Serial_Put_Int(b, i->item);
+	    i=i->nexting;
+	  }
+	while (i!=g->items);
+    }
+}
+
+// append il to the end of g's circular list of items
+static void AppendToGroup(GROUP *g, ITEMLIST *il)
+{
+  il->parentg=g;
+  if (g->items==NULL)
+    {
+      g->items=il;
+      il->nexting=il->previousing=il;
+      return;
+    }
+  il->nexting=g->items;
+  il->previousing=g->items->previousing;
+  il->previousing->nexting=il;
+  g->items->previousing=il;
+}
+
+// rebuild counters written by Freq_Serialize. Zero counters of items
+// that were dropped from the first group keep their hashtable entries,
+// as they do in Freq_Update. Returns NULL and sets r->error if the
+// image is malformed
+freq_type* Freq_Deserialize(serial_reader* r)
+{
+  freq_type *result;
+  GROUP *g, *prevg, **groups;
+  ITEMLIST *il, **items;
+  int ngroups, n, item, nitems=0, j;
+
+  if (!Serial_Get_Header(r, SERIAL_FREQ)) return NULL;
+  result=calloc(1,sizeof(freq_type));
+  result->k=Serial_Get_Int(r);
+  result->tblsz=Serial_Get_Int(r);
+  result->a=Serial_Get_Long(r);
+  result->b=Serial_Get_Long(r);
+  ngroups=Serial_Get_Int(r);
+  if (r->error || result->k < 1 || result->tblsz < 1 ||
+      ngroups < 1 || ngroups > result->k+1 ||
+      !Serial_Check_Count(r, result->k+1, 4))
+    {
+      r->error=1;
+      free(result);
+      return NULL;
+    }
+  result->hashtable=calloc(result->tblsz+2,sizeof(ITEMLIST *));
+  groups=calloc(ngroups,sizeof(GROUP *));
+  items=calloc(result->k+1,sizeof(ITEMLIST *));
+
+  prevg=NULL;
+  for (int gi=0; gi<ngroups && !r->error; gi++)
+    {
+      g=malloc(sizeof(GROUP));
+      groups[gi]=g;
+      g->diff=Serial_Get_Int(r);
+      g->items=NULL;
+      g->previousg=prevg;
+      g->nextg=NULL;
+      if (prevg!=NULL) prevg->nextg=g;
+      prevg=g;
+      n=Serial_Get_Int(r);
+      // every group has at least one item; the pool has diff 0 (so
+      // can other groups, after deletions)
+      if ((gi==0 && g->diff!=0) || g->diff < 0 ||
+	  n < 1 || n > result->k+1-nitems)
+	{
+	  r->error=1;
+	  break;
+	}
+      for (int x=0; x<n; x++)
+	{
+	  item=Serial_Get_Int(r);
+	  il=malloc(sizeof(ITEMLIST));
+	  items[nitems++]=il;
+	  il->item=item;
+	  il->nexti=il->previousi=NULL;
+	  AppendToGroup(g,il);
+	  if (item < 0 || (gi > 0 && item == 0))
+	    {
+	      r->error=1;
+	      break;
+	    }
+	  if (item==0) continue;
+	  // each tracked item may appear only once
+	  j=hash31(result->a,result->b,item) % result->tblsz;
+	  for (ITEMLIST *c=result->hashtable[j]; c!=NULL; c=c->nexti)
+	    if (c->item==item) r->error=1;
+	  if (r->error) break;
+	  InsertIntoHashtable(result,il,j,item);
+	}
+    }
+  if (nitems != result->k+1) r->error=1;
+  if (r->error)
+    {
+      for (j=0; j<nitems; j++) free(items[j]);
+      for (j=0; j<ngroups; j++) free(groups[j]);
+      free(items);
+      free(groups);
+      free(result->hashtable);
+      free(result);
+      return NULL;
+    }
+  result->groups=groups[0];
+  free(items);
+  free(groups);
+  return(result);
+}
+
+static int CountCmp(const void *p, const void *q)
+{
+  int a=((const int *) p)[1], b=((const int *) q)[1];
+  return (a==b) ? 0 : (a<b) ? -1 : 1;
+}
+
+// counters as Freq_Init(phi) makes them, then fed the n distinct
+// items with their counts, all at once. The k largest counts
+// are kept exactly: every dropped item has a count no larger than
+// they are, so at most m/(k+1), within the usual Misra-Gries bound.
+// Used to move from exact counting to the sketch mid-stream
+freq_type* Freq_From_Counts(float phi, const int* items, const int* counts, int n)
+{
+  freq_type *proto=Freq_Init(phi), *result;
+  serial_buf b;
+  serial_reader r;
+  int k=proto->k, keep, *pairs, prev=0, ngroups=1, npairs=0;
+
+  // (item, count) pairs by increasing count; keep the last k. Items
+  // that are not positive are left out, as Freq_Update never counts them
+  pairs=malloc(2*(n+1)*sizeof(int));
+  for (int i=0; i<n; i++)
+    if (items[i]>0)
+      {
+	pairs[2*npairs]=items[i];
+	pairs[2*npairs+1]=counts[i];
+	npairs++;
+      }
+  qsort(pairs, npairs, 2*sizeof(int), CountCmp);
+  keep=(npairs < k) ? npairs : k;
+  pairs+=2*(npairs-keep);
+  for (int i=0; i<keep; i++)
+    if (i==0 || pairs[2*i+1]!=pairs[2*i-1]) ngroups++;
+
+  // written as Freq_Serialize would write them, and read back
+  Serial_Init(&b);
+  Serial_Put_Header(&b, SERIAL_FREQ);
+  Serial_Put_Int(&b, k);
+  Serial_Put_Int(&b, proto->tblsz);
+  Serial_Put_Long(&b, proto->a);
+  Serial_Put_Long(&b, proto->b);
+  Serial_Put_Int(&b, ngroups);
+  Serial_Put_Int(&b, 0);
+  Serial_Put_Int(&b, k+1-keep);
+  for (int i=0; i<k+1-keep; i++)
+    Serial_Put_Int(&b, 0);
+  for (int i=0, j; i<keep; i=j)
+    {
+      for (j=i; j<keep && pairs[2*j+1]==pairs[2*i+1]; j++);
+      Serial_Put_Int(&b, pairs[2*i+1]-prev);
+      Serial_Put_Int(&b, j-i);
+      for (int x=i; x<j; x++)
+	Serial_Put_Int(&b, pairs[2*x]);
+      prev=pairs[2*i+1];
+    }
+  Serial_Reader_Init(&r, b.data, b.len);
+  result=Freq_Deserialize(&r);
+  free(pairs-2*(npairs-keep));
+  Serial_Free(&b);
+  Freq_Destroy(proto);
+  return(result);
+}
@@ -1,6 +1,11 @@
 //frequent.h -- simple frequent items routine
 // see Misra&Gries 1982, Demaine et al 2002, Karp et al 2003
 // implemented by Graham Cormode, 2002,2003
+#include "serial.h"
+
+#ifndef FREQUENT_H
+#define FREQUENT_H
+
 typedef struct itemlist ITEMLIST;
 typedef struct group GROUP;
 
@@ -34,5 +39,12 @@ extern freq_type * Freq_Init(float);
 extern void Freq_Destroy(freq_type *);
 extern void Freq_Update(freq_type *, int);
 extern int Freq_Size(freq_type *);
+extern int Freq_Size_Phi(float);
 extern unsigned int * Freq_Output(freq_type *,int);
 extern void SaveMax(freq_type* freq, int*, int*);
+extern int Freq_Counts(freq_type* freq, int* items, int* counts, int max);
+extern void Freq_Serialize(freq_type* freq, serial_buf* b);
+extern freq_type* Freq_Deserialize(serial_reader* r);
+extern freq_type* Freq_From_Counts(float phi, const int* items, const int* counts, int n);
+
+#endif
@@ -0,0 +1,388 @@
+/*group.c
+ *Entropy of the tokens of every group at once, e.g. of the destination
+ *ports of each source address, for hundreds of thousands of groups.
+ *
+ *A group starts as one small record counting up to GROUP_INLINE
+ *distinct tokens exactly, which is all most groups ever need, and its
+ *entropy is then exact. A group that sees more distinct tokens takes a
+ *block from a shared pool holding the slow estimator's samplers as
+ *lanes (lanes.h) and flatfreq Misra-Gries counters, replays its counts
+ *into them and goes on as a slow estimator would, with the same SIMD
+ *kernel. Records, blocks and the generator seeding the samplers are
+ *shared by all groups.
+ *
+ *Groups are kept in order of their last update. When the bytes in use
+ *pass the budget the least recently updated groups are evicted, and a
+ *group seen again after eviction starts over. Tokens must not be
+ *negative, as for flatfreq.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include "grouppriv.h"
+#include "heap.h"
+#include "prng.h"
+#include "util.h"
+
+//c samplers and k Misra-Gries counters for each sampled group, and at
+//most budget bytes for all groups
+Group_Estimator_type* Group_Estimator_Init(int c, int k, long budget)
+{
+  Group_Estimator_type* est = (Group_Estimator_type*) safe_malloc(sizeof(Group_Estimator_type));
+  prng_type* prng;
+
+  est->c = c;
+  est->k = k;
+  est->padded_c = (c + SLOW_LANES - 1) / SLOW_LANES * SLOW_LANES;
+  est->budget = budget;
+  est->kernel = Slow_Select_Kernel(&est->kernel_name);
+
+  prng = prng_Init(lrand48(), 2);
+  est->rng = ((unsigned long long) prng_int(prng) << 32 ^ prng_int(prng)) | 1;
+  est->a = prng_int(prng) & MOD;
+  est->b = prng_int(prng) & MOD;
+  prng_Destroy(prng);
+
+  est->maxrecs = 1024;
+  est->recs = (group_rec*) safe_malloc(est->maxrecs * sizeof(group_rec));
+  est->nrecs = 0;
+  est->free_rec = -1;
+  est->bits = 10;
+  est->buckets = (int*) safe_malloc((1 << est->bits) * sizeof(int));
+  for(int i = 0; i < (1 << est->bits); i++)
+    est->buckets[i] = -1;
+  est->ngroups = 0;
+  est->lru_head = est->lru_tail = -1;
+
+  //lanes padded to a cache line, then the counters
+  est->block_ints = 7 * est->padded_c + (FlatFreq_Ints(k) + 15) / 16 * 16;
+  est->chunks = NULL;
+  est->nchunks = est->nblocks = est->nfree = 0;
+  est->free_blocks = NULL;
+
+  est->bytes = sizeof(Group_Estimator_type) + (1 << est->bits) * sizeof(int);
+  return est;
+}
+
+void Group_Estimator_Destroy(Group_Estimator_type* est)
+{
+  for(int i = 0; i < est->nchunks; i++)
+    free(est->chunks[i]);
+  free(est->chunks);
+  free(est->free_blocks);
+  free(est->buckets);
+  free(est->recs);
+  free(est);
+}
+
+//bytes held by live groups and the table, which is what the budget
+//limits. Freed records and blocks stay in the pools for reuse
+long Group_Estimator_Size(Group_Estimator_type* est)
+{
+  return est->bytes;
+}
+
+int Group_Estimator_Groups(Group_Estimator_type* est)
+{
+  return est->ngroups;
+}
+
+void Group_Estimator_Update(Group_Estimator_type* est, int group, int token)
+{
+  group_rec* rec;
+  Sample_lanes lanes;
+  flatfreq_type freq;
+  int g = group_find(est, group);
+
+  if(g < 0)
+    g = group_add(est, group);
+  else if(g != est->lru_head)
+  {
+    group_unlink(est, g);
+    group_push_front(est, g);
+  }
+  rec = &est->recs[g];
+  rec->count++;
+  if(rec->ninline >= 0)
+  {
+    for(int i = 0; i < rec->ninline; i++)
+    {
+      if(rec->tokens[i] == token)
+      {
+        rec->counts[i]++;
+        return;
+      }
+    }
+    if(rec->ninline < GROUP_INLINE)
+    {
+      rec->tokens[rec->ninline] = token;
+      rec->counts[rec->ninline++] = 1;
+      return;
+    }
+    group_promote(est, g);
+    rec = &est->recs[g];
+  }
+  group_lanes(est, rec->block, &lanes, &freq);
+  FlatFreq_Update(&freq, token);
+  est->kernel(&lanes, 0, est->padded_c, token);
+}
+
+//estimated entropy of group's tokens, or -1 if the group has not been
+//seen or was evicted
+double Group_Estimator_Entropy(Group_Estimator_type* est, int group)
+{
+  int g = group_find(est, group);
+  return g < 0 ? -1 : group_entropy(est, &est->recs[g]);
+}
+
+//the at most n groups of at least min_count tokens with the largest
+//entropy, largest first. Returns how many were found
+int Group_Estimator_Top(Group_Estimator_type* est, int n, int min_count,
+                        int* groups, double* entropies)
+{
+  group_rank* ranks;
+  group_rank* r;
+  heap* top;
+  double h;
+  int found;
+
+  if(n <= 0)
+    return 0;
+  ranks = (group_rank*) safe_malloc(n * sizeof(group_rank));
+  top = new_heap(group_rank_comp, n+2);
+  found = 0;
+  for(int g = est->lru_head; g >= 0; g = est->recs[g].next)
+  {
+    if(est->recs[g].count < min_count)
+      continue;
+    h = group_entropy(est, &est->recs[g]);
+    //once n are held, a larger one takes the place of the smallest
+    if(found < n)
+      r = &ranks[found++];
+    else if(h > ((group_rank*) peek_min(top))->entropy)
+      r = (group_rank*) delete_min(top);
+    else
+      continue;
+    r->group = est->recs[g].id;
+    r->entropy = h;
+    insert_heap(top, r);
+  }
+  for(int i = found-1; i >= 0; i--)
+  {
+    r = (group_rank*) delete_min(top);
+    groups[i] = r->group;
+    entropies[i] = r->entropy;
+  }
+  free_heap(top);
+  free(ranks);
+  return found;
+}
+
+static int group_find(Group_Estimator_type* est, int group)
+{
+  int g = est->buckets[(unsigned int) group * 2654435769u >> (32 - est->bits)];
+  while(g >= 0 && est->recs[g].id != group)
+    g = est->recs[g].hnext;
+  return g;
+}
+
+//a record for a new group, made the most recent. May evict others to
+//stay within the budget
+static int group_add(Group_Estimator_type* est, int group)
+{
+  int g, bn;
+
+  while(est->bytes + (long) sizeof(group_rec) > est->budget && est->lru_tail >= 0)
+    group_evict(est, est->lru_tail);
+  if(est->free_rec >= 0)
+  {
+    g = est->free_rec;
+    est->free_rec = est->recs[g].hnext;
+  }
+  else
+  {
+    if(est->nrecs == est->maxrecs)
+    {
+      est->maxrecs *= 2;
+      est->recs = (group_rec*) safe_realloc(est->recs, est->maxrecs * sizeof(group_rec));
+    }
+    g = est->nrecs++;
+  }
+  est->recs[g].id = group;
+  est->recs[g].count = 0;
+  est->recs[g].ninline = 0;
+  est->recs[g].block = -1;
+  bn = (unsigned int) group * 2654435769u >> (32 - est->bits);
+  est->recs[g].hnext = est->buckets[bn];
+  est->buckets[bn] = g;
+  group_push_front(est, g);
+  est->ngroups++;
+  est->bytes += sizeof(group_rec);
+  if(est->ngroups > (1 << est->bits))
+    group_rehash(est);
+  return g;
+}
+
+static void group_unlink(Group_Estimator_type* est, int g)
+{
+  group_rec* rec = &est->recs[g];
+  if(rec->prev >= 0) est->recs[rec->prev].next = rec->next;
+  else est->lru_head = rec->next;
+  if(rec->next >= 0) est->recs[rec->next].prev = rec->prev;
+  else est->lru_tail = rec->prev;
+}
+
+static void group_push_front(Group_Estimator_type* est, int g)
+{
+  est->recs[g].prev = -1;
+  est->recs[g].next = est->lru_head;
+  if(est->lru_head >= 0) est->recs[est->lru_head].prev = g;
+  else est->lru_tail = g;
+  est->lru_head = g;
+}
+
+//forget group g, returning its record and block to the pools
+static void group_evict(Group_Estimator_type* est, int g)
+{
+  group_rec* rec = &est->recs[g];
+  int* p = &est->buckets[(unsigned int) rec->id * 2654435769u >> (32 - est->bits)];
+
+  while(*p != g)
+    p = &est->recs[*p].hnext;
+  *p = rec->hnext;
+  group_unlink(est, g);
+  if(rec->ninline < 0)
+  {
+    est->free_blocks[est->nfree++] = rec->block;
+    est->bytes -= est->block_ints * sizeof(int);
+  }
+  rec->hnext = est->free_rec;
+  est->free_rec = g;
+  est->ngroups--;
+  est->bytes -= sizeof(group_rec);
+}
+
+//double the buckets, once there are more groups than buckets
+static void group_rehash(Group_Estimator_type* est)
+{
+  int bn;
+
+  est->bytes += (1 << est->bits) * sizeof(int);
+  est->bits++;
+  est->buckets = (int*) safe_realloc(est->buckets, (1 << est->bits) * sizeof(int));
+  for(int i = 0; i < (1 << est->bits); i++)
+    est->buckets[i] = -1;
+  for(int g = est->lru_head; g >= 0; g = est->recs[g].next)
+  {
+    bn = (unsigned int) est->recs[g].id * 2654435769u >> (32 - est->bits);
+    est->recs[g].hnext = est->buckets[bn];
+    est->buckets[bn] = g;
+  }
+}
+
+//g has outgrown its inline counts: give it samplers and counters and
+//replay the counts into them
+static void group_promote(Group_Estimator_type* est, int g)
+{
+  Sample_lanes lanes;
+  flatfreq_type freq;
+  group_rec* rec;
+  int block;
+
+  //make room, but never by evicting g itself
+  group_unlink(est, g);
+  while(est->bytes + est->block_ints * (long) sizeof(int) > est->budget && est->lru_tail >= 0)
+    group_evict(est, est->lru_tail);
+  group_push_front(est, g);
+
+  block = group_block_alloc(est);
+  est->bytes += est->block_ints * sizeof(int);
+  rec = &est->recs[g];
+  rec->block = block;
+  group_lanes(est, block, &lanes, &freq);
+  for(int i = 0; i < est->padded_c; i++)
+  {
+    lanes.s0[i] = lanes.s1[i] = 0;
+    lanes.r0[i] = lanes.r1[i] = 0;
+    lanes.t0[i] = lanes.t1[i] = INT_MAX;
+    lanes.rng[i] = group_rand(est) | 1; //xorshift needs nonzero state
+  }
+  FlatFreq_Reset(&freq);
+  for(int i = 0; i < rec->ninline; i++)
+  {
+    for(int j = 0; j < rec->counts[i]; j++)
+    {
+      FlatFreq_Update(&freq, rec->tokens[i]);
+      est->kernel(&lanes, 0, est->padded_c, rec->tokens[i]);
+    }
+  }
+  rec->ninline = -1;
+}
+
+static void group_lanes(Group_Estimator_type* est, int block, Sample_lanes* lanes,
+                        flatfreq_type* freq)
+{
+  int* mem = est->chunks[block / GROUP_CHUNK] + (long) (block % GROUP_CHUNK) * est->block_ints;
+  int n = est->padded_c;
+
+  lanes->s0 = mem;
+  lanes->t0 = mem + n;
+  lanes->r0 = (unsigned int*) (mem + 2*n);
+  lanes->s1 = mem + 3*n;
+  lanes->t1 = mem + 4*n;
+  lanes->r1 = (unsigned int*) (mem + 5*n);
+  lanes->rng = (unsigned int*) (mem + 6*n);
+  FlatFreq_Attach(freq, est->k, est->a, est->b, mem + 7*n);
+}
+
+//a free block, from the free list or a new chunk
+static int group_block_alloc(Group_Estimator_type* est)
+{
+  if(est->nfree > 0)
+    return est->free_blocks[--est->nfree];
+  if(est->nblocks == est->nchunks * GROUP_CHUNK)
+  {
+    est->chunks = (int**) safe_realloc(est->chunks, (est->nchunks+1) * sizeof(int*));
+    est->chunks[est->nchunks++] = (int*) safe_malloc((long) GROUP_CHUNK * est->block_ints * sizeof(int));
+    est->free_blocks = (int*) safe_realloc(est->free_blocks, est->nchunks * GROUP_CHUNK * sizeof(int));
+  }
+  return est->nblocks++;
+}
+
+static double group_entropy(Group_Estimator_type* est, group_rec* rec)
+{
+  Sample_lanes lanes;
+  flatfreq_type freq;
+  double sum_flogf = 0;
+  int max_token = INT_MIN, max_count = 0;
+
+  if(rec->count == 0)
+    return 0;
+  if(rec->ninline >= 0)
+  {
+    for(int i = 0; i < rec->ninline; i++)
+      sum_flogf += rec->counts[i] * log2(rec->counts[i]);
+    return log2(rec->count) - sum_flogf / rec->count;
+  }
+  group_lanes(est, rec->block, &lanes, &freq);
+  FlatFreq_Max(&freq, &max_token, &max_count);
+  return Slow_Lanes_Estimate(&lanes, est->c, rec->count, max_token, max_count);
+}
+
+//32 bits from xorshift64*
+static unsigned int group_rand(Group_Estimator_type* est)
+{
+  est->rng ^= est->rng >> 12;
+  est->rng ^= est->rng << 25;
+  est->rng ^= est->rng >> 27;
+  return (unsigned int) ((est->rng * 2685821657736338717ULL) >> 32);
+}
+
+static int group_rank_comp(void* a, void* b)
+{
+  double x = ((group_rank*) a)->entropy, y = ((group_rank*) b)->entropy;
+  return x < y ? -1 : x > y;
+}
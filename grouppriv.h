@@ -0,0 +1,64 @@
+#ifndef GROUPPRIV_H
+#define GROUPPRIV_H
+#include "grouppub.h"
+#include "lanes.h"
+#include "flatfreq.h"
+
+#define GROUP_INLINE 8       //distinct tokens a group counts exactly
+#define GROUP_CHUNK 64       //sampler blocks allocated at a time
+
+//one group. Until it has seen more than GROUP_INLINE distinct tokens
+//it counts them exactly in place; after that its samplers and
+//Misra-Gries counters are a block from the shared pool
+typedef struct group_rec{
+  int id, count;
+  int ninline;             //distinct tokens counted in place, -1 once sampled
+  int block;               //pool block, once sampled
+  int prev, next;          //recency list, most recent first
+  int hnext;               //hash chain, or free list
+  int tokens[GROUP_INLINE];
+  int counts[GROUP_INLINE];
+} group_rec;
+
+//a group and its entropy, for Group_Estimator_Top
+typedef struct group_rank{
+  int group;
+  double entropy;
+} group_rank;
+
+struct Group_Estimator_type{
+  int c, k, padded_c;
+  long budget, bytes;      //bytes in use may not pass budget
+  slow_kernel_fn kernel;   //as the slow estimator's
+  const char* kernel_name;
+  unsigned long long rng;  //seeds the samplers' generators
+  long long a, b;          //Misra-Gries hash
+
+  group_rec* recs;
+  int nrecs, maxrecs, free_rec;
+  int* buckets;            //hash of group ids to records
+  int bits, ngroups;
+  int lru_head, lru_tail;
+
+  //pool of sampler blocks of block_ints ints each
+  int** chunks;
+  int nchunks, block_ints, nblocks;
+  int* free_blocks;
+  int nfree;
+};
+
+static int group_find(Group_Estimator_type* est, int group);
+static int group_add(Group_Estimator_type* est, int group);
+static void group_unlink(Group_Estimator_type* est, int g);
+static void group_push_front(Group_Estimator_type* est, int g);
+static void group_evict(Group_Estimator_type* est, int g);
+static void group_rehash(Group_Estimator_type* est);
+static void group_promote(Group_Estimator_type* est, int g);
+static void group_lanes(Group_Estimator_type* est, int block, Sample_lanes* lanes,
+                        flatfreq_type* freq);
+static int group_block_alloc(Group_Estimator_type* est);
+static double group_entropy(Group_Estimator_type* est, group_rec* rec);
+static unsigned int group_rand(Group_Estimator_type* est);
+static int group_rank_comp(void* a, void* b);
+
+#endif
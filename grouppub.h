@@ -0,0 +1,15 @@
+#ifndef GROUPPUB_H
+#define GROUPPUB_H
+
+typedef struct Group_Estimator_type Group_Estimator_type;
+
+extern Group_Estimator_type* Group_Estimator_Init(int c, int k, long budget);
+extern void Group_Estimator_Destroy(Group_Estimator_type* est);
+extern long Group_Estimator_Size(Group_Estimator_type* est);
+extern int Group_Estimator_Groups(Group_Estimator_type* est);
+extern void Group_Estimator_Update(Group_Estimator_type* est, int group, int token);
+extern double Group_Estimator_Entropy(Group_Estimator_type* est, int group);
+extern int Group_Estimator_Top(Group_Estimator_type* est, int n, int min_count,
+                               int* groups, double* entropies);
+
+#endif
@@ -0,0 +1,33 @@
+/*************************************************************************/
+/* handoff.h                                                             */
+/*************************************************************************/
+
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+#include "prng.h"
+#include "frequent.h"
+
+//one sampler's state in a form every version of the algorithm can take
+//over. Its primary sample is the occurrence of token s0 holding the
+//least rank t0 in [0,1) of the stream so far, and r0 counts the
+//occurrences of s0 from there on; the backup (s1, r1, t1) is the same
+//among the positions holding other tokens, so t1 > t0. r0 is 0 before
+//the first token and r1 is 0 while the sampler has no backup
+typedef struct Sample_state{
+  int s0, s1;
+  int r0, r1;
+  double t0, t1;
+} Sample_state;
+
+//an estimator's samplers, its Misra-Gries counters and the generator
+//it draws from, taken out of one version to start another on the rest
+//of the same stream. The version taking it over owns prng and freq
+typedef struct Sampler_handoff{
+  int c, k, count;
+  prng_type* prng;
+  freq_type* freq;
+  Sample_state* samplers;
+} Sampler_handoff;
+
+#endif
@@ -6,7 +6,7 @@
  * found in the Downloads section of http://cs-www.cs.yale.edu/homes/fischer/
  
  * The only modification made to the original version from Professor Fischer
- * is the inclusion of the fuctions peek_min() and sizeof_heap()
+ * is the inclusion of the fuctions peek_min(), sizeof_heap() and load_heap()
  ***************************************************************************/
 
 #include <stdio.h>
@@ -63,6 +63,24 @@ int cur_size(heap* h)
   return h->cursize;
 }
 
+/* -------------------------------------------------------------------
+ * replace the contents of the heap with the n values, which must
+ * already be in heap order, keeping capacity for maxsize nodes.
+ * Used to restore a saved heap exactly, including the order of ties
+ * load_heap not included in original version of code
+ */
+void load_heap( heap* h, void** values, int n, int maxsize )
+{
+  if (maxsize <= n) maxsize = n+1;
+  if (maxsize != h->maxsize) {
+    h->maxsize = maxsize;
+    h->node = safe_realloc( h->node, h->maxsize * sizeof(void*) );
+  }
+  h->cursize = n;
+  for (int i = 0; i < n; i++)
+    h->node[ root+i ] = values[ i ];
+}
+
 /* -------------------------------------------------------------------
  * insert element at end of heap and fixup heap by walk towards root
  */
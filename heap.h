@@ -27,4 +27,5 @@ void map_heap( heap_fn, heap*, void* );
 void* peek_min(heap* h);
 int sizeof_heap(heap* h);
 int cur_size(heap* h);
+void load_heap( heap*, void** values, int n, int maxsize );
 #endif
@@ -0,0 +1,747 @@
+/* history.c
+ *Point-in-time entropy queries over a long stream.
+ *
+ *Tokens arrive with a time and are grouped into periods of a fixed
+ *length. When a period closes its state becomes a bucket: a bottom-c
+ *sample of its positions (each position gets a random tag and the c
+ *smallest are kept, with the count r of the position's token from there
+ *to the end of the period), the Misra-Gries counters, and the exact
+ *counts in the period of every token sampled by an older bucket, which
+ *the open period tracks. Consecutive buckets merge, so a query merges
+ *the buckets overlapping the requested range and runs the estimator of
+ *slowentropy.c on the result: each bucket's samples are a uniform
+ *sample of its positions, weighted by its rate, and the r of a position in an older bucket grows by
+ *the newer bucket's count of its token, so it stays exact.
+ *
+ *Older buckets are compacted as in an exponential histogram: once more
+ *than per_level buckets have been merged the same number of times, the
+ *two oldest of them merge into one. A history of n periods keeps
+ *B = O(per_level log n) buckets of at most c samples, c(B-1) watched
+ *counts and k counters each. Watched counts of tokens that later merges
+ *drop from the older samples are pruned.
+ *
+ *Every sample keeps its time, so a query keeps only the samples inside
+ *the requested range even where a bucket straddles its ends. What
+ *coarsens with age is the number of samples a range gets: a bucket of
+ *2^l periods spreads its c samples over all of them.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include "history.h"
+#include "prng.h"
+#include "util.h"
+
+static int history_tag_comp(void* a, void* b);
+static int history_sample_order(const void* a, const void* b);
+static int history_item_order(const void* a, const void* b);
+static int history_count_order(const void* a, const void* b);
+static int history_freq_merge(history_counter* freq, int n, int k);
+static int history_watch_count(History_Bucket* b, int token);
+static int history_int_order(const void* a, const void* b);
+static int history_long_order(const void* a, const void* b);
+static int history_long_rank(const long* sorted, int n, long x);
+static int history_token_time_order(const void* a, const void* b);
+static double history_after(History_Bucket* last, const long* times,
+                            const history_sample* later, int nlater,
+                            const history_sample* s, long to);
+static void history_prune(History_Bucket* b, History_Bucket** older, int n);
+static double history_estimate(History_Bucket* b, const double* weights);
+static unsigned long long history_rand(History_type* h);
+static void history_reset_live(History_type* h);
+static void history_unwatch(History_type* h, int token);
+static void history_unwatch_dropped(History_type* h, History_Bucket* in,
+                                    History_Bucket* out);
+static void history_close(History_type* h);
+
+History_type* History_Init(int c, int k, long period, int per_level)
+{
+  History_type* h = (History_type*) safe_malloc(sizeof(History_type));
+  prng_type* prng;
+
+  h->c = c;
+  h->k = k;
+  h->period = period;
+  h->per_level = per_level < 1 ? 1 : per_level;
+  h->nbuckets = 0;
+  h->maxbuckets = 16;
+  h->buckets = (History_Bucket**) safe_malloc(h->maxbuckets * sizeof(History_Bucket*));
+
+  h->live_heap = new_heap(history_tag_comp, c+2);
+  h->live_samples = (history_live_sample*) safe_malloc(c * sizeof(history_live_sample));
+  //one chain per sampler to start with
+  h->table_size = c > 0 ? c : 1;
+  h->live_table = new_naivesymtab(h->table_size);
+  h->live_freq_mem = (int*) safe_malloc(FlatFreq_Ints(k) * sizeof(int));
+  //same Misra-Gries hash as Freq_Init
+  prng = prng_Init(45445, 2);
+  for(int i = 0; i < 4; i++)
+    prng_int(prng);
+  long long a = (long long) (prng_int(prng) % MOD);
+  long long b = (long long) (prng_int(prng) % MOD);
+  prng_Destroy(prng);
+  FlatFreq_Attach(&h->live_freq, k, a, b, h->live_freq_mem);
+
+  prng = prng_Init(lrand48(), 2);
+  h->rng = ((unsigned long long) prng_int(prng) << 32 ^ prng_int(prng)) | 1;
+  prng_Destroy(prng);
+  history_reset_live(h);
+  return h;
+}
+
+void History_Destroy(History_type* h)
+{
+  for(int i = 0; i < h->nbuckets; i++)
+    History_Bucket_Destroy(h->buckets[i]);
+  free(h->buckets);
+  free_heap(h->live_heap);
+  free(h->live_samples);
+  free_naivesymtab(h->live_table);
+  free(h->live_freq_mem);
+  free(h);
+}
+
+int History_Size(History_type* h)
+{
+  int size = sizeof(History_type) + h->maxbuckets * sizeof(History_Bucket*);
+  for(int i = 0; i < h->nbuckets; i++)
+    size += History_Bucket_Size(h->buckets[i]);
+  size += sizeof_heap(h->live_heap) + h->c * sizeof(history_live_sample);
+  size += sizeof_naivesymtab(h->live_table);
+  size += FlatFreq_Ints(h->k) * sizeof(int);
+  return size;
+}
+
+//add token seen at time. Times should not decrease; a token older than
+//the open period is counted in it
+void History_Update(History_type* h, long time, int token)
+{
+  heap* hp = h->live_heap;
+  history_live_sample* s = NULL;
+  unsigned long long tag;
+  c_a* ca;
+
+  if(h->live_count > 0 && time >= h->live_start + h->period)
+    history_close(h);
+  if(h->live_count == 0)
+    h->live_start = time - ((time % h->period) + h->period) % h->period;
+  h->live_count++;
+  FlatFreq_Update(&h->live_freq, token);
+
+  //keep the position if its tag is among the c smallest so far. The
+  //evicted sample goes first, so it cannot free the counter we use
+  tag = history_rand(h);
+  if(cur_size(hp) < h->c)
+    s = &h->live_samples[cur_size(hp)];
+  else if(tag < ((history_live_sample*) peek_min(hp))->tag)
+  {
+    s = (history_live_sample*) delete_min(hp);
+    naive_decrement_prim_samplers(h->live_table, s->ca);
+  }
+
+  ca = naive_find_c_a(h->live_table, token);
+  if(ca != NULL)
+    ca->count++;
+  if(s != NULL)
+  {
+    if(ca == NULL)
+    {
+      ca = naive_insert_c_a(h->live_table, token);
+      ca->processing = 0;
+    }
+    naive_increment_prim_samplers(ca);
+    s->tag = tag;
+    s->time = time;
+    s->token = token;
+    s->at = ca->count;
+    s->ca = ca;
+    insert_heap(hp, s);
+  }
+}
+
+//estimate the entropy of the tokens with times in [from, to). The
+//buckets overlapping the range are merged keeping all their samples,
+//and the samples outside the range are dropped. Buckets of different
+//sizes sample at different rates, so each sample stands for the
+//positions per sample of its bucket in the estimate. A sample's r counts
+//its token to the end of the merged buckets, so in the newest bucket
+//the count after to, estimated from that bucket's samples, comes off.
+//The range of times the answer covers, the requested one cut to the
+//history held, is saved in covered_from and covered_to. Returns -1 if
+//no bucket overlaps the range
+double History_Query(History_type* h, long from, long to,
+                     long* covered_from, long* covered_to)
+{
+  History_Bucket *acc = NULL, *next, *live = NULL, *last = NULL;
+  int total = 0, n = 0, nafter = 0, nmerged = 0;
+  long *times = NULL, *starts;
+  double *spread, *weights;
+  history_sample* later = NULL;
+  double m = 0;
+  double est;
+
+  if(h->live_count > 0 && h->live_start < to && h->live_start + h->period > from)
+    live = History_Live_Bucket(h);
+  for(int i = 0; i <= h->nbuckets; i++)
+  {
+    History_Bucket* b = i < h->nbuckets ? h->buckets[i] : live;
+    if(b == NULL || b->start >= to || b->end <= from)
+      continue;
+    total += b->nsamples;
+    m += History_Bucket_Share(b, from, to);
+    last = b;
+  }
+  if(last == NULL)
+  {
+    *covered_from = *covered_to = 0;
+    return -1;
+  }
+  starts = (long*) safe_malloc((h->nbuckets + 1) * sizeof(long));
+  spread = (double*) safe_malloc((h->nbuckets + 1) * sizeof(double));
+  for(int i = 0; i <= h->nbuckets; i++)
+  {
+    History_Bucket* b = i < h->nbuckets ? h->buckets[i] : live;
+    if(b == NULL || b->start >= to || b->end <= from)
+      continue;
+    starts[nmerged] = b->start;
+    spread[nmerged++] = b->nsamples > 0 ? (double) b->count / b->nsamples : 0;
+    next = History_Bucket_Merge(acc, b, total, h->k);
+    History_Bucket_Destroy(acc);
+    acc = next;
+  }
+
+  //the newest bucket's samples after the range, by token and then time,
+  //and the times of all of its samples
+  if(last->end > to && last->nsamples > 0)
+  {
+    times = (long*) safe_malloc(last->nsamples * sizeof(long));
+    later = (history_sample*) safe_malloc(last->nsamples * sizeof(history_sample));
+    for(int i = 0; i < last->nsamples; i++)
+    {
+      times[i] = last->samples[i].time;
+      if(last->samples[i].time >= to)
+        later[nafter++] = last->samples[i];
+    }
+    qsort(times, last->nsamples, sizeof(long), history_long_order);
+    qsort(later, nafter, sizeof(history_sample), history_token_time_order);
+  }
+  weights = (double*) safe_malloc((acc->nsamples > 0 ? acc->nsamples : 1) * sizeof(double));
+  for(int i = 0; i < acc->nsamples; i++)
+  {
+    history_sample s = acc->samples[i];
+    int j = nmerged - 1;
+    if(s.time < from || s.time >= to)
+      continue;
+    if(nafter > 0)
+    {
+      s.r -= (int) (history_after(last, times, later, nafter, &s, to) + 0.5);
+      if(s.r < 1) s.r = 1;
+    }
+    while(j > 0 && starts[j] > s.time)
+      j--;
+    weights[n] = spread[j];
+    acc->samples[n++] = s;
+  }
+  acc->nsamples = n;
+  free(times);
+  free(later);
+  free(starts);
+  free(spread);
+
+  *covered_from = acc->start > from ? acc->start : from;
+  *covered_to = acc->end < to ? acc->end : to;
+  //heavy-hitter counts cover all of the merged buckets
+  for(int i = 0; i < acc->nfreq; i++)
+    acc->freq[i].count = (int) (acc->freq[i].count * (m / acc->count));
+  acc->count = (long) (m + 0.5);
+  est = acc->count > 0 ? history_estimate(acc, weights) : 0;
+  free(weights);
+  History_Bucket_Destroy(acc);
+  History_Bucket_Destroy(live);
+  return est;
+}
+
+//estimated count of the token of s in the part of last from to on, which
+//s's r includes. times holds last's sample times in order, later its
+//samples from to on by token and time. If last sampled the token after
+//to, the first such sample's r is that count but for the stretch before
+//it. Otherwise the count is taken as the share of the token's count in
+//last (of s's r, if s is last's own) that falls after to. A stretch
+//with no sample of the token is unlikely to hold more of it than the
+//positions one sample stands for, so neither guess goes above that
+static double history_after(History_Bucket* last, const long* times,
+                            const history_sample* later, int nlater,
+                            const history_sample* s, long to)
+{
+  int n = last->nsamples, lo = 0, hi = nlater, mid, first;
+  long since;
+  double share, cap = (double) last->count / n;
+
+  while(lo < hi)
+  {
+    mid = (lo + hi) / 2;
+    if(later[mid].token < s->token) lo = mid+1;
+    else hi = mid;
+  }
+  if(lo < nlater && later[lo].token == s->token)
+  {
+    first = history_long_rank(times, n, later[lo].time);
+    share = (double) later[lo].r * (first - history_long_rank(times, n, to)) / (n - first);
+    return later[lo].r + (share < cap ? share : cap);
+  }
+
+  since = s->time > last->start ? s->time : last->start;
+  share = (double) (n - history_long_rank(times, n, to)) /
+          (n - history_long_rank(times, n, since));
+  if(s->time >= last->start)
+    share *= s->r;
+  else
+    share *= history_watch_count(last, s->token);
+  return share < cap ? share : cap;
+}
+
+//a bucket that has kept c samples has kept exactly the positions with
+//tags up to its largest one, so samples of buckets of different sizes
+//form a uniform sample once cut to the least such tag over the buckets
+void History_Bucket_Bound(History_Bucket* b, int c, unsigned long long* tau)
+{
+  if(b->nsamples == c && b->samples[b->nsamples-1].tag < *tau)
+    *tau = b->samples[b->nsamples-1].tag;
+}
+
+//tokens of b with times in [from, to), estimated from its samples'
+//times when b straddles either end
+double History_Bucket_Share(History_Bucket* b, long from, long to)
+{
+  int inside = 0;
+
+  if(b->start >= from && b->end <= to)
+    return b->count;
+  if(b->nsamples == 0)
+    return 0;
+  for(int i = 0; i < b->nsamples; i++)
+  {
+    if(b->samples[i].time >= from && b->samples[i].time < to)
+      inside++;
+  }
+  return (double) b->count * inside / b->nsamples;
+}
+
+//drop the buckets that end at or before time before. They are the
+//oldest, so at the front
+void History_Expire(History_type* h, long before)
+{
+  int n = 0;
+  while(n < h->nbuckets && h->buckets[n]->end <= before)
+  {
+    for(int j = 0; j < h->buckets[n]->nsamples; j++)
+      history_unwatch(h, h->buckets[n]->samples[j].token);
+    History_Bucket_Destroy(h->buckets[n++]);
+  }
+  if(n == 0) return;
+  memmove(h->buckets, h->buckets + n, (h->nbuckets - n) * sizeof(History_Bucket*));
+  h->nbuckets -= n;
+}
+
+//a bucket for the stream of older followed by that of newer, keeping
+//c samples and k counters. With older NULL, a copy of newer
+History_Bucket* History_Bucket_Merge(History_Bucket* older, History_Bucket* newer,
+                                     int c, int k)
+{
+  History_Bucket* b = (History_Bucket*) safe_malloc(sizeof(History_Bucket));
+  int i = 0, j = 0, n = 0, no = 0, nf = 0;
+
+  if(older != NULL)
+    no = older->nsamples;
+  b->start = older != NULL ? older->start : newer->start;
+  b->end = newer->end;
+  b->count = newer->count + (older != NULL ? older->count : 0);
+  b->level = newer->level;
+  if(older != NULL && older->level > b->level)
+    b->level = older->level;
+
+  //bottom-c of the union; older positions also count their token in newer
+  if(c > no + newer->nsamples)
+    c = no + newer->nsamples;
+  b->samples = (history_sample*) safe_malloc((c > 0 ? c : 1) * sizeof(history_sample));
+  while(n < c && (i < no || j < newer->nsamples))
+  {
+    if(j == newer->nsamples || (i < no && older->samples[i].tag < newer->samples[j].tag))
+    {
+      b->samples[n] = older->samples[i++];
+      b->samples[n].r += history_watch_count(newer, b->samples[n].token);
+    }
+    else
+      b->samples[n] = newer->samples[j++];
+    n++;
+  }
+  b->nsamples = n;
+
+  //watched counts add up
+  b->watch = (history_counter*) safe_malloc((newer->nwatch + (older != NULL ?
+                                  older->nwatch : 0) + 1) * sizeof(history_counter));
+  i = j = n = 0;
+  no = older != NULL ? older->nwatch : 0;
+  while(i < no || j < newer->nwatch)
+  {
+    if(j == newer->nwatch || (i < no && older->watch[i].item < newer->watch[j].item))
+      b->watch[n++] = older->watch[i++];
+    else if(i == no || newer->watch[j].item < older->watch[i].item)
+      b->watch[n++] = newer->watch[j++];
+    else
+    {
+      b->watch[n] = older->watch[i++];
+      b->watch[n++].count += newer->watch[j++].count;
+    }
+  }
+  b->nwatch = n;
+
+  nf = newer->nfreq + (older != NULL ? older->nfreq : 0);
+  b->freq = (history_counter*) safe_malloc((nf > 0 ? nf : 1) * sizeof(history_counter));
+  memcpy(b->freq, newer->freq, newer->nfreq * sizeof(history_counter));
+  if(older != NULL)
+    memcpy(b->freq + newer->nfreq, older->freq, older->nfreq * sizeof(history_counter));
+  b->nfreq = history_freq_merge(b->freq, nf, k);
+  return b;
+}
+
+//estimate as in Slow_Lanes_Estimate, with the bucket's samples. When
+//one token is more than half the stream its positions are left out of
+//the sample and its share is accounted for exactly
+double History_Bucket_Estimate(History_Bucket* b)
+{
+  return history_estimate(b, NULL);
+}
+
+//the estimate with sample i standing for weights[i] positions, or for
+//the same number each when weights is NULL
+static double history_estimate(History_Bucket* b, const double* weights)
+{
+  double m = b->count, p_max = 0, sum_Xis = 0, n = 0, w, X;
+  int max_token = INT_MIN, r;
+
+  if(b->nfreq > 0 && b->freq[0].count > (long) (b->count/2))
+  {
+    max_token = b->freq[0].item;
+    p_max = b->freq[0].count / m;
+  }
+  for(int i = 0; i < b->nsamples; i++)
+  {
+    if(p_max > 0 && b->samples[i].token == max_token)
+      continue;
+    r = b->samples[i].r;
+    w = weights != NULL ? weights[i] : 1;
+    X = r * log10(m/r)/log10(2);
+    if(r > 1)
+      X -= (r-1) * log10(m/(r-1))/log10(2);
+    n += w;
+    sum_Xis += w * X;
+  }
+  if(p_max == 0)
+    return n > 0 ? sum_Xis / n : 0;
+  return (n > 0 ? (1-p_max) * sum_Xis / n : 0) + p_max * log10(1/p_max)/log10(2);
+}
+
+void History_Bucket_Destroy(History_Bucket* b)
+{
+  if(b == NULL) return;
+  free(b->samples);
+  free(b->watch);
+  free(b->freq);
+  free(b);
+}
+
+int History_Bucket_Size(History_Bucket* b)
+{
+  return sizeof(History_Bucket) + b->nsamples * sizeof(history_sample) +
+         (b->nwatch + b->nfreq) * sizeof(history_counter);
+}
+
+//heap order: largest tag first, so the root is the next to evict
+static int history_tag_comp(void* a, void* b)
+{
+  unsigned long long x = ((history_live_sample*) a)->tag;
+  unsigned long long y = ((history_live_sample*) b)->tag;
+  return x > y ? -1 : x < y;
+}
+
+static int history_sample_order(const void* a, const void* b)
+{
+  unsigned long long x = ((const history_sample*) a)->tag;
+  unsigned long long y = ((const history_sample*) b)->tag;
+  return x < y ? -1 : x > y;
+}
+
+static int history_item_order(const void* a, const void* b)
+{
+  int x = ((const history_counter*) a)->item, y = ((const history_counter*) b)->item;
+  return x < y ? -1 : x > y;
+}
+
+static int history_count_order(const void* a, const void* b)
+{
+  int x = ((const history_counter*) a)->count, y = ((const history_counter*) b)->count;
+  return x > y ? -1 : x < y;
+}
+
+//combine the counters of two Misra-Gries summaries (Agarwal et al.
+//2012): add the counts of equal items and, if more than k are left,
+//take the (k+1)th largest count off all of them. Leaves the counters
+//largest first and returns how many there are
+static int history_freq_merge(history_counter* freq, int n, int k)
+{
+  int i, j = 0;
+
+  if(n == 0) return 0;
+  qsort(freq, n, sizeof(history_counter), history_item_order);
+  for(i = 1; i < n; i++)
+  {
+    if(freq[i].item == freq[j].item)
+      freq[j].count += freq[i].count;
+    else
+      freq[++j] = freq[i];
+  }
+  n = j+1;
+  qsort(freq, n, sizeof(history_counter), history_count_order);
+  if(n > k)
+  {
+    int cut = freq[k].count;
+    for(n = 0; n < k && freq[n].count > cut; n++)
+      freq[n].count -= cut;
+  }
+  return n;
+}
+
+//count of token in b, for a token sampled by an older bucket
+static int history_watch_count(History_Bucket* b, int token)
+{
+  int lo = 0, hi = b->nwatch, mid;
+  while(lo < hi)
+  {
+    mid = (lo + hi) / 2;
+    if(b->watch[mid].item < token) lo = mid+1;
+    else hi = mid;
+  }
+  return lo < b->nwatch && b->watch[lo].item == token ? b->watch[lo].count : 0;
+}
+
+static int history_int_order(const void* a, const void* b)
+{
+  int x = *(const int*) a, y = *(const int*) b;
+  return x < y ? -1 : x > y;
+}
+
+static int history_long_order(const void* a, const void* b)
+{
+  long x = *(const long*) a, y = *(const long*) b;
+  return x < y ? -1 : x > y;
+}
+
+static int history_token_time_order(const void* a, const void* b)
+{
+  const history_sample *x = (const history_sample*) a, *y = (const history_sample*) b;
+  if(x->token != y->token)
+    return x->token < y->token ? -1 : 1;
+  return x->time < y->time ? -1 : x->time > y->time;
+}
+
+//number of entries of sorted[0, n) below x
+static int history_long_rank(const long* sorted, int n, long x)
+{
+  int lo = 0, hi = n, mid;
+  while(lo < hi)
+  {
+    mid = (lo + hi) / 2;
+    if(sorted[mid] < x) lo = mid+1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+//drop the watched counts of b for tokens no bucket in older[0, n)
+//samples any more
+static void history_prune(History_Bucket* b, History_Bucket** older, int n)
+{
+  int total = 0, m = 0;
+  int* tokens;
+
+  for(int i = 0; i < n; i++)
+    total += older[i]->nsamples;
+  tokens = (int*) safe_malloc((total+1) * sizeof(int));
+  for(int i = 0; i < n; i++)
+    for(int j = 0; j < older[i]->nsamples; j++)
+      tokens[m++] = older[i]->samples[j].token;
+  qsort(tokens, m, sizeof(int), history_int_order);
+  m = 0;
+  for(int i = 0; i < b->nwatch; i++)
+  {
+    if(bsearch(&b->watch[i].item, tokens, total, sizeof(int), history_int_order) != NULL)
+      b->watch[m++] = b->watch[i];
+  }
+  b->nwatch = m;
+  free(tokens);
+}
+
+//xorshift64*: one tag per token, so it must be cheap
+static unsigned long long history_rand(History_type* h)
+{
+  h->rng ^= h->rng >> 12;
+  h->rng ^= h->rng << 25;
+  h->rng ^= h->rng >> 27;
+  return h->rng * 2685821657736338717ULL;
+}
+
+//the open period as a bucket, leaving it open
+History_Bucket* History_Live_Bucket(History_type* h)
+{
+  History_Bucket* b = (History_Bucket*) safe_malloc(sizeof(History_Bucket));
+  history_live_sample* s;
+
+  b->start = h->live_start;
+  b->end = h->live_start + h->period;
+  b->count = h->live_count;
+  b->level = 0;
+  b->nsamples = cur_size(h->live_heap);
+  b->samples = (history_sample*) safe_malloc((h->c > 0 ? h->c : 1) * sizeof(history_sample));
+  for(int i = 0; i < b->nsamples; i++)
+  {
+    s = (history_live_sample*) h->live_heap->node[i+1];
+    b->samples[i].tag = s->tag;
+    b->samples[i].time = s->time;
+    b->samples[i].token = s->token;
+    b->samples[i].r = s->ca->count - s->at + 1;
+  }
+  qsort(b->samples, b->nsamples, sizeof(history_sample), history_sample_order);
+
+  //the watched tokens are the ones marked processing
+  c_a** all = (c_a**) safe_malloc((naive_list_c_a(h->live_table, NULL) + 1) * sizeof(c_a*));
+  int n = naive_list_c_a(h->live_table, all);
+  b->watch = (history_counter*) safe_malloc((n+1) * sizeof(history_counter));
+  b->nwatch = 0;
+  for(int i = 0; i < n; i++)
+  {
+    if(all[i]->processing && all[i]->count > 0)
+    {
+      b->watch[b->nwatch].item = all[i]->key;
+      b->watch[b->nwatch++].count = all[i]->count;
+    }
+  }
+  free(all);
+  qsort(b->watch, b->nwatch, sizeof(history_counter), history_item_order);
+  b->nfreq = *h->live_freq.used;
+  b->freq = (history_counter*) safe_malloc((h->k > 0 ? h->k : 1) * sizeof(history_counter));
+  for(int i = 0; i < b->nfreq; i++)
+  {
+    b->freq[i].item = h->live_freq.items[i];
+    b->freq[i].count = h->live_freq.counts[i];
+  }
+  qsort(b->freq, b->nfreq, sizeof(history_counter), history_count_order);
+  return b;
+}
+
+//start a new period. Every counter left in the table belongs to a
+//token some bucket samples (the open period's samples have just become
+//a bucket's), so all of them are watched from here on
+static void history_reset_live(History_type* h)
+{
+  int n;
+  c_a** all;
+
+  h->live_count = 0;
+  h->live_start = 0;
+  h->live_heap->cursize = 0;
+  FlatFreq_Reset(&h->live_freq);
+
+  n = naive_list_c_a(h->live_table, NULL);
+  all = (c_a**) safe_malloc((n+1) * sizeof(c_a*));
+  naive_list_c_a(h->live_table, all);
+  //keep the chains short: rebuild with more of them once the table
+  //holds twice as many counters as chains
+  if(n > 2 * h->table_size)
+  {
+    symtab* table = new_naivesymtab(2*n);
+    for(int i = 0; i < n; i++)
+      naive_insert_c_a(table, all[i]->key)->num_prim_samplers = all[i]->num_prim_samplers;
+    free_naivesymtab(h->live_table);
+    h->live_table = table;
+    h->table_size = 2*n;
+    naive_list_c_a(h->live_table, all);
+  }
+  for(int i = 0; i < n; i++)
+  {
+    all[i]->count = 0;
+    all[i]->processing = 1;
+  }
+  free(all);
+}
+
+//a bucket no longer samples token: drop its counter once nothing does
+static void history_unwatch(History_type* h, int token)
+{
+  c_a* ca = naive_find_c_a(h->live_table, token);
+  if(ca == NULL)
+    fatal("history: unwatching token %d that is not watched", token);
+  if(--ca->num_prim_samplers == 0)
+    naive_done_processing(h->live_table, ca);
+}
+
+//release the samples of in that did not make it into out, a merge of in
+static void history_unwatch_dropped(History_type* h, History_Bucket* in,
+                                    History_Bucket* out)
+{
+  if(out->nsamples < h->c)
+    return;
+  for(int i = 0; i < in->nsamples; i++)
+  {
+    if(in->samples[i].tag > out->samples[out->nsamples-1].tag)
+      history_unwatch(h, in->samples[i].token);
+  }
+}
+
+//turn the open period into a bucket, then compact: while some level
+//has more than per_level buckets, merge its two oldest into one bucket
+//of the next level. Buckets of a level are always adjacent
+static void history_close(History_type* h)
+{
+  History_Bucket* merged;
+  int level, first, n;
+
+  if(h->nbuckets == h->maxbuckets)
+  {
+    h->maxbuckets *= 2;
+    h->buckets = (History_Bucket**) safe_realloc(h->buckets,
+                                    h->maxbuckets * sizeof(History_Bucket*));
+  }
+  h->buckets[h->nbuckets++] = History_Live_Bucket(h);
+
+  for(level = 0; ; level++)
+  {
+    first = -1;
+    n = 0;
+    for(int i = 0; i < h->nbuckets; i++)
+    {
+      if(h->buckets[i]->level == level)
+      {
+        if(first < 0) first = i;
+        n++;
+      }
+    }
+    if(n <= h->per_level)
+      break;
+    merged = History_Bucket_Merge(h->buckets[first], h->buckets[first+1], h->c, h->k);
+    merged->level = level+1;
+    history_unwatch_dropped(h, h->buckets[first], merged);
+    history_unwatch_dropped(h, h->buckets[first+1], merged);
+    history_prune(merged, h->buckets, first);
+    History_Bucket_Destroy(h->buckets[first]);
+    History_Bucket_Destroy(h->buckets[first+1]);
+    h->buckets[first] = merged;
+    memmove(h->buckets + first+1, h->buckets + first+2,
+            (h->nbuckets - first-2) * sizeof(History_Bucket*));
+    h->nbuckets--;
+  }
+  history_reset_live(h);
+}
@@ -0,0 +1,87 @@
+/*************************************************************************/
+/* history.h                                                             */
+/*************************************************************************/
+
+#ifndef HISTORY_H
+#define HISTORY_H
+#include "heap.h"
+#include "naivesymtab.h"
+#include "flatfreq.h"
+
+//one position of a bucket's stream, kept because its random tag is
+//among the c smallest: its time, and the count r of its token from
+//there to the end of the bucket
+typedef struct history_sample{
+  unsigned long long tag;
+  long time;
+  int token;
+  int r;
+} history_sample;
+
+typedef struct history_counter{
+  int item, count;
+} history_counter;
+
+//summary of the stream in the time range [start, end): a uniform
+//sample of c positions, the exact counts of the tokens sampled by
+//older buckets and the Misra-Gries counters. Two buckets covering
+//consecutive ranges merge into one covering both
+typedef struct History_Bucket{
+  long start, end;
+  long count;
+  int level;               //times merged in compaction
+  int nsamples;
+  history_sample* samples; //ascending tag order
+  int nwatch;
+  history_counter* watch;  //ascending item order, only nonzero counts
+  int nfreq;
+  history_counter* freq;   //Misra-Gries counters, largest first
+} History_Bucket;
+
+//a position sampled in the open period. Its r is the token's count
+//since then: ca->count - at + 1
+typedef struct history_live_sample{
+  unsigned long long tag;
+  long time;
+  int token, at;
+  c_a* ca;
+} history_live_sample;
+
+typedef struct History_type{
+  int c, k, per_level;
+  long period;
+  //closed periods, oldest first; levels never increase toward the end
+  int nbuckets, maxbuckets;
+  History_Bucket** buckets;
+  //the open period
+  long live_start, live_count;
+  heap* live_heap;         //largest tag on top
+  history_live_sample* live_samples;
+  //counts of the tokens sampled in the open period, and of every token
+  //sampled by a bucket (marked processing). num_prim_samplers counts
+  //the samples of either kind that hold the token
+  symtab* live_table;
+  int table_size;
+  int* live_freq_mem;
+  flatfreq_type live_freq;
+  unsigned long long rng;
+} History_type;
+
+extern History_type* History_Init(int c, int k, long period, int per_level);
+extern void History_Destroy(History_type* h);
+extern int History_Size(History_type* h);
+extern void History_Update(History_type* h, long time, int token);
+extern double History_Query(History_type* h, long from, long to,
+                            long* covered_from, long* covered_to);
+extern void History_Expire(History_type* h, long before);
+extern History_Bucket* History_Live_Bucket(History_type* h);
+
+extern History_Bucket* History_Bucket_Merge(History_Bucket* older, History_Bucket* newer,
+                                            int c, int k);
+extern double History_Bucket_Estimate(History_Bucket* b);
+extern void History_Bucket_Bound(History_Bucket* b, int c, unsigned long long* tau);
+extern double History_Bucket_Share(History_Bucket* b, long from, long to);
+extern void History_Bucket_Destroy(History_Bucket* b);
+extern int History_Bucket_Size(History_Bucket* b);
+
+#endif
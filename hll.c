@@ -0,0 +1,42 @@
+/*hll.c
+ *HyperLogLog distinct counting, after Flajolet, Fusy, Gandouet and
+ *Meunier, "HyperLogLog: the analysis of a near-optimal cardinality
+ *estimation algorithm" (AofA 2007), with their corrections for small
+ *counts (linear counting on the empty registers) and for counts near
+ *the 2^32 range of the hash.
+ */
+
+#include <string.h>
+#include <math.h>
+#include "hll.h"
+
+void HLL_Reset(hll_type* h)
+{
+  memset(h->reg, 0, HLL_REGISTERS);
+}
+
+//dst counts the tokens of both; both must have been fed the same hash
+void HLL_Merge(hll_type* dst, const hll_type* src)
+{
+  for(int i = 0; i < HLL_REGISTERS; i++)
+    if(src->reg[i] > dst->reg[i])
+      dst->reg[i] = src->reg[i];
+}
+
+double HLL_Estimate(const hll_type* h)
+{
+  double m = HLL_REGISTERS, sum = 0, e, two32 = 4294967296.0;
+  int zeros = 0;
+
+  for(int i = 0; i < HLL_REGISTERS; i++)
+  {
+    sum += ldexp(1, -h->reg[i]);
+    if(h->reg[i] == 0) zeros++;
+  }
+  e = 0.7213 / (1 + 1.079/m) * m * m / sum;
+  if(e <= 2.5 * m && zeros > 0)
+    return m * log(m / zeros);
+  if(e > two32 / 30)
+    return -two32 * log(1 - e / two32);
+  return e;
+}
@@ -0,0 +1,45 @@
+/*************************************************************************/
+/* hll.h                                                                 */
+/*************************************************************************/
+
+#ifndef HLL_H
+#define HLL_H
+
+//HyperLogLog (Flajolet et al. 2007) with 2^HLL_BITS one-byte registers:
+//4KB, with a standard error of 1.04/64 = 1.6% in the number of
+//distinct tokens. It is fed the 32-bit token itself: the mix here is
+//a bijection, so distinct tokens never share a mixed value. A hash
+//mod 2^31 - 1 such as hash31 would not do, as it maps x and
+//x + 2^31 - 1 alike
+#define HLL_BITS 12
+#define HLL_REGISTERS (1 << HLL_BITS)
+
+typedef struct hll_type{
+  unsigned char reg[HLL_REGISTERS];
+} hll_type;
+
+extern void HLL_Reset(hll_type* h);
+extern void HLL_Merge(hll_type* dst, const hll_type* src);
+extern double HLL_Estimate(const hll_type* h);
+
+//the top HLL_BITS bits of the mixed hash pick a register, which keeps
+//the most leading zeros seen in the rest, plus one. Inline, as it runs
+//on every token
+static inline void HLL_Add(hll_type* h, unsigned int hash)
+{
+  unsigned int x = hash, rest;
+  unsigned char rank;
+
+  //murmur3's 32-bit finalizer
+  x ^= x >> 16;
+  x *= 0x85ebca6bu;
+  x ^= x >> 13;
+  x *= 0xc2b2ae35u;
+  x ^= x >> 16;
+  rest = x << HLL_BITS;
+  rank = rest ? __builtin_clz(rest) + 1 : 32 - HLL_BITS + 1;
+  if(rank > h->reg[x >> (32 - HLL_BITS)])
+    h->reg[x >> (32 - HLL_BITS)] = rank;
+}
+
+#endif
@@ -0,0 +1,158 @@
+/*hybrid.c
+ *Entropy estimation that counts exactly until the counts would take
+ *more than a given number of bytes, and only then pays for the sketch.
+ *
+ *Small and low-cardinality streams never leave the exact histogram, an
+ *open-addressing table of (token, count), and get their entropy and
+ *number of distinct tokens exactly, at the cost of one table probe per
+ *token. When the table would have to grow past threshold, the fast
+ *estimator is built from it with Estimator_Init_From_Counts, which
+ *draws each sampler's state from the histogram as if it had read a
+ *stream with those counts, and the rest of the stream goes to it. No
+ *token is read twice.
+ */
+
+#include <stdlib.h>
+#include <math.h>
+#include "hybridpriv.h"
+#include "util.h"
+
+//threshold is in bytes; the histogram takes 8 per slot
+Hybrid_Estimator_type* Hybrid_Estimator_Init(int c, int k, long threshold)
+{
+  Hybrid_Estimator_type* est = (Hybrid_Estimator_type*) safe_malloc(sizeof(Hybrid_Estimator_type));
+  est->c = c;
+  est->k = k;
+  est->threshold = threshold;
+  est->count = 0;
+  est->size = HYBRID_MIN_SLOTS;
+  est->entries = 0;
+  est->keys = (int*) safe_malloc(est->size * sizeof(int));
+  est->counts = (int*) calloc(est->size, sizeof(int));
+  if(est->counts == NULL) fatal("Hybrid_Estimator_Init: Out of memory");
+  est->sketch = NULL;
+  return est;
+}
+
+void Hybrid_Estimator_Destroy(Hybrid_Estimator_type* est)
+{
+  if(est->sketch != NULL)
+    Estimator_Destroy(est->sketch);
+  free(est->keys);
+  free(est->counts);
+  free(est);
+}
+
+int Hybrid_Estimator_Size(Hybrid_Estimator_type* est)
+{
+  if(est->sketch != NULL)
+    return sizeof(Hybrid_Estimator_type) + Estimator_Size(est->sketch);
+  return sizeof(Hybrid_Estimator_type) + est->size * 2 * sizeof(int);
+}
+
+//1 while the estimator still counts exactly
+int Hybrid_Estimator_Exact(Hybrid_Estimator_type* est)
+{
+  return est->sketch == NULL;
+}
+
+void Hybrid_Estimator_Update(Hybrid_Estimator_type* est, int token)
+{
+  int i;
+
+  if(est->sketch != NULL)
+  {
+    Estimator_Update(est->sketch, token);
+    return;
+  }
+  est->count++;
+  i = hybrid_slot(est, token);
+  if(est->counts[i] == 0)
+  {
+    if(2 * (est->entries+1) > est->size && !hybrid_grow(est))
+    {
+      //the histogram has reached threshold: the sketch takes over
+      //from the counts so far, and then takes this token
+      est->count--;
+      hybrid_switch(est);
+      Estimator_Update(est->sketch, token);
+      return;
+    }
+    i = hybrid_slot(est, token);
+    est->keys[i] = token;
+    est->entries++;
+  }
+  est->counts[i]++;
+}
+
+double Hybrid_Estimator_end_stream(Hybrid_Estimator_type* est)
+{
+  double sum_flogf = 0;
+
+  if(est->sketch != NULL)
+    return Estimator_end_stream(est->sketch);
+  if(est->count == 0)
+    return 0;
+  for(int i = 0; i < est->size; i++)
+    if(est->counts[i] > 0)
+      sum_flogf += est->counts[i] * log2(est->counts[i]);
+  return log2(est->count) - sum_flogf / est->count;
+}
+
+//number of distinct tokens, exact while the histogram lasts
+double Hybrid_Estimator_Distinct(Hybrid_Estimator_type* est)
+{
+  if(est->sketch != NULL)
+    return Estimator_Distinct(est->sketch);
+  return est->entries;
+}
+
+//slot holding token, or the empty slot where it would go
+static int hybrid_slot(Hybrid_Estimator_type* est, int token)
+{
+  int i = ((unsigned int) token * 2654435769u) & (est->size - 1);
+  while(est->counts[i] != 0 && est->keys[i] != token)
+    i = (i + 1) & (est->size - 1);
+  return i;
+}
+
+//double the histogram; 0, leaving it alone, if that would pass threshold
+static int hybrid_grow(Hybrid_Estimator_type* est)
+{
+  int *keys = est->keys, *counts = est->counts, size = est->size, i;
+
+  if((long) size * 2 * 2 * sizeof(int) > est->threshold)
+    return 0;
+  est->size = 2 * size;
+  est->keys = (int*) safe_malloc(est->size * sizeof(int));
+  est->counts = (int*) calloc(est->size, sizeof(int));
+  if(est->counts == NULL) fatal("Hybrid_Estimator_Update: Out of memory");
+  for(int j = 0; j < size; j++)
+  {
+    if(counts[j] == 0) continue;
+    i = hybrid_slot(est, keys[j]);
+    est->keys[i] = keys[j];
+    est->counts[i] = counts[j];
+  }
+  free(keys);
+  free(counts);
+  return 1;
+}
+
+//build the sketch from the histogram and drop the histogram
+static void hybrid_switch(Hybrid_Estimator_type* est)
+{
+  int n = 0;
+
+  for(int i = 0; i < est->size; i++)
+  {
+    if(est->counts[i] == 0) continue;
+    est->keys[n] = est->keys[i];
+    est->counts[n++] = est->counts[i];
+  }
+  est->sketch = Estimator_Init_From_Counts(est->c, est->k, est->keys, est->counts, n);
+  free(est->keys);
+  free(est->counts);
+  est->keys = est->counts = NULL;
+  est->size = est->entries = 0;
+}
@@ -0,0 +1,24 @@
+#ifndef HYBRIDPRIV_H
+#define HYBRIDPRIV_H
+#include "hybridpub.h"
+#include "entropypub.h"
+
+#define HYBRID_MIN_SLOTS 64
+
+struct Hybrid_Estimator_type{
+  int c, k;
+  long threshold;          //bytes the exact histogram may use
+  int count;
+  //exact phase: open addressing histogram, slot empty where count is 0
+  int* keys;
+  int* counts;
+  int size, entries;       //size is a power of 2, at most half full
+  //sketch phase, once the histogram would outgrow threshold
+  Estimator_type* sketch;
+};
+
+static int hybrid_slot(Hybrid_Estimator_type* est, int token);
+static int hybrid_grow(Hybrid_Estimator_type* est);
+static void hybrid_switch(Hybrid_Estimator_type* est);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef HYBRIDPUB_H
+#define HYBRIDPUB_H
+
+typedef struct Hybrid_Estimator_type Hybrid_Estimator_type;
+
+extern Hybrid_Estimator_type* Hybrid_Estimator_Init(int c, int k, long threshold);
+extern void Hybrid_Estimator_Destroy(Hybrid_Estimator_type* est);
+extern int Hybrid_Estimator_Size(Hybrid_Estimator_type* est);
+extern void Hybrid_Estimator_Update(Hybrid_Estimator_type* est, int token);
+extern double Hybrid_Estimator_end_stream(Hybrid_Estimator_type* est);
+extern double Hybrid_Estimator_Distinct(Hybrid_Estimator_type* est);
+extern int Hybrid_Estimator_Exact(Hybrid_Estimator_type* est);
+
+#endif
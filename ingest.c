@@ -0,0 +1,151 @@
+/* ingest.c
+ *Concurrent ingest front-end for a single fast estimator. Any number of
+ *producer threads (up to max_producers) stage tokens in private buffers
+ *and hand full batches to a dedicated owner thread through per-producer
+ *lock-free queues; only the owner thread ever calls Estimator_Update.
+ *
+ *Producers never take a lock. Ingest_Update only writes to the caller's
+ *staging buffer; when the batch is full it is pushed to the caller's
+ *queue, yielding if the owner has fallen a whole queue behind.
+ *
+ *Ordering: tokens from one producer are applied in the order that
+ *producer submitted them. Tokens from different producers are
+ *interleaved arbitrarily, a batch at a time, so the estimator sees some
+ *merge of the per-producer sequences. The estimate does not depend on
+ *the order of the stream, only on its token counts.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <sched.h>
+#include "ingestpriv.h"
+#include "util.h"
+
+static void* owner_main(void* arg);
+
+//start an owner thread that feeds est. The caller keeps ownership of
+//est but must not touch it until Ingest_Close has returned
+Ingest_type* Ingest_Init(Estimator_type* est, int max_producers)
+{
+  Ingest_type* ing = (Ingest_type*) safe_malloc(sizeof(Ingest_type));
+  if(max_producers < 1) fatal("Ingest_Init: need at least one producer");
+  ing->est = est;
+  ing->max_producers = max_producers;
+  ing->nproducers = 0;
+  ing->closing = 0;
+  ing->slots = (Ingest_Producer**) safe_malloc(max_producers * sizeof(Ingest_Producer*));
+  for(int i = 0; i < max_producers; i++)
+  {
+    ing->slots[i] = NULL;
+  }
+  if(pthread_create(&ing->owner, NULL, owner_main, ing) != 0)
+    fatal("Ingest_Init: can't create owner thread");
+  ing->running = 1;
+  return ing;
+}
+
+//claim a producer slot. Safe to call from any thread; each producer
+//thread should register once and use only its own handle
+Ingest_Producer* Ingest_Register(Ingest_type* ing)
+{
+  int slot = __atomic_fetch_add(&ing->nproducers, 1, __ATOMIC_ACQ_REL);
+  Ingest_Producer* prod;
+
+  if(slot >= ing->max_producers)
+    fatal("Ingest_Register: more than %d producers", ing->max_producers);
+  prod = (Ingest_Producer*) safe_malloc(sizeof(Ingest_Producer));
+  prod->queue = Ring_Init(INGEST_QUEUE);
+  prod->nstaged = 0;
+  __atomic_store_n(&ing->slots[slot], prod, __ATOMIC_RELEASE);
+  return prod;
+}
+
+//stage a token, handing the batch to the owner once it is full
+void Ingest_Update(Ingest_Producer* prod, int token)
+{
+  prod->staged[prod->nstaged++] = token;
+  if(prod->nstaged == INGEST_BATCH)
+  {
+    Ring_Push_All(prod->queue, prod->staged, INGEST_BATCH);
+    prod->nstaged = 0;
+  }
+}
+
+//hand any partially filled batch to the owner. Every producer must
+//flush before Ingest_Close is called or its staged tokens are lost
+void Ingest_Flush(Ingest_Producer* prod)
+{
+  Ring_Push_All(prod->queue, prod->staged, prod->nstaged);
+  prod->nstaged = 0;
+}
+
+//owner loop: visit each producer's queue in turn, applying whatever
+//batches are waiting. Exits once closing is set and all queues are dry
+static void* owner_main(void* arg)
+{
+  Ingest_type* ing = (Ingest_type*) arg;
+  Ingest_Producer* prod;
+  int batch[INGEST_BATCH];
+  int n, total, closing, nprod;
+
+  for(;;)
+  {
+    //read closing before draining so a final pass sees every push
+    closing = __atomic_load_n(&ing->closing, __ATOMIC_ACQUIRE);
+    nprod = __atomic_load_n(&ing->nproducers, __ATOMIC_ACQUIRE);
+    if(nprod > ing->max_producers) nprod = ing->max_producers;
+    total = 0;
+    for(int i = 0; i < nprod; i++)
+    {
+      prod = __atomic_load_n(&ing->slots[i], __ATOMIC_ACQUIRE);
+      if(prod == NULL) continue; //registration still in progress
+      while((n = Ring_Pop(prod->queue, batch, INGEST_BATCH)) > 0)
+      {
+        for(int j = 0; j < n; j++)
+        {
+          Estimator_Update(ing->est, batch[j]);
+        }
+        total += n;
+      }
+    }
+    if(total == 0)
+    {
+      if(closing) break;
+      sched_yield();
+    }
+  }
+  return NULL;
+}
+
+//wait for the owner to apply every flushed token and stop it
+void Ingest_Close(Ingest_type* ing)
+{
+  if(!ing->running) return;
+  __atomic_store_n(&ing->closing, 1, __ATOMIC_RELEASE);
+  pthread_join(ing->owner, NULL);
+  ing->running = 0;
+}
+
+//end of stream reached. Close the front-end and compute the estimate
+double Ingest_end_stream(Ingest_type* ing)
+{
+  Ingest_Close(ing);
+  return Estimator_end_stream(ing->est);
+}
+
+//free the front-end and producer handles, but not the estimator
+void Ingest_Destroy(Ingest_type* ing)
+{
+  int nprod;
+  Ingest_Close(ing);
+  nprod = ing->nproducers;
+  if(nprod > ing->max_producers) nprod = ing->max_producers;
+  for(int i = 0; i < nprod; i++)
+  {
+    if(ing->slots[i] == NULL) continue;
+    Ring_Destroy(ing->slots[i]->queue);
+    free(ing->slots[i]);
+  }
+  free(ing->slots);
+  free(ing);
+}
@@ -0,0 +1,28 @@
+#ifndef INGESTPRIV_H
+#define INGESTPRIV_H
+#include <pthread.h>
+#include "ingestpub.h"
+#include "ring.h"
+
+#define INGEST_BATCH 256     //tokens staged by a producer before a push
+#define INGEST_QUEUE 16384   //capacity of each producer's queue in tokens
+
+//per-thread staging area. staged/nstaged are private to the producer
+//thread, queue is shared only with the owner thread
+struct Ingest_Producer{
+  ring_type* queue;
+  int nstaged;
+  int staged[INGEST_BATCH];
+};
+
+struct Ingest_type{
+  Estimator_type* est;      //only touched by the owner thread while open
+  int max_producers;
+  int nproducers;           //slots handed out so far
+  int closing;              //set by Ingest_Close
+  Ingest_Producer** slots;  //published with release once initialized
+  pthread_t owner;
+  int running;
+};
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef INGESTPUB_H
+#define INGESTPUB_H
+#include "entropypub.h"
+
+typedef struct Ingest_type Ingest_type;
+typedef struct Ingest_Producer Ingest_Producer;
+
+extern Ingest_type* Ingest_Init(Estimator_type* est, int max_producers);
+extern void Ingest_Destroy(Ingest_type* ing);
+extern Ingest_Producer* Ingest_Register(Ingest_type* ing);
+extern void Ingest_Update(Ingest_Producer* prod, int token);
+extern void Ingest_Flush(Ingest_Producer* prod);
+extern void Ingest_Close(Ingest_type* ing);
+extern double Ingest_end_stream(Ingest_type* ing);
+
+#endif
@@ -0,0 +1,36 @@
+/*************************************************************************/
+/* lanes.h                                                               */
+/*************************************************************************/
+
+#ifndef LANES_H
+#define LANES_H
+
+//samplers are processed SLOW_LANES at a time, so the sampler arrays
+//are padded to a multiple of SLOW_LANES (the widest vector kernel, and
+//one 64-byte cache line of ints)
+#define SLOW_LANES 16
+
+//the c samplers stored as parallel arrays (structure of arrays) so one
+//token can be applied to many samplers per instruction. Sampler i is
+//(s0[i], r0[i], t0[i], s1[i], r1[i], t1[i]) and draws its random
+//numbers from its own xorshift generator rng[i]
+typedef struct Sample_lanes{
+  int* s0;
+  int* t0;
+  unsigned int* r0;
+  int* s1;
+  int* t1;
+  unsigned int* r1;
+  unsigned int* rng;
+} Sample_lanes;
+
+//apply token to samplers [from, to), both multiples of SLOW_LANES
+typedef void (*slow_kernel_fn)(Sample_lanes* lanes, int from, int to, int token);
+
+//the update kernels and estimate live in slowentropy.c; they work on
+//any lanes, wherever they are stored
+extern slow_kernel_fn Slow_Select_Kernel(const char** name);
+extern double Slow_Lanes_Estimate(Sample_lanes* lanes, int c, int m, int max_token,
+                                  int max_count);
+
+#endif
@@ -4,10 +4,11 @@
 #include <stdlib.h>
 
 // simple timing routines for testing
-// these use global variables, so they will not interleave well
+// the clock is thread-local, so each thread can time its own work,
+// but calls within one thread must still not interleave
 
-long secs, usecs;
-struct timeval tt;
+static __thread long secs, usecs;
+static __thread struct timeval tt;
 
 void StartTheClock()
 {
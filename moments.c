@@ -0,0 +1,51 @@
+/*moments.c
+ *Frequency moments and Renyi and Tsallis entropies from the samplers of
+ *the entropy estimators (Alon, Matias and Szegedy 1996). A position
+ *sampled uniformly from a stream of length m, with r the count of its
+ *token from that position on, gives
+ *  X = m (r^p - (r-1)^p)
+ *whose expectation is F_p = sum f_i^p: the f_i positions of token i
+ *contribute 1^p - 0^p + 2^p - 1^p + ... + f_i^p - (f_i-1)^p. p = 0
+ *counts the distinct tokens, p = 2 is the self-join size. Then
+ *  Renyi   H_alpha = log2(F_alpha / m^alpha) / (1 - alpha)
+ *  Tsallis S_alpha = (1 - F_alpha / m^alpha) / (alpha - 1)
+ *both of which tend to the Shannon entropy as alpha -> 1 (Tsallis in
+ *nats), so alpha = 1 is left to the estimators' end_stream.
+ */
+
+#include <math.h>
+#include "moments.h"
+#include "util.h"
+
+double Moments_Fp(const int* r, int n, double p, long m, int max_count)
+{
+  double sum_Xis = 0;
+
+  if(p < 0) fatal("Moments_Fp: p must be at least 0, not %f", p);
+  if(m == 0 || n == 0)
+    return 0;
+  for(int i = 0; i < n; i++)
+  {
+    if(r[i] <= 0) //ignore empty samplers
+      continue;
+    sum_Xis += pow(r[i], p);
+    if(r[i] > 1) //0^p is taken as 0, also for p = 0
+      sum_Xis -= pow(r[i]-1, p);
+  }
+  //the samplers only see the m - max_count positions of other tokens
+  return (max_count > 0 ? pow(max_count, p) : 0) + (double) (m - max_count) * sum_Xis / n;
+}
+
+double Moments_Renyi(double f_alpha, double alpha, long m)
+{
+  if(m == 0 || f_alpha <= 0)
+    return 0;
+  return (log2(f_alpha) - alpha * log2(m)) / (1 - alpha);
+}
+
+double Moments_Tsallis(double f_alpha, double alpha, long m)
+{
+  if(m == 0)
+    return 0;
+  return (1 - f_alpha / pow(m, alpha)) / (alpha - 1);
+}
@@ -0,0 +1,19 @@
+/*************************************************************************/
+/* moments.h                                                             */
+/*************************************************************************/
+
+#ifndef MOMENTS_H
+#define MOMENTS_H
+
+//the samplers' r, the count of the sampled token from the sampled
+//position on, gives any sum of f(count) as well as the entropy. These
+//turn the r of n samplers into the frequency moment F_p = sum f_i^p of
+//a stream of length m, and F_alpha into Renyi and Tsallis entropies.
+//As for the entropy, a token with more than half the stream is counted
+//exactly with max_count (0 if there is none) and the samplers sample
+//the rest of the stream
+extern double Moments_Fp(const int* r, int n, double p, long m, int max_count);
+extern double Moments_Renyi(double f_alpha, double alpha, long m);
+extern double Moments_Tsallis(double f_alpha, double alpha, long m);
+
+#endif
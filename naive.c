@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include <math.h>
 #include <limits.h>
+#include <stdint.h>
 #include "massdal.h"
 #include "naivepriv.h"
 #include "util.h"
@@ -35,14 +36,22 @@ static Sample_type * Naive_Sample_Init()
 
 //initialize estimator with c samplers and k counters (used by Misra-Gries alg)
 Naive_Estimator_type * Naive_Estimator_Init(int c, int k)
+{
+  // initialize the random number generator
+  prng_type* prng = prng_Init(lrand48(), 2); 
+  return naive_estimator_new(c, k, prng, Freq_Init((float)1.0/k));
+}
+
+//an empty estimator using the given generator and Misra-Gries counters
+static Naive_Estimator_type* naive_estimator_new(int c, int k, prng_type* prng,
+                                                 freq_type* freq)
 {
   Naive_Estimator_type* est = (Naive_Estimator_type*) safe_malloc(sizeof(Naive_Estimator_type));
   est->c=c;
   est->k=k;
   est->count = 0;
-  est->prng=prng_Init(drand48(), 2); 
-  // initialize the random number generator
-  est->freq=Freq_Init((float)1.0/k);
+  est->prng=prng;
+  est->freq=freq;
 	
   est->samplers = (Sample_type**) safe_malloc(sizeof(Sample_type*) * c);	
   for(int i = 0; i < c; i++)
@@ -64,12 +73,18 @@ static void Naive_Sample_Destroy(Sample_type * sm)
 void Naive_Estimator_Destroy(Naive_Estimator_type * est)
 {
   prng_Destroy(est->prng);
+  Freq_Destroy(est->freq);
+  naive_estimator_free(est);
+}
+
+//everything but the generator and the Misra-Gries counters
+static void naive_estimator_free(Naive_Estimator_type* est)
+{
   for(int i=0; i < est->c; i++)
   {
     Naive_Sample_Destroy(est->samplers[i]);
   }
   free(est->samplers);
-  Freq_Destroy(est->freq);
   free_heap(est->prim_heap);
   free_naivesymtab(est->hashtable);
   free(est);
@@ -190,4 +205,209 @@ double Naive_Estimator_end_stream(Naive_Estimator_type* est)
 	  sum_Xis -= (double) (r-1) * log10((double) m/(r-1))/log10(2);
   }
   return sum_Xis /est->c;  
-}
\ No newline at end of file
+}
+//whether the Misra-Gries counters show a token in more than half the
+//stream, which the naive version has no backup samples for. The token
+//and its (under)count are saved in token and count
+int Naive_Estimator_Dominant(Naive_Estimator_type* est, int* token, int* count)
+{
+  *token = INVALID_TOKEN;
+  *count = 0;
+  SaveMax(est->freq, token, count);
+  return *count > (int) (est->count/2);
+}
+
+//hand est's samplers, Misra-Gries counters and generator over to h and
+//free the rest of est. The samplers go without backups
+void Naive_Estimator_Handoff(Naive_Estimator_type* est, Sampler_handoff* h)
+{
+  Sample_state* st;
+  Sample_type* cur;
+
+  h->c = est->c;
+  h->k = est->k;
+  h->count = est->count;
+  h->prng = est->prng;
+  h->freq = est->freq;
+  h->samplers = (Sample_state*) safe_malloc(est->c * sizeof(Sample_state));
+  for(int i = 0; i < est->c; i++)
+  {
+    st = &h->samplers[i];
+    cur = est->samplers[i];
+    st->s0 = st->s1 = 0;
+    st->r0 = st->r1 = 0;
+    st->t0 = cur->t0;
+    st->t1 = 1;
+    if(est->count > 0)
+    {
+      st->s0 = cur->c_s0->key;
+      st->r0 = cur->c_s0->count - cur->val_c_s0 + 1;
+    }
+  }
+  naive_estimator_free(est);
+}
+
+//maps a sampler's address back to its index in est->samplers
+typedef struct sampler_ref{
+  Sample_type* sm;
+  int index;
+} sampler_ref;
+
+static int sampler_ref_cmp(const void* p, const void* q)
+{
+  uintptr_t a = (uintptr_t) ((const sampler_ref*) p)->sm;
+  uintptr_t b = (uintptr_t) ((const sampler_ref*) q)->sm;
+  return (a==b) ? 0 : (a<b) ? -1 : 1;
+}
+
+//writes the whole state of est: samplers, the counters they sample,
+//the order of the sampler heap, the generator and the Misra-Gries
+//counters. Returns a malloc'd image of *len bytes
+unsigned char* Naive_Estimator_Serialize(Naive_Estimator_type* est, long* len)
+{
+  serial_buf b;
+  sampler_ref *refs, key, *found;
+  c_a** counters;
+  int n;
+
+  Serial_Init(&b);
+  Serial_Put_Header(&b, SERIAL_NAIVE);
+  Serial_Put_Int(&b, est->c);
+  Serial_Put_Int(&b, est->k);
+  Serial_Put_Int(&b, est->count);
+  prng_Serialize(est->prng, &b);
+  Freq_Serialize(est->freq, &b);
+
+  n = naive_list_c_a(est->hashtable, NULL);
+  counters = (c_a**) safe_malloc((n+1) * sizeof(c_a*));
+  naive_list_c_a(est->hashtable, counters);
+  Serial_Put_Int(&b, n);
+  for(int i = 0; i < n; i++)
+  {
+    Serial_Put_Int(&b, counters[i]->key);
+    Serial_Put_Int(&b, counters[i]->count);
+    Serial_Put_Int(&b, counters[i]->num_prim_samplers);
+    Serial_Put_Int(&b, counters[i]->processing);
+  }
+  free(counters);
+
+  for(int i = 0; i < est->c; i++)
+  {
+    Sample_type* cur = est->samplers[i];
+    Serial_Put_Int(&b, cur->val_c_s0);
+    Serial_Put_Double(&b, cur->t0);
+    //samplers have no sample before the first token
+    Serial_Put_Int(&b, est->count > 0);
+    Serial_Put_Int(&b, est->count > 0 ? cur->c_s0->key : 0);
+    Serial_Put_Int(&b, cur->prim);
+  }
+
+  refs = (sampler_ref*) safe_malloc(est->c * sizeof(sampler_ref));
+  for(int i = 0; i < est->c; i++)
+  {
+    refs[i].sm = est->samplers[i];
+    refs[i].index = i;
+  }
+  qsort(refs, est->c, sizeof(sampler_ref), sampler_ref_cmp);
+  Serial_Put_Int(&b, est->prim_heap->maxsize);
+  Serial_Put_Int(&b, est->prim_heap->cursize);
+  for(int j = 1; j <= est->prim_heap->cursize; j++)
+  {
+    key.sm = est->prim_heap->node[j];
+    found = (sampler_ref*) bsearch(&key, refs, est->c, sizeof(sampler_ref), sampler_ref_cmp);
+    if(found == NULL) fatal("Naive_Estimator_Serialize: sampler not in estimator");
+    Serial_Put_Int(&b, found->index);
+  }
+  free(refs);
+
+  *len = b.len;
+  return b.data;
+}
+
+//rebuild an estimator from an image written by
+//Naive_Estimator_Serialize. Returns NULL if the image is truncated,
+//corrupt, or from another version of the format
+Naive_Estimator_type* Naive_Estimator_Deserialize(const unsigned char* image, long len)
+{
+  serial_reader r;
+  Naive_Estimator_type* est;
+  prng_type* prng;
+  freq_type* freq;
+  int c, k, count, n, maxsize, index;
+  int* fields;
+  Sample_type** sms;
+  c_a* a;
+
+  Serial_Reader_Init(&r, image, len);
+  if(!Serial_Get_Header(&r, SERIAL_NAIVE)) return NULL;
+  c = Serial_Get_Int(&r);
+  k = Serial_Get_Int(&r);
+  count = Serial_Get_Int(&r);
+  if(r.error || c < 1 || k < 1 || count < 0 || !Serial_Check_Count(&r, c, 4))
+    return NULL;
+  prng = prng_Deserialize(&r);
+  if(prng == NULL) return NULL;
+  freq = Freq_Deserialize(&r);
+  if(freq == NULL)
+  {
+    prng_Destroy(prng);
+    return NULL;
+  }
+  est = naive_estimator_new(c, k, prng, freq);
+  est->count = count;
+
+  //insert in reverse to recreate the buckets in their saved order
+  n = Serial_Get_Int(&r);
+  if(Serial_Check_Count(&r, n, 16))
+  {
+    fields = (int*) safe_malloc((n+1) * 4 * sizeof(int));
+    for(int i = 0; i < 4*n; i++)
+      fields[i] = Serial_Get_Int(&r);
+    for(int i = n-1; i >= 0 && !r.error; i--)
+    {
+      a = naive_insert_c_a(est->hashtable, fields[4*i]);
+      if(a == NULL)
+      {
+        r.error = 1;
+        break;
+      }
+      a->count = fields[4*i + 1];
+      a->num_prim_samplers = fields[4*i + 2];
+      a->processing = fields[4*i + 3];
+    }
+    free(fields);
+  }
+
+  for(int i = 0; i < c && !r.error; i++)
+  {
+    Sample_type* cur = est->samplers[i];
+    int has0, key0;
+    cur->val_c_s0 = Serial_Get_Int(&r);
+    cur->t0 = Serial_Get_Double(&r);
+    has0 = Serial_Get_Int(&r);
+    key0 = Serial_Get_Int(&r);
+    cur->prim = Serial_Get_Int(&r);
+    cur->c_s0 = has0 ? naive_find_c_a(est->hashtable, key0) : NULL;
+    if(has0 && cur->c_s0 == NULL) r.error = 1;
+  }
+
+  maxsize = Serial_Get_Int(&r);
+  n = Serial_Get_Int(&r);
+  if(n < 0 || n > c) r.error = 1;
+  sms = (Sample_type**) safe_malloc((c+1) * sizeof(Sample_type*));
+  for(int j = 0; j < n && !r.error; j++)
+  {
+    index = Serial_Get_Int(&r);
+    if(index < 0 || index >= c) r.error = 1;
+    else sms[j] = est->samplers[index];
+  }
+  if(!r.error) load_heap(est->prim_heap, (void**) sms, n, maxsize);
+  free(sms);
+
+  if(r.error || r.pos != r.len)
+  {
+    Naive_Estimator_Destroy(est);
+    return NULL;
+  }
+  return est;
+}
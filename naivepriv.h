@@ -27,5 +27,8 @@ static Sample_type* Naive_Sample_Init();
 static void Naive_Sample_Destroy(Sample_type * sm);
 static void naive_reset_wait_times(Sample_type* cur, Naive_Estimator_type* est);
 static void naive_handle_first(Naive_Estimator_type* est, c_a* first);
+static Naive_Estimator_type* naive_estimator_new(int c, int k, prng_type* prng,
+                                                 freq_type* freq);
+static void naive_estimator_free(Naive_Estimator_type* est);
 
 #endif
@@ -1,6 +1,8 @@
 #ifndef NAIVEPUB_H
 #define NAIVEPUB_H
 
+#include "handoff.h"
+
 typedef struct Naive_Estimator_type Naive_Estimator_type;
 
 extern Naive_Estimator_type* Naive_Estimator_Init(int c, int k);
@@ -8,5 +10,9 @@ extern void Naive_Estimator_Destroy(Naive_Estimator_type * est);
 extern int Naive_Estimator_Size(Naive_Estimator_type * est);
 extern void Naive_Estimator_Update(Naive_Estimator_type * est, int token);
 extern double Naive_Estimator_end_stream(Naive_Estimator_type* est);
+extern int Naive_Estimator_Dominant(Naive_Estimator_type* est, int* token, int* count);
+extern void Naive_Estimator_Handoff(Naive_Estimator_type* est, Sampler_handoff* h);
+extern unsigned char* Naive_Estimator_Serialize(Naive_Estimator_type* est, long* len);
+extern Naive_Estimator_type* Naive_Estimator_Deserialize(const unsigned char* image, long len);
 
 #endif
\ No newline at end of file
@@ -74,6 +74,49 @@ int naive_lookup( symtab* table, int key )
   return NOT_FOUND;
 }
 
+// Return the counter for key, or NULL if key is not tracked
+c_a* naive_find_c_a( symtab* table, int key )
+{
+  c_a* c = table->bucket[ hash( table, key ) ];
+  while (c != NULL) {
+    if(c->key == key) return c;
+    c = c->next;
+  }
+  return NULL;
+}
+
+// Add a fresh counter for key and return it, or NULL if key is
+// already tracked. Used to rebuild a saved table; naive_list_c_a lists
+// each bucket front to back, so inserting the listed keys in reverse
+// order recreates every bucket in its original order
+c_a* naive_insert_c_a( symtab* table, int key )
+{
+  int bn = hash(table, key);
+  if(naive_find_c_a(table, key) != NULL) return NULL;
+  c_a* n = init_c_a(key);
+  n->next = table->bucket[bn];
+  if(table->bucket[bn] != NULL)
+	table->bucket[bn]->previous = n;
+  table->bucket[ bn ] = n;
+  return n;
+}
+
+// Save every tracked counter in out, which must have room for all of
+// them, and return how many there are. With out NULL just count them
+int naive_list_c_a( symtab* table, c_a** out )
+{
+  int n = 0;
+  for(int i = 0; i < table->size; i++)
+  {
+    for(c_a* c = table->bucket[i]; c != NULL; c = c->next)
+    {
+      if(out != NULL) out[n] = c;
+      n++;
+    }
+  }
+  return n;
+}
+
 //decrements number of primary samplers of b. If b
 //is not being processed and not being sampled, b is 
 //removed from hashtable.
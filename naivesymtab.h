@@ -22,6 +22,9 @@ typedef struct symtab symtab;
 symtab* new_naivesymtab( int k );
 void free_naivesymtab( symtab* table );
 int naive_lookup( symtab* table, int key );
+c_a* naive_find_c_a( symtab* table, int key );
+c_a* naive_insert_c_a( symtab* table, int key );
+int naive_list_c_a( symtab* table, c_a** out );
 c_a* naive_increment_count(symtab*, int key);
 void naive_increment_prim_samplers(c_a* b);
 void naive_done_processing(symtab* table, c_a* b);
@@ -0,0 +1,70 @@
+/*oblivious.c
+ *Entropy estimation for streams whose length isn't known in advance:
+ *pipes, sockets, or streams that never end.
+ *
+ *The (eps, delta) guarantee needs c = 16/eps^2 log(2/delta) log(m e)
+ *samplers for a stream of length m, which entropymain gets from the
+ *length up front. Here the stream is cut into doubling epochs instead,
+ *and at the start of the epoch beginning at length m the fast
+ *estimator is grown (Estimator_Grow) to the samplers a stream of
+ *length 4m needs. So through the whole epoch, which ends at 2m, the
+ *samplers already there before it (sized for 2m) meet the bound on
+ *their own, and the copies made at m, which share their original's
+ *sample with probability m/(current length), add to it. Memory stays
+ *proportional to the log of the length read so far.
+ */
+
+#include <stdlib.h>
+#include <math.h>
+#include "obliviouspriv.h"
+#include "util.h"
+
+//k counters for the Misra-Gries part, which don't depend on m
+Oblivious_Estimator_type* Oblivious_Estimator_Init(double eps, double delta, int k)
+{
+  Oblivious_Estimator_type* est = (Oblivious_Estimator_type*) safe_malloc(sizeof(Oblivious_Estimator_type));
+  est->eps = eps;
+  est->delta = delta;
+  est->count = 0;
+  est->epoch_end = OBLIVIOUS_FIRST_EPOCH;
+  est->est = Estimator_Init(oblivious_samplers(est, 2*est->epoch_end), k);
+  return est;
+}
+
+void Oblivious_Estimator_Destroy(Oblivious_Estimator_type* est)
+{
+  Estimator_Destroy(est->est);
+  free(est);
+}
+
+int Oblivious_Estimator_Size(Oblivious_Estimator_type* est)
+{
+  return sizeof(Oblivious_Estimator_type) + Estimator_Size(est->est);
+}
+
+//samplers kept now
+int Oblivious_Estimator_Samplers(Oblivious_Estimator_type* est)
+{
+  return oblivious_samplers(est, 2*est->epoch_end);
+}
+
+void Oblivious_Estimator_Update(Oblivious_Estimator_type* est, int token)
+{
+  Estimator_Update(est->est, token);
+  if(++est->count == est->epoch_end)
+  {
+    Estimator_Grow(est->est, oblivious_samplers(est, 4*est->count));
+    est->epoch_end *= 2;
+  }
+}
+
+double Oblivious_Estimator_end_stream(Oblivious_Estimator_type* est)
+{
+  return Estimator_end_stream(est->est);
+}
+
+//samplers the guarantee needs for a stream of length m
+static int oblivious_samplers(Oblivious_Estimator_type* est, long m)
+{
+  return ceil(16 / (est->eps*est->eps) * log(2/est->delta) * (log(m) + 1));
+}
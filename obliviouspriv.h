@@ -0,0 +1,17 @@
+#ifndef OBLIVIOUSPRIV_H
+#define OBLIVIOUSPRIV_H
+#include "obliviouspub.h"
+#include "entropypub.h"
+
+#define OBLIVIOUS_FIRST_EPOCH 1024 //tokens before the samplers first grow
+
+struct Oblivious_Estimator_type{
+  double eps, delta;
+  long count;
+  long epoch_end;          //length at which the samplers next grow
+  Estimator_type* est;
+};
+
+static int oblivious_samplers(Oblivious_Estimator_type* est, long m);
+
+#endif
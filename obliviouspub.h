@@ -0,0 +1,13 @@
+#ifndef OBLIVIOUSPUB_H
+#define OBLIVIOUSPUB_H
+
+typedef struct Oblivious_Estimator_type Oblivious_Estimator_type;
+
+extern Oblivious_Estimator_type* Oblivious_Estimator_Init(double eps, double delta, int k);
+extern void Oblivious_Estimator_Destroy(Oblivious_Estimator_type* est);
+extern int Oblivious_Estimator_Size(Oblivious_Estimator_type* est);
+extern int Oblivious_Estimator_Samplers(Oblivious_Estimator_type* est);
+extern void Oblivious_Estimator_Update(Oblivious_Estimator_type* est, int token);
+extern double Oblivious_Estimator_end_stream(Oblivious_Estimator_type* est);
+
+#endif
@@ -0,0 +1,293 @@
+/*pair.c
+ *Entropies of a stream of pairs (x, y): H(X), H(Y), the joint H(X,Y)
+ *and from them the mutual information and conditional entropies, in
+ *one pass.
+ *
+ *Every pair is one position of three streams at once, the x's, the
+ *y's and the pairs, so one uniform sample of positions serves all
+ *three. Each of c samplers holds a position with the three keys there
+ *and counts r of each key from the position on; the AMS estimator
+ *  X = r log(m/r) - (r-1) log(m/(r-1))
+ *is then applied per stream, as in entropy.c. Samplers know the
+ *position at which they are next replaced and sit in a heap on it, so
+ *an update that replaces nothing costs three table lookups.
+ *
+ *A key with more than half of its stream, found with Misra-Gries
+ *counters, is counted exactly and samplers holding it are left out of
+ *that stream's average: those that remain are uniform over the other
+ *positions. This takes the place of the fast estimator's backup
+ *samplers, which would need a second sample per stream.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <limits.h>
+#include "pairpriv.h"
+#include "prng.h"
+#include "util.h"
+
+//murmur3's 64-bit finalizer
+#define PAIR_MIX(h) ((h) ^= (h) >> 33, (h) *= 0xff51afd7ed558ccdULL, \
+                     (h) ^= (h) >> 33, (h) *= 0xc4ceb9fe1a85ec53ULL, (h) ^= (h) >> 33)
+
+Pair_Estimator_type* Pair_Estimator_Init(int c, int k)
+{
+  Pair_Estimator_type* est = (Pair_Estimator_type*) safe_malloc(sizeof(Pair_Estimator_type));
+  prng_type* prng;
+
+  est->c = c;
+  est->k = k;
+  est->count = 0;
+
+  prng = prng_Init(lrand48(), 2);
+  est->rng = ((unsigned long long) prng_int(prng) << 32 ^ prng_int(prng)) | 1;
+  est->seed = (unsigned long long) prng_int(prng) << 32 ^ prng_int(prng);
+  prng_Destroy(prng);
+
+  //every sampler takes the first position
+  est->samplers = (Pair_Sample*) safe_malloc(c * sizeof(Pair_Sample));
+  est->next_heap = new_heap(pair_next_comp, c+2);
+  for(int i = 0; i < c; i++)
+  {
+    for(int s = 0; s < PAIR_STREAMS; s++)
+    {
+      est->samplers[i].entry[s] = NULL;
+      est->samplers[i].base[s] = 0;
+    }
+    est->samplers[i].next = 1;
+    insert_heap(est->next_heap, &est->samplers[i]);
+  }
+
+  for(int s = 0; s < PAIR_STREAMS; s++)
+  {
+    pair_table* t = &est->tables[s];
+    t->size = 2*c > 0 ? 2*c : 1;
+    t->buckets = (pair_entry**) safe_malloc(t->size * sizeof(pair_entry*));
+    for(int i = 0; i < t->size; i++)
+      t->buckets[i] = NULL;
+    t->entries = 0;
+
+    est->freqs[s].n = 0;
+    est->freqs[s].items = (unsigned long long*) safe_malloc(k * sizeof(unsigned long long));
+    est->freqs[s].counts = (long*) safe_malloc(k * sizeof(long));
+  }
+  return est;
+}
+
+void Pair_Estimator_Destroy(Pair_Estimator_type* est)
+{
+  pair_entry *e, *next;
+  for(int s = 0; s < PAIR_STREAMS; s++)
+  {
+    for(int i = 0; i < est->tables[s].size; i++)
+    {
+      for(e = est->tables[s].buckets[i]; e != NULL; e = next)
+      {
+        next = e->next;
+        free(e);
+      }
+    }
+    free(est->tables[s].buckets);
+    free(est->freqs[s].items);
+    free(est->freqs[s].counts);
+  }
+  free_heap(est->next_heap);
+  free(est->samplers);
+  free(est);
+}
+
+int Pair_Estimator_Size(Pair_Estimator_type* est)
+{
+  int size = sizeof(Pair_Estimator_type) + est->c * sizeof(Pair_Sample) +
+             sizeof_heap(est->next_heap);
+  for(int s = 0; s < PAIR_STREAMS; s++)
+    size += est->tables[s].size * sizeof(pair_entry*) +
+            est->tables[s].entries * sizeof(pair_entry) +
+            est->k * (sizeof(unsigned long long) + sizeof(long));
+  return size;
+}
+
+void Pair_Estimator_Update(Pair_Estimator_type* est, int x, int y)
+{
+  unsigned long long keys[PAIR_STREAMS];
+  pair_entry* e[PAIR_STREAMS];
+  Pair_Sample* sm;
+  double next;
+
+  keys[PAIR_X] = (unsigned int) x;
+  keys[PAIR_Y] = (unsigned int) y;
+  keys[PAIR_XY] = (unsigned long long) (unsigned int) x << 32 | (unsigned int) y;
+  est->count++;
+  for(int s = 0; s < PAIR_STREAMS; s++)
+  {
+    pair_freq_update(&est->freqs[s], est->k, keys[s]);
+    e[s] = pair_find(est, &est->tables[s], keys[s]);
+    if(e[s] != NULL)
+      e[s]->count++;
+  }
+
+  //replace every sampler whose next position is this one
+  while((sm = (Pair_Sample*) peek_min(est->next_heap))->next <= est->count)
+  {
+    delete_min(est->next_heap);
+    for(int s = 0; s < PAIR_STREAMS; s++)
+    {
+      if(e[s] == NULL)
+      {
+        e[s] = pair_hold(est, &est->tables[s], keys[s]);
+        e[s]->count = 1;
+      }
+      e[s]->refs++;
+      if(sm->entry[s] != NULL)
+        pair_release(est, &est->tables[s], sm->entry[s]);
+      sm->entry[s] = e[s];
+      sm->base[s] = e[s]->count - 1;
+    }
+    //a sample of one from count positions survives to position t
+    //with probability count/t
+    next = floor(est->count / pair_uniform(est)) + 1;
+    sm->next = next < LONG_MAX/2 ? (long) next : LONG_MAX/2;
+    insert_heap(est->next_heap, sm);
+  }
+}
+
+//end of stream reached. Compute estimates for the three entropies and
+//what follows from them. The estimates are independent of each other
+//only in their noise, so differences are clamped at 0
+void Pair_Estimator_end_stream(Pair_Estimator_type* est, Pair_Entropies* out)
+{
+  out->hx = pair_entropy(est, PAIR_X);
+  out->hy = pair_entropy(est, PAIR_Y);
+  out->hxy = pair_entropy(est, PAIR_XY);
+  out->mi = fmax(0, out->hx + out->hy - out->hxy);
+  out->hx_y = fmax(0, out->hxy - out->hy);
+  out->hy_x = fmax(0, out->hxy - out->hx);
+}
+
+//entropy of stream s from the samplers
+static double pair_entropy(Pair_Estimator_type* est, int s)
+{
+  pair_freq* f = &est->freqs[s];
+  unsigned long long max_key = 0;
+  double m = est->count, p_max = 0, sum_Xis = 0, r;
+  int n = 0;
+
+  if(est->count == 0)
+    return 0;
+  for(int i = 0; i < f->n; i++)
+  {
+    if(f->counts[i] > est->count/2)
+    {
+      max_key = f->items[i];
+      p_max = f->counts[i] / m;
+    }
+  }
+  for(int i = 0; i < est->c; i++)
+  {
+    Pair_Sample* sm = &est->samplers[i];
+    if(sm->entry[s] == NULL)
+      continue;
+    if(p_max > 0 && sm->entry[s]->key == max_key)
+      continue;
+    r = sm->entry[s]->count - sm->base[s];
+    sum_Xis += r * log2(m/r);
+    if(r > 1) //treat (r-1)log(m/(r-1)) as 0 if r=1
+      sum_Xis -= (r-1) * log2(m/(r-1));
+    n++;
+  }
+  if(p_max == 0)
+    return n > 0 ? sum_Xis / n : 0;
+  return (n > 0 ? (1-p_max) * sum_Xis / n : 0) + p_max * log2(1/p_max);
+}
+
+//uniform in (0, 1], from xorshift64*
+static double pair_uniform(Pair_Estimator_type* est)
+{
+  est->rng ^= est->rng >> 12;
+  est->rng ^= est->rng << 25;
+  est->rng ^= est->rng >> 27;
+  return ((est->rng * 2685821657736338717ULL >> 11) + 1.0) / 9007199254740992.0;
+}
+
+static int pair_bucket(Pair_Estimator_type* est, pair_table* t, unsigned long long key)
+{
+  unsigned long long h = key ^ est->seed;
+  PAIR_MIX(h);
+  return (int) (h % t->size);
+}
+
+static pair_entry* pair_find(Pair_Estimator_type* est, pair_table* t, unsigned long long key)
+{
+  pair_entry* e = t->buckets[pair_bucket(est, t, key)];
+  while(e != NULL && e->key != key)
+    e = e->next;
+  return e;
+}
+
+//a fresh entry for key, which must not be held yet
+static pair_entry* pair_hold(Pair_Estimator_type* est, pair_table* t, unsigned long long key)
+{
+  int bn = pair_bucket(est, t, key);
+  pair_entry* e = (pair_entry*) safe_malloc(sizeof(pair_entry));
+  e->key = key;
+  e->refs = 0;
+  e->count = 0;
+  e->next = t->buckets[bn];
+  t->buckets[bn] = e;
+  t->entries++;
+  return e;
+}
+
+//a sampler lets go of e; forget the key once no sampler holds it
+static void pair_release(Pair_Estimator_type* est, pair_table* t, pair_entry* e)
+{
+  pair_entry** p;
+
+  if(--e->refs > 0)
+    return;
+  p = &t->buckets[pair_bucket(est, t, e->key)];
+  while(*p != e)
+    p = &(*p)->next;
+  *p = e->next;
+  free(e);
+  t->entries--;
+}
+
+//Misra-Gries: a key that is not counted and finds no free counter
+//takes one off every counter instead. k is small, so the counters are
+//scanned
+static void pair_freq_update(pair_freq* f, int k, unsigned long long key)
+{
+  int i, n;
+
+  for(i = 0; i < f->n; i++)
+  {
+    if(f->items[i] == key)
+    {
+      f->counts[i]++;
+      return;
+    }
+  }
+  if(f->n < k)
+  {
+    f->items[f->n] = key;
+    f->counts[f->n++] = 1;
+    return;
+  }
+  for(i = n = 0; i < f->n; i++)
+  {
+    if(--f->counts[i] > 0)
+    {
+      f->items[n] = f->items[i];
+      f->counts[n++] = f->counts[i];
+    }
+  }
+  f->n = n;
+}
+
+static int pair_next_comp(void* a, void* b)
+{
+  long x = ((Pair_Sample*) a)->next, y = ((Pair_Sample*) b)->next;
+  return x < y ? -1 : x > y;
+}
@@ -0,0 +1,60 @@
+#ifndef PAIRPRIV_H
+#define PAIRPRIV_H
+#include "heap.h"
+#include "pairpub.h"
+
+//the three streams every pair feeds: X, Y and the pair itself
+#define PAIR_X 0
+#define PAIR_Y 1
+#define PAIR_XY 2
+#define PAIR_STREAMS 3
+
+//a key some sampler holds, with its count since it was first held
+typedef struct pair_entry{
+  unsigned long long key;
+  int refs;
+  long count;
+  struct pair_entry* next;
+} pair_entry;
+
+//keys of one stream held by samplers, chained in buckets
+typedef struct pair_table{
+  pair_entry** buckets;
+  int size, entries;
+} pair_table;
+
+//Misra-Gries over one stream's keys, with k counters scanned in turn
+typedef struct pair_freq{
+  int n;
+  unsigned long long* items;
+  long* counts;
+} pair_freq;
+
+//one sampled position, shared by the three streams: the key of each
+//stream there, and each key's count before it, so r = count - base
+typedef struct Pair_Sample{
+  pair_entry* entry[PAIR_STREAMS];
+  long base[PAIR_STREAMS];
+  long next;          //position at which the sample is next replaced
+} Pair_Sample;
+
+struct Pair_Estimator_type{
+  int c, k;
+  long count;
+  unsigned long long rng, seed;
+  Pair_Sample* samplers;
+  heap* next_heap;    //samplers by next, smallest first
+  pair_table tables[PAIR_STREAMS];
+  pair_freq freqs[PAIR_STREAMS];
+};
+
+static double pair_uniform(Pair_Estimator_type* est);
+static int pair_bucket(Pair_Estimator_type* est, pair_table* t, unsigned long long key);
+static pair_entry* pair_find(Pair_Estimator_type* est, pair_table* t, unsigned long long key);
+static pair_entry* pair_hold(Pair_Estimator_type* est, pair_table* t, unsigned long long key);
+static void pair_release(Pair_Estimator_type* est, pair_table* t, pair_entry* e);
+static void pair_freq_update(pair_freq* f, int k, unsigned long long key);
+static double pair_entropy(Pair_Estimator_type* est, int s);
+static int pair_next_comp(void* a, void* b);
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef PAIRPUB_H
+#define PAIRPUB_H
+
+typedef struct Pair_Estimator_type Pair_Estimator_type;
+
+//what one pass over a stream of pairs (x, y) gives, in bits
+typedef struct Pair_Entropies{
+  double hx, hy, hxy;      //H(X), H(Y) and the joint H(X,Y)
+  double mi;               //I(X;Y) = H(X) + H(Y) - H(X,Y)
+  double hx_y, hy_x;       //H(X|Y) = H(X,Y) - H(Y), H(Y|X) = H(X,Y) - H(X)
+} Pair_Entropies;
+
+extern Pair_Estimator_type* Pair_Estimator_Init(int c, int k);
+extern void Pair_Estimator_Destroy(Pair_Estimator_type* est);
+extern int Pair_Estimator_Size(Pair_Estimator_type* est);
+extern void Pair_Estimator_Update(Pair_Estimator_type* est, int x, int y);
+extern void Pair_Estimator_end_stream(Pair_Estimator_type* est, Pair_Entropies* out);
+
+#endif
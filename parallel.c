@@ -0,0 +1,195 @@
+/* parallel.c
+ *Key-partitioned parallel driver for the fast estimator. Tokens are
+ *hash-partitioned across P shards, each owned by a worker thread with a
+ *private Estimator_type fed through a lock-free queue. Since every
+ *distinct token lands in exactly one shard, the entropy of the whole
+ *stream decomposes exactly as
+ *
+ *   H = sum_i (m_i/m) H_i + sum_i (m_i/m) log(m/m_i)
+ *
+ *where m_i and H_i are the length and entropy of shard i, so no merging
+ *of samplers is needed.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <sched.h>
+#include "parallelpriv.h"
+#include "prng.h"
+#include "util.h"
+
+static void* shard_main(void* arg);
+static void flush_shard(Shard_type* shard);
+
+//Estimator_Init seeds from lrand48(), which is not thread safe
+static pthread_mutex_t init_lock = PTHREAD_MUTEX_INITIALIZER;
+
+//initialize a parallel estimator with shards worker threads, each
+//running an estimator with c samplers and k counters
+Parallel_Estimator_type* Parallel_Estimator_Init(int c, int k, int shards)
+{
+  Parallel_Estimator_type* pest =
+      (Parallel_Estimator_type*) safe_malloc(sizeof(Parallel_Estimator_type));
+  prng_type* prng = prng_Init(77777, 2);
+
+  if(shards < 1) fatal("Parallel_Estimator_Init: need at least one shard");
+  pest->shards = shards;
+  pest->a = (long long) (prng_int(prng) % MOD);
+  pest->b = (long long) (prng_int(prng) % MOD);
+  prng_Destroy(prng);
+
+  pest->shard = (Shard_type**) safe_malloc(shards * sizeof(Shard_type*));
+  for(int i = 0; i < shards; i++)
+  {
+    Shard_type* shard = (Shard_type*) safe_malloc_aligned(CACHE_LINE, sizeof(Shard_type));
+    shard->c = c;
+    shard->k = k;
+    shard->est = NULL;
+    shard->queue = Ring_Init(SHARD_QUEUE);
+    shard->nstaged = 0;
+    shard->done = 0;
+    shard->count = 0;
+    shard->entropy = 0;
+    if(pthread_create(&shard->thread, NULL, shard_main, shard) != 0)
+      fatal("Parallel_Estimator_Init: can't create worker thread");
+    pest->shard[i] = shard;
+  }
+  pest->running = 1;
+  return pest;
+}
+
+//worker loop: drain the shard's queue into its estimator until the
+//reader marks the stream as done. The estimator is created here so
+//its memory is first touched by the thread that uses it
+static void* shard_main(void* arg)
+{
+  Shard_type* shard = (Shard_type*) arg;
+  int batch[SHARD_BATCH];
+  int n;
+
+  pthread_mutex_lock(&init_lock);
+  shard->est = Estimator_Init(shard->c, shard->k);
+  pthread_mutex_unlock(&init_lock);
+
+  for(;;)
+  {
+    n = Ring_Pop(shard->queue, batch, SHARD_BATCH);
+    for(int i = 0; i < n; i++)
+    {
+      Estimator_Update(shard->est, batch[i]);
+    }
+    if(n == 0)
+    {
+      //check done before re-checking the queue so no tokens are lost
+      if(__atomic_load_n(&shard->done, __ATOMIC_ACQUIRE) &&
+         Ring_Empty(shard->queue))
+        break;
+      sched_yield();
+    }
+  }
+  shard->entropy = Estimator_end_stream(shard->est);
+  return NULL;
+}
+
+static void flush_shard(Shard_type* shard)
+{
+  Ring_Push_All(shard->queue, shard->staged, shard->nstaged);
+  shard->nstaged = 0;
+}
+
+//route a token to the shard owning its key
+void Parallel_Estimator_Update(Parallel_Estimator_type* pest, int token)
+{
+  Shard_type* shard = 
+      pest->shard[hash31(pest->a, pest->b, token) % pest->shards];
+  shard->count++;
+  shard->staged[shard->nstaged++] = token;
+  if(shard->nstaged == SHARD_BATCH)
+    flush_shard(shard);
+}
+
+//flush all staged tokens and wait for every worker to finish
+static void join_shards(Parallel_Estimator_type* pest)
+{
+  if(!pest->running) return;
+  for(int i = 0; i < pest->shards; i++)
+  {
+    flush_shard(pest->shard[i]);
+    __atomic_store_n(&pest->shard[i]->done, 1, __ATOMIC_RELEASE);
+  }
+  for(int i = 0; i < pest->shards; i++)
+  {
+    pthread_join(pest->shard[i]->thread, NULL);
+  }
+  pest->running = 0;
+}
+
+//combine per-shard lengths and entropies of a key-partitioned stream
+//into the entropy of the whole stream
+double Combine_Shard_Entropies(const long* counts, const double* entropies,
+                               int shards)
+{
+  double m = 0, result = 0, p;
+  for(int i = 0; i < shards; i++)
+  {
+    m += counts[i];
+  }
+  if(m == 0) return 0;
+  for(int i = 0; i < shards; i++)
+  {
+    if(counts[i] == 0) continue;
+    p = counts[i]/m;
+    result += p * entropies[i] + p * log10(1/p)/log10(2);
+  }
+  return result;
+}
+
+//end of stream reached. Join the workers and combine their estimates
+double Parallel_Estimator_end_stream(Parallel_Estimator_type* pest)
+{
+  long* counts = (long*) safe_malloc(pest->shards * sizeof(long));
+  double* entropies = (double*) safe_malloc(pest->shards * sizeof(double));
+  double result;
+
+  join_shards(pest);
+  for(int i = 0; i < pest->shards; i++)
+  {
+    counts[i] = pest->shard[i]->count;
+    entropies[i] = pest->shard[i]->entropy;
+  }
+  result = Combine_Shard_Entropies(counts, entropies, pest->shards);
+  free(counts);
+  free(entropies);
+  return result;
+}
+
+// return the size of the estimator in bytes
+int Parallel_Estimator_Size(Parallel_Estimator_type* pest)
+{
+  int size;
+  if(!pest) return 0;
+  size = sizeof(Parallel_Estimator_type) + pest->shards * sizeof(Shard_type*);
+  for(int i = 0; i < pest->shards; i++)
+  {
+    size += sizeof(Shard_type) + sizeof(ring_type) + 
+            (pest->shard[i]->queue->mask+1) * sizeof(int);
+    //workers may still be creating their estimators while running
+    if(!pest->running)
+      size += Estimator_Size(pest->shard[i]->est);
+  }
+  return size;
+}
+
+void Parallel_Estimator_Destroy(Parallel_Estimator_type* pest)
+{
+  join_shards(pest);
+  for(int i = 0; i < pest->shards; i++)
+  {
+    Estimator_Destroy(pest->shard[i]->est);
+    Ring_Destroy(pest->shard[i]->queue);
+    free(pest->shard[i]);
+  }
+  free(pest->shard);
+  free(pest);
+}
@@ -0,0 +1,34 @@
+#ifndef PARALLELPRIV_H
+#define PARALLELPRIV_H
+#include <pthread.h>
+#include "parallelpub.h"
+#include "entropypub.h"
+#include "ring.h"
+
+#define SHARD_BATCH 256     //tokens staged per shard before a queue push
+#define SHARD_QUEUE 65536   //capacity of each shard's queue in tokens
+
+//one worker thread and its private estimator. The reader fills the
+//staging buffer, counts the shard's tokens and sets done; those fields
+//sit on their own cache lines, apart from the ones the worker writes
+typedef struct Shard_type{
+  int c, k;
+  Estimator_type* est;
+  ring_type* queue;
+  double entropy;          //set by the worker when the stream ends
+  pthread_t thread;
+  char pad0[CACHE_LINE];
+  int staged[SHARD_BATCH]; //producer-side batch, written by reader only
+  int nstaged;
+  int done;                //set by reader once the stream has ended
+  long count;              //tokens routed to this shard
+  char pad1[CACHE_LINE];
+} Shard_type;
+
+struct Parallel_Estimator_type{
+  int shards, running;
+  long long a, b;          //hash used to partition tokens across shards
+  Shard_type** shard;     //allocated separately to keep shards off shared lines
+};
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef PARALLELPUB_H
+#define PARALLELPUB_H
+
+typedef struct Parallel_Estimator_type Parallel_Estimator_type;
+
+extern Parallel_Estimator_type* Parallel_Estimator_Init(int c, int k, int shards);
+extern void Parallel_Estimator_Destroy(Parallel_Estimator_type* pest);
+extern int Parallel_Estimator_Size(Parallel_Estimator_type* pest);
+extern void Parallel_Estimator_Update(Parallel_Estimator_type* pest, int token);
+extern double Parallel_Estimator_end_stream(Parallel_Estimator_type* pest);
+extern double Combine_Shard_Entropies(const long* counts, const double* entropies,
+                                      int shards);
+
+#endif
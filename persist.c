@@ -0,0 +1,970 @@
+/* persist.c
+ *Fast estimator (entropy.c) whose working state lives in a file
+ *mapping, so a collector that crashes can map the file again and carry
+ *on without a deserialize step.
+ *
+ *The file holds a header page and two state slots. A slot holds what
+ *Estimator_type holds on the heap, with every pointer replaced by an
+ *index: the samplers name their counters by index into an array of
+ *counters, the counters chain their hash buckets by index, the
+ *primary and backup heaps hold indices, and each counter's heap of
+ *samplers is a block of ints in an area of the slot. Positions in
+ *those heaps (c_s0_pos, backup_pos) are stored as in c_a_heap.c and
+ *backup_heap.c. The header records the offset of every array, so
+ *nothing depends on where the file is mapped. Counters and blocks
+ *come from free lists in the slot; a heap block is moved to the next
+ *size class up when full and down when under a quarter full, which
+ *bounds how many blocks of each class can be in use at once, so every
+ *area is sized when the file is created. The generator and the
+ *Misra-Gries counters (flatfreq.c) are in the slot too, and both take
+ *the same draws as Estimator_Update's, so the estimate matches a heap
+ *estimator seeded the same way.
+ *
+ *Tokens are applied in batches: the first token of a batch copies the
+ *live part of the committed slot into the other one, the batch updates
+ *that copy in place, and the commit marker (the header's seq) is
+ *advanced once the batch is done. A crash at any point leaves the last
+ *committed slot untouched, so Persist_Estimator_Attach resumes from it
+ *and the caller replays the input from Persist_Estimator_Committed
+ *tokens on.
+ *
+ *The state is in the page cache as soon as it is written, which is
+ *enough to survive the process dying. Surviving the machine going down
+ *needs durable set, which syncs the slot before advancing the marker
+ *and the header after it.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "persistpriv.h"
+#include "util.h"
+
+#define INVALID_TOKEN INT_MIN
+#define MAX_WAIT 90000000   //as in entropy.c
+#define persist_round(x, a) (((x) + (a)-1) / (a) * (a))
+#define persist_block_ints(i) (PERSIST_BLOCK << (i))
+
+static int persist_hash(Persist_Estimator_type* est, int key);
+static int32_t* persist_nodes(Persist_Estimator_type* est, int a);
+static void persist_heap_move(Persist_Estimator_type* est, int a, int cls);
+static void persist_sample_insert(Persist_Estimator_type* est, int a, int s);
+static void persist_sample_delete_pos(Persist_Estimator_type* est, int a, int index);
+static void persist_sample_restore(Persist_Estimator_type* est, int a, int index);
+static long persist_backup_key(Persist_Estimator_type* est, int a);
+static void persist_backup_insert(Persist_Estimator_type* est, int a);
+static void persist_backup_delete_pos(Persist_Estimator_type* est, int index);
+static void persist_backup_restore(Persist_Estimator_type* est, int index);
+static void persist_prim_insert(Persist_Estimator_type* est, int s);
+static int persist_prim_delete_min(Persist_Estimator_type* est);
+static int persist_increment_count(Persist_Estimator_type* est, int key);
+static void persist_counter_free(Persist_Estimator_type* est, int a);
+static void persist_increment_prim(Persist_Estimator_type* est, int a, int s);
+static void persist_decrement_prim(Persist_Estimator_type* est, int a, int s);
+static void persist_decrement_backup(Persist_Estimator_type* est, int a);
+static void persist_done_processing(Persist_Estimator_type* est, int a);
+static void persist_reset_wait_times(Persist_Estimator_type* est, int s);
+static void persist_backup_wait(Persist_Estimator_type* est, int s, double r1);
+
+//offsets of everything in a file for c samplers and k counters
+static void persist_layout(persist_header* h, int c, int k, long page)
+{
+  int64_t off;
+  int size;
+
+  h->c = c;
+  h->k = k;
+  h->page = page;
+  //each sampler holds at most two counters; the token being processed
+  //and the first token may hold one more each
+  h->counters = 2*c + 2;
+  h->buckets = 2*c; //as new_symtab(2*c)
+  //a heap holds at most c samplers. Only counters with primary
+  //samplers have a block, and one of class i > 0 is over a quarter
+  //full, so the c samplers fill at most 4c/size of them
+  h->classes = 0;
+  do
+  {
+    size = persist_block_ints(h->classes);
+    h->class_blocks[h->classes] = h->classes == 0 ? c : 4*c/size + 1;
+    h->classes++;
+  } while(size < c+1 && h->classes < PERSIST_CLASSES);
+
+  off = persist_round((int64_t) sizeof(persist_state), 64);
+  h->samplers_off = off;
+  off += persist_round((int64_t) c * sizeof(persist_sampler), 64);
+  h->counters_off = off;
+  off += persist_round((int64_t) h->counters * sizeof(persist_counter), 64);
+  h->buckets_off = off;
+  off += persist_round((int64_t) h->buckets * sizeof(int32_t), 64);
+  //heaps start at slot 1, so c entries need c+1 slots
+  h->prim_off = off;
+  off += persist_round((int64_t) (c+1) * sizeof(int32_t), 64);
+  h->backup_off = off;
+  off += persist_round((int64_t) (c+1) * sizeof(int32_t), 64);
+  h->freq_off = off;
+  off += persist_round(FlatFreq_Ints(k) * (int64_t) sizeof(int), 64);
+  for(int i = 0; i < h->classes; i++)
+  {
+    h->class_off[i] = off;
+    off += persist_round((int64_t) h->class_blocks[i] * persist_block_ints(i) *
+                         sizeof(int32_t), 64);
+  }
+  h->slot_bytes = persist_round(off, page);
+  h->slot_off[0] = persist_round((int64_t) sizeof(persist_header), page);
+  h->slot_off[1] = h->slot_off[0] + h->slot_bytes;
+  h->file_bytes = h->slot_off[1] + h->slot_bytes;
+}
+
+//point the estimator's arrays at a slot of the mapping
+static void persist_bind(Persist_Estimator_type* est, int slot)
+{
+  persist_header* h = est->head;
+  unsigned char* s = est->base + h->slot_off[slot];
+
+  est->st = (persist_state*) s;
+  est->sm = (persist_sampler*) (s + h->samplers_off);
+  est->ca = (persist_counter*) (s + h->counters_off);
+  est->bucket = (int32_t*) (s + h->buckets_off);
+  est->prim = (int32_t*) (s + h->prim_off);
+  est->backup = (int32_t*) (s + h->backup_off);
+  for(int i = 0; i < h->classes; i++)
+    est->area[i] = (int32_t*) (s + h->class_off[i]);
+  FlatFreq_Attach(&est->freq, h->k, h->a, h->b, (int*) (s + h->freq_off));
+}
+
+//copy slot from to slot to. Counters and blocks past the tops of their
+//free lists have never been used, so they are left out
+static void persist_copy(Persist_Estimator_type* est, int from, int to)
+{
+  persist_header* h = est->head;
+  unsigned char* s = est->base + h->slot_off[from];
+  unsigned char* d = est->base + h->slot_off[to];
+  persist_state* st = (persist_state*) s;
+
+  memcpy(d, s, h->counters_off);
+  memcpy(d + h->counters_off, s + h->counters_off,
+         (size_t) st->counters_top * sizeof(persist_counter));
+  memcpy(d + h->buckets_off, s + h->buckets_off, h->class_off[0] - h->buckets_off);
+  for(int i = 0; i < h->classes; i++)
+    memcpy(d + h->class_off[i], s + h->class_off[i],
+           (size_t) st->class_top[i] * persist_block_ints(i) * sizeof(int32_t));
+}
+
+static Persist_Estimator_type* persist_map(int fd, long bytes, int batch, int durable)
+{
+  void* base = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if(base == MAP_FAILED)
+    return NULL;
+  Persist_Estimator_type* est =
+      (Persist_Estimator_type*) safe_malloc(sizeof(Persist_Estimator_type));
+  est->fd = fd;
+  est->base = (unsigned char*) base;
+  est->head = (persist_header*) base;
+  est->batch = batch > 0 ? batch : 1;
+  est->durable = durable;
+  est->pending = 0;
+  return est;
+}
+
+//create (or overwrite) path holding an empty estimator. Returns NULL if
+//the file cannot be created
+Persist_Estimator_type* Persist_Estimator_Create(const char* path, int c, int k,
+                                                 int batch, int durable)
+{
+  persist_header h;
+  prng_type* prng;
+  Persist_Estimator_type* est;
+  persist_state* st;
+  int fd;
+
+  if(c <= 0 || k <= 0 || c >= persist_block_ints(PERSIST_CLASSES-1))
+    return NULL;
+  memset(&h, 0, sizeof(h));
+  persist_layout(&h, c, k, sysconf(_SC_PAGESIZE));
+  fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if(fd < 0)
+    return NULL;
+  if(ftruncate(fd, h.file_bytes) != 0 ||
+     (est = persist_map(fd, h.file_bytes, batch, durable)) == NULL)
+  {
+    close(fd);
+    return NULL;
+  }
+  //same Misra-Gries hash as Freq_Init, same bucket hash as new_symtab
+  prng = prng_Init(45445, 2);
+  for(int i = 0; i < 4; i++)
+    prng_int(prng);
+  h.a = (long long) (prng_int(prng) % MOD);
+  h.b = (long long) (prng_int(prng) % MOD);
+  prng_Destroy(prng);
+  prng = prng_Init(12345, 2);
+  for(int i = 0; i < 2; i++)
+    prng_int(prng);
+  h.sym_a = (long long) (prng_int(prng) % MOD);
+  h.sym_b = (long long) (prng_int(prng) % MOD);
+  prng_Destroy(prng);
+
+  //the magic goes in last, so a file whose creation was cut short is
+  //never attached
+  memcpy(est->head, &h, sizeof(h));
+  est->c = c;
+  est->k = k;
+  est->work = 0;
+  persist_bind(est, 0);
+  st = est->st;
+  st->count = 0;
+  st->two_distinct_tokens = 0;
+  st->first = PERSIST_NONE;
+  st->prim_size = st->backup_size = 0;
+  st->free_counter = PERSIST_NONE;
+  st->counters_top = 0;
+  for(int i = 0; i < PERSIST_CLASSES; i++)
+  {
+    st->class_free[i] = PERSIST_NONE;
+    st->class_top[i] = 0;
+  }
+  //as Estimator_Init, then kept in the slot
+  prng = prng_Init(lrand48(), 2);
+  st->prng = *prng;
+  prng_Destroy(prng);
+  for(int i = 0; i < c; i++)
+  { //as Sample_Init
+    persist_sampler* sm = &est->sm[i];
+    memset(sm, 0, sizeof(*sm));
+    sm->t0 = sm->t1 = 1;
+    sm->c_s0 = sm->c_s1 = PERSIST_NONE;
+    sm->c_s0_pos = PERSIST_NONE;
+  }
+  for(int i = 0; i < h.buckets; i++)
+    est->bucket[i] = PERSIST_NONE;
+  FlatFreq_Reset(&est->freq);
+  if(durable)
+    msync(est->base, h.file_bytes, MS_SYNC);
+  est->head->version = PERSIST_VERSION;
+  __atomic_store_n(&est->head->magic, PERSIST_MAGIC, __ATOMIC_RELEASE);
+  if(durable)
+    msync(est->base, h.page, MS_SYNC);
+  return est;
+}
+
+//map an existing file and resume from its last committed batch. Returns
+//NULL if the file is missing or is not a complete estimator file
+Persist_Estimator_type* Persist_Estimator_Attach(const char* path, int batch, int durable)
+{
+  persist_header h, expect;
+  persist_state* st;
+  struct stat sb;
+  Persist_Estimator_type* est;
+  int fd, bad;
+  long page = sysconf(_SC_PAGESIZE);
+
+  fd = open(path, O_RDWR);
+  if(fd < 0)
+    return NULL;
+  if(fstat(fd, &sb) != 0 || sb.st_size < (off_t) sizeof(h) ||
+     pread(fd, &h, sizeof(h), 0) != (ssize_t) sizeof(h))
+  {
+    close(fd);
+    return NULL;
+  }
+  //the layout is a function of c, k and the page size, so anything
+  //else in the header that differs from a fresh layout is damage
+  memset(&expect, 0, sizeof(expect));
+  bad = h.magic != PERSIST_MAGIC || h.version != PERSIST_VERSION || h.c <= 0 ||
+        h.k <= 0 || h.c >= persist_block_ints(PERSIST_CLASSES-1) ||
+        h.page <= 0 || h.page % page != 0 || h.seq < 0;
+  if(!bad)
+  {
+    persist_layout(&expect, h.c, h.k, h.page);
+    expect.magic = h.magic;
+    expect.version = h.version;
+    expect.a = h.a;
+    expect.b = h.b;
+    expect.sym_a = h.sym_a;
+    expect.sym_b = h.sym_b;
+    expect.seq = h.seq;
+    bad = memcmp(&h, &expect, sizeof(h)) != 0 || sb.st_size != h.file_bytes;
+  }
+  if(bad || (est = persist_map(fd, h.file_bytes, batch, durable)) == NULL)
+  {
+    close(fd);
+    return NULL;
+  }
+  est->c = h.c;
+  est->k = h.k;
+  est->work = h.seq & 1;
+  persist_bind(est, est->work);
+  st = est->st;
+  bad = st->count < 0 || st->counters_top < 0 || st->counters_top > h.counters ||
+        st->prim_size < 0 || st->prim_size > h.c ||
+        st->backup_size < 0 || st->backup_size > h.c ||
+        *est->freq.used < 0 || *est->freq.used > h.k;
+  for(int i = 0; i < h.classes; i++)
+    bad |= st->class_top[i] < 0 || st->class_top[i] > h.class_blocks[i];
+  if(bad)
+  {
+    Persist_Estimator_Close(est);
+    return NULL;
+  }
+  return est;
+}
+
+//commit any pending tokens and unmap. The file stays behind
+void Persist_Estimator_Close(Persist_Estimator_type* est)
+{
+  Persist_Estimator_Commit(est);
+  munmap(est->base, est->head->file_bytes);
+  close(est->fd);
+  free(est);
+}
+
+int Persist_Estimator_Size(Persist_Estimator_type* est)
+{
+  return sizeof(Persist_Estimator_type) + est->head->file_bytes;
+}
+
+/******************************************************************/
+//the pieces of symtab.c, c_a_heap.c, backup_heap.c and heap.c that
+//Estimator_Update uses, over indices
+
+static int persist_hash(Persist_Estimator_type* est, int key)
+{
+  return hash31(est->head->sym_a, est->head->sym_b, key) % est->head->buckets;
+}
+
+//a's heap of samplers
+static int32_t* persist_nodes(Persist_Estimator_type* est, int a)
+{
+  persist_counter* n = &est->ca[a];
+  return est->area[n->heap_class] + (int64_t) n->heap * persist_block_ints(n->heap_class);
+}
+
+//move a's heap of samplers to a free block of class cls, taking one if
+//it has none. The first int of a free block links the next one
+static void persist_heap_move(Persist_Estimator_type* est, int a, int cls)
+{
+  persist_state* st = est->st;
+  persist_counter* n = &est->ca[a];
+  int b = st->class_free[cls];
+  int32_t* old;
+
+  if(b != PERSIST_NONE)
+    st->class_free[cls] = est->area[cls][(int64_t) b * persist_block_ints(cls)];
+  else if(st->class_top[cls] < est->head->class_blocks[cls])
+    b = st->class_top[cls]++;
+  else
+    fatal("persist: heap blocks of class %d used up\n", cls);
+  if(n->heap != PERSIST_NONE)
+  {
+    old = persist_nodes(est, a);
+    memcpy(est->area[cls] + (int64_t) b * persist_block_ints(cls), old,
+           (n->heap_size + 1) * sizeof(int32_t));
+    old[0] = st->class_free[n->heap_class];
+    st->class_free[n->heap_class] = n->heap;
+  }
+  n->heap = b;
+  n->heap_class = cls;
+}
+
+//insert_c_a_heap
+static void persist_sample_insert(Persist_Estimator_type* est, int a, int s)
+{
+  persist_counter* n = &est->ca[a];
+  persist_sampler* sm = est->sm;
+  int32_t* node;
+  int hole, scan;
+
+  if(n->heap == PERSIST_NONE)
+    persist_heap_move(est, a, 0);
+  else if(n->heap_size + 1 == persist_block_ints(n->heap_class))
+    persist_heap_move(est, a, n->heap_class + 1);
+  node = persist_nodes(est, a);
+  hole = ++n->heap_size;
+  while(hole != 1)
+  {
+    scan = hole/2;
+    if(sm[node[scan]].backup_minus_delay <= sm[s].backup_minus_delay)
+      break;
+    node[hole] = node[scan];
+    sm[node[hole]].c_s0_pos = hole;
+    hole = scan;
+  }
+  sm[s].c_s0_pos = hole;
+  node[hole] = s;
+}
+
+//delete_pos_c_a_heap. The block goes back once the heap is empty, or
+//down a class once it is under a quarter full
+static void persist_sample_delete_pos(Persist_Estimator_type* est, int a, int index)
+{
+  persist_counter* n = &est->ca[a];
+  int32_t* node = persist_nodes(est, a);
+
+  if(n->heap_size <= 0) fatal("Attempt to delete from empty heap\n");
+  if(index > n->heap_size) fatal("index in persist_sample_delete_pos too big\n");
+  est->sm[node[index]].c_s0_pos = PERSIST_NONE;
+  int value = node[n->heap_size--];
+  if(index <= n->heap_size)
+  {
+    node[index] = value;
+    persist_sample_restore(est, a, index);
+  }
+  if(n->heap_size == 0)
+  {
+    node[0] = est->st->class_free[n->heap_class];
+    est->st->class_free[n->heap_class] = n->heap;
+    n->heap = PERSIST_NONE;
+    n->heap_class = 0;
+  }
+  else if(n->heap_class > 0 && n->heap_size < persist_block_ints(n->heap_class)/4)
+    persist_heap_move(est, a, n->heap_class - 1);
+}
+
+//restore_c_a_heap_property
+static void persist_sample_restore(Persist_Estimator_type* est, int a, int index)
+{
+  persist_counter* n = &est->ca[a];
+  persist_sampler* sm = est->sm;
+  int32_t* node = persist_nodes(est, a);
+  int end = n->heap_size + 1;
+  int hole = index, value, lson, rson, smaller, scan;
+
+  if(index == PERSIST_NONE) fatal("persist_sample_restore called with index -1\n");
+  if(index >= end) fatal("index in persist_sample_restore too big\n");
+  value = node[index];
+  lson = 2*hole;
+  rson = 2*hole + 1;
+  if((lson < end && sm[value].backup_minus_delay > sm[node[lson]].backup_minus_delay) ||
+     (rson < end && sm[value].backup_minus_delay > sm[node[rson]].backup_minus_delay))
+  {
+    for(;;)
+    {
+      lson = 2*hole;
+      rson = 2*hole + 1;
+      smaller = lson;
+      if(lson >= end) break;
+      if(rson < end &&
+         sm[node[lson]].backup_minus_delay > sm[node[rson]].backup_minus_delay)
+        smaller = rson;
+      if(sm[value].backup_minus_delay <= sm[node[smaller]].backup_minus_delay)
+        break;
+      node[hole] = node[smaller];
+      sm[node[hole]].c_s0_pos = hole;
+      hole = smaller;
+    }
+  }
+  else
+  {
+    while(hole != 1)
+    {
+      scan = hole/2;
+      if(sm[node[scan]].backup_minus_delay <= sm[value].backup_minus_delay)
+        break;
+      node[hole] = node[scan];
+      sm[node[hole]].c_s0_pos = hole;
+      hole = scan;
+    }
+  }
+  sm[value].c_s0_pos = hole;
+  node[hole] = value;
+}
+
+//b_cmp's key: when a's next backup sample is due
+static long persist_backup_key(Persist_Estimator_type* est, int a)
+{
+  return (long) est->ca[a].count + est->sm[persist_nodes(est, a)[1]].backup_minus_delay;
+}
+
+//insert_bheap
+static void persist_backup_insert(Persist_Estimator_type* est, int a)
+{
+  int32_t* node = est->backup;
+  long key = persist_backup_key(est, a);
+  int hole = ++est->st->backup_size, scan;
+
+  while(hole != 1)
+  {
+    scan = hole/2;
+    if(persist_backup_key(est, node[scan]) <= key)
+      break;
+    node[hole] = node[scan];
+    est->ca[node[hole]].backup_pos = hole;
+    hole = scan;
+  }
+  est->ca[a].backup_pos = hole;
+  node[hole] = a;
+}
+
+//delete_pos_bheap
+static void persist_backup_delete_pos(Persist_Estimator_type* est, int index)
+{
+  int32_t* node = est->backup;
+  persist_state* st = est->st;
+
+  if(st->backup_size <= 0) fatal("Attempt to delete from empty heap\n");
+  if(index > st->backup_size) fatal("index in persist_backup_delete_pos too big\n");
+  est->ca[node[index]].backup_pos = PERSIST_NONE;
+  st->backup_size--;
+  if(index <= st->backup_size)
+  {
+    node[index] = node[st->backup_size + 1];
+    persist_backup_restore(est, index);
+  }
+}
+
+//restore_bheap_property
+static void persist_backup_restore(Persist_Estimator_type* est, int index)
+{
+  int32_t* node = est->backup;
+  int end = est->st->backup_size + 1;
+  int hole = index, value, lson, rson, smaller, scan;
+  long key;
+
+  if(index == PERSIST_NONE) return;
+  if(index >= end) fatal("index in persist_backup_restore too big\n");
+  value = node[index];
+  key = persist_backup_key(est, value);
+  lson = 2*hole;
+  rson = 2*hole + 1;
+  if((lson < end && key > persist_backup_key(est, node[lson])) ||
+     (rson < end && key > persist_backup_key(est, node[rson])))
+  {
+    for(;;)
+    {
+      lson = 2*hole;
+      rson = 2*hole + 1;
+      smaller = lson;
+      if(lson >= end) break;
+      if(rson < end &&
+         persist_backup_key(est, node[lson]) > persist_backup_key(est, node[rson]))
+        smaller = rson;
+      if(key <= persist_backup_key(est, node[smaller]))
+        break;
+      node[hole] = node[smaller];
+      est->ca[node[hole]].backup_pos = hole;
+      hole = smaller;
+    }
+  }
+  else
+  {
+    while(hole != 1)
+    {
+      scan = hole/2;
+      if(persist_backup_key(est, node[scan]) <= key)
+        break;
+      node[hole] = node[scan];
+      est->ca[node[hole]].backup_pos = hole;
+      hole = scan;
+    }
+  }
+  est->ca[value].backup_pos = hole;
+  node[hole] = value;
+}
+
+//insert_heap on the primary heap
+static void persist_prim_insert(Persist_Estimator_type* est, int s)
+{
+  int32_t* node = est->prim;
+  int hole = ++est->st->prim_size, scan;
+
+  while(hole != 1)
+  {
+    scan = hole/2;
+    if(est->sm[node[scan]].prim <= est->sm[s].prim)
+      break;
+    node[hole] = node[scan];
+    hole = scan;
+  }
+  node[hole] = s;
+}
+
+//delete_min on the primary heap
+static int persist_prim_delete_min(Persist_Estimator_type* est)
+{
+  int32_t* node = est->prim;
+  persist_sampler* sm = est->sm;
+  int end, hole = 1, lson, rson, smaller, minval, value;
+
+  if(est->st->prim_size <= 0) fatal("Attempt to delete from empty heap\n");
+  minval = node[1];
+  end = est->st->prim_size--;
+  value = node[end];
+  for(;;)
+  {
+    lson = 2*hole;
+    rson = 2*hole + 1;
+    smaller = lson;
+    if(lson >= end) break;
+    if(rson < end && sm[node[lson]].prim > sm[node[rson]].prim)
+      smaller = rson;
+    if(sm[value].prim <= sm[node[smaller]].prim)
+      break;
+    node[hole] = node[smaller];
+    hole = smaller;
+  }
+  node[hole] = value;
+  return minval;
+}
+
+//increment_count: count key, adding a counter for it if it has none.
+//Leaves the counter processing
+static int persist_increment_count(Persist_Estimator_type* est, int key)
+{
+  persist_state* st = est->st;
+  int bn = persist_hash(est, key);
+  int a;
+
+  for(a = est->bucket[bn]; a != PERSIST_NONE; a = est->ca[a].next)
+  {
+    if(est->ca[a].key == key)
+    {
+      est->ca[a].count++;
+      est->ca[a].processing = 1;
+      return a;
+    }
+  }
+  if(st->free_counter != PERSIST_NONE)
+  {
+    a = st->free_counter;
+    st->free_counter = est->ca[a].next;
+  }
+  else if(st->counters_top < est->head->counters)
+    a = st->counters_top++;
+  else
+    fatal("persist: counters used up\n");
+  persist_counter* n = &est->ca[a];
+  n->key = key;
+  n->count = n->processing = 1;
+  n->num_prim_samplers = n->num_backup_samplers = 0;
+  n->heap = PERSIST_NONE;
+  n->heap_class = n->heap_size = 0;
+  n->backup_pos = PERSIST_NONE;
+  n->previous = PERSIST_NONE;
+  n->next = est->bucket[bn];
+  if(n->next != PERSIST_NONE)
+    est->ca[n->next].previous = a;
+  est->bucket[bn] = a;
+  return a;
+}
+
+//take a out of its bucket and put it, and its block, on the free lists
+static void persist_counter_free(Persist_Estimator_type* est, int a)
+{
+  persist_counter* n = &est->ca[a];
+
+  if(n->previous == PERSIST_NONE)
+    est->bucket[persist_hash(est, n->key)] = n->next;
+  else
+    est->ca[n->previous].next = n->next;
+  if(n->next != PERSIST_NONE)
+    est->ca[n->next].previous = n->previous;
+  if(n->heap != PERSIST_NONE)
+  {
+    persist_nodes(est, a)[0] = est->st->class_free[n->heap_class];
+    est->st->class_free[n->heap_class] = n->heap;
+    n->heap = PERSIST_NONE;
+  }
+  n->next = est->st->free_counter;
+  est->st->free_counter = a;
+}
+
+//increment_prim_samplers
+static void persist_increment_prim(Persist_Estimator_type* est, int a, int s)
+{
+  est->ca[a].num_prim_samplers++;
+  persist_sample_insert(est, a, s);
+  if(est->ca[a].num_prim_samplers == 1)
+    persist_backup_insert(est, a);
+  else
+    persist_backup_restore(est, est->ca[a].backup_pos);
+}
+
+//decrement_prim_samplers
+static void persist_decrement_prim(Persist_Estimator_type* est, int a, int s)
+{
+  persist_counter* n = &est->ca[a];
+
+  n->num_prim_samplers--;
+  if(n->num_prim_samplers == 0)
+  {
+    persist_backup_delete_pos(est, n->backup_pos);
+    if(n->num_backup_samplers == n->processing && n->processing == 0)
+    {
+      persist_counter_free(est, a);
+      return;
+    }
+  }
+  persist_sample_delete_pos(est, a, est->sm[s].c_s0_pos);
+  persist_backup_restore(est, n->backup_pos);
+}
+
+//decrement_backup_samplers
+static void persist_decrement_backup(Persist_Estimator_type* est, int a)
+{
+  persist_counter* n = &est->ca[a];
+
+  n->num_backup_samplers--;
+  if(n->num_prim_samplers == n->num_backup_samplers &&
+     n->num_backup_samplers == n->processing && n->processing == 0)
+    persist_counter_free(est, a);
+}
+
+//done_processing
+static void persist_done_processing(Persist_Estimator_type* est, int a)
+{
+  persist_counter* n = &est->ca[a];
+
+  n->processing = 0;
+  if(n->num_prim_samplers == n->num_backup_samplers && n->num_backup_samplers == 0)
+    persist_counter_free(est, a);
+}
+
+/******************************************************************/
+
+//reset_wait_times
+static void persist_reset_wait_times(Persist_Estimator_type* est, int s)
+{
+  persist_sampler* cur = &est->sm[s];
+  double r0 = prng_float(&est->st->prng);
+  double r1 = prng_float(&est->st->prng);
+
+  if(r0 == 0) cur->prim = est->st->count+1;
+  else if(cur->t0 == 0)
+    cur->prim = MAX_WAIT;
+  else
+    cur->prim = ceil(log(r0)/log(1-cur->t0)) + est->st->count;
+  if(cur->prim < 0 || cur->prim > MAX_WAIT) //check for overflow
+    cur->prim = MAX_WAIT;
+  persist_backup_wait(est, s, r1);
+}
+
+//s's backup wait time from the uniform r1
+static void persist_backup_wait(Persist_Estimator_type* est, int s, double r1)
+{
+  persist_sampler* cur = &est->sm[s];
+  int c0 = est->ca[cur->c_s0].count;
+  int wait;
+
+  if(r1 == 0) cur->backup_minus_delay = est->st->count + 1 - c0;
+  else if(cur->t1-cur->t0 == 0)
+    cur->backup_minus_delay = MAX_WAIT - c0;
+  else
+  {
+    wait = ceil(log(r1)/log(1.0-(cur->t1-cur->t0)));
+    if(wait < 0 || wait > MAX_WAIT) //check for overflow
+      cur->backup_minus_delay = MAX_WAIT - c0;
+    else
+      cur->backup_minus_delay = wait + est->st->count - c0;
+  }
+}
+
+//Estimator_Update on the slot being written
+void Persist_Estimator_Update(Persist_Estimator_type* est, int token)
+{
+  persist_state* st;
+  persist_sampler* sm;
+  persist_sampler* cur;
+  int counter, min, min2, old_c_s1;
+  double r;
+
+  //start a batch in the slot the marker does not point at
+  if(est->pending == 0)
+  {
+    int from = est->head->seq & 1;
+    est->work = from ^ 1;
+    persist_copy(est, from, est->work);
+    persist_bind(est, est->work);
+  }
+  st = est->st;
+  sm = est->sm;
+  st->count++;
+  FlatFreq_Update(&est->freq, token);
+  counter = persist_increment_count(est, token);
+
+  if(st->count == 1)
+  { //handle_first
+    st->first = counter;
+    for(int i = 0; i < est->c; i++)
+    {
+      sm[i].c_s0 = counter;
+      sm[i].val_c_s0 = 1;
+      sm[i].t0 = prng_float(&st->prng);
+    }
+  }
+  else if(est->ca[counter].count == st->count)
+  { //handle_nondistinct
+    for(int i = 0; i < est->c; i++)
+    {
+      r = prng_float(&st->prng);
+      if(r < sm[i].t0)
+      {
+        sm[i].t0 = r;
+        sm[i].val_c_s0 = est->ca[counter].count;
+      }
+    }
+  }
+  else if(st->two_distinct_tokens == 0)
+  { //handle_second_distinct
+    st->two_distinct_tokens = 1;
+    for(int i = 0; i < est->c; i++)
+    {
+      cur = &sm[i];
+      r = prng_float(&st->prng);
+      if(r < cur->t0)
+      {
+        cur->val_c_s1 = cur->val_c_s0;
+        cur->c_s1 = cur->c_s0;
+        cur->t1 = cur->t0;
+        cur->val_c_s0 = 1;
+        cur->c_s0 = counter;
+        cur->t0 = r;
+      }
+      else
+      {
+        cur->val_c_s1 = 1;
+        cur->c_s1 = counter;
+        cur->t1 = r;
+      }
+      persist_reset_wait_times(est, i);
+      persist_prim_insert(est, i);
+      persist_increment_prim(est, cur->c_s0, i);
+      est->ca[cur->c_s1].num_backup_samplers++;
+    }
+    persist_done_processing(est, counter);
+    persist_done_processing(est, st->first);
+  }
+  else
+  {
+    persist_backup_restore(est, est->ca[counter].backup_pos);
+
+    while(sm[est->prim[1]].prim <= st->count)
+    {
+      min = persist_prim_delete_min(est);
+      cur = &sm[min];
+      if(cur->prim < st->count)
+        fatal("a sampler's prim decreased. fatal error\n");
+      //have min take a new primary sample
+      if(cur->c_s0 == counter)
+      {
+        cur->val_c_s0 = est->ca[counter].count;
+        cur->t0 *= prng_float(&st->prng);
+        persist_reset_wait_times(est, min);
+        persist_sample_restore(est, counter, cur->c_s0_pos);
+        persist_backup_restore(est, est->ca[counter].backup_pos);
+      }
+      else
+      {
+        old_c_s1 = cur->c_s1;
+        cur->c_s1 = cur->c_s0;
+        cur->val_c_s1 = cur->val_c_s0;
+        cur->t1 = cur->t0;
+        cur->c_s0 = counter;
+        cur->val_c_s0 = est->ca[counter].count;
+        cur->t0 *= prng_float(&st->prng);
+        persist_reset_wait_times(est, min);
+        //in Estimator_Update's order, so c_s1 is not freed while min
+        //is still in its heap
+        est->ca[cur->c_s1].num_backup_samplers++;
+        persist_decrement_backup(est, old_c_s1);
+        persist_decrement_prim(est, cur->c_s1, min);
+        persist_increment_prim(est, counter, min);
+      }
+      persist_prim_insert(est, min);
+    }
+
+    min2 = est->backup[1];
+    min = persist_nodes(est, min2)[1];
+    while(sm[min].backup_minus_delay + est->ca[min2].count <= st->count)
+    {
+      if(sm[min].backup_minus_delay + est->ca[min2].count < st->count)
+        fatal("error: sampler's backup wait time decreased\n");
+      cur = &sm[min];
+      persist_decrement_backup(est, cur->c_s1);
+      est->ca[counter].num_backup_samplers++;
+      cur->t1 -= prng_float(&st->prng) * (cur->t1-cur->t0);
+      cur->c_s1 = counter;
+      cur->val_c_s1 = est->ca[counter].count;
+      persist_backup_wait(est, min, prng_float(&st->prng));
+      persist_sample_restore(est, cur->c_s0, cur->c_s0_pos);
+      persist_backup_restore(est, est->ca[cur->c_s0].backup_pos);
+
+      min2 = est->backup[1];
+      min = persist_nodes(est, min2)[1];
+    }
+    persist_done_processing(est, counter);
+  }
+  if(++est->pending == est->batch)
+    Persist_Estimator_Commit(est);
+}
+
+//make the pending tokens part of the committed state
+void Persist_Estimator_Commit(Persist_Estimator_type* est)
+{
+  persist_header* h = est->head;
+
+  if(est->pending == 0)
+    return;
+  if(est->durable)
+    msync(est->base + h->slot_off[est->work], h->slot_bytes, MS_SYNC);
+  __atomic_store_n(&h->seq, h->seq + 1, __ATOMIC_RELEASE);
+  if(est->durable)
+    msync(est->base, h->page, MS_SYNC);
+  est->pending = 0;
+}
+
+//tokens covered by the committed state: after a crash, replay the
+//input from this position
+long Persist_Estimator_Committed(Persist_Estimator_type* est)
+{
+  return ((persist_state*) (est->base + est->head->slot_off[est->head->seq & 1]))->count;
+}
+
+//Estimator_end_stream
+double Persist_Estimator_end_stream(Persist_Estimator_type* est)
+{
+  int max_count = 0, max_token = INVALID_TOKEN, r, m;
+  double p_max, sum_Xis = 0;
+  persist_sampler* cur;
+
+  Persist_Estimator_Commit(est);
+  m = est->st->count;
+  if(m == 0 || est->st->two_distinct_tokens == 0)
+    return 0;
+  FlatFreq_Max(&est->freq, &max_token, &max_count);
+  if(max_count > (int) (m/2))
+  {
+    p_max = (double) max_count/m;
+    for(int i = 0; i < est->c; i++)
+    {
+      cur = &est->sm[i];
+      if(est->ca[cur->c_s0].key == max_token)
+        r = est->ca[cur->c_s1].count - cur->val_c_s1 + 1;
+      else
+        r = est->ca[cur->c_s0].count - cur->val_c_s0 + 1;
+      sum_Xis += (double) r * log10((double) m/r)/log10(2);
+      if(r > 1) //treat (r-1)log(m/(r-1)) as 0 if r=1, also ignore r=0
+        sum_Xis -= (double) (r-1) * log10((double) m/(r-1))/log10(2);
+    }
+    return (1-p_max) * (sum_Xis / est->c) + p_max * log10(1/p_max)/log10(2);
+  }
+  for(int i = 0; i < est->c; i++)
+  {
+    cur = &est->sm[i];
+    r = est->ca[cur->c_s0].count - cur->val_c_s0 + 1;
+    if(r != 0) //ignore empty stream
+      sum_Xis += r * log10((double) m/r)/log10(2);
+    if(r > 1) //treat (r-1)log(m/(r-1)) as 0 if r=1, also ignore r=0
+      sum_Xis -= (r-1) * log10((double) m/(r-1))/log10(2);
+  }
+  return sum_Xis / est->c;
+}
@@ -0,0 +1,217 @@
+/*Benchmark for the file-backed estimator in persist.c.
+ *
+ *Times updates to the heap-resident fast estimator (entropy.c) and to
+ *the persistent one over the same synthetic zipfian stream, for a few batch
+ *sizes (the batch is the unit of commit, so it sets how much copying
+ *and, with -D, syncing each token pays for). Both start from the same
+ *seed, so their estimates should agree exactly.
+ *
+ *Then checks recovery: a child process attaches to a fresh file, is
+ *killed in the middle of a batch partway through the stream, and this
+ *process attaches again, replays from the committed position and
+ *compares the result with an uninterrupted run.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <signal.h>
+#include <unistd.h>
+#include <ctype.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include "massdal.h"
+#include "prng.h"
+#include "entropypub.h"
+#include "persistpub.h"
+#include "util.h"
+
+#define LENGTH_DEFAULT 200000
+#define RANGE_DEFAULT 99999
+#define PATH_DEFAULT "persist.state"
+//the estimators seed themselves from lrand48(); every run reseeds it
+//with this so they all sample the same positions
+#define SEED 44545
+
+static int* CreateStream(int length, double zipfpar, int range, double* exact);
+static double Run_Persist(const char* path, int* stream, int length, int c, int k,
+                          int batch, int durable, long* ms);
+static long Now_Usec();
+
+int main(int argc, char **argv) 
+{
+  int length = LENGTH_DEFAULT, range = RANGE_DEFAULT, c = 0, k = 0, batch = 0;
+  int durable = 0, next;
+  double zipfparam = 1.1, eps = .5, delta = .1, exact;
+  const char* path = PATH_DEFAULT;
+  int batches[] = {256, 4096, 65536};
+  int nbatches = 3;
+  
+  while ((next = getopt (argc, argv, "z:l:r:e:d:c:k:b:f:D")) != -1)
+  {     
+	switch (next)
+	{
+	  case 'z': zipfparam = strtod(optarg, (char **) NULL); break;
+	  case 'l': length = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'r': range = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'e': eps = strtod(optarg, (char **) NULL); break;
+	  case 'd': delta = strtod(optarg, (char **) NULL); break;
+	  case 'c': c = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'k': k = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'b': batch = (int)strtol(optarg, (char **)NULL, 10); break;
+	  case 'f': path = optarg; break;
+	  case 'D': durable = 1; break;
+   	  case '?':
+	   if (isprint (optopt))
+		fprintf (stderr, "Unknown option or required argument not provided `-%c'.\n", optopt);
+		else
+		 fprintf (stderr, "Unknown option character `\\x%x'.\n",
+                        optopt);
+		exit(1);
+		break;
+	 default:
+	   abort();
+    }
+  }
+  if(length <= 1 || range <= 0 || zipfparam < 0 || eps <= 0 || eps > 1 ||
+     delta <= 0 || delta > 1 || batch < 0)
+  {
+    fprintf(stderr, "invalid arguments\n");
+	exit(1);
+  }
+  if(c <= 0)
+	c = ceil(16 * 1/(eps*eps) * log(2/delta) * log(length * M_E));
+  if(k <= 0)
+	k = ceil(7/eps);
+  if(batch > 0)
+  {
+    batches[0] = batch;
+    nbatches = 1;
+  }
+
+  int* stream = CreateStream(length, zipfparam, range, &exact);
+  printf("exact entropy is %f, c %d, k %d, %d tokens\n", exact, c, k, length);
+
+  //heap-resident baseline
+  srand48(SEED);
+  Estimator_type* heap = Estimator_Init(c, k);
+  StartTheClock();
+  for(int i = 0; i < length; i++)
+    Estimator_Update(heap, stream[i]);
+  long heap_ms = StopTheClock();
+  double heap_est = Estimator_end_stream(heap);
+  printf("heap:       %6ld ms, %10.0f tokens/s, estimate %f\n",
+         heap_ms, length / (heap_ms > 0 ? heap_ms/1000.0 : 1e-3), heap_est);
+  Estimator_Destroy(heap);
+
+  //persistent, for each batch size
+  double est;
+  long ms;
+  for(int b = 0; b < nbatches; b++)
+  {
+    for(int d = 0; d <= durable; d++)
+    {
+      est = Run_Persist(path, stream, length, c, k, batches[b], d, &ms);
+      printf("mmap %6d%s %6ld ms, %10.0f tokens/s, estimate %f, %.2fx heap%s\n",
+             batches[b], d ? "D" : ":", ms, length / (ms > 0 ? ms/1000.0 : 1e-3),
+             est, heap_ms > 0 ? (double) ms / heap_ms : 0.0,
+             est == heap_est ? "" : " (differs from heap)");
+    }
+  }
+
+  //crash and reattach: the child is killed midway through a batch
+  batch = batches[nbatches-1 > 1 ? 1 : 0];
+  int kill_at = length/2 + batch/2;
+  if(kill_at >= length) kill_at = length-1;
+  double ref = Run_Persist(path, stream, length, c, k, batch, 0, &ms);
+  srand48(SEED);
+  Persist_Estimator_type* pe = Persist_Estimator_Create(path, c, k, batch, 0);
+  if(pe == NULL) fatal("can't create %s", path);
+  Persist_Estimator_Close(pe);
+  fflush(stdout);
+  pid_t pid = fork();
+  if(pid < 0) fatal("can't fork");
+  if(pid == 0)
+  {
+    pe = Persist_Estimator_Attach(path, batch, 0);
+    if(pe == NULL) _exit(1);
+    for(int i = 0; i < kill_at; i++)
+      Persist_Estimator_Update(pe, stream[i]);
+    kill(getpid(), SIGKILL);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+  if(!WIFSIGNALED(status))
+    fatal("child did not crash as planned");
+
+  long t = Now_Usec();
+  pe = Persist_Estimator_Attach(path, batch, 0);
+  t = Now_Usec() - t;
+  if(pe == NULL) fatal("can't reattach to %s", path);
+  long from = Persist_Estimator_Committed(pe);
+  for(long i = from; i < length; i++)
+    Persist_Estimator_Update(pe, stream[i]);
+  est = Persist_Estimator_end_stream(pe);
+  printf("killed at token %d, reattached in %ld us at committed token %ld, "
+         "estimate %f %s\n", kill_at, t, from, est,
+         est == ref ? "matches the uninterrupted run" : "DIFFERS from the uninterrupted run");
+  printf("state file is %d bytes\n", Persist_Estimator_Size(pe));
+  Persist_Estimator_Close(pe);
+  unlink(path);
+  free(stream);
+  return est == ref ? 0 : 1;
+}
+
+static double Run_Persist(const char* path, int* stream, int length, int c, int k,
+                          int batch, int durable, long* ms)
+{
+  srand48(SEED);
+  Persist_Estimator_type* pe = Persist_Estimator_Create(path, c, k, batch, durable);
+  if(pe == NULL) fatal("can't create %s", path);
+  StartTheClock();
+  for(int i = 0; i < length; i++)
+    Persist_Estimator_Update(pe, stream[i]);
+  Persist_Estimator_Commit(pe);
+  *ms = StopTheClock();
+  double est = Persist_Estimator_end_stream(pe);
+  Persist_Estimator_Close(pe);
+  return est;
+}
+
+static long Now_Usec()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000000L + tv.tv_usec;
+}
+
+/******************************************************************/
+//Creates and returns stream of ints in range [1, range+1] according
+//to zipfian distribution based on zipfpar, and its exact entropy
+static int* CreateStream(int length, double zipfpar, int range, double* exact)
+{
+  float zet;
+  int* stream;
+  prng_type * prng;
+  double sum_flogf = 0;
+  int* counts = (int*)calloc(range+2, sizeof(int));
+  
+  stream=(int *) safe_malloc(length * sizeof(int));
+  prng=prng_Init(44545,2);
+  zet=zeta(length,zipfpar);
+  for (int i=0;i<length;i++) 
+  {
+	stream[i]=(int) floor(fastzipf(zipfpar,range,zet,prng));
+	counts[stream[i]]++;
+  }
+  for (int i=0;i<range+2;i++)
+    if(counts[i] > 0)
+      sum_flogf += counts[i] * log(counts[i]);
+  *exact = (log(length) - sum_flogf/length) / log(2);
+  free(counts);
+  prng_Destroy(prng);
+  return(stream);
+}
@@ -0,0 +1,96 @@
+#ifndef PERSISTPRIV_H
+#define PERSISTPRIV_H
+
+#include <stdint.h>
+#include "persistpub.h"
+#include "prng.h"
+#include "flatfreq.h"
+
+#define PERSIST_MAGIC 0x53524550   //"PERS" little-endian
+#define PERSIST_VERSION 2
+#define PERSIST_NONE (-1)          //null link
+//a counter's heap of samplers is a block of PERSIST_BLOCK << class
+//ints; slot 0 is unused, as in c_a_heap.c
+#define PERSIST_BLOCK 4
+#define PERSIST_CLASSES 28
+
+//a sampler, as Sample_type with its counters named by index into the
+//slot's counter array
+typedef struct persist_sampler{
+  double t0, t1;
+  int32_t val_c_s0, val_c_s1;
+  int32_t c_s0, c_s1;              //counters, or PERSIST_NONE
+  int32_t c_s0_pos;                //position in c_s0's heap of samplers
+  int32_t prim;                    //next time to take primary sample
+  int32_t backup_minus_delay;      //next backup sample minus c_s0's delay
+  int32_t pad;
+} persist_sampler;
+
+//a counter, as c_a. The bucket chain is by index, and the heap of
+//samplers is block heap of the area for heap_class, or PERSIST_NONE
+//while the counter has no primary samplers. A free counter chains
+//through next
+typedef struct persist_counter{
+  int32_t backup_pos;              //position in backup heap
+  int32_t count, num_prim_samplers, num_backup_samplers, processing;
+  int32_t key;
+  int32_t next, previous;
+  int32_t heap, heap_class, heap_size;
+} persist_counter;
+
+//everything in a slot that is not an array
+typedef struct persist_state{
+  int32_t count, two_distinct_tokens;
+  int32_t first;                   //counter of the first token
+  int32_t prim_size, backup_size;  //entries in the two heaps
+  int32_t free_counter;            //free list of counters
+  int32_t counters_top;            //counters ever handed out
+  int32_t class_free[PERSIST_CLASSES]; //free list of blocks of each class
+  int32_t class_top[PERSIST_CLASSES];  //blocks ever handed out
+  prng_type prng;
+} persist_state;
+
+//first page of the file. Everything after it is found through the
+//offsets here, never through stored pointers, so the file can be
+//mapped at any address by any process
+typedef struct persist_header{
+  uint32_t magic, version;
+  int32_t c, k, page;
+  int32_t counters, buckets, classes;
+  int32_t class_blocks[PERSIST_CLASSES]; //capacity of each class's area
+  int64_t a, b;                          //Misra-Gries hash parameters
+  int64_t sym_a, sym_b;                  //bucket hash parameters
+  int64_t file_bytes, slot_bytes;
+  int64_t slot_off[2];                   //each slot, from the start of the file
+  //each array, from the start of a slot
+  int64_t samplers_off, counters_off, buckets_off, prim_off, backup_off, freq_off;
+  int64_t class_off[PERSIST_CLASSES];
+  //commit marker: slot seq&1 holds the last committed state. It is
+  //only advanced once the other slot is complete
+  int64_t seq;
+} persist_header;
+
+struct Persist_Estimator_type{
+  int fd, durable, batch;
+  int c, k;
+  unsigned char* base;
+  persist_header* head;
+  //the slot being written: a copy of the committed slot plus the
+  //pending tokens of the current batch
+  int work, pending;
+  persist_state* st;
+  persist_sampler* sm;
+  persist_counter* ca;
+  int32_t* bucket;
+  int32_t* prim;                   //samplers by prim, from slot 1
+  int32_t* backup;                 //counters with primary samplers, from slot 1
+  int32_t* area[PERSIST_CLASSES];
+  flatfreq_type freq;
+};
+
+static void persist_layout(persist_header* h, int c, int k, long page);
+static void persist_bind(Persist_Estimator_type* est, int slot);
+static Persist_Estimator_type* persist_map(int fd, long bytes, int batch, int durable);
+static void persist_copy(Persist_Estimator_type* est, int from, int to);
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef PERSISTPUB_H
+#define PERSISTPUB_H
+
+typedef struct Persist_Estimator_type Persist_Estimator_type;
+
+extern Persist_Estimator_type* Persist_Estimator_Create(const char* path, int c, int k,
+                                                        int batch, int durable);
+extern Persist_Estimator_type* Persist_Estimator_Attach(const char* path, int batch,
+                                                        int durable);
+extern void Persist_Estimator_Close(Persist_Estimator_type* est);
+extern int Persist_Estimator_Size(Persist_Estimator_type* est);
+extern void Persist_Estimator_Update(Persist_Estimator_type* est, int token);
+extern void Persist_Estimator_Commit(Persist_Estimator_type* est);
+extern long Persist_Estimator_Committed(Persist_Estimator_type* est);
+extern double Persist_Estimator_end_stream(Persist_Estimator_type* est);
+
+#endif
@@ -0,0 +1,248 @@
+/* pool.c
+ *Work-stealing thread pool. Each worker keeps its own deque of tasks;
+ *tasks submitted from inside a task go on the submitting worker's
+ *deque, tasks submitted from outside are dealt round robin. A worker
+ *with an empty deque steals from the others before going to sleep.
+ *Tasks are expected to be coarse (a whole stream or more), so each
+ *deque is simply guarded by its own mutex.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <sched.h>
+#include <unistd.h>
+#include "pool.h"
+#include "util.h"
+
+#define POOL_DEQUE_START 64
+
+typedef struct worker_arg{
+  Pool_type* pool;
+  int id;
+} worker_arg;
+
+static __thread int worker_id = -1;
+
+static void* worker_main(void* arg);
+static void deque_push(pool_deque* d, pool_task task);
+static int deque_pop(pool_deque* d, pool_task* task);
+static int deque_steal(pool_deque* d, pool_task* task);
+static int find_task(Pool_type* pool, int id, pool_task* task);
+
+//start a pool of threads workers; if pin is set worker i is bound to
+//core i modulo the number of online cores
+Pool_type* Pool_Init(int threads, int pin)
+{
+  Pool_type* pool = (Pool_type*) safe_malloc(sizeof(Pool_type));
+
+  if(threads < 1) fatal("Pool_Init: need at least one thread");
+  pool->threads = threads;
+  pool->pin = pin;
+  pool->next = 0;
+  pool->queued = 0;
+  pool->pending = 0;
+  pool->shutdown = 0;
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->work, NULL);
+  pthread_cond_init(&pool->idle, NULL);
+
+  pool->deques = (pool_deque*) safe_malloc(threads * sizeof(pool_deque));
+  for(int i = 0; i < threads; i++)
+  {
+    pthread_mutex_init(&pool->deques[i].lock, NULL);
+    pool->deques[i].size = POOL_DEQUE_START;
+    pool->deques[i].tasks = (pool_task*) safe_malloc(POOL_DEQUE_START * sizeof(pool_task));
+    pool->deques[i].top = pool->deques[i].bottom = 0;
+  }
+
+  pool->workers = (pthread_t*) safe_malloc(threads * sizeof(pthread_t));
+  for(int i = 0; i < threads; i++)
+  {
+    worker_arg* arg = (worker_arg*) safe_malloc(sizeof(worker_arg));
+    arg->pool = pool;
+    arg->id = i;
+    if(pthread_create(&pool->workers[i], NULL, worker_main, arg) != 0)
+      fatal("Pool_Init: can't create worker thread");
+  }
+  return pool;
+}
+
+//queue fn(arg) to be run by some worker
+void Pool_Submit(Pool_type* pool, pool_task_fn fn, void* arg)
+{
+  pool_task task;
+  int target;
+
+  task.fn = fn;
+  task.arg = arg;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->pending++;
+  if(worker_id >= 0 && worker_id < pool->threads)
+    target = worker_id;
+  else
+  {
+    target = pool->next;
+    pool->next = (pool->next + 1) % pool->threads;
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  deque_push(&pool->deques[target], task);
+
+  pthread_mutex_lock(&pool->lock);
+  pool->queued++;
+  pthread_cond_signal(&pool->work);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+//block until every submitted task, including those submitted by
+//other tasks, has finished
+void Pool_Wait(Pool_type* pool)
+{
+  pthread_mutex_lock(&pool->lock);
+  while(pool->pending > 0)
+    pthread_cond_wait(&pool->idle, &pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+//wait for outstanding tasks, then stop and free the workers
+void Pool_Destroy(Pool_type* pool)
+{
+  Pool_Wait(pool);
+  pthread_mutex_lock(&pool->lock);
+  pool->shutdown = 1;
+  pthread_cond_broadcast(&pool->work);
+  pthread_mutex_unlock(&pool->lock);
+
+  for(int i = 0; i < pool->threads; i++)
+    pthread_join(pool->workers[i], NULL);
+  for(int i = 0; i < pool->threads; i++)
+  {
+    pthread_mutex_destroy(&pool->deques[i].lock);
+    free(pool->deques[i].tasks);
+  }
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->work);
+  pthread_cond_destroy(&pool->idle);
+  free(pool->deques);
+  free(pool->workers);
+  free(pool);
+}
+
+//index of the calling worker, or -1 outside the pool
+int Pool_Worker_Id(void)
+{
+  return worker_id;
+}
+
+static void* worker_main(void* arg)
+{
+  worker_arg* warg = (worker_arg*) arg;
+  Pool_type* pool = warg->pool;
+  int id = warg->id;
+  pool_task task;
+
+  free(warg);
+  worker_id = id;
+  if(pool->pin)
+  {
+    cpu_set_t set;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    CPU_ZERO(&set);
+    CPU_SET(id % (cores > 0 ? cores : 1), &set);
+    //pinning is best effort, e.g. a restricted cpuset may refuse it
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  }
+
+  for(;;)
+  {
+    pthread_mutex_lock(&pool->lock);
+    while(pool->queued == 0 && !pool->shutdown)
+      pthread_cond_wait(&pool->work, &pool->lock);
+    if(pool->queued == 0 && pool->shutdown)
+    {
+      pthread_mutex_unlock(&pool->lock);
+      return NULL;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    //another worker may have taken the task first, in which case
+    //just go back to waiting
+    if(!find_task(pool, id, &task))
+    {
+      sched_yield();
+      continue;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->queued--;
+    pthread_mutex_unlock(&pool->lock);
+
+    task.fn(task.arg);
+
+    pthread_mutex_lock(&pool->lock);
+    if(--pool->pending == 0)
+      pthread_cond_broadcast(&pool->idle);
+    pthread_mutex_unlock(&pool->lock);
+  }
+}
+
+//own deque first, then the others starting from the next worker
+static int find_task(Pool_type* pool, int id, pool_task* task)
+{
+  if(deque_pop(&pool->deques[id], task))
+    return 1;
+  for(int i = 1; i < pool->threads; i++)
+  {
+    if(deque_steal(&pool->deques[(id + i) % pool->threads], task))
+      return 1;
+  }
+  return 0;
+}
+
+static void deque_push(pool_deque* d, pool_task task)
+{
+  pthread_mutex_lock(&d->lock);
+  if(d->bottom - d->top == d->size)
+  {
+    pool_task* grown = (pool_task*) safe_malloc(2 * d->size * sizeof(pool_task));
+    for(long i = d->top; i < d->bottom; i++)
+      grown[i & (2*d->size - 1)] = d->tasks[i & (d->size - 1)];
+    free(d->tasks);
+    d->tasks = grown;
+    d->size *= 2;
+  }
+  d->tasks[d->bottom & (d->size - 1)] = task;
+  d->bottom++;
+  pthread_mutex_unlock(&d->lock);
+}
+
+static int deque_pop(pool_deque* d, pool_task* task)
+{
+  int found = 0;
+  pthread_mutex_lock(&d->lock);
+  if(d->bottom > d->top)
+  {
+    d->bottom--;
+    *task = d->tasks[d->bottom & (d->size - 1)];
+    found = 1;
+  }
+  pthread_mutex_unlock(&d->lock);
+  return found;
+}
+
+static int deque_steal(pool_deque* d, pool_task* task)
+{
+  int found = 0;
+  pthread_mutex_lock(&d->lock);
+  if(d->bottom > d->top)
+  {
+    *task = d->tasks[d->top & (d->size - 1)];
+    d->top++;
+    found = 1;
+  }
+  pthread_mutex_unlock(&d->lock);
+  return found;
+}
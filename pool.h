@@ -0,0 +1,48 @@
+/*************************************************************************/
+/* pool.h                                                                */
+/*************************************************************************/
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <pthread.h>
+
+typedef void (*pool_task_fn)(void* arg);
+
+typedef struct pool_task{
+  pool_task_fn fn;
+  void* arg;
+} pool_task;
+
+//one deque per worker. The owner pushes and pops at the bottom and
+//thieves take from the top, so a worker runs its newest tasks first
+//while idle workers take the oldest (usually largest) ones
+typedef struct pool_deque{
+  pthread_mutex_t lock;
+  pool_task* tasks;
+  int size;   //capacity, a power of 2
+  long top;   //next task to steal
+  long bottom;//next free slot
+} pool_deque;
+
+typedef struct Pool_type{
+  int threads;
+  int pin;              //pin worker i to core i mod cores
+  pthread_t* workers;
+  pool_deque* deques;
+  int next;             //deque that gets the next outside submission
+  long queued;          //tasks sitting in deques
+  long pending;         //tasks submitted and not yet finished
+  int shutdown;
+  pthread_mutex_t lock; //guards sleeping, pending and shutdown
+  pthread_cond_t work;
+  pthread_cond_t idle;
+} Pool_type;
+
+extern Pool_type* Pool_Init(int threads, int pin);
+extern void Pool_Submit(Pool_type* pool, pool_task_fn fn, void* arg);
+extern void Pool_Wait(Pool_type* pool);
+extern void Pool_Destroy(Pool_type* pool);
+extern int Pool_Worker_Id(void);
+
+#endif
@@ -0,0 +1,322 @@
+/*prefix.c
+ *Entropy of a stream at several prefix levels of the same key, such as
+ *the /8, /16, /24 and /32 prefixes of IPv4 addresses, in one pass.
+ *
+ *A level keeps the top bits of the 32-bit token, so every position is
+ *one position of each level's stream and, as in pair.c, one uniform
+ *sample of c positions serves every level: each sampler holds the
+ *prefixes at its position and counts r of each from there on, and the
+ *AMS estimator of entropy.c is applied per level. Samplers sit in a
+ *heap on the position at which they are next replaced, so an update
+ *that replaces nothing only looks up its prefixes.
+ *
+ *The levels are nested: a sampler holding a token's prefix at one
+ *level holds its prefix at every coarser level too. The lookups go
+ *from the coarsest level and stop at the first prefix no sampler
+ *holds, so a token outside the sampled /8s costs one lookup however
+ *many levels there are.
+ *
+ *A prefix with more than half of its level, found with Misra-Gries
+ *counters, is counted exactly and samplers holding it are left out of
+ *that level's average, as in pair.c.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <limits.h>
+#include "prefixpriv.h"
+#include "prng.h"
+#include "util.h"
+
+//murmur3's 64-bit finalizer
+#define PREFIX_MIX(h) ((h) ^= (h) >> 33, (h) *= 0xff51afd7ed558ccdULL, \
+                       (h) ^= (h) >> 33, (h) *= 0xc4ceb9fe1a85ec53ULL, (h) ^= (h) >> 33)
+
+//bits[l] is the prefix length of level l, from 1 to 32, increasing
+Prefix_Estimator_type* Prefix_Estimator_Init(int c, int k, int levels, const int* bits)
+{
+  Prefix_Estimator_type* est;
+  prng_type* prng;
+
+  if(levels < 1 || levels > PREFIX_MAX_LEVELS)
+    fatal("Prefix_Estimator_Init: need 1 to %d levels", PREFIX_MAX_LEVELS);
+  for(int l = 0; l < levels; l++)
+  {
+    if(bits[l] < 1 || bits[l] > 32 || (l > 0 && bits[l] <= bits[l-1]))
+      fatal("Prefix_Estimator_Init: prefix lengths must increase from 1 to 32");
+  }
+  est = (Prefix_Estimator_type*) safe_malloc(sizeof(Prefix_Estimator_type));
+  est->c = c;
+  est->k = k;
+  est->levels = levels;
+  est->count = 0;
+  for(int l = 0; l < levels; l++)
+  {
+    est->bits[l] = bits[l];
+    est->masks[l] = bits[l] == 32 ? ~0u : ~(~0u >> bits[l]);
+  }
+
+  prng = prng_Init(lrand48(), 2);
+  est->rng = ((unsigned long long) prng_int(prng) << 32 ^ prng_int(prng)) | 1;
+  est->seed = (unsigned long long) prng_int(prng) << 32 ^ prng_int(prng);
+  prng_Destroy(prng);
+
+  //every sampler takes the first position
+  est->samplers = (Prefix_Sample*) safe_malloc(c * sizeof(Prefix_Sample));
+  est->entries = (prefix_entry**) safe_malloc((long) c * levels * sizeof(prefix_entry*));
+  est->bases = (long*) safe_malloc((long) c * levels * sizeof(long));
+  est->next_heap = new_heap(prefix_next_comp, c+2);
+  for(int i = 0; i < c; i++)
+  {
+    Prefix_Sample* sm = &est->samplers[i];
+    sm->entry = est->entries + (long) i * levels;
+    sm->base = est->bases + (long) i * levels;
+    for(int l = 0; l < levels; l++)
+    {
+      sm->entry[l] = NULL;
+      sm->base[l] = 0;
+    }
+    sm->next = 1;
+    insert_heap(est->next_heap, sm);
+  }
+
+  est->tables = (prefix_table*) safe_malloc(levels * sizeof(prefix_table));
+  est->freqs = (prefix_freq*) safe_malloc(levels * sizeof(prefix_freq));
+  for(int l = 0; l < levels; l++)
+  {
+    prefix_table* t = &est->tables[l];
+    t->size = 2*c > 0 ? 2*c : 1;
+    t->buckets = (prefix_entry**) safe_malloc(t->size * sizeof(prefix_entry*));
+    for(int i = 0; i < t->size; i++)
+      t->buckets[i] = NULL;
+    t->entries = 0;
+
+    est->freqs[l].n = 0;
+    est->freqs[l].items = (unsigned int*) safe_malloc(k * sizeof(unsigned int));
+    est->freqs[l].counts = (long*) safe_malloc(k * sizeof(long));
+  }
+  return est;
+}
+
+void Prefix_Estimator_Destroy(Prefix_Estimator_type* est)
+{
+  prefix_entry *e, *next;
+  for(int l = 0; l < est->levels; l++)
+  {
+    for(int i = 0; i < est->tables[l].size; i++)
+    {
+      for(e = est->tables[l].buckets[i]; e != NULL; e = next)
+      {
+        next = e->next;
+        free(e);
+      }
+    }
+    free(est->tables[l].buckets);
+    free(est->freqs[l].items);
+    free(est->freqs[l].counts);
+  }
+  free(est->tables);
+  free(est->freqs);
+  free_heap(est->next_heap);
+  free(est->entries);
+  free(est->bases);
+  free(est->samplers);
+  free(est);
+}
+
+int Prefix_Estimator_Size(Prefix_Estimator_type* est)
+{
+  int size = sizeof(Prefix_Estimator_type) + est->c * sizeof(Prefix_Sample) +
+             est->c * est->levels * (sizeof(prefix_entry*) + sizeof(long)) +
+             sizeof_heap(est->next_heap) +
+             est->levels * (sizeof(prefix_table) + sizeof(prefix_freq));
+  for(int l = 0; l < est->levels; l++)
+    size += est->tables[l].size * sizeof(prefix_entry*) +
+            est->tables[l].entries * sizeof(prefix_entry) +
+            est->k * (sizeof(unsigned int) + sizeof(long));
+  return size;
+}
+
+int Prefix_Estimator_Levels(Prefix_Estimator_type* est)
+{
+  return est->levels;
+}
+
+void Prefix_Estimator_Update(Prefix_Estimator_type* est, int token)
+{
+  unsigned int keys[PREFIX_MAX_LEVELS];
+  prefix_entry* e[PREFIX_MAX_LEVELS];
+  Prefix_Sample* sm;
+  double next;
+  int held = 1;
+
+  est->count++;
+  for(int l = 0; l < est->levels; l++)
+  {
+    keys[l] = (unsigned int) token & est->masks[l];
+    prefix_freq_update(&est->freqs[l], est->k, keys[l]);
+    //no sampler holds a finer prefix of a coarse prefix none holds
+    e[l] = held ? prefix_find(est, &est->tables[l], keys[l]) : NULL;
+    if(e[l] != NULL)
+      e[l]->count++;
+    else held = 0;
+  }
+
+  //replace every sampler whose next position is this one
+  while((sm = (Prefix_Sample*) peek_min(est->next_heap))->next <= est->count)
+  {
+    delete_min(est->next_heap);
+    for(int l = 0; l < est->levels; l++)
+    {
+      if(e[l] == NULL)
+      {
+        e[l] = prefix_hold(est, &est->tables[l], keys[l]);
+        e[l]->count = 1;
+      }
+      e[l]->refs++;
+      if(sm->entry[l] != NULL)
+        prefix_release(est, &est->tables[l], sm->entry[l]);
+      sm->entry[l] = e[l];
+      sm->base[l] = e[l]->count - 1;
+    }
+    //a sample of one from count positions survives to position t
+    //with probability count/t
+    next = floor(est->count / prefix_uniform(est)) + 1;
+    sm->next = next < LONG_MAX/2 ? (long) next : LONG_MAX/2;
+    insert_heap(est->next_heap, sm);
+  }
+}
+
+//end of stream reached. Writes the entropy of each level, coarsest
+//first, to entropies
+void Prefix_Estimator_end_stream(Prefix_Estimator_type* est, double* entropies)
+{
+  for(int l = 0; l < est->levels; l++)
+    entropies[l] = prefix_entropy(est, l);
+}
+
+//entropy of level l from the samplers
+static double prefix_entropy(Prefix_Estimator_type* est, int l)
+{
+  prefix_freq* f = &est->freqs[l];
+  unsigned int max_key = 0;
+  double m = est->count, p_max = 0, sum_Xis = 0, r;
+  int n = 0;
+
+  if(est->count == 0)
+    return 0;
+  for(int i = 0; i < f->n; i++)
+  {
+    if(f->counts[i] > est->count/2)
+    {
+      max_key = f->items[i];
+      p_max = f->counts[i] / m;
+    }
+  }
+  for(int i = 0; i < est->c; i++)
+  {
+    Prefix_Sample* sm = &est->samplers[i];
+    if(sm->entry[l] == NULL)
+      continue;
+    if(p_max > 0 && sm->entry[l]->key == max_key)
+      continue;
+    r = sm->entry[l]->count - sm->base[l];
+    sum_Xis += r * log2(m/r);
+    if(r > 1) //treat (r-1)log(m/(r-1)) as 0 if r=1
+      sum_Xis -= (r-1) * log2(m/(r-1));
+    n++;
+  }
+  if(p_max == 0)
+    return n > 0 ? sum_Xis / n : 0;
+  return (n > 0 ? (1-p_max) * sum_Xis / n : 0) + p_max * log2(1/p_max);
+}
+
+//uniform in (0, 1], from xorshift64*
+static double prefix_uniform(Prefix_Estimator_type* est)
+{
+  est->rng ^= est->rng >> 12;
+  est->rng ^= est->rng << 25;
+  est->rng ^= est->rng >> 27;
+  return ((est->rng * 2685821657736338717ULL >> 11) + 1.0) / 9007199254740992.0;
+}
+
+static int prefix_bucket(Prefix_Estimator_type* est, prefix_table* t, unsigned int key)
+{
+  unsigned long long h = key ^ est->seed;
+  PREFIX_MIX(h);
+  return (int) (h % t->size);
+}
+
+static prefix_entry* prefix_find(Prefix_Estimator_type* est, prefix_table* t, unsigned int key)
+{
+  prefix_entry* e = t->buckets[prefix_bucket(est, t, key)];
+  while(e != NULL && e->key != key)
+    e = e->next;
+  return e;
+}
+
+//a fresh entry for key, which must not be held yet
+static prefix_entry* prefix_hold(Prefix_Estimator_type* est, prefix_table* t, unsigned int key)
+{
+  int bn = prefix_bucket(est, t, key);
+  prefix_entry* e = (prefix_entry*) safe_malloc(sizeof(prefix_entry));
+  e->key = key;
+  e->refs = 0;
+  e->count = 0;
+  e->next = t->buckets[bn];
+  t->buckets[bn] = e;
+  t->entries++;
+  return e;
+}
+
+//a sampler lets go of e; forget the prefix once no sampler holds it
+static void prefix_release(Prefix_Estimator_type* est, prefix_table* t, prefix_entry* e)
+{
+  prefix_entry** p;
+
+  if(--e->refs > 0)
+    return;
+  p = &t->buckets[prefix_bucket(est, t, e->key)];
+  while(*p != e)
+    p = &(*p)->next;
+  *p = e->next;
+  free(e);
+  t->entries--;
+}
+
+//Misra-Gries as in pair.c, on one level's prefixes
+static void prefix_freq_update(prefix_freq* f, int k, unsigned int key)
+{
+  int i, n;
+
+  for(i = 0; i < f->n; i++)
+  {
+    if(f->items[i] == key)
+    {
+      f->counts[i]++;
+      return;
+    }
+  }
+  if(f->n < k)
+  {
+    f->items[f->n] = key;
+    f->counts[f->n++] = 1;
+    return;
+  }
+  for(i = n = 0; i < f->n; i++)
+  {
+    if(--f->counts[i] > 0)
+    {
+      f->items[n] = f->items[i];
+      f->counts[n++] = f->counts[i];
+    }
+  }
+  f->n = n;
+}
+
+static int prefix_next_comp(void* a, void* b)
+{
+  long x = ((Prefix_Sample*) a)->next, y = ((Prefix_Sample*) b)->next;
+  return x < y ? -1 : x > y;
+}
@@ -0,0 +1,62 @@
+#ifndef PREFIXPRIV_H
+#define PREFIXPRIV_H
+#include "heap.h"
+#include "prefixpub.h"
+
+#define PREFIX_MAX_LEVELS 32
+
+//a prefix some sampler holds, with its count since it was first held
+typedef struct prefix_entry{
+  unsigned int key;
+  int refs;
+  long count;
+  struct prefix_entry* next;
+} prefix_entry;
+
+//prefixes of one level held by samplers, chained in buckets
+typedef struct prefix_table{
+  prefix_entry** buckets;
+  int size, entries;
+} prefix_table;
+
+//Misra-Gries over one level's prefixes, with k counters scanned in turn
+typedef struct prefix_freq{
+  int n;
+  unsigned int* items;
+  long* counts;
+} prefix_freq;
+
+//one sampled position, shared by every level: the prefix of each
+//level there, and each prefix's count before it, so r = count - base.
+//entry and base point at this sampler's levels in the estimator's
+//arrays
+typedef struct Prefix_Sample{
+  prefix_entry** entry;
+  long* base;
+  long next;          //position at which the sample is next replaced
+} Prefix_Sample;
+
+struct Prefix_Estimator_type{
+  int c, k, levels;
+  long count;
+  unsigned long long rng, seed;
+  unsigned int masks[PREFIX_MAX_LEVELS];  //coarsest level first
+  int bits[PREFIX_MAX_LEVELS];
+  Prefix_Sample* samplers;
+  prefix_entry** entries;  //c by levels
+  long* bases;
+  heap* next_heap;    //samplers by next, smallest first
+  prefix_table* tables;
+  prefix_freq* freqs;
+};
+
+static double prefix_uniform(Prefix_Estimator_type* est);
+static int prefix_bucket(Prefix_Estimator_type* est, prefix_table* t, unsigned int key);
+static prefix_entry* prefix_find(Prefix_Estimator_type* est, prefix_table* t, unsigned int key);
+static prefix_entry* prefix_hold(Prefix_Estimator_type* est, prefix_table* t, unsigned int key);
+static void prefix_release(Prefix_Estimator_type* est, prefix_table* t, prefix_entry* e);
+static void prefix_freq_update(prefix_freq* f, int k, unsigned int key);
+static double prefix_entropy(Prefix_Estimator_type* est, int l);
+static int prefix_next_comp(void* a, void* b);
+
+#endif
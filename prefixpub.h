@@ -0,0 +1,13 @@
+#ifndef PREFIXPUB_H
+#define PREFIXPUB_H
+
+typedef struct Prefix_Estimator_type Prefix_Estimator_type;
+
+extern Prefix_Estimator_type* Prefix_Estimator_Init(int c, int k, int levels, const int* bits);
+extern void Prefix_Estimator_Destroy(Prefix_Estimator_type* est);
+extern int Prefix_Estimator_Size(Prefix_Estimator_type* est);
+extern int Prefix_Estimator_Levels(Prefix_Estimator_type* est);
+extern void Prefix_Estimator_Update(Prefix_Estimator_type* est, int token);
+extern void Prefix_Estimator_end_stream(Prefix_Estimator_type* est, double* entropies);
+
+#endif
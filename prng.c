@@ -313,6 +313,58 @@ void prng_Destroy(prng_type * prng)
   free(prng);
 }
 
+// write the full generator state, so a restored generator continues
+// the same sequence (the drand48 generator, usenric 3, is global and
+// is not saved)
+void prng_Serialize(prng_type * prng, serial_buf * b)
+{
+  int i;
+
+  Serial_Put_Int(b, prng->usenric);
+  Serial_Put_Float(b, prng->scale);
+  Serial_Put_Long(b, prng->floatidum);
+  Serial_Put_Long(b, prng->intidum);
+  Serial_Put_Long(b, prng->iy);
+  for (i=0; i<NTAB; i++)
+    Serial_Put_Long(b, prng->iv[i]);
+  for (i=0; i<KK; i++)
+    Serial_Put_U64(b, prng->randbuffer[i]);
+  Serial_Put_Int(b, prng->r_p1);
+  Serial_Put_Int(b, prng->r_p2);
+  Serial_Put_Int(b, prng->iset);
+  Serial_Put_Double(b, prng->gset);
+}
+
+prng_type * prng_Deserialize(serial_reader * r)
+{
+  prng_type * result;
+  int i;
+
+  result=(prng_type *) calloc(1,sizeof(prng_type));
+  result->usenric=Serial_Get_Int(r);
+  result->scale=Serial_Get_Float(r);
+  result->floatidum=Serial_Get_Long(r);
+  result->intidum=Serial_Get_Long(r);
+  result->iy=Serial_Get_Long(r);
+  for (i=0; i<NTAB; i++)
+    result->iv[i]=Serial_Get_Long(r);
+  for (i=0; i<KK; i++)
+    result->randbuffer[i]=Serial_Get_U64(r);
+  result->r_p1=Serial_Get_Int(r);
+  result->r_p2=Serial_Get_Int(r);
+  result->iset=Serial_Get_Int(r);
+  result->gset=Serial_Get_Double(r);
+  if (r->error || result->usenric < 1 || result->usenric > 3 ||
+      result->r_p1 < 0 || result->r_p1 >= KK ||
+      result->r_p2 < 0 || result->r_p2 >= KK)
+    {
+      r->error=1;
+      free(result);
+      return NULL;
+    }
+  return(result);
+}
+
 /**********************************************************************/
 /* Next, a load of routines that convert uniform random variables     */
 /* from [0,1] to stable distribitions, such as gaussian, levy or      */
@@ -344,30 +396,50 @@ double prng_normal(prng_type * prng) {
   }
 }
 
-double prng_stabledbn(prng_type * prng, double alpha) {
+double stable_from_uniform(double alpha, double beta, double u1, double u2) {
 
-  // From 'stable distributions', John Nolan, manuscript, p24
-  // we set beta = 0 by analogy with the normal and cauchy case
-  // identical to the above routine, but returns a double instead 
-  // of a long double (you'll see this a lot...)
+  // From 'stable distributions', John Nolan, manuscript, p24, after
+  // Chambers, Mallows and Stuck: turns two uniforms in (0,1) into a
+  // value of the stable distribution with index alpha and skew beta,
+  // scale 1 and shift 0, in the parameterization where
+  // log E e^(iuX) = -|u|^alpha (1 - i beta sign(u) tan(pi alpha/2))
+  // and, for alpha = 1, -|u| (1 + i beta (2/pi) sign(u) log|u|)
 
-  double theta, W, holder, left, right;
+  double theta, W, B, S, holder, left, right;
 
-  theta=PI*(prng_float(prng) - 0.5);
-  W = -log(prng_float(prng)); // takes natural log
+  theta=PI*(u1 - 0.5);
+  W = -log(u2); // takes natural log
 
-  //  printf("theta %Lf, W = %Lf \n", theta, W);
+  if (alpha == 1.0) {
+    holder = PI/2 + beta*theta;
+    return((2/PI)*(holder*tan(theta) - beta*log((PI/2)*W*cos(theta)/holder)));
+  }
 
   // some notes on Nolan's notes:
   // if beta == 0 then c(alpha,beta)=1; theta_0 = 0
   // expression reduces to sin alpha.theta / (cos theta) ^1/alpha
   //  * (cos (theta - alpha theta)/W) ^(1-alpha)/alpha
-  left = (sin(alpha*theta)/pow(cos(theta), 1.0/alpha));
-  right= pow(cos(theta*(1.0 - alpha))/W, ((1.0-alpha)/alpha));
+  B = atan(beta*tan(PI*alpha/2))/alpha;
+  S = pow(1 + beta*beta*tan(PI*alpha/2)*tan(PI*alpha/2), 1/(2*alpha));
+  left = S*(sin(alpha*(theta+B))/pow(cos(theta), 1.0/alpha));
+  right= pow(cos(theta - alpha*(theta+B))/W, ((1.0-alpha)/alpha));
   holder=left*right;
   return(holder);
 }
 
+double prng_stabledbn(prng_type * prng, double alpha) {
+
+  // we set beta = 0 by analogy with the normal and cauchy case
+  // identical to the above routine, but returns a double instead 
+  // of a long double (you'll see this a lot...)
+
+  double u1, u2;
+
+  u1=prng_float(prng);
+  u2=prng_float(prng);
+  return(stable_from_uniform(alpha, 0.0, u1, u2));
+}
+
 
 long double prng_cauchy(prng_type * prng) {
 
@@ -3,6 +3,7 @@
 // 
 
 #include <math.h>
+#include "serial.h"
 
 #ifndef _PRNG
 
@@ -39,12 +40,15 @@ extern float prng_float(prng_type *);
 extern prng_type * prng_Init(long, int);
 extern void prng_Destroy(prng_type * prng);
 void prng_Reseed(prng_type *, long);
+extern void prng_Serialize(prng_type *, serial_buf *);
+extern prng_type * prng_Deserialize(serial_reader *);
 
 //extern long double zipf(double, long) ;
 extern double fastzipf(double, long, double, prng_type *);
 extern double zeta(long, double);
 extern double prng_normal(prng_type * prng);
 extern double prng_stable(prng_type * prng, double);
+extern double stable_from_uniform(double alpha, double beta, double u1, double u2);
 
 //extern double stable(double); // stable distributions 
 //extern double stabledevd(float) ;
@@ -0,0 +1,153 @@
+/*************************************************************************/
+/* reference.c -- a reference distribution as a flat table of costs     */
+/*************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <limits.h>
+#include "reference.h"
+#include "util.h"
+
+#define REFERENCE_EMPTY INT_MIN   //never a token: frequent.c reserves it too
+
+static int reference_count_cmp(const void* p, const void* q);
+
+typedef struct reference_pair{
+  int token;
+  long count;
+} reference_pair;
+
+//Q from n (token, count) pairs, tokens distinct, storing the keep most
+//frequent (all of them if keep <= 0)
+Reference_type* Reference_Init(const int* tokens, const long* counts, int n,
+                               int keep, double alpha)
+{
+  Reference_type* ref = (Reference_type*) safe_malloc(sizeof(Reference_type));
+  reference_pair* pairs = (reference_pair*) safe_malloc((n > 0 ? n : 1) * sizeof(reference_pair));
+  double z, rest = 0;
+  int bits = 1;
+
+  if(alpha <= 0) fatal("Reference_Init: alpha must be positive, not %f", alpha);
+  ref->total = 0;
+  for(int i = 0; i < n; i++)
+  {
+    if(tokens[i] == REFERENCE_EMPTY || counts[i] <= 0)
+      fatal("Reference_Init: bad pair (%d, %ld)", tokens[i], counts[i]);
+    pairs[i].token = tokens[i];
+    pairs[i].count = counts[i];
+    ref->total += counts[i];
+  }
+  ref->distinct = n;
+  if(keep <= 0 || keep > n)
+    keep = n;
+  else
+    qsort(pairs, n, sizeof(reference_pair), reference_count_cmp);
+
+  //the tokens not kept share what they had of the reference
+  for(int i = keep; i < n; i++)
+    rest += pairs[i].count;
+  z = ref->total + alpha * (n+1);
+  ref->other_cost = -log2(((n > keep ? rest / (n-keep) : 0) + alpha) / z);
+
+  //at most half full
+  while((1 << bits) < 2*keep) bits++;
+  ref->size = 1 << bits;
+  ref->shift = 32 - bits;
+  ref->n = keep;
+  ref->slots = (reference_slot*) safe_malloc(ref->size * sizeof(reference_slot));
+  for(int i = 0; i < ref->size; i++)
+    ref->slots[i].token = REFERENCE_EMPTY;
+  for(int i = 0; i < keep; i++)
+  {
+    unsigned int j = (unsigned int) pairs[i].token * 2654435769u >> ref->shift;
+    while(ref->slots[j].token != REFERENCE_EMPTY)
+    {
+      if(ref->slots[j].token == pairs[i].token)
+        fatal("Reference_Init: token %d given twice", pairs[i].token);
+      j = (j + 1) & (ref->size - 1);
+    }
+    ref->slots[j].token = pairs[i].token;
+    ref->slots[j].cost = -log2((pairs[i].count + alpha) / z);
+  }
+  free(pairs);
+  return ref;
+}
+
+//Q from a text file of "token count" lines, as Reference_Save writes
+Reference_type* Reference_Load(const char* path, int keep, double alpha)
+{
+  FILE* file = fopen(path, "r");
+  Reference_type* ref;
+  int* tokens;
+  long* counts;
+  int n = 0, max = 1024, token;
+  long count;
+
+  if(file == NULL)
+    return NULL;
+  tokens = (int*) safe_malloc(max * sizeof(int));
+  counts = (long*) safe_malloc(max * sizeof(long));
+  while(fscanf(file, "%d %ld", &token, &count) == 2)
+  {
+    if(n == max)
+    {
+      max *= 2;
+      tokens = (int*) safe_realloc(tokens, max * sizeof(int));
+      counts = (long*) safe_realloc(counts, max * sizeof(long));
+    }
+    tokens[n] = token;
+    counts[n++] = count;
+  }
+  if(!feof(file))
+    fatal("Reference_Load: %s is not a list of token count pairs", path);
+  fclose(file);
+  ref = Reference_Init(tokens, counts, n, keep, alpha);
+  free(tokens);
+  free(counts);
+  return ref;
+}
+
+//write n (token, count) pairs for Reference_Load. Returns 0 on success
+int Reference_Save(const char* path, const int* tokens, const long* counts, int n)
+{
+  FILE* file = fopen(path, "w");
+  if(file == NULL)
+    return -1;
+  for(int i = 0; i < n; i++)
+    fprintf(file, "%d %ld\n", tokens[i], counts[i]);
+  return fclose(file) == 0 ? 0 : -1;
+}
+
+void Reference_Destroy(Reference_type* ref)
+{
+  free(ref->slots);
+  free(ref);
+}
+
+int Reference_Size(Reference_type* ref)
+{
+  return sizeof(Reference_type) + ref->size * sizeof(reference_slot);
+}
+
+//-log2 q(token)
+float Reference_Cost(Reference_type* ref, int token)
+{
+  unsigned int j = (unsigned int) token * 2654435769u >> ref->shift;
+  if(token == REFERENCE_EMPTY)
+    return ref->other_cost;
+  while(ref->slots[j].token != token)
+  {
+    if(ref->slots[j].token == REFERENCE_EMPTY)
+      return ref->other_cost;
+    j = (j + 1) & (ref->size - 1);
+  }
+  return ref->slots[j].cost;
+}
+
+//largest count first
+static int reference_count_cmp(const void* p, const void* q)
+{
+  long a = ((const reference_pair*) p)->count, b = ((const reference_pair*) q)->count;
+  return (a==b) ? 0 : (a>b) ? -1 : 1;
+}
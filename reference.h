@@ -0,0 +1,40 @@
+/*************************************************************************/
+/* reference.h                                                           */
+/*************************************************************************/
+
+#ifndef REFERENCE_H
+#define REFERENCE_H
+
+//a reference distribution Q to measure a stream against, kept as the
+//cost -log2 q(token) of each token in one flat open-addressing table,
+//so a lookup is one probe into one cache line in most cases.
+//
+//It is built from (token, count) pairs of a prior run. With keep less
+//than the number of tokens only the keep most frequent are stored and
+//the rest share their mass evenly, which gives a compact sketch of a
+//long-tailed reference. Counts are smoothed by alpha, so a token the
+//reference never saw costs log2((N + alpha (V+1)) / alpha) for N
+//tokens and V distinct ones, and any token not stored costs the same
+typedef struct reference_slot{
+  int token;
+  float cost;          //-log2 q(token)
+} reference_slot;
+
+typedef struct Reference_type{
+  int size, n;         //slots (a power of 2) and tokens stored
+  int shift;           //32 - log2(size), for the multiplicative hash
+  reference_slot* slots;
+  double total;        //tokens in the reference stream
+  long distinct;
+  float other_cost;    //cost of any token not stored
+} Reference_type;
+
+extern Reference_type* Reference_Init(const int* tokens, const long* counts, int n,
+                                      int keep, double alpha);
+extern Reference_type* Reference_Load(const char* path, int keep, double alpha);
+extern int Reference_Save(const char* path, const int* tokens, const long* counts, int n);
+extern void Reference_Destroy(Reference_type* ref);
+extern int Reference_Size(Reference_type* ref);
+extern float Reference_Cost(Reference_type* ref, int token);
+
+#endif
@@ -0,0 +1,179 @@
+/* ring.c
+ *Lock-free single-producer token queues used to hand tokens from a
+ *reader thread to worker threads: a ring with one consumer, and a
+ *broadcast ring in which each of several consumers reads every token.
+ *Uses the GCC __atomic builtins for acquire/release ordering on the
+ *head and tail indices.
+ */
+
+#include <stdlib.h>
+#include <sched.h>
+#include "ring.h"
+#include "util.h"
+
+//size is rounded up to a power of 2
+ring_type* Ring_Init(int size)
+{
+  ring_type* ring = (ring_type*) safe_malloc(sizeof(ring_type));
+  unsigned long n = 1;
+  while(n < (unsigned long) size) n <<= 1;
+  ring->buf = (int*) safe_malloc(n * sizeof(int));
+  ring->mask = n-1;
+  ring->head = ring->tail = 0;
+  return ring;
+}
+
+void Ring_Destroy(ring_type* ring)
+{
+  if(!ring) return;
+  free(ring->buf);
+  free(ring);
+}
+
+//copy up to n tokens into the ring, returns number copied
+//must only be called by the producer
+int Ring_Push(ring_type* ring, const int* tokens, int n)
+{
+  unsigned long tail = ring->tail;
+  unsigned long head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  unsigned long space = ring->mask + 1 - (tail - head);
+  int i;
+
+  if((unsigned long) n > space) n = space;
+  for(i = 0; i < n; i++)
+  {
+    ring->buf[(tail+i) & ring->mask] = tokens[i];
+  }
+  __atomic_store_n(&ring->tail, tail+n, __ATOMIC_RELEASE);
+  return n;
+}
+
+//push all n tokens, yielding while the consumer catches up
+void Ring_Push_All(ring_type* ring, const int* tokens, int n)
+{
+  int done = 0;
+  while(done < n)
+  {
+    done += Ring_Push(ring, tokens+done, n-done);
+    if(done < n) sched_yield();
+  }
+}
+
+//copy up to max tokens out of the ring, returns number copied
+//must only be called by the consumer
+int Ring_Pop(ring_type* ring, int* tokens, int max)
+{
+  unsigned long head = ring->head;
+  unsigned long tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+  int n = (int) (tail - head);
+  int i;
+
+  if(n > max) n = max;
+  for(i = 0; i < n; i++)
+  {
+    tokens[i] = ring->buf[(head+i) & ring->mask];
+  }
+  __atomic_store_n(&ring->head, head+n, __ATOMIC_RELEASE);
+  return n;
+}
+
+int Ring_Empty(ring_type* ring)
+{
+  return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) ==
+         __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
+
+/******************************************************************/
+
+//size is rounded up to a power of 2
+broadcast_type* Broadcast_Init(int size, int nreaders)
+{
+  broadcast_type* b = (broadcast_type*) safe_malloc(sizeof(broadcast_type));
+  unsigned long n = 1;
+  while(n < (unsigned long) size) n <<= 1;
+  b->buf = (int*) safe_malloc(n * sizeof(int));
+  b->mask = n-1;
+  b->nreaders = nreaders;
+  b->heads = (reader_pos*) safe_malloc_aligned(CACHE_LINE, nreaders * sizeof(reader_pos));
+  for(int i = 0; i < nreaders; i++)
+  {
+    b->heads[i].head = 0;
+  }
+  b->tail = b->min_head = 0;
+  return b;
+}
+
+void Broadcast_Destroy(broadcast_type* b)
+{
+  if(!b) return;
+  free(b->heads);
+  free(b->buf);
+  free(b);
+}
+
+//lowest position any reader still needs
+static unsigned long slowest_reader(broadcast_type* b)
+{
+  unsigned long head, min = b->tail;
+  for(int i = 0; i < b->nreaders; i++)
+  {
+    head = __atomic_load_n(&b->heads[i].head, __ATOMIC_ACQUIRE);
+    if(head < min) min = head;
+  }
+  return min;
+}
+
+//push all n tokens, yielding while the slowest reader catches up
+//must only be called by the producer
+void Broadcast_Push_All(broadcast_type* b, const int* tokens, int n)
+{
+  unsigned long size = b->mask + 1;
+  unsigned long space;
+  int i, done = 0;
+
+  while(done < n)
+  {
+    space = size - (b->tail - b->min_head);
+    if(space == 0)
+    { //only rescan the readers once the cached bound is used up
+      b->min_head = slowest_reader(b);
+      space = size - (b->tail - b->min_head);
+      if(space == 0)
+      {
+        sched_yield();
+        continue;
+      }
+    }
+    if(space > (unsigned long) (n-done)) space = n-done;
+    for(i = 0; i < (int) space; i++)
+    {
+      b->buf[(b->tail+i) & b->mask] = tokens[done+i];
+    }
+    __atomic_store_n(&b->tail, b->tail+space, __ATOMIC_RELEASE);
+    done += space;
+  }
+}
+
+//copy up to max tokens not yet seen by reader, returns number copied
+//must only be called by that reader
+int Broadcast_Pop(broadcast_type* b, int reader, int* tokens, int max)
+{
+  unsigned long head = b->heads[reader].head;
+  unsigned long tail = __atomic_load_n(&b->tail, __ATOMIC_ACQUIRE);
+  int n = (int) (tail - head);
+  int i;
+
+  if(n > max) n = max;
+  for(i = 0; i < n; i++)
+  {
+    tokens[i] = b->buf[(head+i) & b->mask];
+  }
+  __atomic_store_n(&b->heads[reader].head, head+n, __ATOMIC_RELEASE);
+  return n;
+}
+
+int Broadcast_Empty(broadcast_type* b, int reader)
+{
+  return __atomic_load_n(&b->heads[reader].head, __ATOMIC_ACQUIRE) ==
+         __atomic_load_n(&b->tail, __ATOMIC_ACQUIRE);
+}
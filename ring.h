@@ -0,0 +1,54 @@
+/*************************************************************************/
+/* ring.h                                                                */
+/*************************************************************************/
+
+#ifndef RING_H
+#define RING_H
+
+#define CACHE_LINE 64
+
+//single-producer single-consumer queue of tokens. head and tail are
+//only ever advanced by their owning thread, so no locks are needed;
+//they are kept on separate cache lines to avoid false sharing
+typedef struct ring_type{
+  int* buf;
+  unsigned long mask;  //size-1, size is a power of 2
+  char pad0[CACHE_LINE];
+  unsigned long head;  //next slot to read, written by consumer
+  char pad1[CACHE_LINE];
+  unsigned long tail;  //next slot to write, written by producer
+  char pad2[CACHE_LINE];
+} ring_type;
+
+//single-producer queue in which every one of nreaders consumers sees
+//every token. The producer waits for the slowest reader
+typedef struct reader_pos{
+  unsigned long head;  //next slot this reader will read
+  char pad[CACHE_LINE - sizeof(unsigned long)];
+} reader_pos;
+
+typedef struct broadcast_type{
+  int* buf;
+  unsigned long mask;
+  int nreaders;
+  reader_pos* heads;
+  char pad0[CACHE_LINE];
+  unsigned long tail;  //next slot to write, written by producer
+  unsigned long min_head; //producer's cached minimum of the heads
+  char pad1[CACHE_LINE];
+} broadcast_type;
+
+extern ring_type* Ring_Init(int size);
+extern void Ring_Destroy(ring_type* ring);
+extern int Ring_Push(ring_type* ring, const int* tokens, int n);
+extern void Ring_Push_All(ring_type* ring, const int* tokens, int n);
+extern int Ring_Pop(ring_type* ring, int* tokens, int max);
+extern int Ring_Empty(ring_type* ring);
+
+extern broadcast_type* Broadcast_Init(int size, int nreaders);
+extern void Broadcast_Destroy(broadcast_type* b);
+extern void Broadcast_Push_All(broadcast_type* b, const int* tokens, int n);
+extern int Broadcast_Pop(broadcast_type* b, int reader, int* tokens, int max);
+extern int Broadcast_Empty(broadcast_type* b, int reader);
+
+#endif
@@ -0,0 +1,174 @@
+/* serial.c
+ *Little-endian encoding used by the estimator checkpoints and by the
+ *distributed protocol, so images and messages can move between hosts
+ *of either byte order. Doubles and floats are stored as their IEEE bit
+ *patterns, so a restored estimator sees exactly the values it saved.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "serial.h"
+#include "util.h"
+
+#define SERIAL_START 256
+
+//store the low n bytes of v at p, least significant first
+void Serial_Store(unsigned char* p, unsigned long long v, int n)
+{
+  for(int i = 0; i < n; i++)
+  {
+    p[i] = (unsigned char) (v >> (8*i));
+  }
+}
+
+unsigned long long Serial_Load(const unsigned char* p, int n)
+{
+  unsigned long long v = 0;
+  for(int i = 0; i < n; i++)
+  {
+    v |= (unsigned long long) p[i] << (8*i);
+  }
+  return v;
+}
+
+void Serial_Init(serial_buf* b)
+{
+  b->size = SERIAL_START;
+  b->len = 0;
+  b->data = (unsigned char*) safe_malloc(b->size);
+}
+
+void Serial_Free(serial_buf* b)
+{
+  free(b->data);
+  b->data = NULL;
+  b->len = b->size = 0;
+}
+
+static void serial_put(serial_buf* b, unsigned long long v, int n)
+{
+  if(b->len + n > b->size)
+  {
+    while(b->len + n > b->size) b->size *= 2;
+    b->data = (unsigned char*) safe_realloc(b->data, b->size);
+  }
+  Serial_Store(b->data + b->len, v, n);
+  b->len += n;
+}
+
+void Serial_Put_U32(serial_buf* b, unsigned int v)
+{
+  serial_put(b, v, 4);
+}
+
+void Serial_Put_U64(serial_buf* b, unsigned long long v)
+{
+  serial_put(b, v, 8);
+}
+
+void Serial_Put_Int(serial_buf* b, int v)
+{
+  serial_put(b, (unsigned int) v, 4);
+}
+
+void Serial_Put_Long(serial_buf* b, long long v)
+{
+  serial_put(b, (unsigned long long) v, 8);
+}
+
+void Serial_Put_Double(serial_buf* b, double v)
+{
+  unsigned long long bits;
+  memcpy(&bits, &v, sizeof(bits));
+  serial_put(b, bits, 8);
+}
+
+void Serial_Put_Float(serial_buf* b, float v)
+{
+  unsigned int bits;
+  memcpy(&bits, &v, sizeof(bits));
+  serial_put(b, bits, 4);
+}
+
+void Serial_Put_Header(serial_buf* b, int kind)
+{
+  Serial_Put_U32(b, SERIAL_MAGIC);
+  Serial_Put_U32(b, SERIAL_VERSION);
+  Serial_Put_U32(b, kind);
+}
+
+void Serial_Reader_Init(serial_reader* r, const unsigned char* data, long len)
+{
+  r->data = data;
+  r->len = len;
+  r->pos = 0;
+  r->error = 0;
+}
+
+static unsigned long long serial_get(serial_reader* r, int n)
+{
+  unsigned long long v;
+  if(r->error || r->pos + n > r->len)
+  {
+    r->error = 1;
+    return 0;
+  }
+  v = Serial_Load(r->data + r->pos, n);
+  r->pos += n;
+  return v;
+}
+
+unsigned int Serial_Get_U32(serial_reader* r)
+{
+  return (unsigned int) serial_get(r, 4);
+}
+
+unsigned long long Serial_Get_U64(serial_reader* r)
+{
+  return serial_get(r, 8);
+}
+
+int Serial_Get_Int(serial_reader* r)
+{
+  return (int) (unsigned int) serial_get(r, 4);
+}
+
+long long Serial_Get_Long(serial_reader* r)
+{
+  return (long long) serial_get(r, 8);
+}
+
+double Serial_Get_Double(serial_reader* r)
+{
+  unsigned long long bits = serial_get(r, 8);
+  double v;
+  memcpy(&v, &bits, sizeof(v));
+  return v;
+}
+
+float Serial_Get_Float(serial_reader* r)
+{
+  unsigned int bits = (unsigned int) serial_get(r, 4);
+  float v;
+  memcpy(&v, &bits, sizeof(v));
+  return v;
+}
+
+//check the magic number, version and kind of the next image
+int Serial_Get_Header(serial_reader* r, int kind)
+{
+  if(Serial_Get_U32(r) != SERIAL_MAGIC ||
+     Serial_Get_U32(r) != SERIAL_VERSION ||
+     Serial_Get_U32(r) != (unsigned int) kind)
+    r->error = 1;
+  return !r->error;
+}
+
+//check that n records of bytes_each bytes can still be read, so a
+//corrupt count can't make the reader allocate a huge array
+int Serial_Check_Count(serial_reader* r, long long n, int bytes_each)
+{
+  if(n < 0 || n > (r->len - r->pos) / bytes_each)
+    r->error = 1;
+  return !r->error;
+}
@@ -0,0 +1,57 @@
+/*************************************************************************/
+/* serial.h                                                              */
+/*************************************************************************/
+
+#ifndef SERIAL_H
+#define SERIAL_H
+
+//every serialized image starts with SERIAL_MAGIC, the format version
+//and one of the kinds below. All fields are little-endian
+#define SERIAL_MAGIC 0x544e4553 //"SENT"
+#define SERIAL_VERSION 2
+
+#define SERIAL_FAST 1
+#define SERIAL_NAIVE 2
+#define SERIAL_SLOW 3
+#define SERIAL_FREQ 4
+#define SERIAL_CHECKPOINT 5
+
+//growable output buffer
+typedef struct serial_buf{
+  unsigned char* data;
+  long len;
+  long size;
+} serial_buf;
+
+//bounds-checked input; reads past the end set error and return 0
+typedef struct serial_reader{
+  const unsigned char* data;
+  long len;
+  long pos;
+  int error;
+} serial_reader;
+
+extern void Serial_Store(unsigned char* p, unsigned long long v, int n);
+extern unsigned long long Serial_Load(const unsigned char* p, int n);
+
+extern void Serial_Init(serial_buf* b);
+extern void Serial_Free(serial_buf* b);
+extern void Serial_Put_U32(serial_buf* b, unsigned int v);
+extern void Serial_Put_U64(serial_buf* b, unsigned long long v);
+extern void Serial_Put_Int(serial_buf* b, int v);
+extern void Serial_Put_Long(serial_buf* b, long long v);
+extern void Serial_Put_Double(serial_buf* b, double v);
+extern void Serial_Put_Float(serial_buf* b, float v);
+extern void Serial_Put_Header(serial_buf* b, int kind);
+
+extern void Serial_Reader_Init(serial_reader* r, const unsigned char* data, long len);
+extern unsigned int Serial_Get_U32(serial_reader* r);
+extern unsigned long long Serial_Get_U64(serial_reader* r);
+extern int Serial_Get_Int(serial_reader* r);
+extern long long Serial_Get_Long(serial_reader* r);
+extern double Serial_Get_Double(serial_reader* r);
+extern float Serial_Get_Float(serial_reader* r);
+extern int Serial_Get_Header(serial_reader* r, int kind);
+extern int Serial_Check_Count(serial_reader* r, long long n, int bytes_each);
+
+#endif
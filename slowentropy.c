@@ -21,67 +21,266 @@
 #include <stdio.h>
 #include <math.h>
 #include <limits.h>
+#include <sched.h>
 #include "prng.h"
 #include "massdal.h"
 #include "slowentropypriv.h"
+#include "moments.h"
+#include "util.h"
+
+#if !defined(SLOW_NO_SIMD) && defined(__GNUC__) && defined(__x86_64__)
+#define SLOW_SIMD 1
+#include <immintrin.h>
+#endif
 
 #define min(x,y)	((x) < (y) ? (x) : (y))
 #define max(x,y)	((x) > (y) ? (x) : (y))
 #define INVALID_TOKEN INT_MIN
 //#define M_E 2.71828183 //should be defined in "math.h"
 
-static Sample_type * Sample_Init(int seed)
+static void slow_kernel_scalar(Sample_lanes* lanes, int from, int to, int token);
+#ifdef SLOW_SIMD
+static void slow_kernel_avx2(Sample_lanes* lanes, int from, int to, int token);
+static void slow_kernel_avx512(Sample_lanes* lanes, int from, int to, int token);
+#endif
+
+//allocate n samplers. t0 and t1 start at INT_MAX so any random int in
+//[0, MOD] will be smaller. Each sampler's generator gets its own seed
+//from prng, or is left for the caller to fill if prng is NULL. The
+//arrays start on cache lines, and SLOW_LANES ints fill one, so workers
+//given whole multiples of SLOW_LANES never share a line
+static void Sample_Lanes_Init(Sample_lanes* lanes, int n, prng_type* prng)
 {
-  Sample_type * sm;
-  
-  sm=(Sample_type *) malloc(sizeof(Sample_type));
-  if(sm)
+  lanes->s0 = (int*) safe_malloc_aligned(CACHE_LINE, n * sizeof(int));
+  lanes->t0 = (int*) safe_malloc_aligned(CACHE_LINE, n * sizeof(int));
+  lanes->r0 = (unsigned int*) safe_malloc_aligned(CACHE_LINE, n * sizeof(unsigned int));
+  lanes->s1 = (int*) safe_malloc_aligned(CACHE_LINE, n * sizeof(int));
+  lanes->t1 = (int*) safe_malloc_aligned(CACHE_LINE, n * sizeof(int));
+  lanes->r1 = (unsigned int*) safe_malloc_aligned(CACHE_LINE, n * sizeof(unsigned int));
+  lanes->rng = (unsigned int*) safe_malloc_aligned(CACHE_LINE, n * sizeof(unsigned int));
+  for(int i = 0; i < n; i++)
   {
-    sm->s0=sm->r0=sm->s1=sm->r1=0;
-	sm->t0=sm->t1=INT_MAX; 
-	//set t0 and t1 to INT_MAX so any random int in [m^3] will be smaller
+    lanes->s0[i] = lanes->s1[i] = 0;
+    lanes->r0[i] = lanes->r1[i] = 0;
+    lanes->t0[i] = lanes->t1[i] = INT_MAX;
+    if(prng != NULL)
+      lanes->rng[i] = (unsigned int) prng_int(prng) | 1; //xorshift needs nonzero state
   }
-  return sm;
+}
+
+static void Sample_Lanes_Destroy(Sample_lanes* lanes)
+{
+  free(lanes->s0);
+  free(lanes->t0);
+  free(lanes->r0);
+  free(lanes->s1);
+  free(lanes->t1);
+  free(lanes->r1);
+  free(lanes->rng);
 }
 
 //initialize estimator with c samplers and k counters (used by Misra-Gries alg)
 Slow_Estimator_type * Slow_Estimator_Init(int c, int k)
 {
-  Slow_Estimator_type* est = (Slow_Estimator_type*) malloc(sizeof(Slow_Estimator_type));
+  // initialize the random number generator
+  prng_type* prng = prng_Init(lrand48(), 2); 
+  return slow_estimator_new(c, k, prng, Freq_Init((float)1.0/k), 1);
+}
+
+//an empty estimator using the given generator and Misra-Gries counters.
+//The samplers' generators are seeded from prng if seed is set
+static Slow_Estimator_type* slow_estimator_new(int c, int k, prng_type* prng,
+                                               freq_type* freq, int seed)
+{
+  Slow_Estimator_type* est = (Slow_Estimator_type*) safe_malloc(sizeof(Slow_Estimator_type));
   est->c=c;
   est->k=k;
   est->count = 0;
-  est->freq=Freq_Init((float)1.0/k);
-  est->samplers = (Sample_type**) malloc(sizeof(Sample_type*) * c);
-  
-  est->prng=prng_Init(drand48(), 2); 
-  // initialize the random number generator
-	
-  int i;
-  for(i = 0; i < c; i++)
+  est->padded_c = (c + SLOW_LANES-1) / SLOW_LANES * SLOW_LANES;
+  est->freq=freq;
+  est->prng=prng;
+  Sample_Lanes_Init(&est->lanes, est->padded_c, seed ? prng : NULL);
+  est->kernel = Slow_Select_Kernel(&est->kernel_name);
+  est->threads = est->running = est->done = 0;
+  est->ring = NULL;
+  est->workers = NULL;
+  est->nstaged = 0;
+  return est;
+}
+
+//pick the widest update kernel this CPU supports
+slow_kernel_fn Slow_Select_Kernel(const char** name)
+{
+#ifdef SLOW_SIMD
+  if(__builtin_cpu_supports("avx512f"))
+  {
+    *name = "avx512";
+    return slow_kernel_avx512;
+  }
+  if(__builtin_cpu_supports("avx2"))
+  {
+    *name = "avx2";
+    return slow_kernel_avx2;
+  }
+#endif
+  *name = "scalar";
+  return slow_kernel_scalar;
+}
+
+//worker loop: apply every broadcast token to this worker's samplers.
+//Each worker has its own slice of the lanes, including their
+//generators, in whole cache lines (see Sample_Lanes_Init), so workers
+//never write to the same cache line
+static void* slow_worker_main(void* arg)
+{
+  Slow_Worker* w = (Slow_Worker*) arg;
+  Slow_Estimator_type* est = w->est;
+  int block[SLOW_BLOCK];
+  int n;
+
+  for(;;)
+  {
+    n = Broadcast_Pop(est->ring, w->id, block, SLOW_BLOCK);
+    for(int i = 0; i < n; i++)
+    {
+      est->kernel(&est->lanes, w->from, w->to, block[i]);
+    }
+    if(n > 0)
+      __atomic_store_n(&w->applied, w->applied + n, __ATOMIC_RELEASE);
+    if(n == 0)
+    {
+      if(__atomic_load_n(&est->done, __ATOMIC_ACQUIRE) &&
+         Broadcast_Empty(est->ring, w->id))
+        break;
+      sched_yield();
+    }
+  }
+  return NULL;
+}
+
+//initialize estimator with c samplers and k counters whose samplers
+//are split across threads worker threads. The calling thread keeps the
+//Misra-Gries counters and broadcasts tokens to the workers; they join
+//in Slow_Estimator_end_stream
+Slow_Estimator_type * Slow_Estimator_Init_Threaded(int c, int k, int threads)
+{
+  Slow_Estimator_type* est = Slow_Estimator_Init(c, k);
+  int blocks = est->padded_c / SLOW_LANES;
+
+  if(threads < 1) fatal("Slow_Estimator_Init_Threaded: need at least one thread");
+  if(threads > blocks) threads = blocks;
+  est->threads = threads;
+  est->ring = Broadcast_Init(SLOW_QUEUE, threads);
+  est->workers = (Slow_Worker*) safe_malloc(threads * sizeof(Slow_Worker));
+  for(int i = 0; i < threads; i++)
   {
-    est->samplers[i]=Sample_Init(i);
+    Slow_Worker* w = &est->workers[i];
+    w->est = est;
+    w->id = i;
+    //slices are whole multiples of SLOW_LANES
+    w->from = (long) blocks * i / threads * SLOW_LANES;
+    w->to = (long) blocks * (i+1) / threads * SLOW_LANES;
+    w->applied = 0;
+    if(pthread_create(&w->thread, NULL, slow_worker_main, w) != 0)
+      fatal("Slow_Estimator_Init_Threaded: can't create worker thread");
   }
+  est->running = 1;
   return est;
 }
 
-static void Sample_Destroy(Sample_type * sm)
+//push staged tokens to the workers and wait for them to finish
+static void slow_join_workers(Slow_Estimator_type* est)
 {
-  if(!sm) return;
-  free(sm);
+  if(!est->running) return;
+  Broadcast_Push_All(est->ring, est->staged, est->nstaged);
+  est->nstaged = 0;
+  __atomic_store_n(&est->done, 1, __ATOMIC_RELEASE);
+  for(int i = 0; i < est->threads; i++)
+  {
+    pthread_join(est->workers[i].thread, NULL);
+  }
+  est->running = 0;
 }
 
 void Slow_Estimator_Destroy(Slow_Estimator_type * est)
 {
   prng_Destroy(est->prng);
-  free(est->freq);
-  int i;
-  for(i=0; i < est->c; i++)
+  Freq_Destroy(est->freq);
+  slow_estimator_free(est);
+}
+
+//everything but the generator and the Misra-Gries counters, once the
+//workers are done
+static void slow_estimator_free(Slow_Estimator_type* est)
+{
+  slow_join_workers(est);
+  Broadcast_Destroy(est->ring);
+  free(est->workers);
+  Sample_Lanes_Destroy(&est->lanes);
+  free(est);
+}
+
+//an estimator taking over the samplers of another version part way
+//through a stream. Ranks in [0,1) become ints in [0, MOD] and each
+//sampler gets a generator seeded from h->prng. Samplers without a
+//backup keep t1 at INT_MAX. Takes over h->prng and h->freq and frees
+//h->samplers
+Slow_Estimator_type * Slow_Estimator_Init_From_Handoff(Sampler_handoff* h)
+{
+  Slow_Estimator_type* est = slow_estimator_new(h->c, h->k, h->prng, h->freq, 1);
+  Sample_lanes* lanes = &est->lanes;
+  Sample_state* st;
+
+  est->count = h->count;
+  for(int i = 0; i < h->c && est->count > 0; i++)
   {
-    Sample_Destroy(est->samplers[i]);
+    st = &h->samplers[i];
+    lanes->s0[i] = st->s0;
+    lanes->r0[i] = st->r0;
+    lanes->t0[i] = (int) minimum(st->t0 * (MOD + 1.0), MOD);
+    if(st->r1 > 0)
+    {
+      lanes->s1[i] = st->s1;
+      lanes->r1[i] = st->r1;
+      lanes->t1[i] = (int) minimum(st->t1 * (MOD + 1.0), MOD);
+    }
   }
-  free(est->samplers);
-  free(est);
+  free(h->samplers);
+  h->samplers = NULL;
+  return est;
+}
+
+//hand est's samplers, Misra-Gries counters and generator over to h and
+//free the rest of est, joining its workers first in threaded mode
+void Slow_Estimator_Handoff(Slow_Estimator_type* est, Sampler_handoff* h)
+{
+  Sample_lanes* lanes = &est->lanes;
+  Sample_state* st;
+
+  slow_join_workers(est);
+  h->c = est->c;
+  h->k = est->k;
+  h->count = est->count;
+  h->prng = est->prng;
+  h->freq = est->freq;
+  h->samplers = (Sample_state*) safe_malloc(est->c * sizeof(Sample_state));
+  for(int i = 0; i < est->c; i++)
+  {
+    st = &h->samplers[i];
+    st->s0 = lanes->s0[i];
+    st->r0 = lanes->r0[i];
+    st->t0 = lanes->t0[i] / (MOD + 1.0);
+    //r1 also counts token 0 before there is a backup
+    st->s1 = st->r1 = 0;
+    st->t1 = 1;
+    if(lanes->t1[i] != INT_MAX)
+    {
+      st->s1 = lanes->s1[i];
+      st->r1 = lanes->r1[i];
+      st->t1 = lanes->t1[i] / (MOD + 1.0);
+    }
+  }
+  slow_estimator_free(est);
 }
 
 // return the size of the estimator in bytes
@@ -91,55 +290,188 @@ int Slow_Estimator_Size(Slow_Estimator_type * est)
   int samplers, admin, freq;
   if (!est) return 0;
   admin=sizeof(Slow_Estimator_type);
-  samplers = est->c*sizeof(Sample_type);
+  samplers = est->padded_c * 7 * sizeof(int);
   freq = Freq_Size(est->freq);
   //note Freq_Size just a placeholder function at the moment
+  if(est->threads)
+    admin += est->threads * sizeof(Slow_Worker) + sizeof(broadcast_type) +
+             (est->ring->mask+1) * sizeof(int);
   return(admin + samplers + freq);
 }
 
-//update a sampler 
-//(called for each sampler each time an item from the stream is read)
-static void Sample_Update(Sample_type * sm, prng_type* prng, int token)
+//name of the update kernel chosen for this CPU
+const char* Slow_Estimator_Kernel(Slow_Estimator_type* est)
 {
-  long rand = prng_int(prng) & MOD;
-  if(token == sm->s0)
-  {
-    if(rand < sm->t0)
-	{
-	  sm->t0=rand;
-	  sm->r0=1;
-	}
-	else sm->r0++;
-  }
-  else
+  return est->kernel_name;
+}
+
+//update samplers [from, to) one at a time. This is the reference
+//version of Algorithm Maintain_Samples; the vector kernels below
+//compute exactly the same thing with compares and blends
+static void slow_kernel_scalar(Sample_lanes* lanes, int from, int to, int token)
+{
+  unsigned int x;
+  int rand;
+  for(int i = from; i < to; i++)
   {
-    if(token == sm->s1)
-	{
-	  sm->r1 ++;
-	}
-  
-    if(rand<sm->t0)
+    x = lanes->rng[i];
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    lanes->rng[i] = x;
+    rand = x & MOD;
+    
+    if(token == lanes->s0[i])
     {
-      sm->s1=sm->s0;
-	  sm->t1=sm->t0;
-	  sm->r1=sm->r0; 
-	
-  	  sm->s0=token;
-	  sm->t0=rand;
-	  sm->r0=1;
+      if(rand < lanes->t0[i])
+      {
+        lanes->t0[i]=rand;
+        lanes->r0[i]=1;
+      }
+      else lanes->r0[i]++;
     }
-    else 
+    else
     {
-      if(rand < sm->t1)
+      if(token == lanes->s1[i])
       {
-	    sm->s1=token;
-	    sm->t1=rand;
-	    sm->r1=1;
-	  }
+        lanes->r1[i]++;
+      }
+      if(rand < lanes->t0[i])
+      {
+        lanes->s1[i]=lanes->s0[i];
+        lanes->t1[i]=lanes->t0[i];
+        lanes->r1[i]=lanes->r0[i]; 
+        
+        lanes->s0[i]=token;
+        lanes->t0[i]=rand;
+        lanes->r0[i]=1;
+      }
+      else if(rand < lanes->t1[i])
+      {
+        lanes->s1[i]=token;
+        lanes->t1[i]=rand;
+        lanes->r1[i]=1;
+      }
     }
   }
 }
 
+#ifdef SLOW_SIMD
+//8 samplers per step. With a = "token differs from s0 and beats t0"
+//and b = "token differs from s0, loses to t0 but beats t1":
+//  t0 = rand where rand < t0, r0 = 1 there, else r0 + (token == s0)
+//  s0 = token where a
+//  (s1,t1,r1) = (s0,t0,r0) where a, (token,rand,1) where b,
+//               else r1 + (token == s1 && token != s0)
+__attribute__((target("avx2")))
+static void slow_kernel_avx2(Sample_lanes* lanes, int from, int to, int token)
+{
+  const __m256i tok = _mm256_set1_epi32(token);
+  const __m256i mod = _mm256_set1_epi32(MOD);
+  const __m256i one = _mm256_set1_epi32(1);
+  __m256i x, rand, s0, t0, r0, s1, t1, r1;
+  __m256i eq0, eq1, lt0, lt1, a, b, inc1;
+
+  for(int i = from; i < to; i += 8)
+  {
+    x = _mm256_loadu_si256((__m256i*) (lanes->rng + i));
+    x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 13));
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 17));
+    x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 5));
+    _mm256_storeu_si256((__m256i*) (lanes->rng + i), x);
+    rand = _mm256_and_si256(x, mod);
+
+    s0 = _mm256_loadu_si256((__m256i*) (lanes->s0 + i));
+    t0 = _mm256_loadu_si256((__m256i*) (lanes->t0 + i));
+    r0 = _mm256_loadu_si256((__m256i*) (lanes->r0 + i));
+    s1 = _mm256_loadu_si256((__m256i*) (lanes->s1 + i));
+    t1 = _mm256_loadu_si256((__m256i*) (lanes->t1 + i));
+    r1 = _mm256_loadu_si256((__m256i*) (lanes->r1 + i));
+
+    eq0 = _mm256_cmpeq_epi32(s0, tok);
+    eq1 = _mm256_cmpeq_epi32(s1, tok);
+    lt0 = _mm256_cmpgt_epi32(t0, rand);
+    lt1 = _mm256_cmpgt_epi32(t1, rand);
+    a = _mm256_andnot_si256(eq0, lt0);
+    b = _mm256_andnot_si256(eq0, _mm256_andnot_si256(lt0, lt1));
+    inc1 = _mm256_andnot_si256(eq0, eq1);
+
+    //masks are -1 where set, so subtracting one adds 1 to those lanes
+    r1 = _mm256_sub_epi32(r1, inc1);
+    r1 = _mm256_blendv_epi8(r1, r0, a);
+    r1 = _mm256_blendv_epi8(r1, one, b);
+    t1 = _mm256_blendv_epi8(t1, t0, a);
+    t1 = _mm256_blendv_epi8(t1, rand, b);
+    s1 = _mm256_blendv_epi8(s1, s0, a);
+    s1 = _mm256_blendv_epi8(s1, tok, b);
+    r0 = _mm256_blendv_epi8(_mm256_sub_epi32(r0, eq0), one, lt0);
+    t0 = _mm256_blendv_epi8(t0, rand, lt0);
+    s0 = _mm256_blendv_epi8(s0, tok, a);
+
+    _mm256_storeu_si256((__m256i*) (lanes->s0 + i), s0);
+    _mm256_storeu_si256((__m256i*) (lanes->t0 + i), t0);
+    _mm256_storeu_si256((__m256i*) (lanes->r0 + i), r0);
+    _mm256_storeu_si256((__m256i*) (lanes->s1 + i), s1);
+    _mm256_storeu_si256((__m256i*) (lanes->t1 + i), t1);
+    _mm256_storeu_si256((__m256i*) (lanes->r1 + i), r1);
+  }
+}
+
+//same as slow_kernel_avx2, 16 samplers per step using mask registers
+__attribute__((target("avx512f")))
+static void slow_kernel_avx512(Sample_lanes* lanes, int from, int to, int token)
+{
+  const __m512i tok = _mm512_set1_epi32(token);
+  const __m512i mod = _mm512_set1_epi32(MOD);
+  const __m512i one = _mm512_set1_epi32(1);
+  __m512i x, rand, s0, t0, r0, s1, t1, r1;
+  __mmask16 eq0, eq1, lt0, lt1, a, b;
+
+  for(int i = from; i < to; i += 16)
+  {
+    x = _mm512_loadu_si512(lanes->rng + i);
+    x = _mm512_xor_si512(x, _mm512_slli_epi32(x, 13));
+    x = _mm512_xor_si512(x, _mm512_srli_epi32(x, 17));
+    x = _mm512_xor_si512(x, _mm512_slli_epi32(x, 5));
+    _mm512_storeu_si512(lanes->rng + i, x);
+    rand = _mm512_and_si512(x, mod);
+
+    s0 = _mm512_loadu_si512(lanes->s0 + i);
+    t0 = _mm512_loadu_si512(lanes->t0 + i);
+    r0 = _mm512_loadu_si512(lanes->r0 + i);
+    s1 = _mm512_loadu_si512(lanes->s1 + i);
+    t1 = _mm512_loadu_si512(lanes->t1 + i);
+    r1 = _mm512_loadu_si512(lanes->r1 + i);
+
+    eq0 = _mm512_cmpeq_epi32_mask(s0, tok);
+    eq1 = _mm512_cmpeq_epi32_mask(s1, tok);
+    lt0 = _mm512_cmpgt_epi32_mask(t0, rand);
+    lt1 = _mm512_cmpgt_epi32_mask(t1, rand);
+    a = ~eq0 & lt0;
+    b = ~eq0 & ~lt0 & lt1;
+
+    r1 = _mm512_mask_add_epi32(r1, ~eq0 & eq1, r1, one);
+    r1 = _mm512_mask_mov_epi32(r1, a, r0);
+    r1 = _mm512_mask_mov_epi32(r1, b, one);
+    t1 = _mm512_mask_mov_epi32(t1, a, t0);
+    t1 = _mm512_mask_mov_epi32(t1, b, rand);
+    s1 = _mm512_mask_mov_epi32(s1, a, s0);
+    s1 = _mm512_mask_mov_epi32(s1, b, tok);
+    r0 = _mm512_mask_add_epi32(r0, eq0, r0, one);
+    r0 = _mm512_mask_mov_epi32(r0, lt0, one);
+    t0 = _mm512_mask_mov_epi32(t0, lt0, rand);
+    s0 = _mm512_mask_mov_epi32(s0, a, tok);
+
+    _mm512_storeu_si512(lanes->s0 + i, s0);
+    _mm512_storeu_si512(lanes->t0 + i, t0);
+    _mm512_storeu_si512(lanes->r0 + i, r0);
+    _mm512_storeu_si512(lanes->s1 + i, s1);
+    _mm512_storeu_si512(lanes->t1 + i, t1);
+    _mm512_storeu_si512(lanes->r1 + i, r1);
+  }
+}
+#endif
+
 //process a new token read from the stream
 void Slow_Estimator_Update(Slow_Estimator_type * est, int token)
 {
@@ -147,35 +479,88 @@ void Slow_Estimator_Update(Slow_Estimator_type * est, int token)
   Freq_Update(est->freq, token);//end of Misra-Gries part of algorithm
   
   //update all c versions of Algorithm Maintain_Samples
-  for(int i=0; i < est->c; i++)
+  if(est->running)
   {
-	Sample_Update(est->samplers[i], est->prng, token);
+    est->staged[est->nstaged++] = token;
+    if(est->nstaged == SLOW_BLOCK)
+    {
+      Broadcast_Push_All(est->ring, est->staged, SLOW_BLOCK);
+      est->nstaged = 0;
+    }
   }
+  else est->kernel(&est->lanes, 0, est->padded_c, token);
 }
 
 //end of stream reached. Compute estimate for entropy  
 double Slow_Estimator_end_stream(Slow_Estimator_type* est)
 {
-  int max_count, max_token, r, m;
-  double p_max, sum_Xis, avg_Xis;
+  int max_count, max_token;
   
-  max_count = sum_Xis = 0;
+  max_count = 0;
   max_token= INVALID_TOKEN;
-  m = est->count;
+  //in threaded mode the stream ends here: wait for every worker
+  slow_join_workers(est);
   
-  int i;	
   //find maximum value retained by Misra-Gries algorithm
   SaveMax(est->freq, &max_token, &max_count);
-	
+  return Slow_Lanes_Estimate(&est->lanes, est->c, est->count, max_token, max_count);
+}
+
+//frequency moment F_p = sum f_i^p from the same samplers as the
+//entropy; see moments.c
+double Slow_Estimator_Fp(Slow_Estimator_type* est, double p)
+{
+  int max_count = 0, max_token = INVALID_TOKEN, m;
+  int* r;
+  double fp;
+
+  slow_join_workers(est);
+  m = est->count;
+  SaveMax(est->freq, &max_token, &max_count);
+  if(max_count <= (int) (m/2))
+    max_count = 0;
+  r = (int*) safe_malloc(est->c * sizeof(int));
+  for(int i = 0; i < est->c; i++)
+    r[i] = (max_count > 0 && est->lanes.s0[i] == max_token) ? est->lanes.r1[i] : est->lanes.r0[i];
+  fp = Moments_Fp(r, est->c, p, m, max_count);
+  free(r);
+  return fp;
+}
+
+//Renyi entropy of order alpha, in bits
+double Slow_Estimator_Renyi(Slow_Estimator_type* est, double alpha)
+{
+  if(alpha == 1)
+    return Slow_Estimator_end_stream(est);
+  return Moments_Renyi(Slow_Estimator_Fp(est, alpha), alpha, est->count);
+}
+
+//Tsallis entropy of order alpha
+double Slow_Estimator_Tsallis(Slow_Estimator_type* est, double alpha)
+{
+  if(alpha == 1) //the limit is the Shannon entropy in nats
+    return Slow_Estimator_end_stream(est) * log(2);
+  return Moments_Tsallis(Slow_Estimator_Fp(est, alpha), alpha, est->count);
+}
+
+//estimate from the first c samplers of a stream of length m whose most
+//frequent token retained by Misra-Gries is max_token, with max_count
+double Slow_Lanes_Estimate(Sample_lanes* lanes, int c, int m, int max_token,
+                           int max_count)
+{
+  int r, i;
+  double p_max, sum_Xis, avg_Xis;
+
+  sum_Xis = 0;
   if(max_count > (int) (m/2))//truncate m/2 in comparison
   {
 	p_max = (double) max_count/m;
-	for(i=0; i < est->c; i++)
+	for(i=0; i < c; i++)
 	{
-	  if(est->samplers[i]->s0 == max_token)
-		r = est->samplers[i]->r1;
+	  if(lanes->s0[i] == max_token)
+		r = lanes->r1[i];
 	  else
-		r=est->samplers[i]->r0;
+		r=lanes->r0[i];
 	  if(r!=0)//treat rlog(m/r) as 0 if r=0 (there was only 1 token in stream)
 	  {
 	    sum_Xis += (double) r * log10((double) m/r)/log10(2);
@@ -185,19 +570,116 @@ double Slow_Estimator_end_stream(Slow_Estimator_type* est)
 	    sum_Xis -= (double) (r-1) * log10((double) m/(r-1))/log10(2);
 	  }
 	}
-	avg_Xis = sum_Xis / est->c;
+	avg_Xis = sum_Xis / c;
 	return (1-p_max) * avg_Xis + p_max * log10(1/p_max)/log10(2); 
   }
   else
   {
-	for(i=0; i < est->c; i++)
+	for(i=0; i < c; i++)
 	{
-	  r=est->samplers[i]->r0;
+	  r=lanes->r0[i];
 	  if(r!=0) //ignore empty stream
 	    sum_Xis += r * log10((double) m/r)/log10(2);
 	  if(r > 1) //treat (r-1)log(m/(r-1)) as 0 if r=1, also ignore r=0
 		sum_Xis -= (r-1) * log10((double) m/(r-1))/log10(2);
 	}
-	return sum_Xis /est->c;  
+	return sum_Xis / c;  
   }	  
-}
\ No newline at end of file
+}
+//in threaded mode, push staged tokens and wait until every worker has
+//applied all of them, so the samplers are consistent with est->count
+static void slow_quiesce(Slow_Estimator_type* est)
+{
+  if(!est->running) return;
+  Broadcast_Push_All(est->ring, est->staged, est->nstaged);
+  est->nstaged = 0;
+  for(int i = 0; i < est->threads; i++)
+  {
+    while(__atomic_load_n(&est->workers[i].applied, __ATOMIC_ACQUIRE) < est->count)
+      sched_yield();
+  }
+}
+
+//writes the samplers (including each one's generator), the seeding
+//generator and the Misra-Gries counters. A threaded estimator keeps
+//its workers; they are only paused while the samplers are copied.
+//Returns a malloc'd image of *len bytes
+unsigned char* Slow_Estimator_Serialize(Slow_Estimator_type* est, long* len)
+{
+  serial_buf b;
+  Sample_lanes* lanes = &est->lanes;
+
+  slow_quiesce(est);
+  Serial_Init(&b);
+  Serial_Put_Header(&b, SERIAL_SLOW);
+  Serial_Put_Int(&b, est->c);
+  Serial_Put_Int(&b, est->k);
+  Serial_Put_Int(&b, est->count);
+  prng_Serialize(est->prng, &b);
+  Freq_Serialize(est->freq, &b);
+  //padding lanes are never read, so only the c real samplers are saved
+  for(int i = 0; i < est->c; i++)
+  {
+    Serial_Put_Int(&b, lanes->s0[i]);
+    Serial_Put_Int(&b, lanes->t0[i]);
+    Serial_Put_U32(&b, lanes->r0[i]);
+    Serial_Put_Int(&b, lanes->s1[i]);
+    Serial_Put_Int(&b, lanes->t1[i]);
+    Serial_Put_U32(&b, lanes->r1[i]);
+    Serial_Put_U32(&b, lanes->rng[i]);
+  }
+  *len = b.len;
+  return b.data;
+}
+
+//rebuild an estimator from an image written by
+//Slow_Estimator_Serialize. The result is not threaded. Returns NULL if
+//the image is truncated, corrupt, or from another version of the format
+Slow_Estimator_type* Slow_Estimator_Deserialize(const unsigned char* image, long len)
+{
+  serial_reader r;
+  Slow_Estimator_type* est;
+  Sample_lanes* lanes;
+  prng_type* prng;
+  freq_type* freq;
+  int c, k, count;
+
+  Serial_Reader_Init(&r, image, len);
+  if(!Serial_Get_Header(&r, SERIAL_SLOW)) return NULL;
+  c = Serial_Get_Int(&r);
+  k = Serial_Get_Int(&r);
+  count = Serial_Get_Int(&r);
+  if(r.error || c < 1 || k < 1 || count < 0 || !Serial_Check_Count(&r, c, 28))
+    return NULL;
+  prng = prng_Deserialize(&r);
+  if(prng == NULL) return NULL;
+  freq = Freq_Deserialize(&r);
+  if(freq == NULL)
+  {
+    prng_Destroy(prng);
+    return NULL;
+  }
+  est = slow_estimator_new(c, k, prng, freq, 0);
+  est->count = count;
+  lanes = &est->lanes;
+  for(int i = 0; i < c; i++)
+  {
+    lanes->s0[i] = Serial_Get_Int(&r);
+    lanes->t0[i] = Serial_Get_Int(&r);
+    lanes->r0[i] = Serial_Get_U32(&r);
+    lanes->s1[i] = Serial_Get_Int(&r);
+    lanes->t1[i] = Serial_Get_Int(&r);
+    lanes->r1[i] = Serial_Get_U32(&r);
+    lanes->rng[i] = Serial_Get_U32(&r);
+    if(lanes->rng[i] == 0) r.error = 1;
+  }
+  //padding lanes just need a valid generator
+  for(int i = c; i < est->padded_c; i++)
+    lanes->rng[i] = 1;
+  if(r.error || r.pos != r.len)
+  {
+    Slow_Estimator_Destroy(est);
+    return NULL;
+  }
+  return est;
+}
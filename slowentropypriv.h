@@ -1,28 +1,49 @@
 #ifndef SLOWENTROPYPRIV_H
 #define SLOWENTROPYPRIV_H
 
+#include <pthread.h>
 #include "slowentropypub.h"
+#include "ring.h"
+#include "lanes.h"
 
 #define minimum(x,y)	((x) < (y) ? (x) : (y))
 #define maximum(x,y)	((x) > (y) ? (x) : (y))
 
-typedef struct Sample_type{
-  unsigned long s0, r0, t0, s1, r1, t1;
-} Sample_type;
+#define SLOW_BLOCK 256      //tokens staged before a broadcast push
+#define SLOW_QUEUE 65536    //capacity of the broadcast ring in tokens
+
+//worker thread owning samplers [from, to) in threaded mode
+typedef struct Slow_Worker{
+  struct Slow_Estimator_type* est;
+  int id, from, to;
+  long applied;            //tokens applied so far, for Serialize
+  pthread_t thread;
+} Slow_Worker;
 
 struct Slow_Estimator_type{
-  //need array of c Sample_types for sampling and array of k coutners for Misra-Gries
+  //need c samplers for sampling and array of k coutners for Misra-Gries
   //plus parallel array to track which token each of the k counters is tracking
   int c, k, count;
-  prng_type* prng;
-  Sample_type** samplers;  
+  int padded_c;            //c rounded up to a multiple of SLOW_LANES
+  prng_type* prng;         //seeds the per-sampler generators
+  Sample_lanes lanes;
   freq_type* freq;
+  slow_kernel_fn kernel;   //chosen at init from the CPU's features
+  const char* kernel_name;
+
+  //threaded mode: the reader broadcasts blocks of tokens to threads
+  //workers, each applying them to its own slice of the samplers
+  int threads, running, done;
+  broadcast_type* ring;
+  Slow_Worker* workers;
+  int nstaged;
+  int staged[SLOW_BLOCK];
 };
 
-static Sample_type * Sample_Init(int seed);
-static void Sample_Destroy(Sample_type * sm);
-static void Sample_Update(Sample_type * sm, prng_type* prng, int token);
-
+static void Sample_Lanes_Init(Sample_lanes* lanes, int n, prng_type* prng);
+static void Sample_Lanes_Destroy(Sample_lanes* lanes);
+static Slow_Estimator_type* slow_estimator_new(int c, int k, prng_type* prng,
+                                               freq_type* freq, int seed);
+static void slow_estimator_free(Slow_Estimator_type* est);
 
 #endif
-
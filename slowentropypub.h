@@ -3,13 +3,23 @@
 
 #include "prng.h"
 #include "frequent.h"
+#include "handoff.h"
 
 typedef struct Slow_Estimator_type Slow_Estimator_type;
 
 extern void Slow_Estimator_Destroy(Slow_Estimator_type* est);
 extern int Slow_Estimator_Size(Slow_Estimator_type* est);
 extern Slow_Estimator_type * Slow_Estimator_Init(int c, int k);
+extern Slow_Estimator_type * Slow_Estimator_Init_Threaded(int c, int k, int threads);
+extern Slow_Estimator_type * Slow_Estimator_Init_From_Handoff(Sampler_handoff* h);
+extern void Slow_Estimator_Handoff(Slow_Estimator_type* est, Sampler_handoff* h);
 extern void Slow_Estimator_Update(Slow_Estimator_type * est, int token);
 extern double Slow_Estimator_end_stream(Slow_Estimator_type* est);
+extern double Slow_Estimator_Fp(Slow_Estimator_type* est, double p);
+extern double Slow_Estimator_Renyi(Slow_Estimator_type* est, double alpha);
+extern double Slow_Estimator_Tsallis(Slow_Estimator_type* est, double alpha);
+extern const char* Slow_Estimator_Kernel(Slow_Estimator_type* est);
+extern unsigned char* Slow_Estimator_Serialize(Slow_Estimator_type* est, long* len);
+extern Slow_Estimator_type* Slow_Estimator_Deserialize(const unsigned char* image, long len);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,230 @@
+/* snapshot.c
+ *Consistent snapshots of a fast estimator for readers on other threads.
+ *
+ *Estimator_Take_Snapshot copies, in O(c + k), exactly the state that
+ *Estimator_end_stream reads: each sampler's sampled tokens and their
+ *counts r since being sampled, the stream length m and the Misra-Gries
+ *counters. It must run on the thread that calls Estimator_Update.
+ *
+ *A Snapshot_Publisher lets the ingest thread publish snapshots every
+ *so often while reader threads compute estimates and top-k from the
+ *latest one. Publishing fills a buffer that no reader holds and then
+ *swaps it in as current, so readers never see a half-written snapshot
+ *and the ingest thread never waits for a reader: if every buffer is
+ *held (more readers than the publisher was sized for) the publish is
+ *skipped.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "snapshot.h"
+#include "entropypriv.h"
+#include "util.h"
+
+Estimator_Snapshot* Snapshot_Init(int c, int k)
+{
+  Estimator_Snapshot* snap = 
+      (Estimator_Snapshot*) safe_malloc(sizeof(Estimator_Snapshot));
+  snap->c = snap->max_c = c;
+  snap->k = snap->max_k = k;
+  snap->m = snap->two_distinct_tokens = 0;
+  snap->max_token = snap->max_count = 0;
+  snap->key0 = (int*) safe_malloc(c * sizeof(int));
+  snap->r0 = (int*) safe_malloc(c * sizeof(int));
+  snap->key1 = (int*) safe_malloc(c * sizeof(int));
+  snap->r1 = (int*) safe_malloc(c * sizeof(int));
+  snap->ntop = 0;
+  snap->top_tokens = (int*) safe_malloc(k * sizeof(int));
+  snap->top_counts = (int*) safe_malloc(k * sizeof(int));
+  snap->refs = 0;
+  return snap;
+}
+
+void Snapshot_Destroy(Estimator_Snapshot* snap)
+{
+  if(!snap) return;
+  free(snap->key0);
+  free(snap->r0);
+  free(snap->key1);
+  free(snap->r1);
+  free(snap->top_tokens);
+  free(snap->top_counts);
+  free(snap);
+}
+
+//copy the query state of est into snap. snap is resized if est has
+//grown or shed samplers since snap was initialized
+void Estimator_Take_Snapshot(Estimator_type* est, Estimator_Snapshot* snap)
+{
+  Sample_type* cur;
+
+  if(est->c > snap->max_c)
+  {
+    snap->max_c = est->c;
+    snap->key0 = (int*) safe_realloc(snap->key0, snap->max_c * sizeof(int));
+    snap->r0 = (int*) safe_realloc(snap->r0, snap->max_c * sizeof(int));
+    snap->key1 = (int*) safe_realloc(snap->key1, snap->max_c * sizeof(int));
+    snap->r1 = (int*) safe_realloc(snap->r1, snap->max_c * sizeof(int));
+  }
+  if(est->k > snap->max_k)
+  {
+    snap->max_k = est->k;
+    snap->top_tokens = (int*) safe_realloc(snap->top_tokens, snap->max_k * sizeof(int));
+    snap->top_counts = (int*) safe_realloc(snap->top_counts, snap->max_k * sizeof(int));
+  }
+  snap->c = est->c;
+  snap->k = est->k;
+  snap->m = est->count;
+  snap->two_distinct_tokens = est->two_distinct_tokens;
+  for(int i = 0; i < est->c; i++)
+  {
+    cur = est->samplers[i];
+    if(cur->c_s0 == NULL)
+    { //empty stream
+      snap->key0[i] = snap->key1[i] = 0;
+      snap->r0[i] = snap->r1[i] = 0;
+      continue;
+    }
+    snap->key0[i] = cur->c_s0->key;
+    snap->r0[i] = cur->c_s0->count - cur->val_c_s0 + 1;
+    if(cur->c_s1 == NULL)
+    { //no backup sample until the second distinct token arrives
+      snap->key1[i] = snap->key0[i];
+      snap->r1[i] = 0;
+    }
+    else
+    {
+      snap->key1[i] = cur->c_s1->key;
+      snap->r1[i] = cur->c_s1->count - cur->val_c_s1 + 1;
+    }
+  }
+  snap->ntop = Freq_Counts(est->freq, snap->top_tokens, snap->top_counts, snap->k);
+  if(snap->ntop > 0)
+  {
+    snap->max_token = snap->top_tokens[0];
+    snap->max_count = snap->top_counts[0];
+  }
+  else snap->max_token = snap->max_count = 0;
+}
+
+//compute the entropy estimate Estimator_end_stream would have returned
+//at the time snap was taken
+double Snapshot_Estimate(Estimator_Snapshot* snap)
+{
+  int r, m = snap->m;
+  double p_max, sum_Xis = 0;
+  int use_backup;
+
+  if(m == 0 || snap->two_distinct_tokens == 0) 
+  { //empty stream or only one character in stream
+    return 0;
+  }
+  use_backup = snap->max_count > (int) (m/2);
+  for(int i = 0; i < snap->c; i++)
+  {
+    if(use_backup && snap->key0[i] == snap->max_token)
+      r = snap->r1[i];
+    else
+      r = snap->r0[i];
+    if(r != 0)
+      sum_Xis += (double) r * log10((double) m/r)/log10(2);
+    if(r > 1) //treat (r-1)log(m/(r-1)) as 0 if r=1, also ignore r=0
+      sum_Xis -= (double) (r-1) * log10((double) m/(r-1))/log10(2);
+  }
+  if(!use_backup) return sum_Xis / snap->c;
+  p_max = (double) snap->max_count/m;
+  return (1-p_max) * sum_Xis / snap->c + p_max * log10(1/p_max)/log10(2);
+}
+
+//copy up to n of the most frequent tokens and their Misra-Gries
+//counts, returns number copied
+int Snapshot_Top(Estimator_Snapshot* snap, int n, int* tokens, int* counts)
+{
+  if(n > snap->ntop) n = snap->ntop;
+  for(int i = 0; i < n; i++)
+  {
+    tokens[i] = snap->top_tokens[i];
+    counts[i] = snap->top_counts[i];
+  }
+  return n;
+}
+
+/******************************************************************/
+
+//publisher for up to readers concurrent readers of an estimator with
+//c samplers and k counters, the buffers growing if it does. One buffer per reader, one for the current
+//snapshot and one to fill means a publish never has to be skipped
+Snapshot_Publisher* Publisher_Init(int c, int k, int readers)
+{
+  Snapshot_Publisher* pub = 
+      (Snapshot_Publisher*) safe_malloc(sizeof(Snapshot_Publisher));
+  pub->nbufs = readers + 2;
+  pub->bufs = (Estimator_Snapshot**) safe_malloc(pub->nbufs * sizeof(Estimator_Snapshot*));
+  for(int i = 0; i < pub->nbufs; i++)
+  {
+    pub->bufs[i] = Snapshot_Init(c, k);
+  }
+  pub->current = NULL;
+  pub->epoch = 0;
+  return pub;
+}
+
+//no reader may still hold a snapshot
+void Publisher_Destroy(Snapshot_Publisher* pub)
+{
+  for(int i = 0; i < pub->nbufs; i++)
+  {
+    Snapshot_Destroy(pub->bufs[i]);
+  }
+  free(pub->bufs);
+  free(pub);
+}
+
+//take a snapshot of est into a free buffer and make it current.
+//Call from the ingest thread only. Returns 0 if every buffer was held
+int Publisher_Publish(Snapshot_Publisher* pub, Estimator_type* est)
+{
+  Estimator_Snapshot* cur = __atomic_load_n(&pub->current, __ATOMIC_SEQ_CST);
+  Estimator_Snapshot* snap = NULL;
+
+  for(int i = 0; i < pub->nbufs; i++)
+  {
+    if(pub->bufs[i] != cur &&
+       __atomic_load_n(&pub->bufs[i]->refs, __ATOMIC_SEQ_CST) == 0)
+    {
+      snap = pub->bufs[i];
+      break;
+    }
+  }
+  if(snap == NULL) return 0;
+  //a reader that raced us onto this buffer will see it is no longer
+  //current and back off before reading it
+  Estimator_Take_Snapshot(est, snap);
+  __atomic_store_n(&pub->current, snap, __ATOMIC_SEQ_CST);
+  pub->epoch++;
+  return 1;
+}
+
+//pin the latest published snapshot, or return NULL if there is none.
+//Must be paired with Publisher_Release
+Estimator_Snapshot* Publisher_Acquire(Snapshot_Publisher* pub)
+{
+  Estimator_Snapshot* snap;
+  for(;;)
+  {
+    snap = __atomic_load_n(&pub->current, __ATOMIC_SEQ_CST);
+    if(snap == NULL) return NULL;
+    __atomic_add_fetch(&snap->refs, 1, __ATOMIC_SEQ_CST);
+    //once refs is raised the publisher can no longer pick snap, so it
+    //is safe to use as long as it was still current after the increment
+    if(__atomic_load_n(&pub->current, __ATOMIC_SEQ_CST) == snap)
+      return snap;
+    __atomic_sub_fetch(&snap->refs, 1, __ATOMIC_SEQ_CST);
+  }
+}
+
+void Publisher_Release(Estimator_Snapshot* snap)
+{
+  __atomic_sub_fetch(&snap->refs, 1, __ATOMIC_SEQ_CST);
+}
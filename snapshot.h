@@ -0,0 +1,44 @@
+/*************************************************************************/
+/* snapshot.h                                                            */
+/*************************************************************************/
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+#include "entropypub.h"
+
+//copy of the part of a fast estimator's state that queries need
+typedef struct Estimator_Snapshot{
+  int c, k, m, two_distinct_tokens;
+  int max_c, max_k;          //samplers and counters the arrays have room for
+  int max_token, max_count;  //most frequent token retained by Misra-Gries
+  int* key0;                 //token of each sampler's primary sample
+  int* r0;                   //its count since it was sampled
+  int* key1;                 //token of each sampler's backup sample
+  int* r1;
+  int ntop;                  //tokens retained by Misra-Gries
+  int* top_tokens;           //most frequent first
+  int* top_counts;
+  int refs;                  //readers holding this snapshot
+} Estimator_Snapshot;
+
+//buffers for epoch-published snapshots of one estimator
+typedef struct Snapshot_Publisher{
+  int nbufs;
+  Estimator_Snapshot** bufs;
+  Estimator_Snapshot* current; //latest published snapshot, or NULL
+  long epoch;                  //number of snapshots published
+} Snapshot_Publisher;
+
+extern Estimator_Snapshot* Snapshot_Init(int c, int k);
+extern void Snapshot_Destroy(Estimator_Snapshot* snap);
+extern void Estimator_Take_Snapshot(Estimator_type* est, Estimator_Snapshot* snap);
+extern double Snapshot_Estimate(Estimator_Snapshot* snap);
+extern int Snapshot_Top(Estimator_Snapshot* snap, int n, int* tokens, int* counts);
+
+extern Snapshot_Publisher* Publisher_Init(int c, int k, int readers);
+extern void Publisher_Destroy(Snapshot_Publisher* pub);
+extern int Publisher_Publish(Snapshot_Publisher* pub, Estimator_type* est);
+extern Estimator_Snapshot* Publisher_Acquire(Snapshot_Publisher* pub);
+extern void Publisher_Release(Estimator_Snapshot* snap);
+
+#endif
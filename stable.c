@@ -0,0 +1,416 @@
+/*stable.c
+ *Turnstile entropy estimation with stable projections, after Clifford
+ *and Cosma, "A simple sketching algorithm for entropy estimation over
+ *streaming data" (AISTATS 2013).
+ *
+ *Each token i has k values X_ij drawn from the maximally skewed
+ *1-stable distribution scaled so that log E e^(tX) = t ln t for t > 0,
+ *and the sketch keeps the k projections y_j = sum_i f_i X_ij of the
+ *counts f_i. For p_i = f_i/m, sum_i p_i X_ij is then distributed so
+ *that E exp(y_j/m) = exp(sum p_i ln p_i) = exp(-H), and
+ *  H = -ln((1/k) sum_j exp(y_j/m))
+ *estimates the entropy in nats with error about 1.2/sqrt(k) bits.
+ *
+ *The projections are linear in the counts, so an update may be
+ *negative (a deletion) and sketches built with the same k and seed
+ *merge by adding them. There are no samplers, heaps or tables of
+ *tokens: an update adds delta X_ij to each y_j in one dense loop.
+ *
+ *X_ij comes from two uniforms u1 and u2 by Chambers-Mallows-Stuck
+ *(stable_from_uniform in prng.c), which for this distribution splits
+ *into a term in u1 and a term in u2:
+ *  X = phi cot phi + ln(sin phi / phi) + ln W,  phi = pi (1 - u1),
+ *W = -ln u2. Evaluating that costs about 90ns, so the dense loop
+ *interpolates both terms from small tables instead, after taking off
+ *the -1/u1 pole of the first, and a second pass recomputes exactly the
+ *few values with a uniform near a singularity. The uniforms for token
+ *i come from a 4-wise independent hash of i (fourwise) spread over
+ *the k projections with splitmix64. Each 32-bit half of the hash gives
+ *a uniform, a table index and the offset within the interval by
+ *masking and shifting its bits into doubles in [1,2), which takes a
+ *quarter off the loop compared with converting between ints and
+ *doubles.
+ *
+ *The dense loop runs in kernels picked at init as in slowentropy.c:
+ *AVX-512 does 8 projections a step with 64-bit multiplies and gathers
+ *from the tables, AVX2 does 4 with the multiplies split into 32-bit
+ *ones, and the scalar loop takes the rest. All give the same values.
+ *They clear the upper register halves on the way out: without that
+ *the exact values of the second pass, computed by SSE code in libm,
+ *run several times slower, which cost more than the loop saved.
+ *
+ *That still leaves every update O(k), about 4ns a projection with
+ *AVX-512 and 10ns scalar, where Estimator_Update is O(1) amortized: at
+ *k = 512 an insertion costs some 15 times as much as with the sampling
+ *estimator, the price of allowing deletions. Callers that see a token
+ *many times in a row should add up its deltas and update once.
+ */
+
+#include <stdlib.h>
+#include <math.h>
+#include "stablepriv.h"
+#include "prng.h"
+#include "util.h"
+
+#if !defined(STABLE_NO_SIMD) && defined(__GNUC__) && defined(__x86_64__)
+#define STABLE_SIMD 1
+#include <immintrin.h>
+#endif
+
+#define STABLE_SIZE (1 << STABLE_BITS)
+#define STABLE_GOLDEN 0x9E3779B97F4A7C15ULL
+#define STABLE_ONE 0x3FF0000000000000ULL  //bits of 1.0
+#define STABLE_OFFSET_BITS (32 - STABLE_BITS)
+//take off 1, less the half step that centers the value in its interval
+#define STABLE_U_BIAS (1 - 1.0/(1ULL << 33))
+#define STABLE_F_BIAS (1 - 1.0/(1ULL << (STABLE_OFFSET_BITS + 1)))
+
+//splitmix64's output function
+#define STABLE_MIX(z) ((z) = ((z) ^ ((z) >> 30)) * 0xbf58476d1ce4e5b9ULL, \
+                       (z) = ((z) ^ ((z) >> 27)) * 0x94d049bb133111ebULL, \
+                       (z) ^= (z) >> 31)
+
+static int stable_kernel_scalar(Stable_Estimator_type* est, unsigned long long seed,
+                                double d, int from, int to, int nfix);
+#ifdef STABLE_SIMD
+static int stable_kernel_avx2(Stable_Estimator_type* est, unsigned long long seed,
+                              double d, int from, int to, int nfix);
+static int stable_kernel_avx512(Stable_Estimator_type* est, unsigned long long seed,
+                                double d, int from, int to, int nfix);
+#endif
+
+//seed is the hash seed: sketches to be merged must share k and seed
+Stable_Estimator_type* Stable_Estimator_Init(int k, long seed)
+{
+  Stable_Estimator_type* est = (Stable_Estimator_type*) safe_malloc(sizeof(Stable_Estimator_type));
+  prng_type* prng = prng_Init(seed, 2);
+  double u;
+
+  est->k = k;
+  est->seed = seed;
+  for(int i = 0; i < 4; i++)
+  {
+    est->a[i] = prng_int(prng) & MOD;
+    est->b[i] = prng_int(prng) & MOD;
+  }
+  prng_Destroy(prng);
+  est->count = 0;
+  est->y = (double*) safe_malloc(k * sizeof(double));
+  est->x = (double*) safe_malloc(k * sizeof(double));
+  est->fix = (int*) safe_malloc(k * sizeof(int));
+  for(int j = 0; j < k; j++)
+    est->y[j] = 0;
+
+  //the tables at the ends of the singular intervals only need to be
+  //finite: the values there are recomputed
+  est->theta_table = (float*) safe_malloc((STABLE_SIZE+1) * sizeof(float));
+  est->w_table = (float*) safe_malloc((STABLE_SIZE+1) * sizeof(float));
+  for(int i = 0; i <= STABLE_SIZE; i++)
+  {
+    //W = 1 leaves the theta term alone, which is smooth up to u1 = 1
+    u = fmin(fmax((double) i / STABLE_SIZE, STABLE_TAIL), 1 - 1.0/(1 << 20));
+    est->theta_table[i] = stable_exact(u, exp(-1)) + 1/u;
+    u = fmin(fmax((double) i / STABLE_SIZE, STABLE_TAIL), 1 - STABLE_TAIL);
+    est->w_table[i] = log(-log(u));
+  }
+  est->kernel = stable_select_kernel(&est->kernel_name);
+  return est;
+}
+
+//pick the widest projection kernel this CPU supports
+static stable_kernel_fn stable_select_kernel(const char** name)
+{
+#ifdef STABLE_SIMD
+  if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq"))
+  {
+    *name = "avx512";
+    return stable_kernel_avx512;
+  }
+  if(__builtin_cpu_supports("avx2"))
+  {
+    *name = "avx2";
+    return stable_kernel_avx2;
+  }
+#endif
+  *name = "scalar";
+  return stable_kernel_scalar;
+}
+
+//name of the kernel the sketch updates with
+const char* Stable_Estimator_Kernel(Stable_Estimator_type* est)
+{
+  return est->kernel_name;
+}
+
+void Stable_Estimator_Destroy(Stable_Estimator_type* est)
+{
+  free(est->y);
+  free(est->x);
+  free(est->fix);
+  free(est->theta_table);
+  free(est->w_table);
+  free(est);
+}
+
+int Stable_Estimator_Size(Stable_Estimator_type* est)
+{
+  return sizeof(Stable_Estimator_type) + est->k * (2*sizeof(double) + sizeof(int)) +
+         2 * (STABLE_SIZE+1) * sizeof(float);
+}
+
+//count of token changes by delta, which may be negative
+void Stable_Estimator_Update(Stable_Estimator_type* est, int token, long delta)
+{
+  unsigned long long seed = stable_token_seed(est, token), h;
+  double* y = est->y;
+  double u1, u2;
+  int nfix;
+
+  est->count += delta;
+  nfix = est->kernel(est, seed, delta, 0, est->k, 0);
+
+  //exact values where the tables are not accurate
+  for(int f = 0; f < nfix; f++)
+  {
+    int j = est->fix[f];
+    h = seed + (j+1) * STABLE_GOLDEN;
+    STABLE_MIX(h);
+    u1 = ((long long) (h >> 32) + 0.5) * (1.0/4294967296.0);
+    u2 = ((long long) (h & 0xffffffff) + 0.5) * (1.0/4294967296.0);
+    y[j] += delta * (stable_exact(u1, u2) - est->x[j]);
+  }
+}
+
+//add src into dst, which then sketches both streams. Returns 0, or -1
+//if the sketches don't have the same k and seed and can't be merged
+int Stable_Estimator_Merge(Stable_Estimator_type* dst, Stable_Estimator_type* src)
+{
+  if(dst->k != src->k || dst->seed != src->seed)
+    return -1;
+  dst->count += src->count;
+  for(int j = 0; j < dst->k; j++)
+    dst->y[j] += src->y[j];
+  return 0;
+}
+
+//estimate of the entropy, in bits, of the counts so far
+double Stable_Estimator_end_stream(Stable_Estimator_type* est)
+{
+  double sum = 0, h;
+
+  if(est->count <= 0)
+    return 0;
+  for(int j = 0; j < est->k; j++)
+    sum += exp(est->y[j] / est->count);
+  h = -log(sum / est->k) / log(2);
+  return h > 0 ? h : 0;
+}
+
+//64 bits for token from two 4-wise independent hashes
+static unsigned long long stable_token_seed(Stable_Estimator_type* est, int token)
+{
+  unsigned long long hi = fourwise(est->a[0], est->a[1], est->a[2], est->a[3], token);
+  unsigned long long lo = fourwise(est->b[0], est->b[1], est->b[2], est->b[3], token);
+  return hi << 33 ^ lo;
+}
+
+//the double whose IEEE 754 representation is bits
+static inline double stable_from_bits(unsigned long long bits)
+{
+  union { unsigned long long i; double d; } v;
+  v.i = bits;
+  return v.d;
+}
+
+//X from its two uniforms: S(1, -1, 1, 0) scaled by pi/2 and shifted
+//by -ln(pi/2), which gives log E e^(tX) = t ln t
+static double stable_exact(double u1, double u2)
+{
+  return (M_PI/2) * stable_from_uniform(1.0, -1.0, u1, u2) - log(M_PI/2);
+}
+
+//add d X_j to y_j for j in [from, to), keeping each X_j in x and
+//appending to fix, which holds nfix entries on entry, the projections
+//whose X_j the tables get wrong. Returns the new number of entries
+static int stable_kernel_scalar(Stable_Estimator_type* est, unsigned long long seed,
+                                double d, int from, int to, int nfix)
+{
+  const float* theta_table = est->theta_table;
+  const float* w_table = est->w_table;
+  double* y = est->y;
+  double* xs = est->x;
+  int* fix = est->fix;
+  unsigned long long h, a1, a2, mask = (1ULL << STABLE_OFFSET_BITS) - 1;
+  double u1, f1, f2, x;
+  int i1, i2;
+
+  for(int j = from; j < to; j++)
+  {
+    h = seed + (j+1) * STABLE_GOLDEN;
+    STABLE_MIX(h);
+    a1 = h >> 32;
+    a2 = h & 0xffffffff;
+    //(a1 + 1/2)/2^32, the index of its interval and the offset in it
+    u1 = stable_from_bits(STABLE_ONE | a1 << 20) - STABLE_U_BIAS;
+    i1 = a1 >> STABLE_OFFSET_BITS;
+    i2 = a2 >> STABLE_OFFSET_BITS;
+    f1 = stable_from_bits(STABLE_ONE | (a1 & mask) << (52 - STABLE_OFFSET_BITS)) - STABLE_F_BIAS;
+    f2 = stable_from_bits(STABLE_ONE | (a2 & mask) << (52 - STABLE_OFFSET_BITS)) - STABLE_F_BIAS;
+    x = theta_table[i1] + f1 * (theta_table[i1+1] - theta_table[i1]) - 1/u1 +
+        w_table[i2] + f2 * (w_table[i2+1] - w_table[i2]);
+    xs[j] = x;
+    y[j] += d * x;
+    fix[nfix] = j;
+    //u1 or u2 within STABLE_TAIL of a singularity
+    nfix += (a1 >> (32 - STABLE_TAIL_BITS) == 0) | (a2 >> (32 - STABLE_TAIL_BITS) == 0) |
+            (a2 >> (32 - STABLE_TAIL_BITS) == (1 << STABLE_TAIL_BITS) - 1);
+  }
+  return nfix;
+}
+
+#ifdef STABLE_SIMD
+//64-bit low product of each lane of x with c, from 32-bit multiplies
+__attribute__((target("avx2")))
+static inline __m256i stable_mullo_avx2(__m256i x, unsigned long long c)
+{
+  const __m256i lo = _mm256_set1_epi64x(c & 0xffffffff);
+  const __m256i hi = _mm256_set1_epi64x(c >> 32);
+  __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), lo),
+                                   _mm256_mul_epu32(x, hi));
+  return _mm256_add_epi64(_mm256_mul_epu32(x, lo), _mm256_slli_epi64(cross, 32));
+}
+
+//same as stable_kernel_scalar, 4 projections per step. The tables are
+//read with gathers and splitmix64's multiplies split into 32-bit ones
+__attribute__((target("avx2")))
+static int stable_kernel_avx2(Stable_Estimator_type* est, unsigned long long seed,
+                              double d, int from, int to, int nfix)
+{
+  const float* theta_table = est->theta_table;
+  const float* w_table = est->w_table;
+  const __m256i one = _mm256_set1_epi64x(STABLE_ONE);
+  const __m256i mask = _mm256_set1_epi64x((1ULL << STABLE_OFFSET_BITS) - 1);
+  const __m256i low = _mm256_set1_epi64x(0xffffffff);
+  const __m256i top = _mm256_set1_epi64x((1 << STABLE_TAIL_BITS) - 1);
+  const __m256i step = _mm256_set1_epi64x(4 * STABLE_GOLDEN);
+  const __m256d u_bias = _mm256_set1_pd(STABLE_U_BIAS);
+  const __m256d f_bias = _mm256_set1_pd(STABLE_F_BIAS);
+  const __m256d dv = _mm256_set1_pd(d);
+  const __m256d ones = _mm256_set1_pd(1);
+  __m256i h, a1, a2, i1, i2, near;
+  __m256d u1, f1, f2, t0, t1, w0, w1, x;
+  int end = from + (to - from) / 4 * 4, bits;
+
+  h = _mm256_set_epi64x(seed + (from+4) * STABLE_GOLDEN, seed + (from+3) * STABLE_GOLDEN,
+                        seed + (from+2) * STABLE_GOLDEN, seed + (from+1) * STABLE_GOLDEN);
+  for(int j = from; j < end; j += 4)
+  {
+    a1 = _mm256_xor_si256(h, _mm256_srli_epi64(h, 30));
+    a1 = stable_mullo_avx2(a1, 0xbf58476d1ce4e5b9ULL);
+    a1 = _mm256_xor_si256(a1, _mm256_srli_epi64(a1, 27));
+    a1 = stable_mullo_avx2(a1, 0x94d049bb133111ebULL);
+    a2 = _mm256_xor_si256(a1, _mm256_srli_epi64(a1, 31));
+    h = _mm256_add_epi64(h, step);
+    a1 = _mm256_srli_epi64(a2, 32);
+    a2 = _mm256_and_si256(a2, low);
+
+    u1 = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(one, _mm256_slli_epi64(a1, 20))), u_bias);
+    i1 = _mm256_srli_epi64(a1, STABLE_OFFSET_BITS);
+    i2 = _mm256_srli_epi64(a2, STABLE_OFFSET_BITS);
+    f1 = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(one,
+             _mm256_slli_epi64(_mm256_and_si256(a1, mask), 52 - STABLE_OFFSET_BITS))), f_bias);
+    f2 = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(one,
+             _mm256_slli_epi64(_mm256_and_si256(a2, mask), 52 - STABLE_OFFSET_BITS))), f_bias);
+    t0 = _mm256_cvtps_pd(_mm256_i64gather_ps(theta_table, i1, 4));
+    t1 = _mm256_cvtps_pd(_mm256_i64gather_ps(theta_table + 1, i1, 4));
+    w0 = _mm256_cvtps_pd(_mm256_i64gather_ps(w_table, i2, 4));
+    w1 = _mm256_cvtps_pd(_mm256_i64gather_ps(w_table + 1, i2, 4));
+    x = _mm256_add_pd(t0, _mm256_mul_pd(f1, _mm256_sub_pd(t1, t0)));
+    x = _mm256_sub_pd(x, _mm256_div_pd(ones, u1));
+    x = _mm256_add_pd(x, w0);
+    x = _mm256_add_pd(x, _mm256_mul_pd(f2, _mm256_sub_pd(w1, w0)));
+    _mm256_storeu_pd(est->x + j, x);
+    _mm256_storeu_pd(est->y + j, _mm256_add_pd(_mm256_loadu_pd(est->y + j), _mm256_mul_pd(dv, x)));
+
+    a1 = _mm256_srli_epi64(a1, 32 - STABLE_TAIL_BITS);
+    a2 = _mm256_srli_epi64(a2, 32 - STABLE_TAIL_BITS);
+    near = _mm256_or_si256(_mm256_cmpeq_epi64(a1, _mm256_setzero_si256()),
+                           _mm256_or_si256(_mm256_cmpeq_epi64(a2, _mm256_setzero_si256()),
+                                           _mm256_cmpeq_epi64(a2, top)));
+    for(bits = _mm256_movemask_pd(_mm256_castsi256_pd(near)); bits; bits &= bits-1)
+      est->fix[nfix++] = j + __builtin_ctz(bits);
+  }
+  //clear the upper halves, or the SSE code that follows runs slowly
+  _mm256_zeroupper();
+  return stable_kernel_scalar(est, seed, d, end, to, nfix);
+}
+
+//same as stable_kernel_scalar, 8 projections per step
+__attribute__((target("avx512f,avx512dq")))
+static int stable_kernel_avx512(Stable_Estimator_type* est, unsigned long long seed,
+                                double d, int from, int to, int nfix)
+{
+  const float* theta_table = est->theta_table;
+  const float* w_table = est->w_table;
+  const __m512i one = _mm512_set1_epi64(STABLE_ONE);
+  const __m512i mask = _mm512_set1_epi64((1ULL << STABLE_OFFSET_BITS) - 1);
+  const __m512i low = _mm512_set1_epi64(0xffffffff);
+  const __m512i top = _mm512_set1_epi64((1 << STABLE_TAIL_BITS) - 1);
+  const __m512i step = _mm512_set1_epi64(8 * STABLE_GOLDEN);
+  const __m512i m1 = _mm512_set1_epi64(0xbf58476d1ce4e5b9ULL);
+  const __m512i m2 = _mm512_set1_epi64(0x94d049bb133111ebULL);
+  const __m512d u_bias = _mm512_set1_pd(STABLE_U_BIAS);
+  const __m512d f_bias = _mm512_set1_pd(STABLE_F_BIAS);
+  const __m512d dv = _mm512_set1_pd(d);
+  const __m512d ones = _mm512_set1_pd(1);
+  __m512i h, a1, a2, i1, i2;
+  __m512d u1, f1, f2, t0, t1, w0, w1, x;
+  __mmask8 near;
+  int end = from + (to - from) / 8 * 8, bits;
+
+  h = _mm512_set_epi64(seed + (from+8) * STABLE_GOLDEN, seed + (from+7) * STABLE_GOLDEN,
+                       seed + (from+6) * STABLE_GOLDEN, seed + (from+5) * STABLE_GOLDEN,
+                       seed + (from+4) * STABLE_GOLDEN, seed + (from+3) * STABLE_GOLDEN,
+                       seed + (from+2) * STABLE_GOLDEN, seed + (from+1) * STABLE_GOLDEN);
+  for(int j = from; j < end; j += 8)
+  {
+    a1 = _mm512_xor_si512(h, _mm512_srli_epi64(h, 30));
+    a1 = _mm512_mullo_epi64(a1, m1);
+    a1 = _mm512_xor_si512(a1, _mm512_srli_epi64(a1, 27));
+    a1 = _mm512_mullo_epi64(a1, m2);
+    a2 = _mm512_xor_si512(a1, _mm512_srli_epi64(a1, 31));
+    h = _mm512_add_epi64(h, step);
+    a1 = _mm512_srli_epi64(a2, 32);
+    a2 = _mm512_and_si512(a2, low);
+
+    u1 = _mm512_sub_pd(_mm512_castsi512_pd(_mm512_or_si512(one, _mm512_slli_epi64(a1, 20))), u_bias);
+    i1 = _mm512_srli_epi64(a1, STABLE_OFFSET_BITS);
+    i2 = _mm512_srli_epi64(a2, STABLE_OFFSET_BITS);
+    f1 = _mm512_sub_pd(_mm512_castsi512_pd(_mm512_or_si512(one,
+             _mm512_slli_epi64(_mm512_and_si512(a1, mask), 52 - STABLE_OFFSET_BITS))), f_bias);
+    f2 = _mm512_sub_pd(_mm512_castsi512_pd(_mm512_or_si512(one,
+             _mm512_slli_epi64(_mm512_and_si512(a2, mask), 52 - STABLE_OFFSET_BITS))), f_bias);
+    t0 = _mm512_cvtps_pd(_mm512_i64gather_ps(i1, theta_table, 4));
+    t1 = _mm512_cvtps_pd(_mm512_i64gather_ps(i1, theta_table + 1, 4));
+    w0 = _mm512_cvtps_pd(_mm512_i64gather_ps(i2, w_table, 4));
+    w1 = _mm512_cvtps_pd(_mm512_i64gather_ps(i2, w_table + 1, 4));
+    x = _mm512_add_pd(t0, _mm512_mul_pd(f1, _mm512_sub_pd(t1, t0)));
+    x = _mm512_sub_pd(x, _mm512_div_pd(ones, u1));
+    x = _mm512_add_pd(x, w0);
+    x = _mm512_add_pd(x, _mm512_mul_pd(f2, _mm512_sub_pd(w1, w0)));
+    _mm512_storeu_pd(est->x + j, x);
+    _mm512_storeu_pd(est->y + j, _mm512_add_pd(_mm512_loadu_pd(est->y + j), _mm512_mul_pd(dv, x)));
+
+    a1 = _mm512_srli_epi64(a1, 32 - STABLE_TAIL_BITS);
+    a2 = _mm512_srli_epi64(a2, 32 - STABLE_TAIL_BITS);
+    near = _mm512_cmpeq_epi64_mask(a1, _mm512_setzero_si512()) |
+           _mm512_cmpeq_epi64_mask(a2, _mm512_setzero_si512()) |
+           _mm512_cmpeq_epi64_mask(a2, top);
+    for(bits = near; bits; bits &= bits-1)
+      est->fix[nfix++] = j + __builtin_ctz(bits);
+  }
+  //clear the upper halves, or the SSE code that follows runs slowly
+  _mm256_zeroupper();
+  return stable_kernel_scalar(est, seed, d, end, to, nfix);
+}
+#endif
@@ -0,0 +1,35 @@
+#ifndef STABLEPRIV_H
+#define STABLEPRIV_H
+#include "stablepub.h"
+
+//the two parts of a projection value are interpolated from tables of
+//2^STABLE_BITS intervals over (0,1), except within STABLE_TAIL of
+//where they are singular, where they are computed exactly
+#define STABLE_BITS 12
+#define STABLE_TAIL_BITS 8
+#define STABLE_TAIL (1.0/(1 << STABLE_TAIL_BITS))
+
+//adds an update's values to projections [from, to); see stable.c
+typedef int (*stable_kernel_fn)(struct Stable_Estimator_type* est, unsigned long long seed,
+                                double d, int from, int to, int nfix);
+
+struct Stable_Estimator_type{
+  int k;
+  long seed;
+  long long a[4], b[4];    //fourwise hashes giving each token's seed
+  long count;              //sum of the updates
+  double* y;               //the k projections
+  float* theta_table;      //theta term plus 1/u1, by u1
+  float* w_table;          //log W, by u2
+  double* x;               //scratch: values added by one update
+  int* fix;                //scratch: projections to correct
+  stable_kernel_fn kernel; //chosen at init from the CPU's features
+  const char* kernel_name;
+};
+
+static unsigned long long stable_token_seed(Stable_Estimator_type* est, int token);
+static double stable_exact(double u1, double u2);
+static inline double stable_from_bits(unsigned long long bits);
+static stable_kernel_fn stable_select_kernel(const char** name);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef STABLEPUB_H
+#define STABLEPUB_H
+
+typedef struct Stable_Estimator_type Stable_Estimator_type;
+
+extern Stable_Estimator_type* Stable_Estimator_Init(int k, long seed);
+extern void Stable_Estimator_Destroy(Stable_Estimator_type* est);
+extern int Stable_Estimator_Size(Stable_Estimator_type* est);
+extern void Stable_Estimator_Update(Stable_Estimator_type* est, int token, long delta);
+extern int Stable_Estimator_Merge(Stable_Estimator_type* dst, Stable_Estimator_type* src);
+extern double Stable_Estimator_end_stream(Stable_Estimator_type* est);
+extern const char* Stable_Estimator_Kernel(Stable_Estimator_type* est);
+
+#endif
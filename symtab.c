@@ -19,6 +19,8 @@ struct symtab {
   c_a** bucket;
   int size;
   long long a,b;
+  int bytes; //held by the counters and their heaps, kept up to date so
+             //sizeof_symtab needn't walk the table
 };
 
 // private functions
@@ -26,6 +28,7 @@ static void free_c_a( c_a* c );
 static void free_chain( c_a* c );
 static int hash( symtab* tab, int item);
 static c_a* init_c_a( int key);
+static int sizeof_c_a( c_a* c );
 static int c_a_heap_cmp(Sample_type* p, Sample_type* q);
 
 // -----------------------------------------------------
@@ -41,6 +44,7 @@ symtab* new_symtab(int k)
   prng_Destroy(prng);
   
   table->size = k;
+  table->bytes = 0;
   table->bucket = (c_a**) safe_malloc(k * sizeof(c_a*));
   for (int i=0; i<k; i++) {
     table->bucket[ i ] = NULL;
@@ -75,6 +79,50 @@ int lookup( symtab* table, int key )
   return NOT_FOUND;
 }
 
+// Return the counter for key, or NULL if key is not tracked
+c_a* find_c_a( symtab* table, int key )
+{
+  c_a* c = table->bucket[ hash( table, key ) ];
+  while (c != NULL) {
+    if(c->key == key) return c;
+    c = c->next;
+  }
+  return NULL;
+}
+
+// Add a fresh counter for key and return it, or NULL if key is
+// already tracked. Used to rebuild a saved table; list_c_a lists
+// each bucket front to back, so inserting the listed keys in reverse
+// order recreates every bucket in its original order
+c_a* insert_c_a( symtab* table, int key )
+{
+  int bn = hash(table, key);
+  if(find_c_a(table, key) != NULL) return NULL;
+  c_a* n = init_c_a(key);
+  table->bytes += sizeof_c_a(n);
+  n->next = table->bucket[bn];
+  if(table->bucket[bn] != NULL)
+	table->bucket[bn]->previous = n;
+  table->bucket[ bn ] = n;
+  return n;
+}
+
+// Save every tracked counter in out, which must have room for all of
+// them, and return how many there are. With out NULL just count them
+int list_c_a( symtab* table, c_a** out )
+{
+  int n = 0;
+  for(int i = 0; i < table->size; i++)
+  {
+    for(c_a* c = table->bucket[i]; c != NULL; c = c->next)
+    {
+      if(out != NULL) out[n] = c;
+      n++;
+    }
+  }
+  return n;
+}
+
 //decrements number of primary samplers of b. If b
 //is not being processed and not being sampled, b is 
 //removed from hashtable. removes min from b->sample_heap
@@ -103,6 +151,7 @@ void decrement_prim_samplers(symtab* table, c_a* b,
 	    b->previous->next = b->next;
 	    if(b->next != NULL) b->next->previous=b->previous;
 	  }
+	  table->bytes -= sizeof_c_a(b);
 	  free_c_a(b);
 	  return;
     }
@@ -135,6 +184,7 @@ void decrement_backup_samplers(symtab* table, c_a* b)
 	  b->previous->next = b->next;
 	  if(b->next != NULL) b->next->previous=b->previous;
 	}
+	table->bytes -= sizeof_c_a(b);
 	free_c_a(b);
   }
 }
@@ -161,16 +211,20 @@ void done_processing(symtab* table, c_a* b)
 	  b->previous->next = b->next;
 	  if(b->next != NULL) b->next->previous=b->previous;
 	}
+	table->bytes -= sizeof_c_a(b);
 	free_c_a(b);
   }
 }
 
 //precondition: min's wait times set properly
 //postcondition: min is in proper place in backup_heap and in b's sample_heap
-void increment_prim_samplers(c_a* b, backup_heap* h, Sample_type* min)
+void increment_prim_samplers(symtab* table, c_a* b, backup_heap* h,
+                             Sample_type* min)
 {
+  int before = sizeof_c_a_heap(b->sample_heap);
   b->num_prim_samplers++;
   insert_c_a_heap(b->sample_heap, min);
+  table->bytes += sizeof_c_a_heap(b->sample_heap) - before;
   if(b->num_prim_samplers == 1)
   {
     insert_bheap(h, b);
@@ -207,6 +261,7 @@ c_a* increment_count(symtab* table, int key)
   }
   // key not found; create new cell
   c_a* n = init_c_a(key);
+  table->bytes += sizeof_c_a(n);
   n->next = table->bucket[bn];
   if(table->bucket[bn] != NULL)
 	table->bucket[bn]->previous = n;
@@ -253,18 +308,30 @@ int total_elements_tracked(symtab* tab)
 
 int sizeof_symtab(symtab* tab)
 {
-  int size = sizeof(struct symtab) + tab->size * sizeof(c_a**);
+  return sizeof(struct symtab) + tab->size * sizeof(c_a**) + tab->bytes;
+}
+
+//bytes new_symtab(k) takes, before any counter is added
+int sizeof_new_symtab(int k)
+{
+  return sizeof(struct symtab) + k * sizeof(c_a**);
+}
+
+//recompute the bytes held by the counters after their heaps were
+//loaded wholesale, e.g. with load_c_a_heap
+void recount_symtab(symtab* tab)
+{
   c_a* iter;
+  tab->bytes = 0;
   for(int i = 0; i < tab->size; i++)
   {
 	iter = tab->bucket[i];
 	while(iter != NULL)
 	{
-	  size += sizeof(struct c_a) + sizeof_c_a_heap(iter->sample_heap);
+	  tab->bytes += sizeof_c_a(iter);
 	  iter = iter->next;
 	}
   }
-  return size;
 }
 
 // =====================================================
@@ -280,7 +347,7 @@ static c_a* init_c_a( int key)
    value->next = value->previous = NULL;
    value->count = value->processing= 1;
    value->num_prim_samplers = value->num_backup_samplers = 0;
-   value->sample_heap = new_c_a_heap(c_a_heap_cmp, 10);
+   value->sample_heap = new_c_a_heap(c_a_heap_cmp, C_A_HEAP_SIZE);
    value->backup_pos = -1;
    return value;
 }
@@ -304,6 +371,12 @@ static void free_c_a( c_a* c )
   free(c);
 }
 
+// bytes held by a counter and its heap of samplers
+static int sizeof_c_a( c_a* c )
+{
+  return sizeof(struct c_a) + sizeof_c_a_heap(c->sample_heap);
+}
+
 static int c_a_heap_cmp(Sample_type* p, Sample_type* q)
 {
   int a = p->backup_minus_delay;
@@ -8,6 +8,9 @@
 #ifndef SYMTAB_H
 #define SYMTAB_H
 
+//slots a counter's heap of samplers starts with
+#define C_A_HEAP_SIZE 10
+
 /* opaque type */
 typedef struct symtab symtab;
 
@@ -15,12 +18,17 @@ typedef struct symtab symtab;
 symtab* new_symtab( int k );
 void free_symtab( symtab* table );
 int lookup( symtab* table, int key );
+c_a* find_c_a( symtab* table, int key );
+c_a* insert_c_a( symtab* table, int key );
+int list_c_a( symtab* table, c_a** out );
 c_a* increment_count(symtab*, int);
-void increment_prim_samplers(c_a*, backup_heap*, Sample_type*);
+void increment_prim_samplers(symtab*, c_a*, backup_heap*, Sample_type*);
 void decrement_backup_samplers(symtab* table, c_a* b);
 void increment_backup_samplers(c_a* b);
 void done_processing(symtab* table, c_a* b);
 int sizeof_symtab(symtab* tab);
+int sizeof_new_symtab(int k);
+void recount_symtab(symtab* tab);
 int max_row(symtab* table);
 int total_elements_tracked(symtab* tab);
 void decrement_prim_samplers(symtab* , c_a*, 
@@ -5,6 +5,7 @@
  * http://cs-www.cs.yale.edu/homes/fischer/
  ***************************************************************************/
 
+#define _POSIX_C_SOURCE 200112L //for posix_memalign
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
@@ -30,6 +31,18 @@ void* safe_realloc( void *ptr, size_t size )
   return ret;
 }
 
+//--------------------------------------------------------------------------
+// malloc memory aligned to align bytes, a power of two multiple of
+// sizeof(void*), and abort on failure. Release with free
+//--------------------------------------------------------------------------
+void* safe_malloc_aligned( size_t align, size_t size )
+{
+  void* ret;
+  if ( posix_memalign( &ret, align, size ) != 0 )
+    fatal( "safe_malloc_aligned: Out of memory" );
+  return ret;
+}
+
 /* ----------------------------------------------------------------------------
  * Report and exit gracefully from fatal error
  * This function is called like printf().
@@ -10,6 +10,7 @@
 // Prototypes
 void* safe_malloc( size_t size );
 void* safe_realloc( void *ptr, size_t size );
+void* safe_malloc_aligned( size_t align, size_t size );
 void fatal( char* format, ... );
 
 #endif
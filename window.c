@@ -0,0 +1,141 @@
+/* window.c
+ *Sliding-window entropy, on top of the buckets of history.c.
+ *
+ *The window's stream is cut into WINDOW_PERIODS periods per window
+ *width, compacted as in an exponential histogram, and buckets that end
+ *before the window are dropped as it slides. Expiry inside the oldest
+ *bucket is exact for the samples: every sample keeps its time (its
+ *position, for windows of tokens), and its r counts its token up to the
+ *newest token, so any sample inside the window is a valid sample of
+ *the window.
+ *
+ *To keep the sample uniform when buckets of different sizes are put
+ *together, only positions whose tag is below the smallest of the full
+ *buckets' largest tags are used: each bucket has kept every such
+ *position. The window's length is exact for windows of tokens; for
+ *windows of time the part of the oldest bucket inside the window is
+ *estimated from the times of its samples, and so are heavy-hitter
+ *counts of tokens that straddle the edge.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <limits.h>
+#include "window.h"
+#include "util.h"
+
+static long window_start(Window_type* w);
+
+Window_type* Window_Init(int c, int k, long width, int by_time, long slack)
+{
+  Window_type* w = (Window_type*) safe_malloc(sizeof(Window_type));
+  long period = width / WINDOW_PERIODS;
+
+  w->h = History_Init(c, k, period > 0 ? period : 1, WINDOW_PER_LEVEL);
+  w->width = width;
+  w->by_time = by_time;
+  w->slack = slack < 0 ? 0 : slack;
+  w->count = 0;
+  w->now = 0;
+  return w;
+}
+
+void Window_Destroy(Window_type* w)
+{
+  History_Destroy(w->h);
+  free(w);
+}
+
+int Window_Size(Window_type* w)
+{
+  return sizeof(Window_type) + History_Size(w->h);
+}
+
+//add token seen at time. For windows of tokens time is ignored
+void Window_Update(Window_type* w, long time, int token)
+{
+  if(w->by_time)
+  {
+    if(w->count == 0 || time > w->now)
+      w->now = time;
+    else if(time < w->now - w->slack)
+      time = w->now - w->slack;
+  }
+  else
+    time = w->count;
+  w->count++;
+  History_Update(w->h, time, token);
+  if(w->h->nbuckets > 0 && w->h->buckets[0]->end <= window_start(w))
+    History_Expire(w->h, window_start(w));
+}
+
+double Window_Estimate(Window_type* w)
+{
+  History_type* h = w->h;
+  History_Bucket *acc = NULL, *next, *live = NULL;
+  unsigned long long tau = ~0ULL;
+  long start = window_start(w);
+  double m = 0;
+  int n = 0, total = 0;
+  double est;
+
+  if(h->live_count > 0)
+    live = History_Live_Bucket(h);
+  for(int i = 0; i < h->nbuckets; i++)
+  {
+    History_Bucket_Bound(h->buckets[i], h->c, &tau);
+    total += h->buckets[i]->nsamples;
+    m += History_Bucket_Share(h->buckets[i], start, LONG_MAX);
+  }
+  if(live != NULL)
+  {
+    History_Bucket_Bound(live, h->c, &tau);
+    total += live->nsamples;
+    m += History_Bucket_Share(live, start, LONG_MAX);
+  }
+  if(!w->by_time)
+    m = w->count < w->width ? w->count : w->width;
+  if(m < 1)
+  {
+    History_Bucket_Destroy(live);
+    return 0;
+  }
+
+  //keep every sample while merging, then cut to the window
+  for(int i = 0; i < h->nbuckets; i++)
+  {
+    next = History_Bucket_Merge(acc, h->buckets[i], total, h->k);
+    History_Bucket_Destroy(acc);
+    acc = next;
+  }
+  if(live != NULL)
+  {
+    next = History_Bucket_Merge(acc, live, total, h->k);
+    History_Bucket_Destroy(acc);
+    History_Bucket_Destroy(live);
+    acc = next;
+  }
+  for(int i = 0; i < acc->nsamples; i++)
+  {
+    if(acc->samples[i].time >= start && acc->samples[i].tag <= tau)
+      acc->samples[n++] = acc->samples[i];
+  }
+  acc->nsamples = n;
+  acc->count = (long) (m + 0.5);
+  for(int i = 0; i < acc->nfreq; i++)
+  {
+    if(acc->freq[i].count > acc->count)
+      acc->freq[i].count = acc->count;
+  }
+  est = History_Bucket_Estimate(acc);
+  History_Bucket_Destroy(acc);
+  return est;
+}
+
+//first time (or position) inside the window
+static long window_start(Window_type* w)
+{
+  if(w->by_time)
+    return w->now - w->width + 1;
+  return w->count - w->width;
+}
@@ -0,0 +1,30 @@
+/*************************************************************************/
+/* window.h                                                              */
+/*************************************************************************/
+
+#ifndef WINDOW_H
+#define WINDOW_H
+#include "history.h"
+
+#define WINDOW_PERIODS 8    //periods of the history per window
+#define WINDOW_PER_LEVEL 2
+
+//entropy of the last width tokens or, with by_time, of the tokens with
+//times in the last width time units. In time windows a token may be up
+//to slack older than the newest time seen; anything older is counted
+//as slack old
+typedef struct Window_type{
+  History_type* h;
+  long width, slack;
+  int by_time;
+  long count;              //tokens seen
+  long now;                //newest time seen
+} Window_type;
+
+extern Window_type* Window_Init(int c, int k, long width, int by_time, long slack);
+extern void Window_Destroy(Window_type* w);
+extern int Window_Size(Window_type* w);
+extern void Window_Update(Window_type* w, long time, int token);
+extern double Window_Estimate(Window_type* w);
+
+#endif